@@ -125,9 +125,8 @@ int main(
             }
             else if (E.type == SDL_KEYDOWN)
             {
-                if (E.key.keysym.sym == SDLK_ESCAPE) run = false;
-
-                app.handleKeyDown(E.key);
+                // Escape stops a run first, it only quits when there is nothing to stop
+                if (!app.handleKeyDown(E.key) && E.key.keysym.sym == SDLK_ESCAPE) run = false;
             }
             else if (E.type == SDL_KEYUP)
             {
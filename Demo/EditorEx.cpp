@@ -48,6 +48,12 @@ void EditorEx::Reset()
 
 void EditorEx::ClickText(int x, int y)
 {
+    // Clicks in a sensitive margin are handled by NotifyParent
+    if (NotifyMarginClick(Point(x, y), false, false, false))
+    {
+        return;
+    }
+
     _startPos = PositionFromLocation(Point(x, y));
     SetSelection(_startPos, _startPos);
 }
@@ -89,3 +95,18 @@ void EditorEx::OnMouseMoveSelection(int x, int y)
             pdoc->NextWordEnd(pos, 1));
     }
 }
+
+void EditorEx::NotifyParent(SCNotification scn)
+{
+    if (scn.nmhdr.code != SCN_MARGINCLICK)
+    {
+        return;
+    }
+
+    auto line = pdoc->LineFromPosition(scn.position);
+
+    if ((pdoc->GetLevel(line) & SC_FOLDLEVELHEADERFLAG) != 0)
+    {
+        ToggleContraction(line);
+    }
+}
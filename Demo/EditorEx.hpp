@@ -3,6 +3,7 @@
 
 #include <iostream>
 #include <map>
+#include <unordered_map>
 #include <vector>
 
 #include "Platform.h"
@@ -78,6 +79,10 @@ public:
     void OnMouseMoveSelection(int x, int y);
 
     int _startPos;
+
+protected:
+    // Clicking the fold margin folds or unfolds the block that starts on that line
+    void NotifyParent(SCNotification scn);
 };
 
 #endif // EDITOREX_HPP
@@ -114,7 +114,7 @@ void ShaderEditOverlay::renderFullscreen()
     }
 }
 
-void ShaderEditOverlay::handleKeyDown(
+bool ShaderEditOverlay::handleKeyDown(
     const SDL_KeyboardEvent &event)
 {
     UpdateMods(event);
@@ -124,25 +124,25 @@ void ShaderEditOverlay::handleKeyDown(
         case SDLK_f:
             if (_inputState.alt)
             {
-                return;
+                return true;
             }
             break;
     }
 
     if (IComponent::componentWithKeyboardFocus != nullptr)
     {
-        IComponent::componentWithKeyboardFocus->handleKeyDown(event, _inputState);
-
-        return;
+        return IComponent::componentWithKeyboardFocus->handleKeyDown(event, _inputState);
     }
 
     for (auto &componentPtr : _components)
     {
         if (auto component = componentPtr.lock())
         {
-            if (component->handleKeyDown(event, _inputState)) return;
+            if (component->handleKeyDown(event, _inputState)) return true;
         }
     }
+
+    return false;
 }
 
 void ShaderEditOverlay::handleKeyUp(
@@ -23,7 +23,8 @@ public:
     void resize(int w, int h);
     void reset();
 
-    void handleKeyDown(const SDL_KeyboardEvent &event);
+    // Returns true when a component used the key
+    bool handleKeyDown(const SDL_KeyboardEvent &event);
     void handleKeyUp(const SDL_KeyboardEvent &event);
     void handleTextInput(SDL_TextInputEvent &event);
     void handleMouseButtonInput(const SDL_MouseButtonEvent &event);
@@ -2,9 +2,12 @@
 #include "editorcomponent.hpp"
 
 #include "screen-utils.hpp"
+#include <algorithm>
+#include <cctype>
 #include <chrono>
 #include <glad/glad.h>
 #include <math.h>
+#include <unordered_map>
 
 class LexState : public LexInterface
 {
@@ -107,32 +110,94 @@ EditorComponent::EditorComponent(
     mMainEditor.SetLexer(mLexer.get());
 }
 
+EditorComponent::~EditorComponent()
+{
+    // The jobs only write into _jobOutput, which they keep, so they are not waited for
+    if (_contentLoadJob != nullptr)
+    {
+        _contentLoadJob->Cancel();
+    }
+
+    if (_resultGridReadJob != nullptr)
+    {
+        _resultGridReadJob->Cancel();
+    }
+}
+
 void EditorComponent::loadContent(
     const std::string &content)
 {
-    std::lock_guard<std::mutex> lk(_contentLoadMutex);
-    _contentToLoad = content;
+    std::lock_guard<std::mutex> lk(_jobOutput->Mutex);
+    _jobOutput->ContentToLoad = content;
+    _jobOutput->ContentReplacesDocument = true;
+    _jobOutput->ContentFoldsByIndentation = false;
+    _jobOutput->ResultGridToShow = nullptr;
 }
 
-void runThread(
-    EditorComponent *thiz,
+void EditorComponent::loadContentAsync(
     const std::string &title,
     const std::string &content)
 {
-    auto res = thiz->_fileRunnerService->Execute(title, content);
+    int generation;
+    {
+        std::lock_guard<std::mutex> lk(_jobOutput->Mutex);
+        _jobOutput->ContentToLoad.clear();
+        _jobOutput->ContentReplacesDocument = true;
+        _jobOutput->ContentFoldsByIndentation = true;
+        _jobOutput->ResultGridToShow = nullptr;
+        generation = ++_jobOutput->ContentLoadGeneration;
+    }
 
-    std::lock_guard<std::mutex> lk(thiz->_contentLoadMutex);
-    thiz->_contentToLoad = res;
-    thiz->_contentIsLoading = false;
+    // A replaced run stops when it next checks its token, anything it writes
+    // until then is left out because its generation is no longer current
+    if (_contentLoadJob != nullptr)
+    {
+        _contentLoadJob->Cancel();
+    }
+
+    // Output is collected until the next frame appends all of it at once
+    auto jobOutput = _jobOutput;
+    _contentLoadJob = _fileRunnerService->ExecuteAsync(
+        title,
+        content,
+        [jobOutput, generation](std::string_view output) {
+            std::lock_guard<std::mutex> lk(jobOutput->Mutex);
+            if (generation == jobOutput->ContentLoadGeneration)
+            {
+                jobOutput->ContentToLoad.append(output);
+            }
+        },
+        JobPriority::Normal,
+        [jobOutput, generation](const std::shared_ptr<ResultGrid> &grid) {
+            std::lock_guard<std::mutex> lk(jobOutput->Mutex);
+            if (generation == jobOutput->ContentLoadGeneration)
+            {
+                jobOutput->ResultGridToShow = grid;
+            }
+        });
 }
 
-void EditorComponent::loadContentAsync(
-    const std::string &title,
-    const std::string &content)
+bool EditorComponent::cancelRun()
+{
+    if (_contentLoadJob == nullptr || _contentLoadJob->IsCompleted() || _contentLoadJob->Token().IsCancellationRequested())
+    {
+        return false;
+    }
+
+    // A sqlite statement is interrupted right away, the run writes that it was cancelled
+    _contentLoadJob->Cancel();
+
+    return true;
+}
+
+std::string EditorComponent::runProgress()
 {
-    _contentIsLoading = true;
-    std::thread t(runThread, this, title, content);
-    t.detach();
+    if (_contentLoadJob == nullptr || _contentLoadJob->IsCompleted())
+    {
+        return std::string();
+    }
+
+    return _contentLoadJob->Token().Progress();
 }
 
 std::string EditorComponent::getContent()
@@ -153,10 +218,27 @@ bool EditorComponent::init(
     _scrollBarLayer.init(glm::vec2(_origin.x, _origin.y));
     _scrollBarLayer.resize(_origin.x, _origin.y, _width, _height);
     _scrollBarLayer.onScrollY = [&](int diff) {
-        mMainEditor.Scroll(diff, _height);
+        auto rowCount = _resultGrid != nullptr ? _resultGrid->RowCount() : -1;
+        if (rowCount <= 0)
+        {
+            mMainEditor.Scroll(diff, _height);
+            return;
+        }
+
+        auto row = static_cast<long long>(topResultRow()) - static_cast<long long>(diff * (rowCount / float(_height)));
+        showResultRow(static_cast<size_t>(std::clamp(row, 0ll, rowCount - 1)));
     };
     _scrollBarLayer.getScrollInfo = [&](float &start, float &length) {
         mMainEditor.GetScrollBar(start, length);
+
+        // A grid is scrolled over all of its rows, not just the ones in the document
+        auto rowCount = _resultGrid != nullptr ? _resultGrid->RowCount() : -1;
+        if (rowCount > 0)
+        {
+            auto linesOnScreen = mMainEditor.Command(SCI_LINESONSCREEN);
+            start = topResultRow() / float(rowCount);
+            length = std::min(1.0f, linesOnScreen / float(rowCount));
+        }
     };
 
     initialiseShaderEditor();
@@ -168,27 +250,98 @@ bool EditorComponent::init(
     return true;
 }
 
+// lineLength carries the length of the last, unterminated, line from one
+// piece of content to the next
+bool containsLongLine(
+    const std::string &content,
+    size_t &lineLength)
+{
+    size_t lineStart = 0;
+    while (lineStart < content.size())
+    {
+        auto lineEnd = content.find('\n', lineStart);
+        if (lineEnd == std::string::npos)
+        {
+            lineLength += content.size() - lineStart;
+            return lineLength > LineLayout::lengthWindowMax;
+        }
+        if (lineLength + (lineEnd - lineStart) > LineLayout::lengthWindowMax)
+        {
+            return true;
+        }
+        lineLength = 0;
+        lineStart = lineEnd + 1;
+    }
+
+    return false;
+}
+
 void EditorComponent::render(
     const struct InputState &inputState)
 {
-    bool contentIsLoading = false;
+    // Everything received since the last frame is taken in one go so the
+    // thread producing the content only waits for a swap. Completion is checked
+    // first, a completed job has written all of its output already.
+    bool contentIsLoading = _contentLoadJob != nullptr && !_contentLoadJob->IsCompleted();
+    std::string contentToAppend;
+    bool contentReplacesDocument = false;
+    bool contentFoldsByIndentation = false;
+    {
+        std::lock_guard<std::mutex> lk(_jobOutput->Mutex);
+        contentToAppend.swap(_jobOutput->ContentToLoad);
+        contentReplacesDocument = _jobOutput->ContentReplacesDocument;
+        contentFoldsByIndentation = _jobOutput->ContentFoldsByIndentation;
+        _jobOutput->ContentReplacesDocument = false;
+    }
+
+    if (contentReplacesDocument)
+    {
+        clearResultGrid();
+        mMainEditor.Command(SCI_CANCEL);
+        mMainEditor.Command(SCI_CLEARALL);
+        mMainEditor.Command(SCI_SETUNDOCOLLECTION, 0);
+        mMainEditor.Command(SCI_EMPTYUNDOBUFFER);
+        mMainEditor.Command(SCI_SETWRAPMODE, SC_WRAP_WORD);
+        _contentIsAppending = true;
+        _appendedLineLength = 0;
+        _foldingByIndentation = contentFoldsByIndentation;
+        _foldedLineCount = 0;
+    }
+
+    if (!contentToAppend.empty())
     {
-        std::lock_guard<std::mutex> lk(_contentLoadMutex);
-        if (!_contentToLoad.empty())
+        // Wrapping lays out a whole line at once, unwrapped long lines are laid out a window at a time
+        if (containsLongLine(contentToAppend, _appendedLineLength))
         {
-            mMainEditor.Command(SCI_CANCEL);
-            mMainEditor.Command(SCI_CLEARALL);
-            mMainEditor.Command(SCI_SETUNDOCOLLECTION, 0);
-            mMainEditor.Command(SCI_EMPTYUNDOBUFFER);
-            mMainEditor.Command(SCI_ADDTEXT, _contentToLoad.size(), reinterpret_cast<uptr_t>(_contentToLoad.data()));
-            mMainEditor.Command(SCI_SETUNDOCOLLECTION, 1);
-            mMainEditor.Command(SCI_SETSAVEPOINT);
-            mMainEditor.Command(SCI_GOTOPOS, 0);
-            _contentToLoad.clear();
+            mMainEditor.Command(SCI_SETWRAPMODE, SC_WRAP_NONE);
         }
-        contentIsLoading = _contentIsLoading;
+        mMainEditor.Command(SCI_APPENDTEXT, contentToAppend.size(), reinterpret_cast<uptr_t>(contentToAppend.data()));
     }
 
+    if (_foldingByIndentation && (!contentToAppend.empty() || !contentIsLoading))
+    {
+        updateFoldLevels(!contentIsLoading);
+        _foldingByIndentation = contentIsLoading;
+    }
+
+    // Appending leaves the caret at the start where clearing put it, so the
+    // view is not moved away from where the user may have scrolled to meanwhile
+    if (_contentIsAppending && !contentIsLoading)
+    {
+        mMainEditor.Command(SCI_SETUNDOCOLLECTION, 1);
+        mMainEditor.Command(SCI_SETSAVEPOINT);
+        _contentIsAppending = false;
+    }
+
+    // A grid is taken once all of the output before it is in the document
+    if (!contentIsLoading)
+    {
+        updateResultGrid();
+    }
+
+    // The editor is shown as soon as the first content arrives
+    bool waitingForContent = contentIsLoading && mMainEditor.Command(SCI_GETLENGTH) == 0;
+
     (void)inputState;
 
     glEnable(GL_BLEND);
@@ -213,7 +366,7 @@ void EditorComponent::render(
 
     static unsigned __int64 initNow = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
 
-    if (contentIsLoading)
+    if (waitingForContent)
     {
         const float pi = 3.14;
         const float frequency = 0.5f; // Frequency in Hz
@@ -253,6 +406,263 @@ void EditorComponent::render(
     _scrollBarLayer.render(inputState);
 }
 
+// Run output is folded on its indentation, which is the nesting of formatted
+// JSON. The levels are set while the output is appended, a line gets its level
+// once the line after it is complete since that decides whether it starts a block.
+void EditorComponent::updateFoldLevels(
+    bool contentComplete)
+{
+    auto lineCount = static_cast<int>(mMainEditor.Command(SCI_GETLINECOUNT));
+    auto tabWidth = std::max(1, static_cast<int>(mMainEditor.Command(SCI_GETTABWIDTH)));
+    auto lastLine = contentComplete ? lineCount : lineCount - 2;
+
+    auto levelOf = [&](int line) {
+        auto level = static_cast<int>(mMainEditor.Command(SCI_GETLINEINDENTATION, line)) / tabWidth;
+        return std::min(level, SC_FOLDLEVELNUMBERMASK - SC_FOLDLEVELBASE);
+    };
+
+    for (; _foldedLineCount < lastLine; _foldedLineCount++)
+    {
+        auto level = levelOf(_foldedLineCount);
+        auto nextLevel = _foldedLineCount + 1 < lineCount ? levelOf(_foldedLineCount + 1) : 0;
+
+        auto foldLevel = SC_FOLDLEVELBASE + level;
+        if (nextLevel > level)
+        {
+            foldLevel |= SC_FOLDLEVELHEADERFLAG;
+        }
+
+        mMainEditor.Command(SCI_SETFOLDLEVEL, _foldedLineCount, foldLevel);
+    }
+}
+
+void EditorComponent::clearResultGrid()
+{
+    // The handle is kept, the next grid reads its first page once this job
+    // is done. A page it still leaves is of an older generation.
+    if (_resultGridReadJob != nullptr)
+    {
+        _resultGridReadJob->Cancel();
+    }
+    _resultGridGeneration++;
+
+    if (_resultGrid != nullptr)
+    {
+        mMainEditor.Command(SCI_SETREADONLY, 0);
+        _resultGrid = nullptr;
+    }
+
+    std::lock_guard<std::mutex> lk(_jobOutput->Mutex);
+    _jobOutput->GridPage = nullptr;
+}
+
+void DeleteEditorRange(
+    Editor &ed,
+    sptr_t start,
+    sptr_t end)
+{
+    ed.Command(SCI_SETTARGETSTART, start);
+    ed.Command(SCI_SETTARGETEND, end);
+    ed.Command(SCI_REPLACETARGET, 0, reinterpret_cast<sptr_t>(""));
+}
+
+// Pages are read when the view comes within a screen of either end of the
+// rows in the document, the document keeps at most a few pages of rows
+void EditorComponent::updateResultGrid()
+{
+    std::shared_ptr<ResultGrid> gridToShow;
+    std::unique_ptr<ResultGridPage> page;
+    {
+        std::lock_guard<std::mutex> lk(_jobOutput->Mutex);
+        gridToShow.swap(_jobOutput->ResultGridToShow);
+        page.swap(_jobOutput->GridPage);
+    }
+
+    if (gridToShow != nullptr)
+    {
+        _resultGrid = gridToShow;
+        _resultGridGeneration++;
+        _resultGridRows = _resultGrid->RowsWritten();
+        _resultGridFirstRow = 0;
+        _resultGridFirstLine = static_cast<int>(mMainEditor.Command(SCI_GETLINECOUNT)) - 1 - static_cast<int>(_resultGridRows);
+        _resultGridEnded = false;
+        _resultGridSeekRow = -1;
+
+        // Rows are replaced as the view moves, so they are not edited and not
+        // wrapped, a row has to stay one line
+        mMainEditor.Command(SCI_SETWRAPMODE, SC_WRAP_NONE);
+        mMainEditor.Command(SCI_SETREADONLY, 1);
+    }
+
+    if (_resultGrid == nullptr)
+    {
+        return;
+    }
+
+    if (page != nullptr && page->Generation == _resultGridGeneration)
+    {
+        applyResultGridPage(*page);
+    }
+
+    if (_resultGridReadJob != nullptr && !_resultGridReadJob->IsCompleted())
+    {
+        return;
+    }
+
+    auto pageRows = std::max<size_t>(1, _resultGrid->RowsWritten());
+    auto firstVisible = static_cast<int>(mMainEditor.Command(SCI_GETFIRSTVISIBLELINE));
+    auto linesOnScreen = static_cast<int>(mMainEditor.Command(SCI_LINESONSCREEN));
+
+    if (_resultGridSeekRow >= 0)
+    {
+        auto row = static_cast<size_t>(_resultGridSeekRow);
+        if (row >= _resultGridFirstRow && row < _resultGridFirstRow + _resultGridRows)
+        {
+            _resultGridSeekRow = -1;
+            showResultRow(row);
+            return;
+        }
+
+        auto firstRow = row > pageRows ? row - pageRows : 0;
+        readResultRows(firstRow, pageRows * 2, _resultGridSeekRow);
+    }
+    else if (!_resultGridEnded && firstVisible + 2 * linesOnScreen >= _resultGridFirstLine + static_cast<int>(_resultGridRows))
+    {
+        readResultRows(_resultGridFirstRow + _resultGridRows, pageRows, -1);
+    }
+    else if (_resultGridFirstRow > 0 && firstVisible < _resultGridFirstLine + linesOnScreen)
+    {
+        auto firstRow = _resultGridFirstRow > pageRows ? _resultGridFirstRow - pageRows : 0;
+        readResultRows(firstRow, _resultGridFirstRow - firstRow, -1);
+    }
+}
+
+void EditorComponent::readResultRows(
+    size_t firstRow,
+    size_t count,
+    long long seekRow)
+{
+    auto generation = _resultGridGeneration;
+    auto jobOutput = _jobOutput;
+
+    _resultGridReadJob = _fileRunnerService->ReadRowsAsync(
+        _resultGrid,
+        firstRow,
+        count,
+        [jobOutput, generation, firstRow, count, seekRow](std::string &lines, size_t rows) {
+            auto page = std::make_unique<ResultGridPage>();
+            page->Generation = generation;
+            page->FirstRow = firstRow;
+            page->RequestedRows = count;
+            page->Rows = rows;
+            page->Lines.swap(lines);
+            page->SeekRow = seekRow;
+
+            std::lock_guard<std::mutex> lk(jobOutput->Mutex);
+            jobOutput->GridPage = std::move(page);
+        });
+}
+
+void EditorComponent::applyResultGridPage(
+    const ResultGridPage &page)
+{
+    auto maxRows = std::max<size_t>(1, _resultGrid->RowsWritten()) * 4;
+    auto firstVisible = static_cast<long long>(mMainEditor.Command(SCI_GETFIRSTVISIBLELINE));
+    auto rowsStart = mMainEditor.Command(SCI_POSITIONFROMLINE, _resultGridFirstLine);
+    auto rowCount = _resultGrid->RowCount();
+
+    mMainEditor.Command(SCI_SETREADONLY, 0);
+
+    if (page.SeekRow >= 0)
+    {
+        DeleteEditorRange(mMainEditor, rowsStart, mMainEditor.Command(SCI_GETLENGTH));
+        mMainEditor.Command(SCI_APPENDTEXT, page.Lines.size(), reinterpret_cast<sptr_t>(page.Lines.data()));
+
+        _resultGridFirstRow = page.FirstRow;
+        _resultGridRows = page.Rows;
+        _resultGridEnded = page.Rows < page.RequestedRows;
+
+        auto seekRow = static_cast<size_t>(page.SeekRow);
+        firstVisible = _resultGridFirstLine + static_cast<long long>(std::min(seekRow - std::min(seekRow, page.FirstRow), page.Rows));
+
+        // A row asked for while this page was read is read next
+        if (_resultGridSeekRow == page.SeekRow)
+        {
+            _resultGridSeekRow = -1;
+        }
+    }
+    else if (page.FirstRow == _resultGridFirstRow + _resultGridRows)
+    {
+        mMainEditor.Command(SCI_APPENDTEXT, page.Lines.size(), reinterpret_cast<sptr_t>(page.Lines.data()));
+
+        _resultGridRows += page.Rows;
+        _resultGridEnded = page.Rows < page.RequestedRows;
+
+        // Rows scrolled past are dropped from the top
+        if (_resultGridRows > maxRows)
+        {
+            auto dropped = _resultGridRows - maxRows;
+            auto droppedEnd = mMainEditor.Command(SCI_POSITIONFROMLINE, _resultGridFirstLine + static_cast<int>(dropped));
+            DeleteEditorRange(mMainEditor, rowsStart, droppedEnd);
+
+            _resultGridFirstRow += dropped;
+            _resultGridRows = maxRows;
+            firstVisible -= static_cast<long long>(dropped);
+        }
+    }
+    else if (page.FirstRow + page.Rows == _resultGridFirstRow)
+    {
+        mMainEditor.Command(SCI_INSERTTEXT, rowsStart, reinterpret_cast<sptr_t>(page.Lines.c_str()));
+
+        _resultGridFirstRow = page.FirstRow;
+        _resultGridRows += page.Rows;
+        firstVisible += static_cast<long long>(page.Rows);
+
+        // Rows scrolled past are dropped from the bottom
+        if (_resultGridRows > maxRows)
+        {
+            auto keptEnd = mMainEditor.Command(SCI_POSITIONFROMLINE, _resultGridFirstLine + static_cast<int>(maxRows));
+            DeleteEditorRange(mMainEditor, keptEnd, mMainEditor.Command(SCI_GETLENGTH));
+
+            _resultGridRows = maxRows;
+            _resultGridEnded = false;
+        }
+    }
+
+    if (rowCount >= 0 && _resultGridFirstRow + _resultGridRows >= static_cast<size_t>(rowCount))
+    {
+        _resultGridEnded = true;
+    }
+
+    mMainEditor.Command(SCI_SETREADONLY, 1);
+    mMainEditor.Command(SCI_SETFIRSTVISIBLELINE, static_cast<uptr_t>(std::max(0ll, firstVisible)));
+}
+
+size_t EditorComponent::topResultRow()
+{
+    auto firstVisible = static_cast<int>(mMainEditor.Command(SCI_GETFIRSTVISIBLELINE));
+
+    return _resultGridFirstRow + static_cast<size_t>(std::max(0, firstVisible - _resultGridFirstLine));
+}
+
+void EditorComponent::showResultRow(
+    size_t row)
+{
+    if (_resultGrid == nullptr)
+    {
+        return;
+    }
+
+    if (row >= _resultGridFirstRow && row < _resultGridFirstRow + _resultGridRows)
+    {
+        mMainEditor.Command(SCI_SETFIRSTVISIBLELINE, _resultGridFirstLine + (row - _resultGridFirstRow));
+        return;
+    }
+
+    // Read by render once the page that is being read is done
+    _resultGridSeekRow = static_cast<long long>(row);
+}
+
 void EditorComponent::resize(
     int x,
     int y,
@@ -275,6 +685,8 @@ bool EditorComponent::handleKeyDown(
 {
     if (_scrollBarLayer.handleKeyDown(event, inputState)) return true;
 
+    if (event.keysym.sym == SDLK_ESCAPE && cancelRun()) return true;
+
     int sciKey;
     switch (event.keysym.sym)
     {
@@ -626,6 +1038,55 @@ const char cppKeyword2[] = {
     "byte ",
 };
 
+// Lower case, the SQL lexer compares words in lower case
+const char sqlKeyword[] = {
+    "abort action add after all alter analyze and as asc attach autoincrement "
+    "before begin between by cascade case cast check collate column commit conflict constraint create cross "
+    "current current_date current_time current_timestamp database default deferrable deferred delete desc "
+    "detach distinct do drop each else end escape except exclusive exists explain fail fetch filter first for "
+    "foreign from full glob go group having identity if ignore immediate in index indexed initially inner insert "
+    "instead intersect into is isnull join key last left like limit match merge natural no not nothing notnull "
+    "null nulls of offset on or order outer over partition pragma primary procedure query raise range recursive "
+    "references regexp reindex release rename replace restrict returning right rollback row rows savepoint "
+    "select set table temp temporary then to top transaction trigger truncate union unique update use using "
+    "vacuum values view virtual when where window with without "
+};
+
+const char sqlKeyword2[] = {
+    "bigint binary bit blob boolean char date datetime datetime2 decimal double float int integer "
+    "money nchar ntext numeric nvarchar real smallint text time timestamp tinyint uniqueidentifier "
+    "varbinary varchar "
+    "avg coalesce count ifnull max min nullif sum "
+};
+
+// The lexer of a file by its extension. Only lexers that number their
+// styles like the C++ one are listed, as the editor colours those.
+struct ExtensionLexer
+{
+    int Lexer;
+    const char *Keywords;
+    const char *Keywords2;
+};
+
+const std::unordered_map<std::string, ExtensionLexer> extensionLexers = {
+    {".c", {SCLEX_CPP, cppKeyword, cppKeyword2}},
+    {".cc", {SCLEX_CPP, cppKeyword, cppKeyword2}},
+    {".cpp", {SCLEX_CPP, cppKeyword, cppKeyword2}},
+    {".cxx", {SCLEX_CPP, cppKeyword, cppKeyword2}},
+    {".h", {SCLEX_CPP, cppKeyword, cppKeyword2}},
+    {".hh", {SCLEX_CPP, cppKeyword, cppKeyword2}},
+    {".hpp", {SCLEX_CPP, cppKeyword, cppKeyword2}},
+    {".hxx", {SCLEX_CPP, cppKeyword, cppKeyword2}},
+    {".inl", {SCLEX_CPP, cppKeyword, cppKeyword2}},
+    {".glsl", {SCLEX_CPP, cppKeyword, cppKeyword2}},
+    {".frag", {SCLEX_CPP, cppKeyword, cppKeyword2}},
+    {".vert", {SCLEX_CPP, cppKeyword, cppKeyword2}},
+    {".sql", {SCLEX_SQL, sqlKeyword, sqlKeyword2}},
+    {".csv", {SCLEX_NULL, "", ""}},
+    {".log", {SCLEX_NULL, "", ""}},
+    {".txt", {SCLEX_NULL, "", ""}},
+};
+
 const size_t NB_FOLDER_STATE = 7;
 const size_t FOLDER_TYPE = 0;
 const int markersArray[][NB_FOLDER_STATE] = {
@@ -667,6 +1128,7 @@ void EditorComponent::initialiseShaderEditor()
 
     mMainEditor.Command(SCI_SETMARGINWIDTHN, 0, _fontSize * 4);  // Calculate correct width
     mMainEditor.Command(SCI_SETMARGINMASKN, 1, SC_MASK_FOLDERS); // Calculate correct width
+    mMainEditor.Command(SCI_SETMARGINSENSITIVEN, 1, 1);
 
     for (size_t i = 0; i < NB_FOLDER_STATE; i++)
     {
@@ -678,6 +1140,7 @@ void EditorComponent::initialiseShaderEditor()
     mMainEditor.Command(SCI_SETUSETABS, 1);
     mMainEditor.Command(SCI_SETTABWIDTH, 4);
     mMainEditor.Command(SCI_SETINDENTATIONGUIDES, SC_IV_REAL);
+    mMainEditor.Command(SCI_ALLOCATELINECHARACTERINDEX, SC_LINECHARACTERINDEX_UTF32); // Responses can be single multi-megabyte lines
 
     SetAStyle(mMainEditor, SCE_C_DEFAULT, MakeRGBA(214, 207, 154), 0xFF333333);
     SetAStyle(mMainEditor, SCE_C_IDENTIFIER, MakeRGBA(214, 207, 154), 0xFF333333);
@@ -695,3 +1158,22 @@ void EditorComponent::initialiseShaderEditor()
     SetAStyle(mMainEditor, SCE_C_COMMENTDOC, MakeRGBA(168, 171, 176), 0xFF333333);
     SetAStyle(mMainEditor, SCE_C_COMMENTDOCKEYWORDERROR, MakeRGBA(168, 171, 176), 0xFF333333);
 }
+
+void EditorComponent::setLexerForFile(
+    const std::filesystem::path &fileName)
+{
+    auto extension = fileName.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    // Other files, like .http, keep the C++ lexer they start with
+    auto found = extensionLexers.find(extension);
+    if (found == extensionLexers.end())
+    {
+        return;
+    }
+
+    mLexer->SetLexer(found->second.Lexer);
+    mLexer->SetWordList(0, found->second.Keywords);
+    mLexer->SetWordList(1, found->second.Keywords2);
+    mLexer->PropSet("fold", "0");
+}
@@ -16,7 +16,7 @@ public:
     EditorComponent(
         const std::unique_ptr<FileRunnerService> &fileRunnerService);
 
-    virtual ~EditorComponent() = default;
+    virtual ~EditorComponent();
 
     bool init(const glm::vec2 &origin);
 
@@ -39,6 +39,20 @@ public:
 
     std::string getContent();
 
+    // Stops the run that loads the content, returns false when nothing was running
+    bool cancelRun();
+
+    // How far the run that loads the content got, empty when nothing is running
+    std::string runProgress();
+
+    // Scrolls a result grid to a row, reading the rows around it when they are not shown
+    void showResultRow(
+        size_t row);
+
+    // Styles the content with the lexer for the extension of the file
+    void setLexerForFile(
+        const std::filesystem::path &fileName);
+
     void tick() { mMainEditor.Tick(); }
     bool isUnTouched();
 
@@ -49,9 +63,54 @@ private:
     const std::unique_ptr<FileRunnerService> &_fileRunnerService;
     ScrollBarComponent _scrollBarLayer;
     EditorEx mMainEditor;
-    std::mutex _contentLoadMutex;
-    std::string _contentToLoad;
-    bool _contentIsLoading = false;
+    std::shared_ptr<JobHandle> _contentLoadJob;
+
+    struct ResultGridPage
+    {
+        // The _resultGridGeneration of the grid the page was read for
+        int Generation;
+        size_t FirstRow;
+        size_t RequestedRows;
+        size_t Rows;
+        std::string Lines;
+        // The row to show for a page that replaces the rows, -1 for one that adds to them
+        long long SeekRow;
+    };
+
+    // What the jobs leave for render to take. The jobs hold on to it instead
+    // of the component, so a job that is replaced, or still running when the
+    // component goes, is not waited for.
+    struct JobOutput
+    {
+        std::mutex Mutex;
+        std::string ContentToLoad;
+        bool ContentReplacesDocument = false;
+        bool ContentFoldsByIndentation = false;
+        int ContentLoadGeneration = 0;
+
+        // A result set that is shown a page at a time and the last page read for it
+        std::shared_ptr<ResultGrid> ResultGridToShow;
+        std::unique_ptr<ResultGridPage> GridPage;
+    };
+
+    std::shared_ptr<JobOutput> _jobOutput = std::make_shared<JobOutput>();
+
+    // Only used from render, while appended content is being loaded
+    bool _contentIsAppending = false;
+    size_t _appendedLineLength = 0;
+    bool _foldingByIndentation = false;
+    int _foldedLineCount = 0;
+
+    // Only used from render and input, the rows of the grid that are in the
+    // document are the lines from _resultGridFirstLine to the end
+    std::shared_ptr<ResultGrid> _resultGrid;
+    int _resultGridGeneration = 0;
+    std::shared_ptr<JobHandle> _resultGridReadJob;
+    int _resultGridFirstLine = 0;
+    size_t _resultGridFirstRow = 0;
+    size_t _resultGridRows = 0;
+    bool _resultGridEnded = false;
+    long long _resultGridSeekRow = -1;
 
     const int defaultFontSize = 14;
     int _fontSize = defaultFontSize;
@@ -60,10 +119,23 @@ private:
 
     void initialiseShaderEditor();
 
-    friend void runThread(
-        EditorComponent *thiz,
-        const std::string &title,
-        const std::string &content);
+    void updateFoldLevels(
+        bool contentComplete);
+
+    void clearResultGrid();
+
+    void updateResultGrid();
+
+    void applyResultGridPage(
+        const ResultGridPage &page);
+
+    void readResultRows(
+        size_t firstRow,
+        size_t count,
+        long long seekRow);
+
+    // The row at the top of the view
+    size_t topResultRow();
 };
 
 #endif // EDITORLAYER_HPP
@@ -0,0 +1,316 @@
+#include "executorservice.hpp"
+
+#include <exception>
+
+bool CancellationToken::IsCancellationRequested() const
+{
+    return _cancellationRequested.load(std::memory_order_relaxed);
+}
+
+void CancellationToken::Cancel()
+{
+    std::unique_lock<std::mutex> lock(_callbacksMutex);
+
+    // Callbacks added from here on are called by AddCancelCallback
+    if (_cancellationRequested.exchange(true))
+    {
+        return;
+    }
+
+    std::vector<size_t> ids;
+    for (auto &callback : _cancelCallbacks)
+    {
+        ids.push_back(callback.first);
+    }
+
+    _cancellingThread = std::this_thread::get_id();
+
+    for (auto id : ids)
+    {
+        // Skips the callbacks that were removed by the ones before them
+        auto found = _cancelCallbacks.find(id);
+        if (found == _cancelCallbacks.end())
+        {
+            continue;
+        }
+
+        auto callback = found->second;
+        _callbackRunning = true;
+        _runningCallbackId = id;
+
+        lock.unlock();
+        callback();
+        lock.lock();
+
+        _callbackRunning = false;
+        _callbackFinished.notify_all();
+    }
+}
+
+size_t CancellationToken::AddCancelCallback(
+    const std::function<void()> &callback) const
+{
+    std::unique_lock<std::mutex> lock(_callbacksMutex);
+
+    auto id = _nextCallbackId++;
+    if (!_cancellationRequested.load(std::memory_order_relaxed))
+    {
+        _cancelCallbacks[id] = callback;
+        return id;
+    }
+
+    lock.unlock();
+    callback();
+
+    return id;
+}
+
+void CancellationToken::RemoveCancelCallback(
+    size_t id) const
+{
+    std::unique_lock<std::mutex> lock(_callbacksMutex);
+
+    _cancelCallbacks.erase(id);
+
+    if (_cancellingThread != std::this_thread::get_id())
+    {
+        _callbackFinished.wait(lock, [this, id]() { return !_callbackRunning || _runningCallbackId != id; });
+    }
+}
+
+void CancellationToken::ReportProgress(
+    const std::string &progress) const
+{
+    std::lock_guard<std::mutex> lock(_progressMutex);
+
+    _progress = progress;
+}
+
+std::string CancellationToken::Progress() const
+{
+    std::lock_guard<std::mutex> lock(_progressMutex);
+
+    return _progress;
+}
+
+CancellationTokenRegistration::CancellationTokenRegistration(
+    const CancellationToken &token,
+    const std::function<void()> &callback)
+    : _token(token),
+      _id(token.AddCancelCallback(callback))
+{}
+
+CancellationTokenRegistration::~CancellationTokenRegistration()
+{
+    _token.RemoveCancelCallback(_id);
+}
+
+JobHandle::JobHandle() = default;
+
+JobHandle::~JobHandle() = default;
+
+void JobHandle::Cancel()
+{
+    _token.Cancel();
+}
+
+bool JobHandle::IsCompleted()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return _completed;
+}
+
+void JobHandle::Wait()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    _completedChanged.wait(lock, [this]() { return _completed; });
+}
+
+bool JobHandle::WaitFor(
+    std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    return _completedChanged.wait_for(lock, timeout, [this]() { return _completed; });
+}
+
+const CancellationToken &JobHandle::Token() const
+{
+    return _token;
+}
+
+std::string JobHandle::Error()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return _error;
+}
+
+void JobHandle::Fail(
+    const std::string &error)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _error = error;
+}
+
+void JobHandle::Complete()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _completed = true;
+    }
+
+    _completedChanged.notify_all();
+}
+
+bool ExecutorService::QueuedJob::operator<(
+    const QueuedJob &other) const
+{
+    // std::priority_queue takes the largest element first
+    if (priority != other.priority)
+    {
+        return priority < other.priority;
+    }
+
+    return sequence > other.sequence;
+}
+
+ExecutorService::ExecutorService(
+    size_t workerCount)
+{
+    if (workerCount == 0)
+    {
+        workerCount = 1;
+    }
+
+    for (size_t i = 0; i < workerCount; i++)
+    {
+        _workers.emplace_back(&ExecutorService::Work, this);
+    }
+}
+
+ExecutorService::~ExecutorService()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+
+    _jobQueued.notify_all();
+
+    for (auto &worker : _workers)
+    {
+        worker.join();
+    }
+}
+
+std::shared_ptr<JobHandle> ExecutorService::Submit(
+    const std::function<void(const CancellationToken &)> &job,
+    JobPriority priority)
+{
+    auto handle = std::make_shared<JobHandle>();
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (_stopping)
+        {
+            handle->Cancel();
+            handle->Complete();
+
+            return handle;
+        }
+
+        _queue.push(QueuedJob{priority, _nextSequence++, job, handle});
+    }
+
+    _jobQueued.notify_one();
+
+    return handle;
+}
+
+void ExecutorService::Work()
+{
+    while (true)
+    {
+        QueuedJob queued;
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+
+            _jobQueued.wait(lock, [this]() { return _stopping || !_queue.empty(); });
+
+            if (_stopping)
+            {
+                // Jobs that did not start are completed without running them
+                while (!_queue.empty())
+                {
+                    _queue.top().handle->Cancel();
+                    _queue.top().handle->Complete();
+                    _queue.pop();
+                }
+
+                return;
+            }
+
+            queued = _queue.top();
+            _queue.pop();
+            queued.handle->_started = true;
+        }
+
+        Run(queued);
+    }
+}
+
+void ExecutorService::Wait(
+    const std::shared_ptr<JobHandle> &handle)
+{
+    while (true)
+    {
+        QueuedJob queued;
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            // A job that started, or that is not queued anymore, only has to be waited for
+            if (handle->_started || _queue.empty())
+            {
+                break;
+            }
+
+            queued = _queue.top();
+            _queue.pop();
+            queued.handle->_started = true;
+        }
+
+        Run(queued);
+    }
+
+    handle->Wait();
+}
+
+void ExecutorService::Run(
+    QueuedJob &queued)
+{
+    if (!queued.handle->Token().IsCancellationRequested())
+    {
+        try
+        {
+            queued.job(queued.handle->Token());
+        }
+        catch (const std::exception &e)
+        {
+            // A failing job must not take its worker down with it
+            queued.handle->Fail(e.what());
+        }
+        catch (...)
+        {
+            queued.handle->Fail("unknown error");
+        }
+    }
+
+    queued.handle->Complete();
+}
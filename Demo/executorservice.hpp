@@ -0,0 +1,177 @@
+#ifndef EXECUTORSERVICE_HPP
+#define EXECUTORSERVICE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class JobPriority
+{
+    Low,
+    Normal,
+    High,
+};
+
+// Set once a job is cancelled, jobs check it at points where they can stop early.
+// A running job can also describe how far it got through it.
+class CancellationToken
+{
+public:
+    bool IsCancellationRequested() const;
+
+    void Cancel();
+
+    // Called from Cancel, on the thread that cancels, for work that does not
+    // check the token often enough. A callback added after Cancel is called
+    // right away. Once RemoveCancelCallback returns the callback is no longer
+    // running and will not be called anymore, unless it is removed from
+    // inside the callback itself.
+    size_t AddCancelCallback(
+        const std::function<void()> &callback) const;
+
+    void RemoveCancelCallback(
+        size_t id) const;
+
+    void ReportProgress(
+        const std::string &progress) const;
+
+    std::string Progress() const;
+
+private:
+    std::atomic<bool> _cancellationRequested{false};
+
+    // Callbacks run without the mutex held, so they can add and remove
+    // callbacks themselves. Removing the one that runs waits for it.
+    mutable std::mutex _callbacksMutex;
+    mutable std::condition_variable _callbackFinished;
+    mutable std::map<size_t, std::function<void()>> _cancelCallbacks;
+    mutable size_t _nextCallbackId = 0;
+    bool _callbackRunning = false;
+    size_t _runningCallbackId = 0;
+    std::thread::id _cancellingThread;
+
+    mutable std::mutex _progressMutex;
+    mutable std::string _progress;
+};
+
+// Adds a cancel callback for the scope it is declared in, it is removed
+// again however the scope is left
+class CancellationTokenRegistration
+{
+public:
+    CancellationTokenRegistration(
+        const CancellationToken &token,
+        const std::function<void()> &callback);
+
+    CancellationTokenRegistration(
+        const CancellationTokenRegistration &) = delete;
+
+    CancellationTokenRegistration &operator=(
+        const CancellationTokenRegistration &) = delete;
+
+    virtual ~CancellationTokenRegistration();
+
+private:
+    const CancellationToken &_token;
+    size_t _id;
+};
+
+// The side of a submitted job that the code submitting it keeps, to cancel
+// the job or wait for it to complete.
+class JobHandle
+{
+public:
+    JobHandle();
+
+    virtual ~JobHandle();
+
+public:
+    // A job that has not started yet is not run at all
+    void Cancel();
+
+    bool IsCompleted();
+
+    void Wait();
+
+    // Returns false when the job did not complete within timeout
+    bool WaitFor(
+        std::chrono::milliseconds timeout);
+
+    const CancellationToken &Token() const;
+
+    // What the job threw, empty when it returned
+    std::string Error();
+
+private:
+    CancellationToken _token;
+    std::mutex _mutex;
+    std::condition_variable _completedChanged;
+    bool _completed = false;
+    std::string _error;
+
+    // Set by the executor when a worker takes the job, guarded by its mutex
+    bool _started = false;
+
+    void Complete();
+
+    void Fail(
+        const std::string &error);
+
+    friend class ExecutorService;
+};
+
+// Runs jobs on a fixed number of worker threads, higher priority jobs first
+// and jobs of the same priority in the order they were submitted.
+class ExecutorService
+{
+public:
+    ExecutorService(
+        size_t workerCount);
+
+    // Cancels the jobs that are still queued and waits for the running ones
+    virtual ~ExecutorService();
+
+public:
+    std::shared_ptr<JobHandle> Submit(
+        const std::function<void(const CancellationToken &)> &job,
+        JobPriority priority = JobPriority::Normal);
+
+    // For a job that waits on jobs it submitted. While the job waited for has
+    // not started, the waiting thread runs queued jobs itself, so jobs that
+    // wait on other jobs can not hold all of the workers between them.
+    void Wait(
+        const std::shared_ptr<JobHandle> &handle);
+
+private:
+    struct QueuedJob
+    {
+        JobPriority priority;
+        unsigned long long sequence;
+        std::function<void(const CancellationToken &)> job;
+        std::shared_ptr<JobHandle> handle;
+
+        bool operator<(const QueuedJob &other) const;
+    };
+
+    std::mutex _mutex;
+    std::condition_variable _jobQueued;
+    std::priority_queue<QueuedJob> _queue;
+    unsigned long long _nextSequence = 0;
+    bool _stopping = false;
+    std::vector<std::thread> _workers;
+
+    void Work();
+
+    void Run(
+        QueuedJob &queued);
+};
+
+#endif // EXECUTORSERVICE_HPP
@@ -1,9 +1,11 @@
 #include "filerunnerservice.hpp"
 
+#include <algorithm>
 #include <assert.h>
 #include <chrono>
 #include <cstdio>
 #include <filesystem>
+#include <iterator>
 #include <libtcc.h>
 #include <sstream>
 #include <stdio.h>
@@ -49,7 +51,8 @@ void demo_perms(
 std::string FileRunnerService::ExecuteC(
     const std::string &firstLine,
     const std::map<std::string, std::string> &headers,
-    const std::vector<std::string> &lines)
+    const std::vector<std::string> &lines,
+    const CancellationToken &cancellationToken)
 {
     TCCState *s;
     std::stringstream result;
@@ -119,6 +122,13 @@ std::string FileRunnerService::ExecuteC(
 
         for (const auto &entry : itr)
         {
+            if (cancellationToken.IsCancellationRequested())
+            {
+                result << "\nCancelled\n";
+
+                break;
+            }
+
             if (filter(entry.path().string().c_str()) == 1)
             {
                 if (flags & SHOW_FILE_SIZE)
@@ -1,25 +1,110 @@
 #include "filerunnerservice.hpp"
 
 #include "stringhelpers.hpp"
+#include <algorithm>
+#include <exception>
 #include <filesystem>
 #include <httpclient.hpp>
+#include <httpresponsecache.hpp>
 #include <string>
 #include <stringcontent.hpp>
 #include <vector>
 
-FileRunnerService::FileRunnerService() {}
+FileRunnerService::FileRunnerService()
+    : _httpMessageHandler(std::make_shared<HttpMessageHandler>()),
+      _executor(std::max(2u, std::thread::hardware_concurrency()))
+{
+    // Requests with "-- Cache: true" keep their responses between runs, so
+    // running a request for a large resource that did not change again only
+    // costs a revalidation
+    std::error_code error;
+    auto cacheDirectory = std::filesystem::temp_directory_path(error) / "scintillagl-http-cache";
+
+    _httpResponseCache = std::make_shared<HttpResponseCache>(error ? std::string() : cacheDirectory.string());
+}
 
 std::string FileRunnerService::Execute(
     const std::string &title,
     const std::string &content)
+{
+    std::string result;
+    CancellationToken neverCancelled;
+
+    Execute(
+        title,
+        content,
+        [&](std::string_view output) {
+            result.append(output);
+        },
+        neverCancelled);
+
+    return result;
+}
+
+std::shared_ptr<JobHandle> FileRunnerService::ExecuteAsync(
+    const std::string &title,
+    const std::string &content,
+    const std::function<void(std::string_view)> &write,
+    JobPriority priority,
+    const std::function<void(const std::shared_ptr<ResultGrid> &)> &showGrid)
+{
+    return _executor.Submit(
+        [this, title, content, write, showGrid](const CancellationToken &cancellationToken) {
+            // A run that throws ends with why in its output, the handle keeps the error too
+            try
+            {
+                Execute(title, content, write, cancellationToken, showGrid);
+            }
+            catch (const std::exception &e)
+            {
+                write(std::string("\nError: ") + e.what() + "\n");
+                throw;
+            }
+        },
+        priority);
+}
+
+std::shared_ptr<JobHandle> FileRunnerService::ReadRowsAsync(
+    const std::shared_ptr<ResultGrid> &grid,
+    size_t firstRow,
+    size_t count,
+    const std::function<void(std::string &, size_t)> &done)
+{
+    // Scrolling waits for these, they go before runs that were started
+    return _executor.Submit(
+        [grid, firstRow, count, done](const CancellationToken &cancellationToken) {
+            std::string lines;
+            auto rows = grid->ReadRows(firstRow, count, lines, cancellationToken);
+            if (!cancellationToken.IsCancellationRequested())
+            {
+                done(lines, rows);
+            }
+        },
+        JobPriority::High);
+}
+
+void FileRunnerService::Execute(
+    const std::string &title,
+    const std::string &content,
+    const std::function<void(std::string_view)> &write,
+    const CancellationToken &cancellationToken,
+    const std::function<void(const std::shared_ptr<ResultGrid> &)> &showGrid)
 {
     auto ext = std::filesystem::path(title).extension();
 
+    // A .http file can hold more than one request
+    if (ext == ".http")
+    {
+        ExecuteHttpFile(content, write, cancellationToken);
+        return;
+    }
+
     auto lines = split_string(content, "\n");
 
     if (lines.empty())
     {
-        return "// ERR: No content to execute";
+        write("// ERR: No content to execute");
+        return;
     }
 
     auto firstLine = lines.front();
@@ -30,28 +115,29 @@ std::string FileRunnerService::Execute(
     auto headers = ParseHeaders(lines, headersEndAt);
     auto linesWithoutHeaders = std::vector<std::string>(lines.begin() + headersEndAt, lines.end());
 
-    if (ext == ".http")
-    {
-        return ExecuteHttp(firstLine, headers, linesWithoutHeaders);
-    }
-
     if (ext == ".sql")
     {
-        return ExecuteSql(firstLine, headers, linesWithoutHeaders);
+        ExecuteSql(title, firstLine, headers, linesWithoutHeaders, write, showGrid, cancellationToken);
+        return;
     }
 
     if (ext == ".c")
     {
-        return ExecuteC(firstLine, headers, linesWithoutHeaders);
+        write(ExecuteC(firstLine, headers, linesWithoutHeaders, cancellationToken));
+        return;
     }
 
-    return "Unsupported file extension";
+    write("Unsupported file extension");
 }
 
-std::string FileRunnerService::ExecuteSql(
+void FileRunnerService::ExecuteSql(
+    const std::string &title,
     const std::string &firstLine,
     const std::map<std::string, std::string> &headers,
-    const std::vector<std::string> &lines)
+    const std::vector<std::string> &lines,
+    const std::function<void(std::string_view)> &write,
+    const std::function<void(const std::shared_ptr<ResultGrid> &)> &showGrid,
+    const CancellationToken &cancellationToken)
 {
     auto sqlType = firstLine;
 
@@ -60,7 +146,8 @@ std::string FileRunnerService::ExecuteSql(
     auto firstSpace = ltrim_copy(sqlType).find_first_of(' ');
     if (firstSpace == std::string::npos)
     {
-        return "// ERR: Could not determine connectionstring type";
+        write("// ERR: Could not determine connectionstring type");
+        return;
     }
 
     auto connectionString = sqlType.substr(firstSpace);
@@ -68,18 +155,38 @@ std::string FileRunnerService::ExecuteSql(
 
     if (iequals(sqlType.substr(0, 6), "sqlite"))
     {
-        return ExecuteSqlite(connectionString, headers, lines);
+        // A list or a glob runs on each of the databases
+        if (connectionString.find_first_of(",*?") != std::string::npos)
+        {
+            auto connectionStrings = ExpandSqliteConnectionStrings(connectionString);
+            if (connectionStrings.empty())
+            {
+                write("Error: no databases match '" + connectionString + "'");
+                return;
+            }
+
+            if (connectionStrings.size() > 1 || connectionStrings.front() != connectionString)
+            {
+                write(ExecuteSqliteShards(connectionStrings, headers, lines, cancellationToken));
+                return;
+            }
+        }
+
+        write(ExecuteSqlite(title, connectionString, headers, lines, showGrid, cancellationToken));
+        return;
     }
 
     if (iequals(sqlType.substr(0, 5), "mssql"))
     {
-        return ExecuteMssql(connectionString, headers, lines);
+        ExecuteMssql(connectionString, headers, lines, write, cancellationToken);
+        return;
     }
 
     if (iequals(sqlType.substr(0, 5), "mysql"))
     {
-        return ExecuteMysql(connectionString, headers, lines);
+        ExecuteMysql(connectionString, headers, lines, write, cancellationToken);
+        return;
     }
 
-    return "empty";
+    write("empty");
 }
@@ -1,9 +1,17 @@
 #ifndef FILERUNNERSERVICE_HPP
 #define FILERUNNERSERVICE_HPP
 
+#include "executorservice.hpp"
+#include "mssqlconnection.hpp"
+#include "mysqlconnection.hpp"
+#include "resultgrid.hpp"
+#include "sqliteconnectionpool.hpp"
+#include <functional>
 #include <httpcontent.hpp>
+#include <httpmessagehandler.hpp>
 #include <memory>
 #include <string>
+#include <string_view>
 
 enum FileTypes
 {
@@ -22,40 +30,139 @@ public:
         const std::string &title,
         const std::string &content);
 
+    // Passes the output to write piece by piece as it becomes available. A
+    // result set too large to write at once is passed to showGrid after its
+    // first rows, without showGrid all of its rows are written.
+    void Execute(
+        const std::string &title,
+        const std::string &content,
+        const std::function<void(std::string_view)> &write,
+        const CancellationToken &cancellationToken,
+        const std::function<void(const std::shared_ptr<ResultGrid> &)> &showGrid = nullptr);
+
+    // Runs Execute on a worker of the executor, write is called from that worker
+    std::shared_ptr<JobHandle> ExecuteAsync(
+        const std::string &title,
+        const std::string &content,
+        const std::function<void(std::string_view)> &write,
+        JobPriority priority = JobPriority::Normal,
+        const std::function<void(const std::shared_ptr<ResultGrid> &)> &showGrid = nullptr);
+
+    // Formats rows of a grid on a worker of the executor, done is called from
+    // that worker with the lines and the number of rows in them
+    std::shared_ptr<JobHandle> ReadRowsAsync(
+        const std::shared_ptr<ResultGrid> &grid,
+        size_t firstRow,
+        size_t count,
+        const std::function<void(std::string &, size_t)> &done);
+
+    // Closes what was kept open for runs from the tab with this title
+    void EndSession(
+        const std::string &title);
+
 private:
-    std::string ExecuteSql(
+    void ExecuteSql(
+        const std::string &title,
         const std::string &firstLine,
         const std::map<std::string, std::string> &headers,
-        const std::vector<std::string> &lines);
+        const std::vector<std::string> &lines,
+        const std::function<void(std::string_view)> &write,
+        const std::function<void(const std::shared_ptr<ResultGrid> &)> &showGrid,
+        const CancellationToken &cancellationToken);
 
     std::string ExecuteSqlite(
+        const std::string &title,
         const std::string &connectionString,
         const std::map<std::string, std::string> &headers,
-        const std::vector<std::string> &lines);
+        const std::vector<std::string> &lines,
+        const std::function<void(const std::shared_ptr<ResultGrid> &)> &showGrid,
+        const CancellationToken &cancellationToken);
+
+    // Runs a script in one transaction with pragmas tuned for loading data,
+    // INSERTs that only differ in their values share a prepared statement
+    std::string ExecuteSqliteBulk(
+        SqliteConnection &connection,
+        const std::string &statement,
+        size_t columnWidth,
+        size_t sampleRows,
+        const CancellationToken &cancellationToken);
 
-    std::string ExecuteMssql(
+    // Runs the script on every database at the same time and merges what
+    // they return, into one table per statement with a column for the database
+    std::string ExecuteSqliteShards(
+        const std::vector<std::string> &connectionStrings,
+        const std::map<std::string, std::string> &headers,
+        const std::vector<std::string> &lines,
+        const CancellationToken &cancellationToken);
+
+    // Runs the batches between GO lines one after the other over one
+    // connection, streaming the rows of each result set to write
+    void ExecuteMssql(
         const std::string &connectionString,
         const std::map<std::string, std::string> &headers,
-        const std::vector<std::string> &lines);
+        const std::vector<std::string> &lines,
+        const std::function<void(std::string_view)> &write,
+        const CancellationToken &cancellationToken);
 
-    std::string ExecuteMysql(
+    // Streams the rows of each result set to write while the server sends
+    // them, over a connection that is kept for the next run
+    void ExecuteMysql(
         const std::string &connectionString,
         const std::map<std::string, std::string> &headers,
-        const std::vector<std::string> &lines);
+        const std::vector<std::string> &lines,
+        const std::function<void(std::string_view)> &write,
+        const CancellationToken &cancellationToken);
+
+    // Runs the requests of a .http file, when there is more than one they run
+    // in parallel and their results are written one after the other
+    void ExecuteHttpFile(
+        const std::string &content,
+        const std::function<void(std::string_view)> &write,
+        const CancellationToken &cancellationToken);
 
-    std::string ExecuteHttp(
+    void ExecuteHttp(
         const std::string &firstLine,
         const std::map<std::string, std::string> &headers,
-        const std::vector<std::string> &lines);
+        const std::vector<std::string> &lines,
+        const std::function<void(std::string_view)> &write,
+        const CancellationToken &cancellationToken);
+
+    // Sends the request over and over from Concurrency clients and reports
+    // throughput, latencies and status codes instead of the response
+    void ExecuteHttpLoadTest(
+        const std::shared_ptr<HttpRequestMessage> &request,
+        const std::map<std::string, std::string> &headers,
+        const std::function<void(std::string_view)> &write,
+        const CancellationToken &cancellationToken);
 
     std::string ExecuteC(
         const std::string &firstLine,
         const std::map<std::string, std::string> &headers,
-        const std::vector<std::string> &lines);
+        const std::vector<std::string> &lines,
+        const CancellationToken &cancellationToken);
 
     std::shared_ptr<HttpContent> ParseRequestContent(
         const std::map<std::string, std::string> &headers,
         const std::vector<std::string> &lines);
+
+private:
+    // Shared by all http requests so their keep-alive connections are reused
+    std::shared_ptr<HttpMessageHandler> _httpMessageHandler;
+
+    // Only used by the requests that ask for it with a Cache header
+    std::shared_ptr<HttpResponseCache> _httpResponseCache;
+
+    // Keeps sqlite databases open with their prepared statements between runs
+    SqliteConnectionPool _sqliteConnectionPool;
+
+    // Keeps logged in mysql connections between runs
+    MysqlConnectionPool _mysqlConnectionPool;
+
+    // Keeps logged in SQL Server connections between runs
+    MssqlConnectionPool _mssqlConnectionPool;
+
+    // Runs are spread over a fixed number of threads however many are started
+    ExecutorService _executor;
 };
 
 #endif // FILERUNNERSERVICE_HPP
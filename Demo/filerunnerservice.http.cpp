@@ -1,59 +1,413 @@
 #include "filerunnerservice.hpp"
 
+#include "jsonformatter.hpp"
 #include "stringhelpers.hpp"
 #include <algorithm> // std::equal
+#include <chrono>
+#include <httpcancellation.hpp>
 #include <httpclient.hpp>
+#include <httpresponsecache.hpp>
+#include <iomanip>
 #include <iterator>
 #include <sstream>
 #include <string>
 #include <stringcontent.hpp>
 #include <vector>
 
-std::string Return(
-    const std::shared_ptr<HttpResponseMessage> response)
+// One of the requests in a .http file, the parts between ### lines
+struct HttpFileRequest
 {
-    auto content = response->Content->ReadAsString();
-    trim(content);
-    return content;
+    std::string name;
+    std::string firstLine;
+    std::map<std::string, std::string> headers;
+    std::vector<std::string> lines;
+};
+
+// Replaces every {{name}} that has a value in variables
+std::string SubstituteVariables(
+    const std::string &text,
+    const std::map<std::string, std::string> &variables)
+{
+    std::string result;
+    size_t pos = 0;
+
+    while (true)
+    {
+        auto open = text.find("{{", pos);
+        auto close = open == std::string::npos ? std::string::npos : text.find("}}", open + 2);
+        if (close == std::string::npos)
+        {
+            result.append(text, pos, std::string::npos);
+            return result;
+        }
+
+        auto variable = variables.find(trim_copy(text.substr(open + 2, close - open - 2)));
+
+        result.append(text, pos, open - pos);
+        if (variable != variables.end())
+        {
+            result.append(variable->second);
+        }
+        else
+        {
+            result.append(text, open, close + 2 - open);
+        }
+
+        pos = close + 2;
+    }
+}
+
+// Splits a .http file on its ### lines. Lines like "@host = localhost" in
+// front of a request define variables that the requests after it use as {{host}}.
+std::vector<HttpFileRequest> ParseHttpFile(
+    const std::string &content)
+{
+    std::vector<HttpFileRequest> requests;
+    std::map<std::string, std::string> variables;
+
+    auto lines = split_string(content, "\n");
+
+    size_t i = 0;
+    while (i < lines.size())
+    {
+        HttpFileRequest request;
+
+        if (lines[i].compare(0, 3, "###") == 0)
+        {
+            request.name = trim_copy(lines[i].substr(3));
+            i++;
+        }
+
+        auto end = i;
+        while (end < lines.size() && lines[end].compare(0, 3, "###") != 0)
+        {
+            end++;
+        }
+
+        // Blank lines, # comments and variables come before the request line
+        for (; i < end; i++)
+        {
+            auto line = trim_copy(lines[i]);
+
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+
+            if (line[0] != '@')
+            {
+                break;
+            }
+
+            auto equals = line.find('=');
+            if (equals != std::string::npos)
+            {
+                auto name = trim_copy(line.substr(1, equals - 1));
+                variables[name] = SubstituteVariables(trim_copy(line.substr(equals + 1)), variables);
+            }
+        }
+
+        if (i < end)
+        {
+            request.firstLine = SubstituteVariables(lines[i], variables);
+            trimComment(request.firstLine);
+
+            std::vector<std::string> rest;
+            for (i++; i < end; i++)
+            {
+                rest.push_back(SubstituteVariables(lines[i], variables));
+            }
+
+            size_t headersEndAt;
+            request.headers = ParseHeaders(rest, headersEndAt);
+            request.lines.assign(rest.begin() + headersEndAt, rest.end());
+
+            requests.push_back(std::move(request));
+        }
+
+        i = end;
+    }
+
+    return requests;
 }
 
-std::string FileRunnerService::ExecuteHttp(
+// Passes the response content on as it arrives, leaving out the whitespace
+// at its start and end like the content was trimmed when it was buffered
+void Return(
+    const std::shared_ptr<HttpResponseMessage> &response,
+    const std::function<void(std::string_view)> &write,
+    const CancellationToken &cancellationToken)
+{
+    if (response->Content == nullptr)
+    {
+        write(cancellationToken.IsCancellationRequested() ? "// Cancelled" : "// ERR: No response received");
+        return;
+    }
+
+    const char *whitespace = " \t\n\v\f\r";
+    bool started = false;
+    std::string heldBack;
+
+    // JSON is pretty-printed while it streams in, which drops the whitespace
+    // around it as well
+    std::unique_ptr<JsonFormatter> jsonFormatter;
+    for (auto &header : response->Headers)
+    {
+        if (iequals(header.first, "Content-Type") && header.second.find("json") != std::string::npos)
+        {
+            jsonFormatter = std::make_unique<JsonFormatter>([&](std::string_view formatted) {
+                started = true;
+                write(formatted);
+            });
+        }
+    }
+
+    auto completed = response->Content->CopyTo([&](std::string_view piece) {
+        // Stopping the copy drops the connection instead of reading the rest
+        if (cancellationToken.IsCancellationRequested())
+        {
+            return false;
+        }
+
+        if (jsonFormatter != nullptr)
+        {
+            jsonFormatter->Write(piece);
+            return true;
+        }
+
+        if (!started)
+        {
+            auto first = piece.find_first_not_of(whitespace);
+            if (first == std::string_view::npos)
+            {
+                return true;
+            }
+            piece.remove_prefix(first);
+            started = true;
+        }
+
+        // Trailing whitespace is only written once more content follows it
+        auto last = piece.find_last_not_of(whitespace);
+        if (last == std::string_view::npos)
+        {
+            heldBack.append(piece);
+            return true;
+        }
+
+        if (!heldBack.empty())
+        {
+            write(heldBack);
+            heldBack.clear();
+        }
+
+        write(piece.substr(0, last + 1));
+        heldBack.assign(piece.substr(last + 1));
+
+        return true;
+    });
+
+    if (cancellationToken.IsCancellationRequested())
+    {
+        write(started ? "\n// Cancelled" : "// Cancelled");
+    }
+    else if (!completed)
+    {
+        write(started ? "\n// ERR: Response ended early" : "// ERR: Response ended early");
+    }
+}
+
+void FileRunnerService::ExecuteHttp(
     const std::string &firstLine,
     const std::map<std::string, std::string> &headers,
-    const std::vector<std::string> &lines)
+    const std::vector<std::string> &lines,
+    const std::function<void(std::string_view)> &write,
+    const CancellationToken &cancellationToken)
 {
-    HttpClient client;
+    HttpClient client(_httpMessageHandler);
 
     auto firstSpace = ltrim_copy(firstLine).find_first_of(' ');
     if (firstSpace == std::string::npos)
     {
-        return "// ERR: Could not determine HTTP method and URL ";
+        write("// ERR: Could not determine HTTP method and URL ");
+        return;
     }
 
     auto url = firstLine.substr(firstSpace);
     trim(url);
 
+    auto method = HttpMethod::Get;
+    std::shared_ptr<HttpContent> content;
+
     if (iequals(firstLine.substr(0, 4), "post"))
     {
-        return Return(client.Post(url, ParseRequestContent(headers, lines)));
+        method = HttpMethod::Post;
+        content = ParseRequestContent(headers, lines);
+    }
+    else if (iequals(firstLine.substr(0, 4), "put"))
+    {
+        method = HttpMethod::Put;
+        content = ParseRequestContent(headers, lines);
+    }
+    else if (iequals(firstLine.substr(0, 4), "patch"))
+    {
+        method = HttpMethod::Patch;
+        content = ParseRequestContent(headers, lines);
+    }
+    else if (iequals(firstLine.substr(0, 4), "delete"))
+    {
+        method = HttpMethod::Delete;
     }
 
-    if (iequals(firstLine.substr(0, 4), "put"))
+    auto request = std::make_shared<HttpRequestMessage>(method, url);
+    request->Content = content;
+
+    // "-- Cache: true" answers a GET from the response cache when the stored
+    // response is fresh, "-- Cache: revalidate" checks with the server that
+    // it is still current. Without the header the cache is not used.
+    bool useCache = false;
+    auto cache = headers.find("Cache");
+    if (cache != headers.end())
     {
-        return Return(client.Put(url, ParseRequestContent(headers, lines)));
+        if (iequals(trim_copy(cache->second), "true"))
+        {
+            useCache = true;
+        }
+        else if (iequals(trim_copy(cache->second), "revalidate"))
+        {
+            useCache = true;
+            request->Headers["Cache-Control"] = "no-cache";
+        }
     }
 
-    if (iequals(firstLine.substr(0, 4), "patch"))
+    if (headers.count("Concurrency") > 0 || headers.count("Requests") > 0 || headers.count("Duration") > 0)
     {
-        return Return(client.Patch(url, ParseRequestContent(headers, lines)));
+        ExecuteHttpLoadTest(request, headers, write, cancellationToken);
+        return;
     }
 
-    if (iequals(firstLine.substr(0, 4), "delete"))
+    // A request waiting on a server that does not answer is ended right away,
+    // one cancelled before it is sent is not sent at all
+    auto cancellation = std::make_shared<HttpCancellation>();
+    CancellationTokenRegistration cancelRegistration(cancellationToken, [cancellation]() {
+        cancellation->Cancel();
+    });
+
+    // The response is shown while it is being received
+    if (useCache)
+    {
+        auto response = _httpResponseCache->Send(
+            request,
+            HttpCompletionOption::ResponseHeadersRead,
+            [&client, &cancellation](const std::shared_ptr<HttpRequestMessage> &requestToSend, HttpCompletionOption completionOption) {
+                return client.Send(requestToSend, completionOption, cancellation);
+            });
+
+        Return(response, write, cancellationToken);
+    }
+    else
     {
-        return Return(client.Delete(url));
+        Return(client.Send(request, HttpCompletionOption::ResponseHeadersRead, cancellation), write, cancellationToken);
     }
+}
+
+void FileRunnerService::ExecuteHttpFile(
+    const std::string &content,
+    const std::function<void(std::string_view)> &write,
+    const CancellationToken &cancellationToken)
+{
+    auto requests = ParseHttpFile(content);
+
+    if (requests.empty())
+    {
+        write("// ERR: Could not determine HTTP method and URL ");
+        return;
+    }
+
+    // A single request is shown as it is received, like before there were ###
+    if (requests.size() == 1)
+    {
+        auto &request = requests.front();
+        ExecuteHttp(request.firstLine, request.headers, request.lines, write, cancellationToken);
+        return;
+    }
+
+    struct Result
+    {
+        std::string output;
+        std::chrono::duration<double, std::milli> elapsed{0};
+    };
+
+    std::vector<Result> results(requests.size());
+
+    // The requests are independent of each other, so they are sent at the
+    // same time, each as a job of its own with its own token. Cancelling the
+    // run cancels them, all of them are waited for before it returns.
+    auto started = std::chrono::steady_clock::now();
+
+    std::vector<std::shared_ptr<JobHandle>> senders;
+    for (size_t i = 0; i < requests.size(); i++)
+    {
+        senders.push_back(_executor.Submit([this, &requests, &results, i](const CancellationToken &senderToken) {
+            auto &result = results[i];
+            auto requestStart = std::chrono::steady_clock::now();
+
+            auto &request = requests[i];
+            ExecuteHttp(
+                request.firstLine,
+                request.headers,
+                request.lines,
+                [&](std::string_view piece) {
+                    result.output.append(piece);
+                },
+                senderToken);
+
+            result.elapsed = std::chrono::steady_clock::now() - requestStart;
+        }));
+    }
+
+    CancellationTokenRegistration cancelRegistration(cancellationToken, [&senders]() {
+        for (auto &sender : senders)
+        {
+            sender->Cancel();
+        }
+    });
+
+    // Results are written in the order of the file, each one as soon as it
+    // and the ones before it are complete
+    std::chrono::duration<double, std::milli> sequentialTime{0};
+    for (size_t i = 0; i < requests.size(); i++)
+    {
+        _executor.Wait(senders[i]);
+
+        auto &result = results[i];
+        auto error = senders[i]->Error();
+        if (!error.empty())
+        {
+            result.output.append("// ERR: " + error);
+        }
+        else if (result.output.empty() && senders[i]->Token().IsCancellationRequested())
+        {
+            // Cancelled before it was sent
+            result.output = "// Cancelled";
+        }
+
+        sequentialTime += result.elapsed;
+
+        std::stringstream section;
+        section << (i == 0 ? "" : "\n\n")
+                << "### " << (requests[i].name.empty() ? trim_copy(requests[i].firstLine) : requests[i].name)
+                << " (" << std::fixed << std::setprecision(2) << result.elapsed.count() << " ms)\n"
+                << result.output;
+        write(section.str());
+    }
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - started;
 
-    return Return(client.Get(url));
+    std::stringstream summary;
+    summary << "\n\n// " << requests.size() << " requests in "
+            << std::fixed << std::setprecision(2) << elapsed.count() << " ms, "
+            << sequentialTime.count() << " ms one after the other";
+    write(summary.str());
 }
 
 std::shared_ptr<HttpContent> FileRunnerService::ParseRequestContent(
@@ -0,0 +1,323 @@
+#include "filerunnerservice.hpp"
+
+#include "stringhelpers.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <httpclient.hpp>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Every client is a thread that blocks while its request is in flight, more
+// than this is a job for a load testing tool and not for the editor
+const size_t LoadTestMaxConcurrency = 64;
+
+// What one load test thread measured, merged once all threads are done
+struct LoadTestResult
+{
+    std::vector<uint32_t> latencies; // microseconds
+    std::map<int, size_t> statusCodes;
+    size_t failed = 0;
+    size_t bytesSent = 0;
+    size_t bytesReceived = 0;
+};
+
+// Accepts "30s", "500ms", "2m" and a plain number of seconds
+std::chrono::milliseconds ParseDuration(
+    const std::string &value)
+{
+    char *unit = nullptr;
+    auto number = strtod(value.c_str(), &unit);
+
+    std::string suffix = unit != nullptr ? trim_copy(unit) : "";
+
+    if (suffix == "ms")
+    {
+        return std::chrono::milliseconds(static_cast<long long>(number));
+    }
+
+    if (suffix == "m" || suffix == "min")
+    {
+        return std::chrono::milliseconds(static_cast<long long>(number * 60000));
+    }
+
+    return std::chrono::milliseconds(static_cast<long long>(number * 1000));
+}
+
+std::string FormatBytes(
+    double bytes)
+{
+    const char *units[] = {"B", "KB", "MB", "GB", "TB"};
+
+    size_t unit = 0;
+    while (bytes >= 1024 && unit < 4)
+    {
+        bytes /= 1024;
+        unit++;
+    }
+
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(unit == 0 ? 0 : 2) << bytes << " " << units[unit];
+
+    return ss.str();
+}
+
+// Writes rows of cells as a table like the sql runners do, the first row is the header
+void WriteTable(
+    const std::vector<std::vector<std::string>> &rows,
+    std::stringstream &result)
+{
+    if (rows.empty())
+    {
+        return;
+    }
+
+    std::vector<size_t> widths(rows.front().size(), 0);
+    for (auto &row : rows)
+    {
+        for (size_t col = 0; col < row.size() && col < widths.size(); col++)
+        {
+            widths[col] = std::max(widths[col], row[col].size());
+        }
+    }
+
+    for (size_t r = 0; r < rows.size(); r++)
+    {
+        for (size_t col = 0; col < widths.size(); col++)
+        {
+            auto &cell = col < rows[r].size() ? rows[r][col] : std::string();
+            result << (col == 0 ? "| " : " | ");
+
+            // The first column is a label, the others are numbers
+            if (col == 0)
+            {
+                result << cell << std::string(widths[col] - cell.size(), ' ');
+            }
+            else
+            {
+                result << std::string(widths[col] - cell.size(), ' ') << cell;
+            }
+        }
+        result << " |\n";
+
+        if (r == 0)
+        {
+            for (size_t col = 0; col < widths.size(); col++)
+            {
+                result << (col == 0 ? "+-" : "-+-") << std::string(widths[col], '-');
+            }
+            result << "-+\n";
+        }
+    }
+
+    result << "\n";
+}
+
+void FileRunnerService::ExecuteHttpLoadTest(
+    const std::shared_ptr<HttpRequestMessage> &request,
+    const std::map<std::string, std::string> &headers,
+    const std::function<void(std::string_view)> &write,
+    const CancellationToken &cancellationToken)
+{
+    auto concurrency = std::clamp(HeaderNumber<size_t>(headers, "Concurrency", 1), size_t(1), LoadTestMaxConcurrency);
+
+    auto durationHeader = headers.find("Duration");
+    auto duration = durationHeader != headers.end() ? ParseDuration(durationHeader->second) : std::chrono::milliseconds(0);
+
+    // Without a limit a fixed number of requests is sent
+    auto requestLimit = HeaderNumber<size_t>(headers, "Requests", duration.count() > 0 ? 0 : 1000);
+
+    {
+        std::stringstream start;
+        start << "Load test: " << request->RequestUri << "\n"
+              << "Concurrency " << concurrency;
+        if (requestLimit > 0)
+        {
+            start << ", " << requestLimit << " requests";
+        }
+        if (duration.count() > 0)
+        {
+            start << ", " << duration.count() / 1000.0 << " s";
+        }
+        start << "\n\n";
+        write(start.str());
+    }
+
+    // A handler of its own keeps an idle connection per client thread, so
+    // every request after the first one of a thread reuses a connection
+    auto handler = std::make_shared<HttpMessageHandler>();
+    handler->MaxIdleConnectionsPerServer = concurrency;
+
+    size_t requestBytes = 0;
+    if (request->Content != nullptr)
+    {
+        request->Content->TryComputeLength(requestBytes);
+    }
+
+    std::atomic<size_t> requestsStarted{0};
+    std::vector<LoadTestResult> results(concurrency);
+
+    auto started = std::chrono::steady_clock::now();
+    auto deadline = started + duration;
+
+    // Each client sends its requests one after the other, the requests run
+    // on threads of their own for the length of the test only because the
+    // client blocks while a request is in flight
+    std::vector<std::thread> clients;
+    for (size_t i = 0; i < concurrency; i++)
+    {
+        clients.emplace_back([&, i]() {
+            HttpClient client(handler);
+            auto &result = results[i];
+
+            while (!cancellationToken.IsCancellationRequested())
+            {
+                if (requestLimit > 0 && requestsStarted.fetch_add(1) >= requestLimit)
+                {
+                    break;
+                }
+
+                auto requestStart = std::chrono::steady_clock::now();
+                if (duration.count() > 0 && requestStart >= deadline)
+                {
+                    break;
+                }
+
+                auto response = client.Send(request);
+
+                auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - requestStart);
+
+                result.bytesSent += requestBytes;
+
+                if (response->Content == nullptr || static_cast<int>(response->StatusCode) == 0)
+                {
+                    result.failed++;
+                    continue;
+                }
+
+                result.latencies.push_back(static_cast<uint32_t>(std::min<long long>(elapsed.count(), UINT32_MAX)));
+                result.statusCodes[static_cast<int>(response->StatusCode)]++;
+                result.bytesReceived += response->Content->ReadAsStringView().size();
+            }
+        });
+    }
+
+    for (auto &client : clients)
+    {
+        client.join();
+    }
+
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    LoadTestResult total;
+    for (auto &result : results)
+    {
+        total.latencies.insert(total.latencies.end(), result.latencies.begin(), result.latencies.end());
+        for (auto &statusCode : result.statusCodes)
+        {
+            total.statusCodes[statusCode.first] += statusCode.second;
+        }
+        total.failed += result.failed;
+        total.bytesSent += result.bytesSent;
+        total.bytesReceived += result.bytesReceived;
+    }
+
+    std::sort(total.latencies.begin(), total.latencies.end());
+
+    auto completed = total.latencies.size();
+
+    std::stringstream output;
+
+    if (cancellationToken.IsCancellationRequested())
+    {
+        output << "Cancelled, results so far:\n\n";
+    }
+
+    std::stringstream throughput;
+    throughput << std::fixed << std::setprecision(1) << (elapsed > 0 ? completed / elapsed : 0) << " req/s";
+
+    std::stringstream time;
+    time << std::fixed << std::setprecision(2) << elapsed << " s";
+
+    WriteTable(
+        {
+            {"Requests", "Completed", "Failed", "Time", "Throughput", "Received", "Sent"},
+            {std::to_string(completed + total.failed),
+             std::to_string(completed),
+             std::to_string(total.failed),
+             time.str(),
+             throughput.str(),
+             FormatBytes(total.bytesReceived) + " (" + FormatBytes(elapsed > 0 ? total.bytesReceived / elapsed : 0) + "/s)",
+             FormatBytes(total.bytesSent)},
+        },
+        output);
+
+    if (completed > 0)
+    {
+        auto percentile = [&](double p) {
+            auto index = static_cast<size_t>(p * (completed - 1) + 0.5);
+            return FormatLatency(total.latencies[index]);
+        };
+
+        unsigned long long sum = 0;
+        for (auto latency : total.latencies)
+        {
+            sum += latency;
+        }
+
+        WriteTable(
+            {
+                {"Latency", "min", "mean", "p50", "p90", "p99", "max"},
+                {"",
+                 FormatLatency(total.latencies.front()),
+                 FormatLatency(static_cast<uint32_t>(sum / completed)),
+                 percentile(0.50),
+                 percentile(0.90),
+                 percentile(0.99),
+                 FormatLatency(total.latencies.back())},
+            },
+            output);
+
+        // Buckets double in width so the whole range fits in a few rows
+        std::vector<std::vector<std::string>> histogram = {{"Latency up to", "Requests", "%", ""}};
+        uint32_t bucketEnd = 100;
+        size_t counted = 0;
+        while (counted < completed)
+        {
+            auto end = std::upper_bound(total.latencies.begin() + counted, total.latencies.end(), bucketEnd) - total.latencies.begin();
+            auto count = static_cast<size_t>(end) - counted;
+
+            if (count > 0 || counted > 0)
+            {
+                std::stringstream share;
+                share << std::fixed << std::setprecision(1) << (100.0 * count / completed);
+
+                auto bar = std::string(static_cast<size_t>(40.0 * count / completed + 0.5), '#');
+
+                histogram.push_back({FormatLatency(bucketEnd), std::to_string(count), share.str(), bar + std::string(40 - bar.size(), ' ')});
+            }
+
+            counted = end;
+            bucketEnd = bucketEnd > UINT32_MAX / 2 ? UINT32_MAX : bucketEnd * 2;
+        }
+
+        WriteTable(histogram, output);
+    }
+
+    std::vector<std::vector<std::string>> statusCodes = {{"Status", "Responses"}};
+    for (auto &statusCode : total.statusCodes)
+    {
+        statusCodes.push_back({std::to_string(statusCode.first), std::to_string(statusCode.second)});
+    }
+    if (total.failed > 0)
+    {
+        statusCodes.push_back({"No response", std::to_string(total.failed)});
+    }
+
+    WriteTable(statusCodes, output);
+
+    write(output.str());
+}
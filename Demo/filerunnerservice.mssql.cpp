@@ -1,21 +1,299 @@
 #include "filerunnerservice.hpp"
 
-#include <algorithm> // std::equal
-#include <httpclient.hpp>
-#include <iterator>
-#include <sstream>
+#include "mssqlconnection.hpp"
+#include "resultexport.hpp"
+#include "stringhelpers.hpp"
+#include "tableformatter.hpp"
+#include <algorithm>
+#include <cctype>
 #include <string>
-#include <stringcontent.hpp>
 #include <vector>
 
-std::string FileRunnerService::ExecuteMssql(
+// Output is passed on in pieces of about this size while rows arrive
+const size_t MssqlWriteSize = 64 * 1024;
+
+struct MssqlBatch
+{
+    std::string Sql;
+    // "GO 5" runs the batch before it five times
+    size_t Count = 1;
+};
+
+// A line with only GO on it ends a batch, like in sqlcmd and Management Studio
+bool IsMssqlBatchSeparator(
+    const std::string &line,
+    size_t &count)
+{
+    auto text = line;
+    auto comment = text.find("--");
+    if (comment != std::string::npos)
+    {
+        text = text.substr(0, comment);
+    }
+    trim(text);
+
+    if (text.size() < 2 || !iequals(text.substr(0, 2), "go") || (text.size() > 2 && !std::isspace(static_cast<unsigned char>(text[2]))))
+    {
+        return false;
+    }
+
+    auto repeat = trim_copy(text.substr(2));
+    if (!std::all_of(repeat.begin(), repeat.end(), [](char c) { return std::isdigit(static_cast<unsigned char>(c)); }))
+    {
+        return false;
+    }
+
+    count = repeat.empty() ? 1 : std::max(1, std::atoi(repeat.c_str()));
+
+    return true;
+}
+
+std::vector<MssqlBatch> SplitMssqlBatches(
+    const std::vector<std::string> &lines)
+{
+    std::vector<MssqlBatch> batches;
+    MssqlBatch batch;
+
+    for (auto &line : lines)
+    {
+        size_t count = 1;
+        if (!IsMssqlBatchSeparator(line, count))
+        {
+            batch.Sql.append(line);
+            batch.Sql.push_back('\n');
+            continue;
+        }
+
+        batch.Count = count;
+        if (!trim_copy(batch.Sql).empty())
+        {
+            batches.push_back(std::move(batch));
+        }
+        batch = MssqlBatch();
+    }
+
+    if (!trim_copy(batch.Sql).empty())
+    {
+        batches.push_back(std::move(batch));
+    }
+
+    return batches;
+}
+
+// Errors with where they were raised, other messages as they are
+void MssqlMessagesResult(
+    const std::vector<MssqlMessage> &messages,
+    std::string &output)
+{
+    for (auto &message : messages)
+    {
+        if (message.Class > 10)
+        {
+            output.append("Error: " + message.Text + " (Msg " + std::to_string(message.Number) + ", Level " + std::to_string(message.Class) + ", State " + std::to_string(message.State) + ", Line " + std::to_string(message.Line) + ")\n\n");
+        }
+        else
+        {
+            output.append(message.Text + "\n\n");
+        }
+    }
+}
+
+void MssqlExportRow(
+    const MssqlResult &result,
+    const MssqlRow &row,
+    ResultExport &resultExport)
+{
+    for (size_t col = 0; col < result.Columns.size(); col++)
+    {
+        resultExport.AddValue(row.Values[col], IsMssqlNumberType(result.Columns[col].Type), row.Nulls[col]);
+    }
+    resultExport.EndRow();
+}
+
+// Writes the results of the batch that was sent last, each result set as
+// its rows arrive. Returns false when the connection broke.
+bool MssqlResults(
+    MssqlConnection &connection,
+    size_t columnWidth,
+    size_t sampleRows,
+    size_t maxRows,
+    const std::string &exportPath,
+    size_t &exportCount,
+    std::string &output,
+    const std::function<void(std::string_view)> &write)
+{
+    MssqlResult result;
+    while (connection.NextResult(result))
+    {
+        MssqlMessagesResult(result.Messages, output);
+
+        if (result.Columns.empty())
+        {
+            if (result.HasRowCount)
+            {
+                output.append("(" + std::to_string(result.RowCount) + (result.RowCount == 1 ? " row" : " rows") + " affected)\n\n");
+            }
+            continue;
+        }
+
+        std::vector<std::string> names;
+        for (auto &column : result.Columns)
+        {
+            names.push_back(column.Name.empty() ? "(No column name)" : trim_copy(column.Name));
+        }
+
+        TableSampler sampler(names, columnWidth);
+
+        std::unique_ptr<ResultExport> resultExport;
+        if (!exportPath.empty())
+        {
+            resultExport = StartResultExport(exportPath, exportCount++, names, output);
+        }
+
+        MssqlRow row;
+        bool hasRow = false;
+
+        while (sampler.RowCount() < std::min(sampleRows, maxRows) && (hasRow = connection.NextRow(row)))
+        {
+            for (size_t col = 0; col < result.Columns.size(); col++)
+            {
+                sampler.AddCell(row.Values[col], IsMssqlNumberType(result.Columns[col].Type), row.Nulls[col]);
+            }
+
+            if (resultExport != nullptr)
+            {
+                MssqlExportRow(result, row, *resultExport);
+            }
+        }
+
+        TableFormatter formatter(sampler.Columns());
+
+        formatter.WriteHeader(output);
+        sampler.WriteRows(formatter, output);
+
+        // Rows after the sample are written as they arrive
+        size_t rowCount = sampler.RowCount();
+        while (hasRow && (hasRow = connection.NextRow(row)))
+        {
+            if (rowCount == maxRows)
+            {
+                output.append("\nStopped after " + std::to_string(maxRows) + " rows, the Max-Rows limit\n");
+                break;
+            }
+
+            for (size_t col = 0; col < result.Columns.size(); col++)
+            {
+                formatter.WriteCell(col, row.Values[col], output);
+            }
+            formatter.EndRow(output);
+            rowCount++;
+
+            if (resultExport != nullptr)
+            {
+                MssqlExportRow(result, row, *resultExport);
+            }
+
+            if (output.size() >= MssqlWriteSize)
+            {
+                write(output);
+                output.clear();
+            }
+        }
+
+        output.append("\n");
+
+        if (resultExport != nullptr)
+        {
+            if (connection.IsBroken())
+            {
+                resultExport->Fail(connection.Error());
+            }
+            FinishResultExport(*resultExport, output);
+        }
+    }
+
+    if (connection.IsBroken())
+    {
+        output.append("Error: " + connection.Error() + "\n\n");
+        return false;
+    }
+
+    return true;
+}
+
+void FileRunnerService::ExecuteMssql(
     const std::string &connectionString,
     const std::map<std::string, std::string> &headers,
-    const std::vector<std::string> &lines)
+    const std::vector<std::string> &lines,
+    const std::function<void(std::string_view)> &write,
+    const CancellationToken &cancellationToken)
 {
-    std::ostringstream imploded;
-    std::copy(lines.begin(), lines.end(),
-              std::ostream_iterator<std::string>(imploded, "\n"));
+    auto columnWidth = HeaderNumber<size_t>(headers, "Column-Width", 40);
+    auto sampleRows = std::max<size_t>(1, HeaderNumber<size_t>(headers, "Sample-Rows", 200));
+    auto maxRows = HeaderNumber<size_t>(headers, "Max-Rows", 0);
+    if (maxRows == 0)
+    {
+        maxRows = SIZE_MAX;
+    }
+
+    // The rows of each result set are also written to a file, the ones
+    // after the first to numbered files next to it
+    auto exportHeader = headers.find("Export");
+    auto exportPath = exportHeader != headers.end() ? trim_copy(exportHeader->second) : std::string();
+    size_t exportCount = 0;
+
+    auto batches = SplitMssqlBatches(lines);
+
+    std::string error;
+    auto connection = _mssqlConnectionPool.Acquire(connectionString, error);
+    if (connection == nullptr)
+    {
+        write("Error: " + error);
+        return;
+    }
+
+    std::string output;
+    bool connected = true;
+
+    {
+        // The server stops the batch that runs and acknowledges it at the end
+        // of the response, after which the connection can be used again
+        CancellationTokenRegistration cancelRegistration(cancellationToken, [&connection]() {
+            connection->Cancel();
+        });
+
+        // Each batch is sent as soon as the response to the one before it ends,
+        // a connection without MARS takes one request at a time
+        for (size_t i = 0; i < batches.size() && connected; i++)
+        {
+            for (size_t run = 0; run < batches[i].Count && connected; run++)
+            {
+                if (cancellationToken.IsCancellationRequested())
+                {
+                    break;
+                }
+
+                if (!connection->Query(batches[i].Sql, error))
+                {
+                    output.append("Error: " + error + "\n\n");
+                    connected = false;
+                    break;
+                }
+
+                connected = MssqlResults(*connection, columnWidth, sampleRows, maxRows, exportPath, exportCount, output, write);
+            }
+        }
+    }
+
+    if (cancellationToken.IsCancellationRequested())
+    {
+        output.append("Cancelled\n");
+    }
+
+    if (connected)
+    {
+        _mssqlConnectionPool.Release(connectionString, std::move(connection));
+    }
 
-    return imploded.str();
+    write(output);
 }
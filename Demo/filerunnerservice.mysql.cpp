@@ -1,21 +1,323 @@
 #include "filerunnerservice.hpp"
 
-#include <algorithm> // std::equal
-#include <httpclient.hpp>
-#include <iterator>
-#include <sstream>
+#include "mysqlconnection.hpp"
+#include "resultexport.hpp"
+#include "stringhelpers.hpp"
+#include "tableformatter.hpp"
+#include <algorithm>
 #include <string>
-#include <stringcontent.hpp>
+#include <thread>
 #include <vector>
 
-std::string FileRunnerService::ExecuteMysql(
+// Output is passed on in pieces of about this size while rows arrive
+const size_t MysqlWriteSize = 64 * 1024;
+
+// Splits a script on the semicolons between its statements, for statements
+// that are prepared one at a time. Quoted text and comments are skipped.
+std::vector<std::string> SplitMysqlStatements(
+    const std::string &script)
+{
+    std::vector<std::string> statements;
+    std::string statement;
+
+    for (size_t i = 0; i < script.size(); i++)
+    {
+        auto c = script[i];
+
+        if (c == '\'' || c == '"' || c == '`')
+        {
+            auto end = i + 1;
+            while (end < script.size() && script[end] != c)
+            {
+                if (script[end] == '\\' && c != '`')
+                {
+                    end++;
+                }
+                end++;
+            }
+
+            statement.append(script, i, std::min(end, script.size() - 1) - i + 1);
+            i = end;
+            continue;
+        }
+
+        if (c == '#' || (c == '-' && script.compare(i, 3, "-- ") == 0) || (c == '-' && script.compare(i, 3, "--\n") == 0))
+        {
+            auto end = script.find('\n', i);
+            i = end == std::string::npos ? script.size() : end;
+            statement.push_back('\n');
+            continue;
+        }
+
+        if (c == '/' && script.compare(i, 2, "/*") == 0)
+        {
+            auto end = script.find("*/", i + 2);
+            i = end == std::string::npos ? script.size() : end + 1;
+            statement.push_back(' ');
+            continue;
+        }
+
+        if (c == ';')
+        {
+            trim(statement);
+            if (!statement.empty())
+            {
+                statements.push_back(statement);
+            }
+            statement.clear();
+            continue;
+        }
+
+        statement.push_back(c);
+    }
+
+    trim(statement);
+    if (!statement.empty())
+    {
+        statements.push_back(statement);
+    }
+
+    return statements;
+}
+
+void MysqlExportRow(
+    const MysqlResult &result,
+    const MysqlRow &row,
+    ResultExport &resultExport)
+{
+    for (size_t col = 0; col < result.Columns.size(); col++)
+    {
+        resultExport.AddValue(row.Values[col], IsMysqlNumberType(result.Columns[col].Type), row.Nulls[col]);
+    }
+    resultExport.EndRow();
+}
+
+// Writes the results of the command that was sent last, each result set as
+// its rows arrive. Returns false when the connection broke.
+bool MysqlResults(
+    MysqlConnection &connection,
+    size_t columnWidth,
+    size_t sampleRows,
+    size_t maxRows,
+    const std::string &exportPath,
+    size_t &exportCount,
+    std::string &output,
+    const std::function<void(std::string_view)> &write)
+{
+    MysqlResult result;
+    while (connection.NextResult(result))
+    {
+        if (!result.Error.empty())
+        {
+            output.append("Error: " + result.Error + "\n\n");
+            continue;
+        }
+
+        if (result.Columns.empty())
+        {
+            output.append("(" + std::to_string(result.AffectedRows) + (result.AffectedRows == 1 ? " row" : " rows") + " affected)\n\n");
+            continue;
+        }
+
+        std::vector<std::string> names;
+        for (auto &column : result.Columns)
+        {
+            names.push_back(trim_copy(column.Name));
+        }
+
+        TableSampler sampler(names, columnWidth);
+
+        std::unique_ptr<ResultExport> resultExport;
+        if (!exportPath.empty())
+        {
+            resultExport = StartResultExport(exportPath, exportCount++, names, output);
+        }
+
+        MysqlRow row;
+        std::string rowError;
+        bool hasRow = false;
+
+        while (sampler.RowCount() < std::min(sampleRows, maxRows) && (hasRow = connection.NextRow(row, rowError)))
+        {
+            for (size_t col = 0; col < result.Columns.size(); col++)
+            {
+                sampler.AddCell(row.Values[col], IsMysqlNumberType(result.Columns[col].Type), row.Nulls[col]);
+            }
+
+            if (resultExport != nullptr)
+            {
+                MysqlExportRow(result, row, *resultExport);
+            }
+        }
+
+        TableFormatter formatter(sampler.Columns());
+
+        formatter.WriteHeader(output);
+        sampler.WriteRows(formatter, output);
+
+        // Rows after the sample are written as they arrive
+        size_t rowCount = sampler.RowCount();
+        while (hasRow && (hasRow = connection.NextRow(row, rowError)))
+        {
+            if (rowCount == maxRows)
+            {
+                output.append("\nStopped after " + std::to_string(maxRows) + " rows, the Max-Rows limit\n");
+                break;
+            }
+
+            for (size_t col = 0; col < result.Columns.size(); col++)
+            {
+                formatter.WriteCell(col, row.Values[col], output);
+            }
+            formatter.EndRow(output);
+            rowCount++;
+
+            if (resultExport != nullptr)
+            {
+                MysqlExportRow(result, row, *resultExport);
+            }
+
+            if (output.size() >= MysqlWriteSize)
+            {
+                write(output);
+                output.clear();
+            }
+        }
+
+        if (!rowError.empty())
+        {
+            output.append("Error: " + rowError + "\n");
+        }
+
+        output.append("\n");
+
+        if (resultExport != nullptr)
+        {
+            if (!rowError.empty())
+            {
+                resultExport->Fail(rowError);
+            }
+            FinishResultExport(*resultExport, output);
+        }
+    }
+
+    if (!connection.Error().empty() && connection.IsBroken())
+    {
+        output.append("Error: " + connection.Error() + "\n\n");
+        return false;
+    }
+
+    return true;
+}
+
+void FileRunnerService::ExecuteMysql(
     const std::string &connectionString,
     const std::map<std::string, std::string> &headers,
-    const std::vector<std::string> &lines)
+    const std::vector<std::string> &lines,
+    const std::function<void(std::string_view)> &write,
+    const CancellationToken &cancellationToken)
 {
-    std::ostringstream imploded;
-    std::copy(lines.begin(), lines.end(),
-              std::ostream_iterator<std::string>(imploded, "\n"));
+    std::string script;
+    for (auto &line : lines)
+    {
+        script.append(line);
+        script.push_back('\n');
+    }
+
+    auto columnWidth = HeaderNumber<size_t>(headers, "Column-Width", 40);
+    auto sampleRows = std::max<size_t>(1, HeaderNumber<size_t>(headers, "Sample-Rows", 200));
+    auto maxRows = HeaderNumber<size_t>(headers, "Max-Rows", 0);
+    if (maxRows == 0)
+    {
+        maxRows = SIZE_MAX;
+    }
+
+    // The rows of each result set are also written to a file, the ones
+    // after the first to numbered files next to it
+    auto exportHeader = headers.find("Export");
+    auto exportPath = exportHeader != headers.end() ? trim_copy(exportHeader->second) : std::string();
+    size_t exportCount = 0;
+
+    // Prepared statements return their rows in the binary protocol, which
+    // is smaller than text for numbers and dates
+    auto prepared = headers.find("Prepared");
+    bool usePrepared = prepared != headers.end() && iequals(trim_copy(prepared->second), "true");
+
+    std::string error;
+    auto connection = _mysqlConnectionPool.Acquire(connectionString, error);
+    if (connection == nullptr)
+    {
+        write("Error: " + error);
+        return;
+    }
+
+    std::string output;
+    bool connected = true;
+
+    {
+        // A query that is running is stopped by the server, from a connection of its own
+        auto settings = connection->Settings();
+        auto threadId = connection->ThreadId();
+        CancellationTokenRegistration cancelRegistration(cancellationToken, [settings, threadId]() {
+            std::thread([settings, threadId]() {
+                MysqlConnection killer;
+                std::string killError;
+                MysqlResult killResult;
+                if (killer.Open(settings, killError) && killer.Query("KILL QUERY " + std::to_string(threadId), killError))
+                {
+                    killer.NextResult(killResult);
+                }
+            }).detach();
+        });
+
+        if (usePrepared)
+        {
+            for (auto &statement : SplitMysqlStatements(script))
+            {
+                if (cancellationToken.IsCancellationRequested())
+                {
+                    break;
+                }
+
+                if (!connection->Execute(statement, error))
+                {
+                    output.append("Error: " + error + "\n\n");
+                    connected = !connection->IsBroken();
+                }
+                else
+                {
+                    connected = MysqlResults(*connection, columnWidth, sampleRows, maxRows, exportPath, exportCount, output, write);
+                }
+
+                if (!connected)
+                {
+                    break;
+                }
+            }
+        }
+        else if (!cancellationToken.IsCancellationRequested())
+        {
+            if (!connection->Query(script, error))
+            {
+                output.append("Error: " + error + "\n\n");
+            }
+            else
+            {
+                MysqlResults(*connection, columnWidth, sampleRows, maxRows, exportPath, exportCount, output, write);
+            }
+        }
+    }
+
+    // A KILL QUERY that is still on its way could stop the next run on a
+    // cancelled connection, so it is not reused
+    if (cancellationToken.IsCancellationRequested())
+    {
+        output.append("Cancelled\n");
+    }
+    else
+    {
+        _mysqlConnectionPool.Release(connectionString, std::move(connection));
+    }
 
-    return imploded.str();
+    write(output);
 }
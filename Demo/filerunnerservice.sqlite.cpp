@@ -1,220 +1,560 @@
 #include "filerunnerservice.hpp"
 
+#include "resultexport.hpp"
+#include "resultfile.hpp"
+#include "sqliteresultgrid.hpp"
+#include "sqlstatementshape.hpp"
 #include "stringhelpers.hpp"
+#include "tableformatter.hpp"
 #include <algorithm> // std::equal
+#include <chrono>
+#include <cstdint>
+#include <functional>
 #include <httpclient.hpp>
 #include <iterator>
 #include <sqlite3.h>
 #include <sstream>
 #include <string>
 #include <stringcontent.hpp>
+#include <unordered_set>
 #include <vector>
 
-void cell(
-    int type,
-    const std::string &value,
-    size_t columnWidth,
-    std::stringstream &result)
+void ErrorResult(
+    sqlite3_stmt *ppStmt,
+    int stepResult,
+    std::string &result)
 {
-    auto valueSize = std::min<size_t>(value.size(), columnWidth);
-    auto prefix = std::string(columnWidth, ' ');
+    result.append("Error: ");
+    result.append(sqlite3_errstr(stepResult));
+    result.append("\n\n");
+}
 
-    if (type != SQLITE_TEXT)
-    {
-        result << prefix.substr(0, columnWidth - valueSize);
-    }
+void UpdateResult(
+    sqlite3 *ppDb,
+    std::string &result)
+{
+    auto changes = sqlite3_changes(ppDb);
 
-    if (value.size() > columnWidth)
+    result.append("(" + std::to_string(changes));
+    if (changes == 1)
     {
-        result << value.substr(0, valueSize - 2) << "..";
+        result.append(" row");
     }
     else
     {
-        result << value.substr(0, valueSize);
+        result.append(" rows");
     }
+    result.append(" affected)\n\n");
+}
 
-    if (type == SQLITE_TEXT)
+std::vector<std::string> SqliteColumnNames(
+    sqlite3_stmt *ppStmt)
+{
+    std::vector<std::string> names;
+    for (int col = 0; col < sqlite3_column_count(ppStmt); col++)
     {
-        result << prefix.substr(0, columnWidth - valueSize);
+        auto name = std::string(sqlite3_column_name(ppStmt, col));
+
+        trim(name);
+
+        names.push_back(name);
     }
-}
 
-void ErrorResult(
-    sqlite3_stmt *ppStmt,
-    int stepResult,
-    std::stringstream &result)
-{
-    result << "Error: " << sqlite3_errstr(stepResult) << "\n\n";
+    return names;
 }
 
-void UpdateResult(
-    sqlite3 *ppDb,
-    std::stringstream &result)
+// Adds the current row of ppStmt to an export with the types sqlite has for
+// its values. Done before the row is formatted, which turns numbers into text.
+void SqliteExportRow(
+    sqlite3_stmt *ppStmt,
+    ResultExport &resultExport)
 {
-    auto changes = sqlite3_changes(ppDb);
+    auto columnCount = sqlite3_column_count(ppStmt);
 
-    result << "(" << changes;
-    if (changes == 1)
-    {
-        result << " row";
-    }
-    else
+    for (int col = 0; col < columnCount; col++)
     {
-        result << " rows";
+        switch (sqlite3_column_type(ppStmt, col))
+        {
+            case SQLITE_NULL:
+                resultExport.AddNull();
+                break;
+            case SQLITE_INTEGER:
+                resultExport.AddInteger(sqlite3_column_int64(ppStmt, col));
+                break;
+            case SQLITE_FLOAT:
+                resultExport.AddReal(sqlite3_column_double(ppStmt, col));
+                break;
+            default:
+                resultExport.AddText(SqliteColumnText(ppStmt, col));
+                break;
+        }
     }
-    result << " affected)\n\n";
+
+    resultExport.EndRow();
 }
 
-void RowResult(
+// Writes the rows of ppStmt, which has stepped to its first row, up to
+// maxRows of them. The columns are sized to the first sampleRows rows.
+// Returns true when there are rows left after maxRows. With an export the
+// rows go on to it up to maxExportRows, also those after maxRows.
+bool RowResult(
+    SqliteConnection &connection,
     sqlite3_stmt *ppStmt,
-    size_t columnWidth,
-    std::stringstream &result)
+    size_t maxColumnWidth,
+    size_t sampleRows,
+    size_t maxRows,
+    std::vector<TableColumn> &columns,
+    std::string &result,
+    ResultExport *resultExport,
+    size_t maxExportRows)
 {
     auto columnCount = sqlite3_column_count(ppStmt);
 
-    auto prefix = std::string(columnWidth, ' ');
-    std::vector<size_t> colWidths(columnCount);
+    TableSampler sampler(SqliteColumnNames(ppStmt), maxColumnWidth);
 
-    for (int col = 0; col < columnCount; col++)
+    int stepResult = SQLITE_ROW;
+    while (stepResult == SQLITE_ROW && sampler.RowCount() < std::min(sampleRows, maxRows))
     {
-        if (col == 0)
-            result << "| ";
-        else
-            result << " | ";
+        if (resultExport != nullptr)
+        {
+            SqliteExportRow(ppStmt, *resultExport);
+        }
 
-        auto name = std::string(sqlite3_column_name(ppStmt, col));
+        for (int col = 0; col < columnCount; col++)
+        {
+            auto type = sqlite3_column_type(ppStmt, col);
 
-        trim(name);
+            sampler.AddCell(SqliteColumnText(ppStmt, col), type == SQLITE_INTEGER || type == SQLITE_FLOAT, type == SQLITE_NULL);
+        }
+        connection.AddRowsRead(1);
+
+        stepResult = sqlite3_step(ppStmt);
+    }
+
+    columns = sampler.Columns();
 
-        colWidths[col] = columnWidth;
+    TableFormatter formatter(columns);
 
-        if (name.size() > columnWidth)
+    formatter.WriteHeader(result);
+    sampler.WriteRows(formatter, result);
+
+    size_t row = sampler.RowCount();
+    for (; stepResult == SQLITE_ROW && row < maxRows; row++)
+    {
+        // Rows after the sample are written as they are stepped, growing the
+        // output a number of rows at a time
+        if (result.capacity() - result.size() < formatter.RowSize())
+        {
+            result.reserve(result.size() + formatter.RowSize() * std::max<size_t>(sampleRows, 64));
+        }
+
+        if (resultExport != nullptr)
         {
-            colWidths[col] = name.size();
+            SqliteExportRow(ppStmt, *resultExport);
         }
 
-        cell(
-            SQLITE_TEXT,
-            name,
-            colWidths[col],
-            result);
+        SqliteRowCells(ppStmt, formatter, result);
+        connection.AddRowsRead(1);
+
+        stepResult = sqlite3_step(ppStmt);
     }
 
-    result << " |\n";
+    bool more = stepResult == SQLITE_ROW;
 
-    for (int col = 0; col < columnCount; col++)
+    for (; resultExport != nullptr && stepResult == SQLITE_ROW && row < maxExportRows; row++)
     {
-        if (col == 0)
-            result << "+-";
-        else
-            result << "-+-";
+        SqliteExportRow(ppStmt, *resultExport);
+        connection.AddRowsRead(1);
 
-        result << std::string(colWidths[col], '-');
+        stepResult = sqlite3_step(ppStmt);
     }
 
-    result << "-+\n";
+    if (stepResult != SQLITE_DONE && stepResult != SQLITE_ROW && resultExport != nullptr)
+    {
+        resultExport->Fail(std::string("reading the rows failed, ") + sqlite3_errstr(stepResult));
+    }
 
-    while (true)
+    if (more)
     {
-        for (int col = 0; col < columnCount; col++)
+        return true;
+    }
+
+    if (stepResult != SQLITE_DONE)
+    {
+        ErrorResult(ppStmt, stepResult, result);
+    }
+
+    result.append("\n");
+
+    return false;
+}
+
+// The first column of the first row a pragma returns
+std::string SqlitePragma(
+    sqlite3 *ppDb,
+    const std::string &pragma)
+{
+    std::string value;
+
+    sqlite3_stmt *ppStmt = nullptr;
+    if (sqlite3_prepare_v2(ppDb, pragma.c_str(), -1, &ppStmt, nullptr) == SQLITE_OK && ppStmt != nullptr)
+    {
+        if (sqlite3_step(ppStmt) == SQLITE_ROW)
+        {
+            value = std::string(SqliteColumnText(ppStmt, 0));
+        }
+    }
+    sqlite3_finalize(ppStmt);
+
+    return value;
+}
+
+void BindLiterals(
+    sqlite3_stmt *ppStmt,
+    const std::vector<SqlLiteral> &values)
+{
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        auto index = int(i + 1);
+
+        switch (values[i].Type)
         {
-            if (col == 0)
-                result << "| ";
-            else
-                result << " | ";
+            case SqlLiteralType::Integer:
+                sqlite3_bind_int64(ppStmt, index, values[i].Integer);
+                break;
+            case SqlLiteralType::Real:
+                sqlite3_bind_double(ppStmt, index, values[i].Real);
+                break;
+            case SqlLiteralType::Text:
+                sqlite3_bind_text(ppStmt, index, values[i].Text.data(), int(values[i].Text.size()), SQLITE_STATIC);
+                break;
+        }
+    }
+}
+
+struct SqliteStatementProfile
+{
+    std::string Statement;
+    std::chrono::steady_clock::duration Elapsed{0};
+    int64_t SqliteNanoseconds = 0;
+    int FullScanSteps = 0;
+    int Sorts = 0;
+    int AutoIndexes = 0;
+    int VmSteps = 0;
+};
+
+// Called by sqlite when a statement ends, with the time it took in nanoseconds
+int AddSqliteProfileTime(
+    unsigned type,
+    void *context,
+    void *ppStmt,
+    void *nanoseconds)
+{
+    (void)ppStmt;
+
+    if (type == SQLITE_TRACE_PROFILE)
+    {
+        *static_cast<int64_t *>(context) += *static_cast<sqlite3_int64 *>(nanoseconds);
+    }
+
+    return 0;
+}
+
+// Writes the EXPLAIN QUERY PLAN of sql as a tree, like the sqlite shell does.
+// Statements without a plan, like CREATE TABLE, write nothing.
+void SqliteQueryPlan(
+    sqlite3 *ppDb,
+    const std::string &sql,
+    std::string &result)
+{
+    struct PlanRow
+    {
+        int Id;
+        int Parent;
+        std::string Detail;
+    };
 
-            cell(
-                sqlite3_column_type(ppStmt, col),
-                reinterpret_cast<const char *>(sqlite3_column_text(ppStmt, col)),
-                colWidths[col],
-                result);
+    std::vector<PlanRow> rows;
+
+    sqlite3_stmt *ppStmt = nullptr;
+    auto explain = "EXPLAIN QUERY PLAN " + sql;
+    if (sqlite3_prepare_v2(ppDb, explain.c_str(), -1, &ppStmt, nullptr) == SQLITE_OK && ppStmt != nullptr)
+    {
+        while (sqlite3_step(ppStmt) == SQLITE_ROW)
+        {
+            rows.push_back({sqlite3_column_int(ppStmt, 0), sqlite3_column_int(ppStmt, 1), std::string(SqliteColumnText(ppStmt, 3))});
         }
+    }
+    sqlite3_finalize(ppStmt);
 
-        result << " |\n";
+    if (rows.empty())
+    {
+        return;
+    }
 
-        auto stepResult = sqlite3_step(ppStmt);
+    result.append("QUERY PLAN\n");
 
-        if (stepResult != SQLITE_ROW)
+    std::function<void(int, const std::string &)> writeChildren = [&](int parent, const std::string &prefix) {
+        for (size_t i = 0; i < rows.size(); i++)
         {
-            if (stepResult != SQLITE_DONE)
+            if (rows[i].Parent != parent)
             {
-                ErrorResult(ppStmt, stepResult, result);
+                continue;
             }
 
-            break;
+            bool last = true;
+            for (size_t next = i + 1; next < rows.size(); next++)
+            {
+                if (rows[next].Parent == parent)
+                {
+                    last = false;
+                    break;
+                }
+            }
+
+            result.append(prefix + (last ? "`--" : "|--") + rows[i].Detail + "\n");
+            writeChildren(rows[i].Id, prefix + (last ? "   " : "|  "));
         }
+    };
+
+    writeChildren(0, "");
+}
+
+std::string FormatProfileTime(
+    int64_t nanoseconds)
+{
+    return FormatLatency(static_cast<uint32_t>(std::min<int64_t>(nanoseconds / 1000, UINT32_MAX)));
+}
+
+void ProfileResult(
+    const SqliteStatementProfile &profile,
+    bool firstPageOnly,
+    std::string &result)
+{
+    result.append("Time " + FormatProfileTime(std::chrono::duration_cast<std::chrono::nanoseconds>(profile.Elapsed).count()));
+    result.append(" (" + FormatProfileTime(profile.SqliteNanoseconds) + " in sqlite)");
+    result.append(", " + std::to_string(profile.VmSteps) + " VM steps");
+    result.append(", " + std::to_string(profile.FullScanSteps) + " full scan steps");
+    result.append(", " + std::to_string(profile.Sorts) + (profile.Sorts == 1 ? " sort" : " sorts"));
+    result.append(", " + std::to_string(profile.AutoIndexes) + (profile.AutoIndexes == 1 ? " automatic index" : " automatic indexes"));
+    if (firstPageOnly)
+    {
+        result.append(", for the first page of rows");
+    }
+    result.append("\n\n");
+}
+
+// The statements of a profiled script, the slowest first
+void ProfileSummaryResult(
+    const std::vector<SqliteStatementProfile> &profiles,
+    size_t columnWidth,
+    std::string &result)
+{
+    std::vector<size_t> order(profiles.size());
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return profiles[a].Elapsed > profiles[b].Elapsed;
+    });
+
+    TableSampler sampler({"#", "Statement", "Time", "In sqlite", "VM steps", "Full scan steps", "Sorts", "Automatic indexes"}, std::max<size_t>(columnWidth, 60));
+
+    for (auto i : order)
+    {
+        auto &profile = profiles[i];
+
+        sampler.AddCell(std::to_string(i + 1), true, false);
+        sampler.AddCell(profile.Statement, false, false);
+        sampler.AddCell(FormatProfileTime(std::chrono::duration_cast<std::chrono::nanoseconds>(profile.Elapsed).count()), true, false);
+        sampler.AddCell(FormatProfileTime(profile.SqliteNanoseconds), true, false);
+        sampler.AddCell(std::to_string(profile.VmSteps), true, false);
+        sampler.AddCell(std::to_string(profile.FullScanSteps), true, false);
+        sampler.AddCell(std::to_string(profile.Sorts), true, false);
+        sampler.AddCell(std::to_string(profile.AutoIndexes), true, false);
     }
 
-    result << "\n";
+    TableFormatter formatter(sampler.Columns());
+    formatter.WriteHeader(result);
+    sampler.WriteRows(formatter, result);
+    result.append("\n");
 }
 
-template <class T>
-T HeaderNumber(
-    const std::map<std::string, std::string> &headers,
-    const char *key,
-    T fallBackValue)
+// The script runs in a transaction of its own, so its own BEGIN and COMMIT are left out
+bool IsTransactionStatement(
+    std::string_view sql)
 {
-    auto header = headers.find(key);
-    if (header == headers.end())
+    auto words = SqlLeadingWords(sql, 3);
+
+    if (words.empty())
     {
-        return fallBackValue;
+        return false;
     }
 
-    auto value = (T)std::atoi(header->second.c_str());
+    if (words[0] == "BEGIN" || words[0] == "COMMIT" || words[0] == "END")
+    {
+        return true;
+    }
 
-    return value;
+    // ROLLBACK TO a savepoint stays within the transaction
+    return words[0] == "ROLLBACK" && std::find(words.begin(), words.end(), "TO") == words.end();
 }
 
 std::string FileRunnerService::ExecuteSqlite(
+    const std::string &title,
     const std::string &connectionString,
     const std::map<std::string, std::string> &headers,
-    const std::vector<std::string> &lines)
+    const std::vector<std::string> &lines,
+    const std::function<void(const std::shared_ptr<ResultGrid> &)> &showGrid,
+    const CancellationToken &cancellationToken)
 {
-    sqlite3 *ppDb;
-    auto openResult = sqlite3_open_v2(connectionString.c_str(), &ppDb, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr);
-    if (openResult != SQLITE_OK)
-    {
-        std::stringstream err;
+    // With a session the database stays open for the next run from the same
+    // tab, which is what keeps an in-memory database from starting out empty
+    std::string session;
 
-        err << "Error: failed to open '" << connectionString << "':\n";
-        err << sqlite3_errstr(openResult);
+    auto sessionHeader = headers.find("Session");
+    if (sessionHeader != headers.end() && iequals(trim_copy(sessionHeader->second), "true"))
+    {
+        session = title;
+    }
 
-        return err.str();
+    std::string openError;
+    auto connection = _sqliteConnectionPool.Acquire(connectionString, session, openError);
+    if (connection == nullptr)
+    {
+        return "Error: failed to open '" + connectionString + "':\n" + openError;
     }
 
+    auto ppDb = connection->Handle();
+
+    // Statements still running after Timeout seconds are interrupted
+    auto timeout = std::chrono::seconds(HeaderNumber<long long>(headers, "Timeout", 0));
+
+    connection->SetCancellationToken(&cancellationToken, timeout);
+
     std::ostringstream imploded;
     std::copy(lines.begin(), lines.end(),
               std::ostream_iterator<std::string>(imploded, "\n"));
 
     auto statement = imploded.str();
 
-    std::stringstream result;
+    std::string result;
 
-    sqlite3_stmt *ppStmt;
-    const char *full = statement.c_str();
-    const char *cursor = full;
-    size_t size = statement.size();
-    const char *tail = nullptr;
+    std::string_view remaining = statement;
 
-    auto columnWidth = HeaderNumber<size_t>(headers, "Column-Width", 20);
+    // Columns are as wide as their values in the first Sample-Rows rows, up
+    // to Column-Width characters
+    auto columnWidth = HeaderNumber<size_t>(headers, "Column-Width", 40);
 
     if (columnWidth < 5)
     {
         columnWidth = 5;
     }
 
-    while (size > 0)
+    auto sampleRows = std::max<size_t>(1, HeaderNumber<size_t>(headers, "Sample-Rows", 200));
+
+    auto bulkHeader = headers.find("Bulk");
+    if (bulkHeader != headers.end() && iequals(trim_copy(bulkHeader->second), "true"))
+    {
+        result = ExecuteSqliteBulk(*connection, statement, columnWidth, sampleRows, cancellationToken);
+
+        connection->SetCancellationToken(nullptr);
+        _sqliteConnectionPool.Release(connectionString, session, std::move(connection));
+
+        return result;
+    }
+
+    // The rows of the last statement are shown a page at a time when there are more
+    auto pageSize = std::max<size_t>(1, HeaderNumber<size_t>(headers, "Page-Size", 1000));
+
+    bool paged = false;
+    std::string pagedQuery;
+    std::vector<TableColumn> pagedColumns;
+
+    // No statement reads more than Max-Rows rows, a grid does not page past them either
+    auto maxRows = HeaderNumber<size_t>(headers, "Max-Rows", 0);
+    if (maxRows == 0)
+    {
+        maxRows = SIZE_MAX;
+    }
+
+    // Each statement is shown with its query plan, its time and what sqlite counted while it ran
+    auto profileHeader = headers.find("Profile");
+    bool profile = profileHeader != headers.end() && iequals(trim_copy(profileHeader->second), "true");
+
+    std::vector<SqliteStatementProfile> profiles;
+    int64_t sqliteNanoseconds = 0;
+
+    // All rows of each statement that returns them, up to Max-Rows, are also
+    // written to a file. Rows exported to a results file are paged from it.
+    auto exportHeader = headers.find("Export");
+    auto exportPath = exportHeader != headers.end() ? trim_copy(exportHeader->second) : std::string();
+    size_t exportCount = 0;
+    std::unique_ptr<ResultFileReader> exportedRows;
+
+    if (profile)
+    {
+        sqlite3_trace_v2(ppDb, SQLITE_TRACE_PROFILE, AddSqliteProfileTime, &sqliteNanoseconds);
+    }
+
+    while (!remaining.empty())
     {
-        auto prepareResult = sqlite3_prepare_v2(ppDb, cursor, int(size), &ppStmt, &tail);
+        if (cancellationToken.IsCancellationRequested())
+        {
+            result.append("Cancelled\n\n");
+
+            break;
+        }
+
+        if (connection->TimedOut())
+        {
+            result.append("Stopped, the script ran for longer than the Timeout of " + std::to_string(timeout.count()) + " s\n\n");
+
+            break;
+        }
+
+        sqlite3_stmt *ppStmt = nullptr;
+        size_t consumed = 0;
+
+        auto prepareResult = connection->Prepare(remaining, &ppStmt, consumed);
         if (prepareResult != SQLITE_OK)
         {
             ErrorResult(ppStmt, prepareResult, result);
 
-            sqlite3_close(ppDb);
+            break;
+        }
 
+        auto query = std::string(remaining.substr(0, consumed));
+        remaining.remove_prefix(consumed);
+
+        // Only whitespace or comments were left
+        if (ppStmt == nullptr)
+        {
             break;
         }
 
+        bool pageable = showGrid != nullptr && sqlite3_stmt_readonly(ppStmt) != 0 && trim_copy(std::string(remaining)).empty();
+
+        SqliteStatementProfile statementProfile;
+        if (profile)
+        {
+            statementProfile.Statement = trim_copy(query);
+
+            SqliteQueryPlan(ppDb, statementProfile.Statement, result);
+
+            // A cached statement still has the counts of its previous runs
+            sqlite3_stmt_status(ppStmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+            sqlite3_stmt_status(ppStmt, SQLITE_STMTSTATUS_SORT, 1);
+            sqlite3_stmt_status(ppStmt, SQLITE_STMTSTATUS_AUTOINDEX, 1);
+            sqlite3_stmt_status(ppStmt, SQLITE_STMTSTATUS_VM_STEP, 1);
+
+            sqliteNanoseconds = 0;
+        }
+
+        auto statementStarted = std::chrono::steady_clock::now();
+        bool firstPageOnly = false;
+
         auto stepResult = sqlite3_step(ppStmt);
 
         if (stepResult == SQLITE_DONE)
@@ -223,24 +563,349 @@ std::string FileRunnerService::ExecuteSqlite(
         }
         else if (stepResult == SQLITE_ROW)
         {
-            RowResult(ppStmt, columnWidth, result);
+            pageable = pageable && pageSize < maxRows;
+
+            std::unique_ptr<ResultExport> resultExport;
+            if (!exportPath.empty())
+            {
+                resultExport = StartResultExport(exportPath, exportCount++, SqliteColumnNames(ppStmt), result);
+            }
+
+            // What became of the export is written before the rows, the rows
+            // of a grid have to be the last lines of the output
+            std::string exportedTable;
+            auto more = RowResult(*connection, ppStmt, columnWidth, sampleRows, pageable ? pageSize : maxRows, pagedColumns, resultExport != nullptr ? exportedTable : result, resultExport.get(), maxRows);
+
+            bool exported = false;
+            if (resultExport != nullptr)
+            {
+                exported = FinishResultExport(*resultExport, result);
+                result.append(exportedTable);
+            }
+
+            if (more && pageable && exported && dynamic_cast<ResultFileWriter *>(resultExport.get()) != nullptr)
+            {
+                std::string readError;
+                exportedRows = std::make_unique<ResultFileReader>();
+                if (!exportedRows->Open(resultExport->Path(), readError))
+                {
+                    exportedRows = nullptr;
+                }
+            }
+
+            if (more && pageable)
+            {
+                firstPageOnly = resultExport == nullptr;
+
+                rtrim(query);
+                while (!query.empty() && query.back() == ';')
+                {
+                    query.pop_back();
+                    rtrim(query);
+                }
+
+                pagedQuery = maxRows == SIZE_MAX ? query : "SELECT * FROM (\n" + query + "\n) LIMIT " + std::to_string(maxRows);
+                paged = true;
+            }
+            else if (more)
+            {
+                result.append("Stopped after " + std::to_string(maxRows) + " rows, the Max-Rows limit\n\n");
+            }
         }
         else
         {
             ErrorResult(ppStmt, stepResult, result);
         }
 
-        size = statement.size() - (tail - full);
+        if (profile)
+        {
+            statementProfile.Elapsed = std::chrono::steady_clock::now() - statementStarted;
+            statementProfile.FullScanSteps = sqlite3_stmt_status(ppStmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+            statementProfile.Sorts = sqlite3_stmt_status(ppStmt, SQLITE_STMTSTATUS_SORT, 1);
+            statementProfile.AutoIndexes = sqlite3_stmt_status(ppStmt, SQLITE_STMTSTATUS_AUTOINDEX, 1);
+            statementProfile.VmSteps = sqlite3_stmt_status(ppStmt, SQLITE_STMTSTATUS_VM_STEP, 1);
+        }
+
+        connection->ResetStatement(ppStmt);
+
+        // sqlite reports the time of a statement once it is reset
+        if (profile)
+        {
+            statementProfile.SqliteNanoseconds = sqliteNanoseconds;
+
+            // The output of the statement without its trailing empty line
+            if (result.size() >= 2 && result.compare(result.size() - 2, 2, "\n\n") == 0)
+            {
+                result.pop_back();
+            }
+            ProfileResult(statementProfile, firstPageOnly, result);
+
+            profiles.push_back(std::move(statementProfile));
+        }
+    }
 
-        cursor = tail;
+    if (profile)
+    {
+        sqlite3_trace_v2(ppDb, 0, nullptr, nullptr);
 
-        if (size < 10 && trim_copy(std::string(cursor)).empty())
+        if (profiles.size() > 1)
+        {
+            ProfileSummaryResult(profiles, columnWidth, result);
+        }
+    }
+
+    connection->SetCancellationToken(nullptr);
+
+    if (!paged)
+    {
+        _sqliteConnectionPool.Release(connectionString, session, std::move(connection));
+
+        return result;
+    }
+
+    if (exportedRows != nullptr)
+    {
+        _sqliteConnectionPool.Release(connectionString, session, std::move(connection));
+
+        showGrid(std::make_shared<ResultFileGrid>(std::move(exportedRows), pagedColumns, pageSize));
+
+        return result;
+    }
+
+    // Without a session an in-memory database only lives as long as its
+    // connection, the grid keeps that connection for the pages it reads
+    std::unique_ptr<SqliteConnection> gridConnection;
+    if (session.empty() && IsSqliteMemoryDatabase(connectionString))
+    {
+        gridConnection = std::move(connection);
+    }
+    else
+    {
+        _sqliteConnectionPool.Release(connectionString, session, std::move(connection));
+    }
+
+    auto grid = std::make_shared<SqliteResultGrid>(
+        _sqliteConnectionPool,
+        connectionString,
+        session,
+        std::move(gridConnection),
+        pagedQuery,
+        pagedColumns,
+        pageSize);
+
+    grid->CountRows(_executor);
+    showGrid(grid);
+
+    return result;
+}
+
+void FileRunnerService::EndSession(
+    const std::string &title)
+{
+    _sqliteConnectionPool.EndSession(title);
+}
+
+std::string FileRunnerService::ExecuteSqliteBulk(
+    SqliteConnection &connection,
+    const std::string &statement,
+    size_t columnWidth,
+    size_t sampleRows,
+    const CancellationToken &cancellationToken)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    auto ppDb = connection.Handle();
+    std::string result;
+
+    // Nothing is synced to disk until the load is done. A database in WAL
+    // mode keeps it, others journal in memory for the length of the load.
+    auto pragmasStarted = Clock::now();
+
+    auto journalMode = SqlitePragma(ppDb, "PRAGMA journal_mode");
+    auto synchronous = SqlitePragma(ppDb, "PRAGMA synchronous");
+    auto cacheSize = SqlitePragma(ppDb, "PRAGMA cache_size");
+
+    if (!iequals(journalMode, "wal"))
+    {
+        SqlitePragma(ppDb, "PRAGMA journal_mode = MEMORY");
+    }
+    SqlitePragma(ppDb, "PRAGMA synchronous = OFF");
+    SqlitePragma(ppDb, "PRAGMA cache_size = -65536");
+
+    // A savepoint starts a transaction, or nests in one a session left open
+    sqlite3_exec(ppDb, "SAVEPOINT bulk", nullptr, nullptr, nullptr);
+
+    auto pragmasTime = Clock::now() - pragmasStarted;
+    Clock::duration prepareTime{0};
+    Clock::duration executeTime{0};
+
+    auto changesBefore = sqlite3_total_changes64(ppDb);
+    size_t statementCount = 0;
+    size_t insertCount = 0;
+    size_t skippedCount = 0;
+    std::unordered_set<std::string> shapes;
+    std::string shape;
+    std::vector<SqlLiteral> values;
+    bool failed = false;
+
+    std::string_view remaining = statement;
+
+    while (!remaining.empty())
+    {
+        if (cancellationToken.IsCancellationRequested())
+        {
+            result.append("Cancelled\n\n");
+            failed = true;
+
+            break;
+        }
+
+        if (connection.TimedOut())
+        {
+            result.append("Stopped, the script ran for longer than its Timeout\n\n");
+            failed = true;
+
+            break;
+        }
+
+        auto prepareStarted = Clock::now();
+
+        auto text = SqliteStatementText(remaining);
+
+        sqlite3_stmt *ppStmt = nullptr;
+        size_t consumed = 0;
+        int prepareResult = SQLITE_OK;
+        bool shaped = false;
+
+        if (IsTransactionStatement(text))
+        {
+            remaining.remove_prefix(text.size());
+            skippedCount++;
+            continue;
+        }
+
+        if (ParameterizeInsert(text, shape, values))
+        {
+            prepareResult = connection.Prepare(shape, &ppStmt, consumed);
+
+            // A shape sqlite does not take, with too many values for instance, runs as it is
+            shaped = prepareResult == SQLITE_OK && ppStmt != nullptr;
+            if (shaped)
+            {
+                BindLiterals(ppStmt, values);
+                consumed = text.size();
+                shapes.insert(shape);
+            }
+        }
+
+        if (!shaped)
+        {
+            prepareResult = connection.Prepare(remaining, &ppStmt, consumed);
+        }
+
+        prepareTime += Clock::now() - prepareStarted;
+
+        if (prepareResult != SQLITE_OK)
+        {
+            result.append("Error in statement " + std::to_string(statementCount + 1) + ": " + sqlite3_errmsg(ppDb) + "\n\n");
+            failed = true;
+
+            break;
+        }
+
+        remaining.remove_prefix(consumed);
+
+        // Only whitespace or comments were left
+        if (ppStmt == nullptr)
+        {
+            break;
+        }
+
+        statementCount++;
+        if (shaped)
+        {
+            insertCount++;
+        }
+
+        auto executeStarted = Clock::now();
+
+        auto stepResult = sqlite3_step(ppStmt);
+
+        if (stepResult == SQLITE_ROW)
+        {
+            std::vector<TableColumn> columns;
+            RowResult(connection, ppStmt, columnWidth, sampleRows, SIZE_MAX, columns, result, nullptr, 0);
+        }
+        else if (stepResult != SQLITE_DONE)
+        {
+            result.append("Error in statement " + std::to_string(statementCount) + ": " + sqlite3_errmsg(ppDb) + "\n\n");
+            failed = true;
+        }
+
+        connection.ResetStatement(ppStmt);
+
+        executeTime += Clock::now() - executeStarted;
+
+        if (failed)
         {
             break;
         }
     }
 
-    sqlite3_close(ppDb);
+    auto changes = sqlite3_total_changes64(ppDb) - changesBefore;
+
+    auto commitStarted = Clock::now();
 
-    return result.str();
+    // All or nothing, like the script ran as one statement
+    if (failed)
+    {
+        sqlite3_exec(ppDb, "ROLLBACK TO bulk", nullptr, nullptr, nullptr);
+        changes = 0;
+    }
+    sqlite3_exec(ppDb, "RELEASE bulk", nullptr, nullptr, nullptr);
+
+    auto commitTime = Clock::now() - commitStarted;
+
+    pragmasStarted = Clock::now();
+
+    SqlitePragma(ppDb, "PRAGMA cache_size = " + cacheSize);
+    SqlitePragma(ppDb, "PRAGMA synchronous = " + synchronous);
+    if (!iequals(journalMode, "wal") && !journalMode.empty())
+    {
+        SqlitePragma(ppDb, "PRAGMA journal_mode = " + journalMode);
+    }
+
+    pragmasTime += Clock::now() - pragmasStarted;
+
+    result.append("(" + std::to_string(changes) + (changes == 1 ? " row" : " rows") + " affected)\n");
+    result.append(std::to_string(statementCount) + " statements in one transaction, " + (failed ? "rolled back" : "committed"));
+    result.append(", " + std::to_string(insertCount) + " INSERTs ran on " + std::to_string(shapes.size()) + " prepared statements");
+    if (skippedCount > 0)
+    {
+        result.append(", " + std::to_string(skippedCount) + " transaction statements left out");
+    }
+    result.append("\n\n");
+
+    auto formatTime = [](Clock::duration time) {
+        return FormatLatency(static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(time).count()));
+    };
+
+    TableSampler timings({"Phase", "Time"}, 20);
+    timings.AddCell("Pragmas", false, false);
+    timings.AddCell(formatTime(pragmasTime), true, false);
+    timings.AddCell("Prepare", false, false);
+    timings.AddCell(formatTime(prepareTime), true, false);
+    timings.AddCell("Execute", false, false);
+    timings.AddCell(formatTime(executeTime), true, false);
+    timings.AddCell(failed ? "Rollback" : "Commit", false, false);
+    timings.AddCell(formatTime(commitTime), true, false);
+    timings.AddCell("Total", false, false);
+    timings.AddCell(formatTime(pragmasTime + prepareTime + executeTime + commitTime), true, false);
+
+    TableFormatter formatter(timings.Columns());
+    formatter.WriteHeader(result);
+    timings.WriteRows(formatter, result);
+    result.append("\n");
+
+    return result;
 }
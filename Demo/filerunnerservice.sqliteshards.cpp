@@ -0,0 +1,566 @@
+#include "filerunnerservice.hpp"
+
+#include "sqliteresultgrid.hpp"
+#include "stringhelpers.hpp"
+#include "tableformatter.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iterator>
+#include <mutex>
+#include <sqlite3.h>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// What one statement returned on one database
+struct ShardStatementResult
+{
+    std::vector<std::string> Names;
+    size_t RowCount = 0;
+    bool RowsLeftOut = false;
+    int Changes = 0;
+
+    // The values of all rows one after the other, with their sqlite types
+    std::string Values;
+    std::vector<size_t> ValueEnds;
+    std::vector<int> Types;
+
+    std::string_view Value(
+        size_t index) const
+    {
+        auto start = index == 0 ? 0 : ValueEnds[index - 1];
+
+        return std::string_view(Values).substr(start, ValueEnds[index] - start);
+    }
+};
+
+struct ShardResult
+{
+    std::vector<ShardStatementResult> Statements;
+    std::string Error;
+    std::chrono::steady_clock::duration Elapsed{0};
+};
+
+// Runs the statements one after the other and keeps up to maxRows rows of
+// each, the first error ends the script on this database
+void RunSqliteShard(
+    SqliteConnection &connection,
+    const std::string &statement,
+    size_t maxRows,
+    const CancellationToken &cancellationToken,
+    ShardResult &shard)
+{
+    auto ppDb = connection.Handle();
+
+    std::string_view remaining = statement;
+
+    while (!remaining.empty())
+    {
+        if (cancellationToken.IsCancellationRequested())
+        {
+            shard.Error = "Cancelled";
+
+            return;
+        }
+
+        sqlite3_stmt *ppStmt = nullptr;
+        size_t consumed = 0;
+
+        if (connection.Prepare(remaining, &ppStmt, consumed) != SQLITE_OK)
+        {
+            shard.Error = sqlite3_errmsg(ppDb);
+
+            return;
+        }
+
+        remaining.remove_prefix(consumed);
+
+        // Only whitespace or comments were left
+        if (ppStmt == nullptr)
+        {
+            break;
+        }
+
+        ShardStatementResult result;
+
+        auto columnCount = sqlite3_column_count(ppStmt);
+        for (int col = 0; col < columnCount; col++)
+        {
+            auto name = std::string(sqlite3_column_name(ppStmt, col));
+
+            trim(name);
+
+            result.Names.push_back(name);
+        }
+
+        auto stepResult = sqlite3_step(ppStmt);
+
+        while (stepResult == SQLITE_ROW)
+        {
+            if (result.RowCount == maxRows)
+            {
+                result.RowsLeftOut = true;
+
+                break;
+            }
+
+            for (int col = 0; col < columnCount; col++)
+            {
+                // The type is only what it was stored as before the value is read as text
+                result.Types.push_back(sqlite3_column_type(ppStmt, col));
+                result.Values.append(SqliteColumnText(ppStmt, col));
+                result.ValueEnds.push_back(result.Values.size());
+            }
+            result.RowCount++;
+            connection.AddRowsRead(1);
+
+            stepResult = sqlite3_step(ppStmt);
+        }
+
+        if (stepResult != SQLITE_ROW && stepResult != SQLITE_DONE)
+        {
+            shard.Error = sqlite3_errmsg(ppDb);
+        }
+        else if (columnCount == 0)
+        {
+            result.Changes = sqlite3_changes(ppDb);
+        }
+
+        connection.ResetStatement(ppStmt);
+
+        shard.Statements.push_back(std::move(result));
+
+        if (!shard.Error.empty())
+        {
+            return;
+        }
+    }
+}
+
+// The rows of statement on every database that returned the same columns,
+// in the order of the databases
+std::vector<std::pair<size_t, size_t>> ShardRows(
+    const std::vector<ShardResult> &shards,
+    size_t statement,
+    size_t columnCount)
+{
+    std::vector<std::pair<size_t, size_t>> rows;
+
+    for (size_t s = 0; s < shards.size(); s++)
+    {
+        if (statement >= shards[s].Statements.size() || shards[s].Statements[statement].Names.size() != columnCount)
+        {
+            continue;
+        }
+
+        for (size_t row = 0; row < shards[s].Statements[statement].RowCount; row++)
+        {
+            rows.emplace_back(s, row);
+        }
+    }
+
+    return rows;
+}
+
+// All rows in one table, with the database they came from in the first column
+void WriteShardUnion(
+    const std::vector<std::string> &connectionStrings,
+    const std::vector<ShardResult> &shards,
+    size_t statement,
+    const std::vector<std::string> &names,
+    size_t columnWidth,
+    size_t sampleRows,
+    std::string &result)
+{
+    auto rows = ShardRows(shards, statement, names.size());
+
+    std::vector<std::string> tableNames = {"Shard"};
+    tableNames.insert(tableNames.end(), names.begin(), names.end());
+
+    TableSampler sampler(tableNames, columnWidth);
+
+    auto sampled = std::min(sampleRows, rows.size());
+    for (size_t i = 0; i < sampled; i++)
+    {
+        auto &source = shards[rows[i].first].Statements[statement];
+
+        sampler.AddCell(connectionStrings[rows[i].first], false, false);
+        for (size_t col = 0; col < names.size(); col++)
+        {
+            auto index = rows[i].second * names.size() + col;
+            auto type = source.Types[index];
+
+            sampler.AddCell(source.Value(index), type == SQLITE_INTEGER || type == SQLITE_FLOAT, type == SQLITE_NULL);
+        }
+    }
+
+    TableFormatter formatter(sampler.Columns());
+
+    formatter.WriteHeader(result);
+    sampler.WriteRows(formatter, result);
+
+    for (size_t i = sampled; i < rows.size(); i++)
+    {
+        auto &source = shards[rows[i].first].Statements[statement];
+
+        formatter.WriteCell(0, connectionStrings[rows[i].first], result);
+        for (size_t col = 0; col < names.size(); col++)
+        {
+            formatter.WriteCell(col + 1, source.Value(rows[i].second * names.size() + col), result);
+        }
+        formatter.EndRow(result);
+    }
+}
+
+// Rows with the same values in their text columns are merged into one, with
+// the sum of their number columns and the number of rows that were merged
+void WriteShardSum(
+    const std::vector<ShardResult> &shards,
+    size_t statement,
+    const std::vector<std::string> &names,
+    size_t columnWidth,
+    std::string &result)
+{
+    auto rows = ShardRows(shards, statement, names.size());
+
+    // Summed are the columns that only hold numbers, or NULL
+    std::vector<bool> summed(names.size(), false);
+    std::vector<bool> hasText(names.size(), false);
+    for (auto &row : rows)
+    {
+        auto &source = shards[row.first].Statements[statement];
+        for (size_t col = 0; col < names.size(); col++)
+        {
+            auto type = source.Types[row.second * names.size() + col];
+
+            summed[col] = summed[col] || type == SQLITE_INTEGER || type == SQLITE_FLOAT;
+            hasText[col] = hasText[col] || type == SQLITE_TEXT || type == SQLITE_BLOB;
+        }
+    }
+    for (size_t col = 0; col < names.size(); col++)
+    {
+        summed[col] = summed[col] && !hasText[col];
+    }
+
+    struct Group
+    {
+        std::pair<size_t, size_t> FirstRow;
+        std::vector<int64_t> Integers;
+        std::vector<double> Reals;
+        std::vector<bool> IsReal;
+        std::vector<bool> HasValue;
+        size_t RowCount = 0;
+    };
+
+    std::vector<Group> groups;
+    std::unordered_map<std::string, size_t> groupsByKey;
+    std::string key;
+
+    for (auto &row : rows)
+    {
+        auto &source = shards[row.first].Statements[statement];
+        auto first = row.second * names.size();
+
+        key.clear();
+        for (size_t col = 0; col < names.size(); col++)
+        {
+            if (!summed[col])
+            {
+                key.push_back(char(source.Types[first + col]));
+                key.append(source.Value(first + col));
+                key.push_back('\0');
+            }
+        }
+
+        auto found = groupsByKey.find(key);
+        if (found == groupsByKey.end())
+        {
+            found = groupsByKey.emplace(key, groups.size()).first;
+
+            Group group;
+            group.FirstRow = row;
+            group.Integers.resize(names.size(), 0);
+            group.Reals.resize(names.size(), 0.0);
+            group.IsReal.resize(names.size(), false);
+            group.HasValue.resize(names.size(), false);
+            groups.push_back(std::move(group));
+        }
+
+        auto &group = groups[found->second];
+        group.RowCount++;
+
+        for (size_t col = 0; col < names.size(); col++)
+        {
+            auto type = source.Types[first + col];
+            if (!summed[col] || type == SQLITE_NULL)
+            {
+                continue;
+            }
+
+            auto value = std::string(source.Value(first + col));
+
+            group.HasValue[col] = true;
+            if (type == SQLITE_FLOAT)
+            {
+                group.IsReal[col] = true;
+            }
+            group.Integers[col] += type == SQLITE_INTEGER ? std::strtoll(value.c_str(), nullptr, 10) : 0;
+            group.Reals[col] += std::strtod(value.c_str(), nullptr);
+        }
+    }
+
+    auto tableNames = names;
+    tableNames.push_back("Merged");
+
+    TableSampler sampler(tableNames, columnWidth);
+
+    for (auto &group : groups)
+    {
+        auto &source = shards[group.FirstRow.first].Statements[statement];
+        auto first = group.FirstRow.second * names.size();
+
+        for (size_t col = 0; col < names.size(); col++)
+        {
+            if (!summed[col])
+            {
+                auto type = source.Types[first + col];
+                sampler.AddCell(source.Value(first + col), type == SQLITE_INTEGER || type == SQLITE_FLOAT, type == SQLITE_NULL);
+            }
+            else if (!group.HasValue[col])
+            {
+                sampler.AddCell("", false, true);
+            }
+            else if (group.IsReal[col])
+            {
+                std::ostringstream value;
+                value.precision(15);
+                value << group.Reals[col];
+                sampler.AddCell(value.str(), true, false);
+            }
+            else
+            {
+                sampler.AddCell(std::to_string(group.Integers[col]), true, false);
+            }
+        }
+        sampler.AddCell(std::to_string(group.RowCount), true, false);
+    }
+
+    TableFormatter formatter(sampler.Columns());
+
+    formatter.WriteHeader(result);
+    sampler.WriteRows(formatter, result);
+}
+
+std::string FileRunnerService::ExecuteSqliteShards(
+    const std::vector<std::string> &connectionStrings,
+    const std::map<std::string, std::string> &headers,
+    const std::vector<std::string> &lines,
+    const CancellationToken &cancellationToken)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    std::ostringstream imploded;
+    std::copy(lines.begin(), lines.end(),
+              std::ostream_iterator<std::string>(imploded, "\n"));
+
+    auto statement = imploded.str();
+
+    auto columnWidth = std::max<size_t>(5, HeaderNumber<size_t>(headers, "Column-Width", 40));
+    auto sampleRows = std::max<size_t>(1, HeaderNumber<size_t>(headers, "Sample-Rows", 200));
+
+    // All rows are kept until every database is done, this keeps a query
+    // that returns a lot of them from running out of memory
+    auto maxRows = std::max<size_t>(1, HeaderNumber<size_t>(headers, "Max-Rows", 10000));
+
+    // Each database is interrupted once it ran for longer than Timeout seconds
+    auto timeout = std::chrono::seconds(HeaderNumber<long long>(headers, "Timeout", 0));
+
+    auto mergeHeader = headers.find("Merge");
+    bool sum = mergeHeader != headers.end() && iequals(trim_copy(mergeHeader->second), "sum");
+
+    // sqlite connections do not share anything, so each database gets a core.
+    // The runners are executor jobs, it decides how many of them run at once.
+    auto parallelism = HeaderNumber<size_t>(headers, "Parallelism", std::max(1u, std::thread::hardware_concurrency()));
+    auto runnerCount = std::min(connectionStrings.size(), std::max<size_t>(1, parallelism));
+
+    std::vector<ShardResult> shards(connectionStrings.size());
+    std::mutex shardsMutex;
+    size_t nextShard = 0;
+
+    auto started = Clock::now();
+
+    std::vector<std::shared_ptr<JobHandle>> runners;
+    for (size_t t = 0; t < runnerCount; t++)
+    {
+        runners.push_back(_executor.Submit([&](const CancellationToken &) {
+            while (true)
+            {
+                size_t i;
+                {
+                    std::lock_guard<std::mutex> lock(shardsMutex);
+                    if (nextShard >= connectionStrings.size())
+                    {
+                        return;
+                    }
+                    i = nextShard++;
+                }
+
+                // Each runner only touches its own result
+                auto &shard = shards[i];
+                auto shardStarted = Clock::now();
+
+                // A shard that fails this way does not stop the others
+                try
+                {
+                    std::string openError;
+                    auto connection = _sqliteConnectionPool.Acquire(connectionStrings[i], "", openError);
+                    if (connection == nullptr)
+                    {
+                        shard.Error = "failed to open: " + openError;
+                    }
+                    else
+                    {
+                        connection->SetCancellationToken(&cancellationToken, timeout);
+
+                        RunSqliteShard(*connection, statement, maxRows, cancellationToken, shard);
+
+                        if (connection->TimedOut())
+                        {
+                            shard.Error = "stopped after the Timeout of " + std::to_string(timeout.count()) + " s";
+                        }
+
+                        connection->SetCancellationToken(nullptr);
+                        _sqliteConnectionPool.Release(connectionStrings[i], "", std::move(connection));
+                    }
+                }
+                catch (const std::exception &e)
+                {
+                    shard.Error = e.what();
+                }
+
+                shard.Elapsed = Clock::now() - shardStarted;
+            }
+        }));
+    }
+
+    for (auto &runner : runners)
+    {
+        _executor.Wait(runner);
+    }
+
+    auto elapsed = Clock::now() - started;
+
+    std::string result;
+
+    size_t statementCount = 0;
+    for (auto &shard : shards)
+    {
+        statementCount = std::max(statementCount, shard.Statements.size());
+    }
+
+    for (size_t statementIndex = 0; statementIndex < statementCount; statementIndex++)
+    {
+        // The first database that got this far decides the columns
+        const ShardStatementResult *first = nullptr;
+        int changes = 0;
+        bool rowsLeftOut = false;
+        std::vector<std::string> differentColumns;
+
+        for (size_t s = 0; s < shards.size(); s++)
+        {
+            if (statementIndex >= shards[s].Statements.size())
+            {
+                continue;
+            }
+
+            auto &shardStatement = shards[s].Statements[statementIndex];
+
+            if (first == nullptr)
+            {
+                first = &shardStatement;
+            }
+            else if (shardStatement.Names.size() != first->Names.size())
+            {
+                differentColumns.push_back(connectionStrings[s]);
+            }
+
+            changes += shardStatement.Changes;
+            rowsLeftOut = rowsLeftOut || shardStatement.RowsLeftOut;
+        }
+
+        if (first->Names.empty())
+        {
+            result.append("(" + std::to_string(changes) + (changes == 1 ? " row" : " rows") + " affected)\n\n");
+
+            continue;
+        }
+
+        if (sum)
+        {
+            WriteShardSum(shards, statementIndex, first->Names, columnWidth, result);
+        }
+        else
+        {
+            WriteShardUnion(connectionStrings, shards, statementIndex, first->Names, columnWidth, sampleRows, result);
+        }
+
+        if (rowsLeftOut)
+        {
+            result.append("Only the first " + std::to_string(maxRows) + " rows of each database are included\n");
+        }
+
+        for (auto &connectionString : differentColumns)
+        {
+            result.append("Left out " + connectionString + ", its columns differ from the first database\n");
+        }
+
+        result.append("\n");
+    }
+
+    auto formatTime = [](Clock::duration time) {
+        return FormatLatency(static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(time).count()));
+    };
+
+    TableSampler timings({"Shard", "Time", "Rows", "Result"}, std::max<size_t>(columnWidth, 60));
+
+    Clock::duration sequentialTime{0};
+    size_t failedCount = 0;
+    for (size_t s = 0; s < shards.size(); s++)
+    {
+        size_t rowCount = 0;
+        for (auto &shardStatement : shards[s].Statements)
+        {
+            rowCount += shardStatement.RowCount;
+        }
+
+        sequentialTime += shards[s].Elapsed;
+        if (!shards[s].Error.empty())
+        {
+            failedCount++;
+        }
+
+        timings.AddCell(connectionStrings[s], false, false);
+        timings.AddCell(formatTime(shards[s].Elapsed), true, false);
+        timings.AddCell(std::to_string(rowCount), true, false);
+        timings.AddCell(shards[s].Error.empty() ? "OK" : "Error: " + shards[s].Error, false, false);
+    }
+
+    TableFormatter formatter(timings.Columns());
+    formatter.WriteHeader(result);
+    timings.WriteRows(formatter, result);
+
+    result.append("\n" + std::to_string(shards.size()) + " databases in " + formatTime(elapsed) + ", " + std::to_string(runnerCount) + " at a time, ");
+    result.append(formatTime(sequentialTime) + " one after the other");
+    if (failedCount > 0)
+    {
+        result.append(", " + std::to_string(failedCount) + " failed");
+    }
+    result.append("\n");
+
+    return result;
+}
@@ -0,0 +1,126 @@
+#include "jsonformatter.hpp"
+
+JsonFormatter::JsonFormatter(
+    const std::function<void(std::string_view)> &write)
+    : _write(write)
+{}
+
+JsonFormatter::~JsonFormatter() = default;
+
+void JsonFormatter::NewLine()
+{
+    _output.push_back('\n');
+    _output.append(_depth, '\t');
+}
+
+void JsonFormatter::Write(
+    std::string_view piece)
+{
+    _output.clear();
+    _output.reserve(piece.size() + piece.size() / 2);
+
+    for (size_t i = 0; i < piece.size(); i++)
+    {
+        auto c = piece[i];
+
+        if (_inString)
+        {
+            // Runs of plain string characters are copied in one go
+            size_t end = i;
+            while (end < piece.size() && piece[end] != '"' && piece[end] != '\\')
+            {
+                end++;
+            }
+
+            if (end > i)
+            {
+                _escaped = false;
+                _output.append(piece.substr(i, end - i));
+                i = end - 1;
+                continue;
+            }
+
+            _output.push_back(c);
+            if (_escaped)
+            {
+                _escaped = false;
+            }
+            else if (c == '\\')
+            {
+                _escaped = true;
+            }
+            else if (c == '"')
+            {
+                _inString = false;
+            }
+            continue;
+        }
+
+        switch (c)
+        {
+            case ' ':
+            case '\t':
+            case '\r':
+                break;
+
+            case '\n':
+                // Values on their own lines, like in JSON lines, stay on their own lines
+                if (_depth == 0 && _valueWritten && !_openPending)
+                {
+                    _output.push_back('\n');
+                    _valueWritten = false;
+                }
+                break;
+
+            case '}':
+            case ']':
+                if (_depth > 0)
+                {
+                    _depth--;
+                }
+                if (!_openPending)
+                {
+                    NewLine();
+                }
+                _openPending = false;
+                _output.push_back(c);
+                break;
+
+            case ',':
+                _openPending = false;
+                _output.push_back(c);
+                NewLine();
+                break;
+
+            case ':':
+                _output.append(": ");
+                break;
+
+            default:
+                if (_openPending)
+                {
+                    NewLine();
+                    _openPending = false;
+                }
+
+                _output.push_back(c);
+                _valueWritten = true;
+
+                if (c == '{' || c == '[')
+                {
+                    _depth++;
+                    _openPending = true;
+                }
+                else if (c == '"')
+                {
+                    _inString = true;
+                }
+                break;
+        }
+    }
+
+    if (!_output.empty())
+    {
+        _write(_output);
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef JSONFORMATTER_HPP
+#define JSONFORMATTER_HPP
+
+#include <functional>
+#include <string>
+#include <string_view>
+
+// Pretty-prints JSON while it is received, piece by piece and without
+// building a document. Every nesting level is indented by one tab, which the
+// result editor folds on. Input that is not valid JSON is passed on reformatted
+// as far as its strings and brackets go, it is not rejected.
+class JsonFormatter
+{
+public:
+    JsonFormatter(
+        const std::function<void(std::string_view)> &write);
+
+    virtual ~JsonFormatter();
+
+public:
+    void Write(
+        std::string_view piece);
+
+private:
+    std::function<void(std::string_view)> _write;
+    std::string _output;
+    int _depth = 0;
+    bool _inString = false;
+    bool _escaped = false;
+    // An object or array was opened, its first line starts once it turns out not to be empty
+    bool _openPending = false;
+    bool _valueWritten = false;
+
+    void NewLine();
+};
+
+#endif // JSONFORMATTER_HPP
@@ -0,0 +1,1639 @@
+#include "mssqlconnection.hpp"
+
+#include "stringhelpers.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+// Packet types
+const uint8_t MssqlSqlBatch = 0x01;
+const uint8_t MssqlAttention = 0x06;
+const uint8_t MssqlLogin7 = 0x10;
+const uint8_t MssqlPrelogin = 0x12;
+const uint8_t MssqlResponse = 0x04;
+
+const uint8_t MssqlEndOfMessage = 0x01;
+
+// Status bits of DONE tokens
+const uint16_t MssqlDoneMore = 0x0001;
+const uint16_t MssqlDoneCount = 0x0010;
+const uint16_t MssqlDoneAttention = 0x0020;
+
+const uint8_t MssqlEncryptNotSupported = 0x02;
+
+const uint64_t MssqlPlpNull = 0xffffffffffffffffull;
+
+void AppendMssqlInt(
+    std::string &output,
+    uint64_t value,
+    size_t bytes)
+{
+    for (size_t i = 0; i < bytes; i++)
+    {
+        output.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+}
+
+uint64_t MssqlInt(
+    std::string_view data,
+    size_t pos,
+    size_t bytes)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes && pos + i < data.size(); i++)
+    {
+        value |= uint64_t(static_cast<uint8_t>(data[pos + i])) << (8 * i);
+    }
+
+    return value;
+}
+
+// SQL Server sends and expects text as UTF-16
+void AppendMssqlUtf16(
+    std::string &output,
+    std::string_view text)
+{
+    for (size_t i = 0; i < text.size();)
+    {
+        auto c = static_cast<uint8_t>(text[i]);
+        uint32_t codePoint = c;
+        size_t length = 1;
+
+        if (c >= 0xf0 && i + 3 < text.size())
+        {
+            codePoint = ((c & 0x07) << 18) | ((text[i + 1] & 0x3f) << 12) | ((text[i + 2] & 0x3f) << 6) | (text[i + 3] & 0x3f);
+            length = 4;
+        }
+        else if (c >= 0xe0 && i + 2 < text.size())
+        {
+            codePoint = ((c & 0x0f) << 12) | ((text[i + 1] & 0x3f) << 6) | (text[i + 2] & 0x3f);
+            length = 3;
+        }
+        else if (c >= 0xc0 && i + 1 < text.size())
+        {
+            codePoint = ((c & 0x1f) << 6) | (text[i + 1] & 0x3f);
+            length = 2;
+        }
+
+        if (codePoint >= 0x10000)
+        {
+            codePoint -= 0x10000;
+            AppendMssqlInt(output, 0xd800 + (codePoint >> 10), 2);
+            AppendMssqlInt(output, 0xdc00 + (codePoint & 0x3ff), 2);
+        }
+        else
+        {
+            AppendMssqlInt(output, codePoint, 2);
+        }
+
+        i += length;
+    }
+}
+
+void AppendMssqlUtf8CodePoint(
+    std::string &output,
+    uint32_t codePoint)
+{
+    if (codePoint < 0x80)
+    {
+        output.push_back(static_cast<char>(codePoint));
+    }
+    else if (codePoint < 0x800)
+    {
+        output.push_back(static_cast<char>(0xc0 | (codePoint >> 6)));
+        output.push_back(static_cast<char>(0x80 | (codePoint & 0x3f)));
+    }
+    else if (codePoint < 0x10000)
+    {
+        output.push_back(static_cast<char>(0xe0 | (codePoint >> 12)));
+        output.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f)));
+        output.push_back(static_cast<char>(0x80 | (codePoint & 0x3f)));
+    }
+    else
+    {
+        output.push_back(static_cast<char>(0xf0 | (codePoint >> 18)));
+        output.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3f)));
+        output.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f)));
+        output.push_back(static_cast<char>(0x80 | (codePoint & 0x3f)));
+    }
+}
+
+void AppendMssqlUtf8(
+    std::string &output,
+    std::string_view utf16)
+{
+    for (size_t i = 0; i + 1 < utf16.size(); i += 2)
+    {
+        auto unit = static_cast<uint32_t>(MssqlInt(utf16, i, 2));
+
+        if (unit >= 0xd800 && unit < 0xdc00 && i + 3 < utf16.size())
+        {
+            auto low = static_cast<uint32_t>(MssqlInt(utf16, i + 2, 2));
+            if (low >= 0xdc00 && low < 0xe000)
+            {
+                AppendMssqlUtf8CodePoint(output, 0x10000 + ((unit - 0xd800) << 10) + (low - 0xdc00));
+                i += 2;
+                continue;
+            }
+        }
+
+        AppendMssqlUtf8CodePoint(output, unit);
+    }
+}
+
+bool IsMssqlUtf8(
+    std::string_view text)
+{
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        auto c = static_cast<uint8_t>(text[i]);
+        size_t continuation = c < 0x80 ? 0 : c >= 0xf0 ? 3 : c >= 0xe0 ? 2 : c >= 0xc2 ? 1 : SIZE_MAX;
+
+        if (continuation == SIZE_MAX || i + continuation >= text.size())
+        {
+            return false;
+        }
+
+        for (size_t j = 1; j <= continuation; j++)
+        {
+            if ((static_cast<uint8_t>(text[i + j]) & 0xc0) != 0x80)
+            {
+                return false;
+            }
+        }
+
+        i += continuation;
+    }
+
+    return true;
+}
+
+// varchar columns are in the code page of their collation. UTF-8 collations
+// and ASCII text are passed on as they are, anything else is taken to be
+// Windows-1252, the code page of the default collations.
+void AppendMssqlSingleByteText(
+    std::string &output,
+    std::string_view text)
+{
+    if (IsMssqlUtf8(text))
+    {
+        output.append(text);
+        return;
+    }
+
+    static const uint16_t windows1252[32] = {
+        0x20ac, 0x0081, 0x201a, 0x0192, 0x201e, 0x2026, 0x2020, 0x2021,
+        0x02c6, 0x2030, 0x0160, 0x2039, 0x0152, 0x008d, 0x017d, 0x008f,
+        0x0090, 0x2018, 0x2019, 0x201c, 0x201d, 0x2022, 0x2013, 0x2014,
+        0x02dc, 0x2122, 0x0161, 0x203a, 0x0153, 0x009d, 0x017e, 0x0178};
+
+    for (auto c : text)
+    {
+        auto byte = static_cast<uint8_t>(c);
+        AppendMssqlUtf8CodePoint(output, byte >= 0x80 && byte < 0xa0 ? windows1252[byte - 0x80] : byte);
+    }
+}
+
+void AppendMssqlHex(
+    std::string &output,
+    std::string_view data)
+{
+    static const char digits[] = "0123456789ABCDEF";
+
+    output.append("0x");
+    for (auto c : data)
+    {
+        output.push_back(digits[static_cast<uint8_t>(c) >> 4]);
+        output.push_back(digits[static_cast<uint8_t>(c) & 0x0f]);
+    }
+}
+
+// days counts from 0001-01-01
+void AppendMssqlDate(
+    std::string &output,
+    int64_t days)
+{
+    // From days since 1970-01-01 to a civil date, as in
+    // http://howardhinnant.github.io/date_algorithms.html
+    auto z = days - 719162 + 719468;
+    auto era = (z >= 0 ? z : z - 146096) / 146097;
+    auto dayOfEra = z - era * 146097;
+    auto yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    auto dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    auto monthFromMarch = (5 * dayOfYear + 2) / 153;
+    auto day = dayOfYear - (153 * monthFromMarch + 2) / 5 + 1;
+    auto month = monthFromMarch < 10 ? monthFromMarch + 3 : monthFromMarch - 9;
+    auto year = yearOfEra + era * 400 + (month <= 2 ? 1 : 0);
+
+    char text[32];
+    std::snprintf(text, sizeof(text), "%04d-%02d-%02d", int(year), int(month), int(day));
+    output.append(text);
+}
+
+// units are 10^-scale seconds since midnight
+void AppendMssqlTime(
+    std::string &output,
+    uint64_t units,
+    uint8_t scale)
+{
+    uint64_t perSecond = 1;
+    for (uint8_t i = 0; i < scale; i++)
+    {
+        perSecond *= 10;
+    }
+
+    auto seconds = units / perSecond;
+
+    char text[48];
+    std::snprintf(text, sizeof(text), "%02d:%02d:%02d", int(seconds / 3600), int(seconds / 60 % 60), int(seconds % 60));
+    output.append(text);
+
+    if (scale > 0)
+    {
+        std::snprintf(text, sizeof(text), ".%0*llu", int(scale), static_cast<unsigned long long>(units % perSecond));
+        output.append(text);
+    }
+}
+
+void AppendMssqlDecimal(
+    std::string &output,
+    std::string_view data,
+    uint8_t scale)
+{
+    // A sign byte, then the value without its decimal point in up to 16 bytes
+    uint8_t magnitude[16] = {};
+    auto length = std::min<size_t>(data.size() - 1, sizeof(magnitude));
+    std::memcpy(magnitude, data.data() + 1, length);
+
+    char digits[48];
+    size_t count = 0;
+
+    bool zero = false;
+    while (!zero)
+    {
+        uint32_t remainder = 0;
+        zero = true;
+        for (size_t i = length; i-- > 0;)
+        {
+            auto current = (remainder << 8) | magnitude[i];
+            magnitude[i] = static_cast<uint8_t>(current / 10);
+            remainder = current % 10;
+            zero = zero && magnitude[i] == 0;
+        }
+        digits[count++] = static_cast<char>('0' + remainder);
+    }
+
+    while (count <= scale)
+    {
+        digits[count++] = '0';
+    }
+
+    bool isZero = std::all_of(digits, digits + count, [](char c) { return c == '0'; });
+    if (data[0] == 0 && !isZero)
+    {
+        output.push_back('-');
+    }
+
+    for (size_t i = count; i-- > 0;)
+    {
+        output.push_back(digits[i]);
+        if (i == scale && scale > 0)
+        {
+            output.push_back('.');
+        }
+    }
+}
+
+int MssqlFixedLength(
+    uint8_t type)
+{
+    switch (type)
+    {
+        case 0x1f: // NULL
+            return 0;
+        case 0x30: // TINYINT
+        case 0x32: // BIT
+            return 1;
+        case 0x34: // SMALLINT
+            return 2;
+        case 0x38: // INT
+        case 0x3a: // SMALLDATETIME
+        case 0x3b: // REAL
+        case 0x7a: // SMALLMONEY
+            return 4;
+        case 0x3c: // MONEY
+        case 0x3d: // DATETIME
+        case 0x3e: // FLOAT
+        case 0x7f: // BIGINT
+            return 8;
+        default:
+            return -1;
+    }
+}
+
+// Writes a value like SQL Server Management Studio shows it
+void FormatMssqlValue(
+    const MssqlColumn &column,
+    std::string_view data,
+    std::string &output)
+{
+    char text[64];
+
+    switch (column.Type)
+    {
+        case 0x30: // TINYINT
+        case 0x34: // SMALLINT
+        case 0x38: // INT
+        case 0x7f: // BIGINT
+        case 0x26: // INTN
+        {
+            auto value = MssqlInt(data, 0, data.size());
+            switch (data.size())
+            {
+                case 1:
+                    output.append(std::to_string(value));
+                    break;
+                case 2:
+                    output.append(std::to_string(int16_t(value)));
+                    break;
+                case 4:
+                    output.append(std::to_string(int32_t(value)));
+                    break;
+                default:
+                    output.append(std::to_string(int64_t(value)));
+                    break;
+            }
+            break;
+        }
+        case 0x32: // BIT
+        case 0x68: // BITN
+            output.push_back(!data.empty() && data[0] != 0 ? '1' : '0');
+            break;
+        case 0x3b: // REAL
+        case 0x3e: // FLOAT
+        case 0x6d: // FLTN
+        {
+            auto bits = MssqlInt(data, 0, data.size());
+            if (data.size() == 4)
+            {
+                float value;
+                auto bits32 = static_cast<uint32_t>(bits);
+                std::memcpy(&value, &bits32, sizeof(value));
+                std::snprintf(text, sizeof(text), "%.7g", value);
+            }
+            else
+            {
+                double value;
+                std::memcpy(&value, &bits, sizeof(value));
+                std::snprintf(text, sizeof(text), "%.15g", value);
+            }
+            output.append(text);
+            break;
+        }
+        case 0x3c: // MONEY
+        case 0x7a: // SMALLMONEY
+        case 0x6e: // MONEYN
+        {
+            // In ten thousandths, money has the high half first
+            int64_t value = data.size() == 4
+                                ? int32_t(MssqlInt(data, 0, 4))
+                                : int64_t((MssqlInt(data, 0, 4) << 32) | MssqlInt(data, 4, 4));
+            auto magnitude = value < 0 ? 0 - uint64_t(value) : uint64_t(value);
+            std::snprintf(text, sizeof(text), "%s%llu.%04llu", value < 0 ? "-" : "", static_cast<unsigned long long>(magnitude / 10000), static_cast<unsigned long long>(magnitude % 10000));
+            output.append(text);
+            break;
+        }
+        case 0x3d: // DATETIME
+        case 0x3a: // SMALLDATETIME
+        case 0x6f: // DATETIMN
+        {
+            // Days since 1900-01-01, then 1/300 seconds or minutes since midnight
+            const int64_t days1900 = 693595;
+            if (data.size() == 4)
+            {
+                AppendMssqlDate(output, days1900 + MssqlInt(data, 0, 2));
+                output.push_back(' ');
+                AppendMssqlTime(output, MssqlInt(data, 2, 2) * 60, 0);
+            }
+            else
+            {
+                AppendMssqlDate(output, days1900 + int32_t(MssqlInt(data, 0, 4)));
+                output.push_back(' ');
+                AppendMssqlTime(output, (MssqlInt(data, 4, 4) * 1000 + 150) / 300, 3);
+            }
+            break;
+        }
+        case 0x28: // DATE
+            AppendMssqlDate(output, MssqlInt(data, 0, 3));
+            break;
+        case 0x29: // TIME
+            AppendMssqlTime(output, MssqlInt(data, 0, data.size()), column.Scale);
+            break;
+        case 0x2a: // DATETIME2
+        {
+            auto timeLength = data.size() - 3;
+            AppendMssqlDate(output, MssqlInt(data, timeLength, 3));
+            output.push_back(' ');
+            AppendMssqlTime(output, MssqlInt(data, 0, timeLength), column.Scale);
+            break;
+        }
+        case 0x2b: // DATETIMEOFFSET
+        {
+            // The date and time are in UTC, they are shown in their own offset
+            auto timeLength = data.size() - 5;
+            auto offset = int16_t(MssqlInt(data, timeLength + 3, 2));
+
+            int64_t perSecond = 1;
+            for (uint8_t i = 0; i < column.Scale; i++)
+            {
+                perSecond *= 10;
+            }
+
+            auto perDay = 86400 * perSecond;
+            auto local = int64_t(MssqlInt(data, timeLength, 3)) * perDay + int64_t(MssqlInt(data, 0, timeLength)) + offset * 60 * perSecond;
+
+            AppendMssqlDate(output, local / perDay);
+            output.push_back(' ');
+            AppendMssqlTime(output, uint64_t(local % perDay), column.Scale);
+
+            auto minutes = offset < 0 ? -offset : offset;
+            std::snprintf(text, sizeof(text), " %c%02d:%02d", offset < 0 ? '-' : '+', minutes / 60, minutes % 60);
+            output.append(text);
+            break;
+        }
+        case 0x6a: // DECIMAL
+        case 0x6c: // NUMERIC
+            if (!data.empty())
+            {
+                AppendMssqlDecimal(output, data, column.Scale);
+            }
+            break;
+        case 0x24: // UNIQUEIDENTIFIER
+        {
+            if (data.size() != 16)
+            {
+                AppendMssqlHex(output, data);
+                break;
+            }
+
+            auto byte = [&data](size_t i) { return static_cast<unsigned>(static_cast<uint8_t>(data[i])); };
+            std::snprintf(text, sizeof(text), "%08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X",
+                          static_cast<unsigned>(MssqlInt(data, 0, 4)), static_cast<unsigned>(MssqlInt(data, 4, 2)), static_cast<unsigned>(MssqlInt(data, 6, 2)),
+                          byte(8), byte(9), byte(10), byte(11), byte(12), byte(13), byte(14), byte(15));
+            output.append(text);
+            break;
+        }
+        case 0xa7: // VARCHAR
+        case 0xaf: // CHAR
+        case 0x23: // TEXT
+            AppendMssqlSingleByteText(output, data);
+            break;
+        case 0xe7: // NVARCHAR
+        case 0xef: // NCHAR
+        case 0x63: // NTEXT
+        case 0xf1: // XML
+            AppendMssqlUtf8(output, data);
+            break;
+        case 0x62: // SQL_VARIANT
+        {
+            // The type of the value, then the properties of that type
+            if (data.size() < 2)
+            {
+                break;
+            }
+
+            MssqlColumn variant;
+            variant.Type = static_cast<uint8_t>(data[0]);
+            auto properties = static_cast<uint8_t>(data[1]);
+
+            if (variant.Type == 0x6a || variant.Type == 0x6c)
+            {
+                variant.Precision = static_cast<uint8_t>(MssqlInt(data, 2, 1));
+                variant.Scale = static_cast<uint8_t>(MssqlInt(data, 3, 1));
+            }
+            else if (variant.Type == 0x29 || variant.Type == 0x2a || variant.Type == 0x2b)
+            {
+                variant.Scale = static_cast<uint8_t>(MssqlInt(data, 2, 1));
+            }
+
+            FormatMssqlValue(variant, data.substr(std::min<size_t>(2 + properties, data.size())), output);
+            break;
+        }
+        default:
+            // BINARY, VARBINARY, IMAGE and user-defined types
+            AppendMssqlHex(output, data);
+            break;
+    }
+}
+
+bool ParseMssqlConnectionString(
+    const std::string &connectionString,
+    MssqlConnectionString &settings,
+    std::string &error)
+{
+    settings = MssqlConnectionString();
+
+    for (auto &pair : split_string(connectionString, ";"))
+    {
+        auto equals = pair.find('=');
+        if (equals == std::string::npos)
+        {
+            if (!trim_copy(pair).empty())
+            {
+                error = "expected key=value in the connection string, not '" + trim_copy(pair) + "'";
+                return false;
+            }
+            continue;
+        }
+
+        auto key = trim_copy(pair.substr(0, equals));
+        auto value = trim_copy(pair.substr(equals + 1));
+
+        if (iequals(key, "server") || iequals(key, "data source") || iequals(key, "address") || iequals(key, "addr") || iequals(key, "network address"))
+        {
+            // tcp:host,port
+            if (value.size() > 4 && iequals(value.substr(0, 4), "tcp:"))
+            {
+                value = value.substr(4);
+            }
+
+            auto comma = value.find(',');
+            if (comma != std::string::npos)
+            {
+                settings.Port = std::atoi(value.substr(comma + 1).c_str());
+                value = trim_copy(value.substr(0, comma));
+            }
+
+            if (value.find('\\') != std::string::npos)
+            {
+                error = "named instances are not supported, give the port of the instance instead, like Server=host,port";
+                return false;
+            }
+
+            settings.Host = value == "." || value == "(local)" ? "localhost" : value;
+        }
+        else if (iequals(key, "port"))
+        {
+            settings.Port = std::atoi(value.c_str());
+        }
+        else if (iequals(key, "database") || iequals(key, "initial catalog"))
+        {
+            settings.Database = value;
+        }
+        else if (iequals(key, "user id") || iequals(key, "uid") || iequals(key, "user"))
+        {
+            settings.User = value;
+        }
+        else if (iequals(key, "password") || iequals(key, "pwd"))
+        {
+            settings.Password = value;
+        }
+        else if (iequals(key, "application name") || iequals(key, "app"))
+        {
+            settings.ApplicationName = value;
+        }
+        else if ((iequals(key, "integrated security") || iequals(key, "trusted_connection")) && !iequals(value, "false") && !iequals(value, "no"))
+        {
+            error = "Windows authentication is not supported, give a User Id and Password";
+            return false;
+        }
+        else if (iequals(key, "encrypt") && (iequals(value, "true") || iequals(value, "yes") || iequals(value, "mandatory") || iequals(value, "strict")))
+        {
+            error = "encrypted connections are not supported";
+            return false;
+        }
+    }
+
+    if (settings.Port <= 0 || settings.Port > 65535)
+    {
+        error = "invalid port in the connection string";
+        return false;
+    }
+
+    return true;
+}
+
+bool IsMssqlNumberType(
+    uint8_t type)
+{
+    switch (type)
+    {
+        case 0x30: // TINYINT
+        case 0x34: // SMALLINT
+        case 0x38: // INT
+        case 0x7f: // BIGINT
+        case 0x26: // INTN
+        case 0x3b: // REAL
+        case 0x3e: // FLOAT
+        case 0x6d: // FLTN
+        case 0x3c: // MONEY
+        case 0x7a: // SMALLMONEY
+        case 0x6e: // MONEYN
+        case 0x6a: // DECIMAL
+        case 0x6c: // NUMERIC
+            return true;
+        default:
+            return false;
+    }
+}
+
+MssqlConnection::MssqlConnection() = default;
+
+MssqlConnection::~MssqlConnection() = default;
+
+const MssqlConnectionString &MssqlConnection::Settings() const
+{
+    return _settings;
+}
+
+bool MssqlConnection::IsBroken()
+{
+    return _state == State::Broken || (_state == State::Idle && _tcp.IsStale());
+}
+
+bool MssqlConnection::InTransaction() const
+{
+    return _transactionDescriptor != 0;
+}
+
+const std::string &MssqlConnection::Error() const
+{
+    return _error;
+}
+
+bool MssqlConnection::Fail(
+    const std::string &error)
+{
+    if (_state != State::Broken || _error.empty())
+    {
+        _error = error;
+    }
+    _state = State::Broken;
+    _tcp.Close();
+
+    return false;
+}
+
+bool MssqlConnection::ReadPacket()
+{
+    char header[8];
+    if (!_tcp.ReadExactly(header, sizeof(header)))
+    {
+        return Fail("the server closed the connection");
+    }
+
+    auto length = (size_t(static_cast<uint8_t>(header[2])) << 8) | static_cast<uint8_t>(header[3]);
+    if (static_cast<uint8_t>(header[0]) != MssqlResponse || length < sizeof(header))
+    {
+        return Fail("the server sent a packet that is not a response");
+    }
+
+    _packet.resize(length - sizeof(header));
+    if (!_packet.empty() && !_tcp.ReadExactly(&_packet[0], _packet.size()))
+    {
+        return Fail("the server closed the connection");
+    }
+
+    _packetPosition = 0;
+    _lastPacket = (header[1] & MssqlEndOfMessage) != 0;
+
+    return true;
+}
+
+bool MssqlConnection::WriteMessage(
+    uint8_t type,
+    std::string_view payload)
+{
+    std::string packet;
+    auto maxPayload = _packetSize - 8;
+
+    do
+    {
+        auto length = std::min(payload.size(), maxPayload);
+        bool last = length == payload.size();
+
+        packet.clear();
+        packet.push_back(static_cast<char>(type));
+        packet.push_back(static_cast<char>(last ? MssqlEndOfMessage : 0));
+        packet.push_back(static_cast<char>((length + 8) >> 8));
+        packet.push_back(static_cast<char>((length + 8) & 0xff));
+        packet.append(2, '\0');
+        packet.push_back(static_cast<char>(++_packetId));
+        packet.push_back('\0');
+        packet.append(payload.substr(0, length));
+
+        if (!_tcp.Write(packet.data(), packet.size()))
+        {
+            return Fail("the connection to the server was lost");
+        }
+
+        payload.remove_prefix(length);
+    } while (!payload.empty());
+
+    return true;
+}
+
+bool MssqlConnection::Read(
+    void *data,
+    size_t size)
+{
+    auto output = static_cast<char *>(data);
+
+    while (size > 0)
+    {
+        if (!_tcp.IsOpen())
+        {
+            return false;
+        }
+
+        if (_packetPosition == _packet.size())
+        {
+            if (!ReadPacket())
+            {
+                return false;
+            }
+            continue;
+        }
+
+        auto available = std::min(size, _packet.size() - _packetPosition);
+        if (output != nullptr)
+        {
+            std::memcpy(output, _packet.data() + _packetPosition, available);
+            output += available;
+        }
+
+        _packetPosition += available;
+        size -= available;
+    }
+
+    return true;
+}
+
+uint8_t MssqlConnection::ReadUInt8()
+{
+    uint8_t value = 0;
+    Read(&value, 1);
+
+    return value;
+}
+
+uint16_t MssqlConnection::ReadUInt16()
+{
+    char bytes[2] = {};
+    Read(bytes, sizeof(bytes));
+
+    return static_cast<uint16_t>(MssqlInt(std::string_view(bytes, sizeof(bytes)), 0, 2));
+}
+
+uint32_t MssqlConnection::ReadUInt32()
+{
+    char bytes[4] = {};
+    Read(bytes, sizeof(bytes));
+
+    return static_cast<uint32_t>(MssqlInt(std::string_view(bytes, sizeof(bytes)), 0, 4));
+}
+
+uint64_t MssqlConnection::ReadUInt64()
+{
+    char bytes[8] = {};
+    Read(bytes, sizeof(bytes));
+
+    return MssqlInt(std::string_view(bytes, sizeof(bytes)), 0, 8);
+}
+
+std::string MssqlConnection::ReadText(
+    size_t length)
+{
+    std::string utf16(length * 2, '\0');
+    if (length > 0)
+    {
+        Read(&utf16[0], utf16.size());
+    }
+
+    std::string text;
+    AppendMssqlUtf8(text, utf16);
+
+    return text;
+}
+
+bool MssqlConnection::Open(
+    const MssqlConnectionString &settings,
+    std::string &error)
+{
+    _settings = settings;
+    _state = State::Broken;
+
+    if (!_tcp.Open(settings.Host, settings.Port, error))
+    {
+        return false;
+    }
+
+    // Options with where their value is, then the values: the version of
+    // the client, no encryption, the default instance, no thread id, no MARS
+    std::string prelogin;
+    const uint8_t options[][2] = {{0x00, 6}, {0x01, 1}, {0x02, 1}, {0x03, 4}, {0x04, 1}};
+    size_t offset = sizeof(options) / sizeof(options[0]) * 5 + 1;
+    for (auto &option : options)
+    {
+        prelogin.push_back(static_cast<char>(option[0]));
+        prelogin.push_back(static_cast<char>(offset >> 8));
+        prelogin.push_back(static_cast<char>(offset & 0xff));
+        prelogin.push_back(0);
+        prelogin.push_back(static_cast<char>(option[1]));
+        offset += option[1];
+    }
+    prelogin.push_back(static_cast<char>(0xff));
+    prelogin.append("\x0b\x00\x00\x00\x00\x00", 6);
+    prelogin.push_back(static_cast<char>(MssqlEncryptNotSupported));
+    prelogin.append(1 + 4 + 1, '\0');
+
+    _packetId = 0;
+    if (!WriteMessage(MssqlPrelogin, prelogin))
+    {
+        error = _error;
+        return false;
+    }
+
+    std::string response;
+    do
+    {
+        if (!ReadPacket())
+        {
+            error = _error;
+            return false;
+        }
+        response.append(_packet);
+    } while (!_lastPacket);
+    _packetPosition = _packet.size();
+
+    uint8_t encryption = 0xff;
+    for (size_t pos = 0; pos + 5 <= response.size() && static_cast<uint8_t>(response[pos]) != 0xff; pos += 5)
+    {
+        auto optionOffset = (size_t(static_cast<uint8_t>(response[pos + 1])) << 8) | static_cast<uint8_t>(response[pos + 2]);
+        if (response[pos] == 0x01 && optionOffset < response.size())
+        {
+            encryption = static_cast<uint8_t>(response[optionOffset]);
+        }
+    }
+
+    if (encryption != MssqlEncryptNotSupported)
+    {
+        error = "the server only accepts encrypted connections, which are not supported";
+        return Fail(error);
+    }
+
+    if (!Login(error))
+    {
+        return Fail(error);
+    }
+
+    _state = State::Idle;
+
+    return true;
+}
+
+bool MssqlConnection::Login(
+    std::string &error)
+{
+    std::string user, password, application, server, library, database;
+    AppendMssqlUtf16(user, _settings.User);
+    AppendMssqlUtf16(password, _settings.Password);
+    AppendMssqlUtf16(application, _settings.ApplicationName);
+    AppendMssqlUtf16(server, _settings.Host);
+    AppendMssqlUtf16(library, "ScintillaGL");
+    AppendMssqlUtf16(database, _settings.Database);
+
+    // The password is not encrypted, only its nibbles are swapped and xor-ed
+    for (auto &c : password)
+    {
+        auto byte = static_cast<uint8_t>(c);
+        c = static_cast<char>((((byte << 4) | (byte >> 4)) & 0xff) ^ 0xa5);
+    }
+
+    const size_t fixedLength = 94;
+
+    std::string login;
+    AppendMssqlInt(login, 0, 4);          // Length, set below
+    AppendMssqlInt(login, 0x74000004, 4); // TDS 7.4
+    AppendMssqlInt(login, _packetSize, 4);
+    AppendMssqlInt(login, 0x07000000, 4); // Client version
+    AppendMssqlInt(login, 0, 4);          // Client process id
+    AppendMssqlInt(login, 0, 4);          // Connection id
+    login.push_back(static_cast<char>(0xe0)); // USE DATABASE and SET LANGUAGE are on, a bad database fails the login
+    login.push_back(static_cast<char>(0x03)); // ODBC behaviour, a bad language fails the login
+    login.push_back(0);                       // SQL type
+    login.push_back(0);
+    AppendMssqlInt(login, 0, 4);     // Time zone
+    AppendMssqlInt(login, 0x409, 4); // Locale
+
+    // Where each value is and its length in characters: the host name,
+    // user, password, application, server, extension, library, language
+    // and database
+    std::string values;
+    for (auto value : {std::string(), user, password, application, server, std::string(), library, std::string(), database})
+    {
+        AppendMssqlInt(login, fixedLength + values.size(), 2);
+        AppendMssqlInt(login, value.size() / 2, 2);
+        values.append(value);
+    }
+
+    login.append(6, '\0'); // Client MAC address
+    for (int unused = 0; unused < 3; unused++)
+    {
+        // SSPI, database file to attach and new password
+        AppendMssqlInt(login, fixedLength + values.size(), 2);
+        AppendMssqlInt(login, 0, 2);
+    }
+    AppendMssqlInt(login, 0, 4); // Long SSPI
+
+    login.append(values);
+
+    auto length = login.size();
+    for (size_t i = 0; i < 4; i++)
+    {
+        login[i] = static_cast<char>((length >> (8 * i)) & 0xff);
+    }
+
+    if (!WriteMessage(MssqlLogin7, login))
+    {
+        error = _error;
+        return false;
+    }
+
+    bool loggedIn = false;
+    _messages.clear();
+
+    while (true)
+    {
+        auto type = ReadUInt8();
+        if (!_tcp.IsOpen())
+        {
+            error = _error;
+            return false;
+        }
+
+        if (type == 0xad) // LOGINACK
+        {
+            Read(nullptr, ReadUInt16());
+            loggedIn = true;
+        }
+        else if (type == 0xfd) // DONE
+        {
+            auto status = ReadUInt16();
+            Read(nullptr, 2 + 8);
+            if ((status & MssqlDoneMore) == 0)
+            {
+                break;
+            }
+        }
+        else
+        {
+            ReadToken(type);
+        }
+    }
+
+    if (!loggedIn)
+    {
+        for (auto &message : _messages)
+        {
+            if (message.Class > 10)
+            {
+                error = message.Text;
+            }
+        }
+
+        if (error.empty())
+        {
+            error = "the server did not accept the login";
+        }
+    }
+
+    _messages.clear();
+
+    return loggedIn && _tcp.IsOpen();
+}
+
+void MssqlConnection::ReadToken(
+    uint8_t type)
+{
+    switch (type)
+    {
+        case 0xaa: // ERROR
+        case 0xab: // INFO
+            ReadMessageToken(type);
+            break;
+        case 0xe3: // ENVCHANGE
+            ReadEnvironmentChange();
+            break;
+        case 0x79: // RETURNSTATUS
+            ReadUInt32();
+            break;
+        case 0xa4: // TABNAME
+        case 0xa5: // COLINFO
+        case 0xa9: // ORDER
+        case 0xad: // LOGINACK
+        case 0xed: // SSPI
+            Read(nullptr, ReadUInt16());
+            break;
+        default:
+        {
+            char text[64];
+            std::snprintf(text, sizeof(text), "unsupported token 0x%02x in the response", type);
+            Fail(text);
+            break;
+        }
+    }
+}
+
+void MssqlConnection::ReadMessageToken(
+    uint8_t type)
+{
+    ReadUInt16(); // Length
+
+    MssqlMessage message;
+    message.Number = static_cast<int32_t>(ReadUInt32());
+    message.State = ReadUInt8();
+    message.Class = ReadUInt8();
+    message.Text = ReadText(ReadUInt16());
+    ReadText(ReadUInt8()); // Server
+    ReadText(ReadUInt8()); // Procedure
+    message.Line = static_cast<int32_t>(ReadUInt32());
+
+    // Some informational messages come as errors with a low class
+    if (type == 0xab && message.Class > 10)
+    {
+        message.Class = 10;
+    }
+
+    _messages.push_back(std::move(message));
+}
+
+void MssqlConnection::ReadEnvironmentChange()
+{
+    auto length = ReadUInt16();
+
+    _value.resize(length);
+    if (length == 0 || !Read(&_value[0], length))
+    {
+        return;
+    }
+
+    std::string_view change = _value;
+    switch (change[0])
+    {
+        case 4: // Packet size
+        {
+            std::string size;
+            AppendMssqlUtf8(size, change.substr(2, static_cast<uint8_t>(change[1]) * 2));
+            _packetSize = std::max(512, std::atoi(size.c_str()));
+            break;
+        }
+        case 8: // Begin transaction
+            _transactionDescriptor = MssqlInt(change, 2, 8);
+            break;
+        case 9:  // Commit transaction
+        case 10: // Rollback transaction
+            _transactionDescriptor = 0;
+            break;
+    }
+}
+
+void MssqlConnection::ReadColumns()
+{
+    auto count = ReadUInt16();
+
+    _columns.clear();
+    if (count == 0xffff)
+    {
+        return;
+    }
+
+    for (uint16_t i = 0; i < count && _tcp.IsOpen(); i++)
+    {
+        MssqlColumn column;
+
+        ReadUInt32(); // User type
+        ReadUInt16(); // Flags
+        column.Type = ReadUInt8();
+
+        auto fixedLength = MssqlFixedLength(column.Type);
+        if (fixedLength >= 0)
+        {
+            column.Length = fixedLength;
+        }
+        else
+        {
+            switch (column.Type)
+            {
+                case 0x24: // UNIQUEIDENTIFIER
+                case 0x26: // INTN
+                case 0x68: // BITN
+                case 0x6d: // FLTN
+                case 0x6e: // MONEYN
+                case 0x6f: // DATETIMN
+                    column.Length = ReadUInt8();
+                    break;
+                case 0x6a: // DECIMAL
+                case 0x6c: // NUMERIC
+                    column.Length = ReadUInt8();
+                    column.Precision = ReadUInt8();
+                    column.Scale = ReadUInt8();
+                    break;
+                case 0x28: // DATE
+                    column.Length = 3;
+                    break;
+                case 0x29: // TIME
+                case 0x2a: // DATETIME2
+                case 0x2b: // DATETIMEOFFSET
+                    column.Scale = ReadUInt8();
+                    break;
+                case 0xa7: // VARCHAR
+                case 0xaf: // CHAR
+                case 0xe7: // NVARCHAR
+                case 0xef: // NCHAR
+                    column.Length = ReadUInt16();
+                    Read(nullptr, 5); // Collation
+                    break;
+                case 0xa5: // VARBINARY
+                case 0xad: // BINARY
+                    column.Length = ReadUInt16();
+                    break;
+                case 0x23: // TEXT
+                case 0x63: // NTEXT
+                case 0x22: // IMAGE
+                {
+                    column.Length = ReadUInt32();
+                    if (column.Type != 0x22)
+                    {
+                        Read(nullptr, 5);
+                    }
+
+                    // The name of the table, in parts
+                    auto parts = ReadUInt8();
+                    for (uint8_t part = 0; part < parts; part++)
+                    {
+                        ReadText(ReadUInt16());
+                    }
+                    break;
+                }
+                case 0xf1: // XML
+                    // The schema collection it is typed with, if any
+                    if (ReadUInt8() != 0)
+                    {
+                        ReadText(ReadUInt8());
+                        ReadText(ReadUInt8());
+                        ReadText(ReadUInt16());
+                    }
+                    column.Length = 0xffff;
+                    break;
+                case 0xf0: // User-defined type
+                    column.Length = ReadUInt16();
+                    ReadText(ReadUInt8());
+                    ReadText(ReadUInt8());
+                    ReadText(ReadUInt8());
+                    ReadText(ReadUInt16());
+                    break;
+                case 0x62: // SQL_VARIANT
+                    column.Length = ReadUInt32();
+                    break;
+                default:
+                {
+                    char text[64];
+                    std::snprintf(text, sizeof(text), "columns of type 0x%02x are not supported", column.Type);
+                    Fail(text);
+                    return;
+                }
+            }
+        }
+
+        column.Name = ReadText(ReadUInt8());
+
+        _columns.push_back(std::move(column));
+    }
+}
+
+void MssqlConnection::ReadDone(
+    MssqlResult *result)
+{
+    auto status = ReadUInt16();
+    ReadUInt16(); // Current command
+    auto count = ReadUInt64();
+
+    if (result != nullptr && (status & MssqlDoneCount) && (status & MssqlDoneAttention) == 0)
+    {
+        result->HasRowCount = true;
+        result->RowCount = count;
+    }
+
+    if ((status & MssqlDoneMore) == 0 && _tcp.IsOpen())
+    {
+        EndOfResponse(status);
+    }
+}
+
+void MssqlConnection::EndOfResponse(
+    uint16_t status)
+{
+    std::lock_guard<std::mutex> lock(_writeMutex);
+
+    // After an attention only its acknowledgement ends the response, even
+    // when the batch was done before the server saw the attention
+    if (_attentionSent && (status & MssqlDoneAttention) == 0)
+    {
+        _state = State::ResultPending;
+        return;
+    }
+
+    _attentionSent = false;
+    _state = State::Idle;
+}
+
+bool MssqlConnection::ReadPartiallyLengthPrefixed()
+{
+    auto total = ReadUInt64();
+    if (total == MssqlPlpNull)
+    {
+        return false;
+    }
+
+    while (_tcp.IsOpen())
+    {
+        auto chunk = ReadUInt32();
+        if (chunk == 0)
+        {
+            break;
+        }
+
+        auto start = _value.size();
+        _value.resize(start + chunk);
+        Read(&_value[start], chunk);
+    }
+
+    return true;
+}
+
+bool MssqlConnection::ReadValue(
+    const MssqlColumn &column)
+{
+    _value.clear();
+
+    size_t length = 0;
+
+    auto fixedLength = MssqlFixedLength(column.Type);
+    if (fixedLength == 0)
+    {
+        return false;
+    }
+
+    if (fixedLength > 0)
+    {
+        length = fixedLength;
+    }
+    else
+    {
+        switch (column.Type)
+        {
+            case 0xa7: // VARCHAR
+            case 0xaf: // CHAR
+            case 0xe7: // NVARCHAR
+            case 0xef: // NCHAR
+            case 0xa5: // VARBINARY
+            case 0xad: // BINARY
+                if (column.Length == 0xffff)
+                {
+                    return ReadPartiallyLengthPrefixed();
+                }
+
+                length = ReadUInt16();
+                if (length == 0xffff)
+                {
+                    return false;
+                }
+                break;
+            case 0xf1: // XML
+            case 0xf0: // User-defined type
+                return ReadPartiallyLengthPrefixed();
+            case 0x23: // TEXT
+            case 0x63: // NTEXT
+            case 0x22: // IMAGE
+            {
+                // A text pointer and a timestamp come before the value
+                auto pointerLength = ReadUInt8();
+                if (pointerLength == 0)
+                {
+                    return false;
+                }
+
+                Read(nullptr, pointerLength + 8);
+                length = ReadUInt32();
+                break;
+            }
+            case 0x62: // SQL_VARIANT
+                length = ReadUInt32();
+                if (length == 0)
+                {
+                    return false;
+                }
+                break;
+            default:
+                length = ReadUInt8();
+                if (length == 0)
+                {
+                    return false;
+                }
+                break;
+        }
+    }
+
+    _value.resize(length);
+
+    return length == 0 || Read(&_value[0], length);
+}
+
+void MssqlConnection::ReadRow(
+    MssqlRow &row,
+    bool nullBitmap)
+{
+    row.Values.resize(_columns.size());
+    row.Nulls.resize(_columns.size());
+    _valueEnds.resize(_columns.size());
+    _rowText.clear();
+
+    // A compressed row starts with a bit per column, the columns that are
+    // NULL are left out after it
+    _nullBitmap.assign(nullBitmap ? (_columns.size() + 7) / 8 : 0, '\0');
+    if (!_nullBitmap.empty())
+    {
+        Read(&_nullBitmap[0], _nullBitmap.size());
+    }
+
+    // The values are formatted one after the other, where they end is kept
+    // until all of them are done since the text can move as it grows
+    for (size_t col = 0; col < _columns.size(); col++)
+    {
+        bool isNull = nullBitmap && (static_cast<uint8_t>(_nullBitmap[col / 8]) & (1 << (col % 8))) != 0;
+
+        if (!isNull)
+        {
+            isNull = !ReadValue(_columns[col]);
+        }
+
+        if (!isNull)
+        {
+            FormatMssqlValue(_columns[col], _value, _rowText);
+        }
+
+        row.Nulls[col] = isNull;
+        _valueEnds[col] = _rowText.size();
+    }
+
+    for (size_t col = 0; col < _columns.size(); col++)
+    {
+        auto start = col == 0 ? 0 : _valueEnds[col - 1];
+        row.Values[col] = std::string_view(_rowText).substr(start, _valueEnds[col] - start);
+    }
+}
+
+bool MssqlConnection::Query(
+    std::string_view sql,
+    std::string &error)
+{
+    // Results that were not read are skipped
+    MssqlResult skipped;
+    while (NextResult(skipped))
+    {
+    }
+
+    if (_state != State::Idle)
+    {
+        error = _error.empty() ? "not connected" : _error;
+        return false;
+    }
+
+    // A batch starts with the transaction it runs in, and the number of
+    // requests that are waiting on the connection
+    std::string payload;
+    AppendMssqlInt(payload, 22, 4);
+    AppendMssqlInt(payload, 18, 4);
+    AppendMssqlInt(payload, 2, 2);
+    AppendMssqlInt(payload, _transactionDescriptor, 8);
+    AppendMssqlInt(payload, 1, 4);
+    AppendMssqlUtf16(payload, sql);
+
+    std::lock_guard<std::mutex> lock(_writeMutex);
+
+    _packetId = 0;
+    if (!WriteMessage(MssqlSqlBatch, payload))
+    {
+        error = _error;
+        return false;
+    }
+
+    _state = State::ResultPending;
+
+    return true;
+}
+
+bool MssqlConnection::NextResult(
+    MssqlResult &result)
+{
+    result = MssqlResult();
+
+    if (_state == State::InRows)
+    {
+        MssqlRow row;
+        while (NextRow(row))
+        {
+        }
+    }
+
+    while (_state == State::ResultPending)
+    {
+        auto type = ReadUInt8();
+        if (_state == State::Broken)
+        {
+            return false;
+        }
+
+        switch (type)
+        {
+            case 0x81: // COLMETADATA
+                ReadColumns();
+                if (_state == State::Broken)
+                {
+                    return false;
+                }
+
+                result.Columns = _columns;
+                result.Messages = std::move(_messages);
+                _messages.clear();
+                _state = State::InRows;
+
+                return true;
+            case 0xfd: // DONE
+            case 0xfe: // DONEPROC
+            case 0xff: // DONEINPROC
+                ReadDone(&result);
+                if (_state == State::Broken)
+                {
+                    return false;
+                }
+
+                if (result.HasRowCount || !_messages.empty())
+                {
+                    result.Messages = std::move(_messages);
+                    _messages.clear();
+
+                    return true;
+                }
+                break;
+            default:
+                ReadToken(type);
+                break;
+        }
+    }
+
+    // Messages that came after the last result
+    if (!_messages.empty())
+    {
+        result.Messages = std::move(_messages);
+        _messages.clear();
+
+        return true;
+    }
+
+    return false;
+}
+
+bool MssqlConnection::NextRow(
+    MssqlRow &row)
+{
+    while (_state == State::InRows)
+    {
+        auto type = ReadUInt8();
+        if (_state == State::Broken)
+        {
+            return false;
+        }
+
+        switch (type)
+        {
+            case 0xd1: // ROW
+                ReadRow(row, false);
+                return _state != State::Broken;
+            case 0xd2: // NBCROW
+                ReadRow(row, true);
+                return _state != State::Broken;
+            case 0xfd: // DONE
+            case 0xfe: // DONEPROC
+            case 0xff: // DONEINPROC
+                _state = State::ResultPending;
+                ReadDone(nullptr);
+                return false;
+            default:
+                ReadToken(type);
+                break;
+        }
+    }
+
+    return false;
+}
+
+void MssqlConnection::Cancel()
+{
+    std::lock_guard<std::mutex> lock(_writeMutex);
+
+    auto state = _state.load();
+    if (state == State::Idle || state == State::Broken || _attentionSent)
+    {
+        return;
+    }
+
+    // The reader is left to find out when writing fails
+    const char attention[8] = {static_cast<char>(MssqlAttention), static_cast<char>(MssqlEndOfMessage), 0, 8, 0, 0, 1, 0};
+    _attentionSent = _tcp.Write(attention, sizeof(attention));
+}
+
+MssqlConnectionPool::MssqlConnectionPool() = default;
+
+MssqlConnectionPool::~MssqlConnectionPool() = default;
+
+std::unique_ptr<MssqlConnection> MssqlConnectionPool::Acquire(
+    const std::string &connectionString,
+    std::string &error)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        auto &idle = _idleConnections[connectionString];
+        while (!idle.empty())
+        {
+            auto connection = std::move(idle.back());
+            idle.pop_back();
+
+            // The server closes connections that were idle for too long
+            if (!connection->IsBroken())
+            {
+                return connection;
+            }
+        }
+    }
+
+    MssqlConnectionString settings;
+    if (!ParseMssqlConnectionString(connectionString, settings, error))
+    {
+        return nullptr;
+    }
+
+    auto connection = std::make_unique<MssqlConnection>();
+    if (!connection->Open(settings, error))
+    {
+        return nullptr;
+    }
+
+    return connection;
+}
+
+void MssqlConnectionPool::Release(
+    const std::string &connectionString,
+    std::unique_ptr<MssqlConnection> connection)
+{
+    if (connection->IsBroken())
+    {
+        return;
+    }
+
+    if (connection->InTransaction())
+    {
+        std::string error;
+        MssqlResult result;
+        if (!connection->Query("IF @@TRANCOUNT > 0 ROLLBACK", error))
+        {
+            return;
+        }
+
+        while (connection->NextResult(result))
+        {
+        }
+
+        if (connection->IsBroken() || connection->InTransaction())
+        {
+            return;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto &idle = _idleConnections[connectionString];
+    if (idle.size() < MaxIdleConnections)
+    {
+        idle.push_back(std::move(connection));
+    }
+}
+
+void MssqlConnectionPool::Clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _idleConnections.clear();
+}
@@ -0,0 +1,239 @@
+#ifndef MSSQLCONNECTION_HPP
+#define MSSQLCONNECTION_HPP
+
+#include "tcpconnection.hpp"
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Where to connect to and as who, parsed from a connection string like
+// "Server=localhost,1433;Database=shop;User Id=sa;Password=secret"
+struct MssqlConnectionString
+{
+    std::string Host = "localhost";
+    int Port = 1433;
+    std::string Database;
+    std::string User;
+    std::string Password;
+    std::string ApplicationName = "ScintillaGL";
+};
+
+bool ParseMssqlConnectionString(
+    const std::string &connectionString,
+    MssqlConnectionString &settings,
+    std::string &error);
+
+struct MssqlColumn
+{
+    std::string Name;
+    uint8_t Type = 0;
+    // The maximum length in bytes, 0xffff for the (max) types
+    uint32_t Length = 0;
+    uint8_t Precision = 0;
+    uint8_t Scale = 0;
+};
+
+// An error or a message like the ones PRINT sends, Class is above 10 for errors
+struct MssqlMessage
+{
+    int32_t Number = 0;
+    uint8_t State = 0;
+    uint8_t Class = 0;
+    int32_t Line = 0;
+    std::string Text;
+};
+
+// One result of a batch: the columns of a result set, whose rows are read
+// with NextRow, or the count of a statement without rows. The messages
+// that came with it, or before it, are passed along.
+struct MssqlResult
+{
+    std::vector<MssqlColumn> Columns;
+    bool HasRowCount = false;
+    uint64_t RowCount = 0;
+    std::vector<MssqlMessage> Messages;
+};
+
+// The values of the row that was read last, they stay valid until the next read
+struct MssqlRow
+{
+    std::vector<std::string_view> Values;
+    std::vector<bool> Nulls;
+};
+
+// A connection speaking TDS 7.4 to SQL Server. A batch is sent with Query,
+// its results are read with NextResult and the rows of each result set with
+// NextRow, while the server sends them.
+class MssqlConnection
+{
+public:
+    MssqlConnection();
+
+    virtual ~MssqlConnection();
+
+public:
+    // Connects and logs in with SQL Server authentication
+    bool Open(
+        const MssqlConnectionString &settings,
+        std::string &error);
+
+    const MssqlConnectionString &Settings() const;
+
+    // True when the connection can not be used anymore, or the server closed it while it was idle
+    bool IsBroken();
+
+    bool InTransaction() const;
+
+    bool Query(
+        std::string_view sql,
+        std::string &error);
+
+    // Reads the next result of the batch, false when there are no more or
+    // the connection broke, Error tells which
+    bool NextResult(
+        MssqlResult &result);
+
+    // Reads the next row of the current result set, false after the last one
+    bool NextRow(
+        MssqlRow &row);
+
+    // Asks the server to stop the batch that is running, can be called from
+    // any thread. The results that were sent before it stops still arrive.
+    void Cancel();
+
+    // Why the connection broke
+    const std::string &Error() const;
+
+private:
+    enum class State
+    {
+        Idle,
+        ResultPending,
+        InRows,
+        Broken,
+    };
+
+    MssqlConnectionString _settings;
+    TcpConnection _tcp;
+    std::atomic<State> _state{State::Broken};
+    std::string _error;
+    size_t _packetSize = 4096;
+    uint8_t _packetId = 0;
+    uint64_t _transactionDescriptor = 0;
+
+    // Cancel writes from another thread, the attention it sends is
+    // acknowledged at the end of the response
+    std::mutex _writeMutex;
+    bool _attentionSent = false;
+
+    // The payload of the packet that is read, tokens run on into the next one
+    std::string _packet;
+    size_t _packetPosition = 0;
+    bool _lastPacket = false;
+
+    std::vector<MssqlColumn> _columns;
+    std::vector<MssqlMessage> _messages;
+    std::string _value;
+    std::string _rowText;
+    std::vector<size_t> _valueEnds;
+    std::string _nullBitmap;
+
+    bool Fail(
+        const std::string &error);
+
+    bool ReadPacket();
+
+    bool WriteMessage(
+        uint8_t type,
+        std::string_view payload);
+
+    bool Read(
+        void *data,
+        size_t size);
+
+    uint8_t ReadUInt8();
+
+    uint16_t ReadUInt16();
+
+    uint32_t ReadUInt32();
+
+    uint64_t ReadUInt64();
+
+    // A length in characters followed by UTF-16 text
+    std::string ReadText(
+        size_t length);
+
+    bool Login(
+        std::string &error);
+
+    // Reads a token that does not change what NextResult or NextRow return
+    void ReadToken(
+        uint8_t type);
+
+    void ReadMessageToken(
+        uint8_t type);
+
+    void ReadEnvironmentChange();
+
+    void ReadColumns();
+
+    // Reads what follows a DONE, DONEPROC or DONEINPROC token
+    void ReadDone(
+        MssqlResult *result);
+
+    // The response ends with the last DONE, or with the acknowledgement of an attention
+    void EndOfResponse(
+        uint16_t status);
+
+    // Reads the bytes of a value into _value, false for NULL
+    bool ReadValue(
+        const MssqlColumn &column);
+
+    // The (max) types come in chunks
+    bool ReadPartiallyLengthPrefixed();
+
+    void ReadRow(
+        MssqlRow &row,
+        bool nullBitmap);
+};
+
+// Keeps logged in connections per connection string between runs
+class MssqlConnectionPool
+{
+public:
+    MssqlConnectionPool();
+
+    virtual ~MssqlConnectionPool();
+
+public:
+    size_t MaxIdleConnections = 2;
+
+public:
+    // Returns an idle or newly opened connection, nullptr with error set when
+    // the server can not be reached or does not accept the login
+    std::unique_ptr<MssqlConnection> Acquire(
+        const std::string &connectionString,
+        std::string &error);
+
+    // Takes back a connection that read all of its results, a transaction it left open is rolled back
+    void Release(
+        const std::string &connectionString,
+        std::unique_ptr<MssqlConnection> connection);
+
+    void Clear();
+
+private:
+    std::mutex _mutex;
+    std::map<std::string, std::vector<std::unique_ptr<MssqlConnection>>> _idleConnections;
+};
+
+// Integer, decimal, money and floating point columns
+bool IsMssqlNumberType(
+    uint8_t type);
+
+#endif // MSSQLCONNECTION_HPP
@@ -0,0 +1,281 @@
+#include "resultexport.hpp"
+
+#include "resultfile.hpp"
+#include "stringhelpers.hpp"
+#include <charconv>
+#include <cmath>
+#include <filesystem>
+
+// The buffered rows are written to the file in pieces of about this size
+const size_t CsvWriteSize = 64 * 1024;
+
+std::string FormatResultReal(
+    double value)
+{
+    if (std::isinf(value))
+    {
+        return value < 0 ? "-Inf" : "Inf";
+    }
+
+    // 15 significant digits like sqlite, more when those do not read back
+    // as the same value
+    char buffer[32];
+    char *end = buffer;
+    for (int precision = 15; precision <= 17; precision++)
+    {
+        end = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::general, precision).ptr;
+
+        double readBack = 0;
+        std::from_chars(buffer, end, readBack);
+        if (readBack == value)
+        {
+            break;
+        }
+    }
+
+    std::string text(buffer, end);
+    if (text.find_first_of(".n") == std::string::npos)
+    {
+        auto exponent = text.find('e');
+        text.insert(exponent == std::string::npos ? text.size() : exponent, ".0");
+    }
+
+    return text;
+}
+
+void ResultExport::AddValue(
+    std::string_view value,
+    bool isNumber,
+    bool isNull)
+{
+    if (isNull)
+    {
+        AddNull();
+        return;
+    }
+
+    if (isNumber && !value.empty())
+    {
+        auto first = value.data();
+        auto last = value.data() + value.size();
+
+        int64_t integer = 0;
+        auto parsed = std::from_chars(first, last, integer);
+        if (parsed.ec == std::errc() && parsed.ptr == last && std::to_string(integer) == value)
+        {
+            AddInteger(integer);
+            return;
+        }
+
+        // Decimals like 12.50 keep their digits as text
+        double real = 0;
+        parsed = std::from_chars(first, last, real);
+        if (parsed.ec == std::errc() && parsed.ptr == last && FormatResultReal(real) == value)
+        {
+            AddReal(real);
+            return;
+        }
+    }
+
+    AddText(value);
+}
+
+const std::string &ResultExport::Path() const
+{
+    return _path;
+}
+
+CsvResultExport::CsvResultExport() = default;
+
+CsvResultExport::~CsvResultExport() = default;
+
+bool CsvResultExport::Open(
+    const std::string &path,
+    const std::vector<std::string> &columnNames,
+    std::string &error)
+{
+    _path = path;
+    _file.open(std::filesystem::u8path(path), std::ios::binary | std::ios::trunc);
+    if (!_file)
+    {
+        error = "the file can not be created";
+        return false;
+    }
+
+    for (auto &name : columnNames)
+    {
+        AddField(name);
+    }
+    _buffer.append("\r\n");
+    _firstField = true;
+
+    return true;
+}
+
+void CsvResultExport::AddField(
+    std::string_view value)
+{
+    if (!_firstField)
+    {
+        _buffer.push_back(',');
+    }
+    _firstField = false;
+
+    // An empty text is quoted, so it is told apart from NULL
+    if (!value.empty() && value.find_first_of(",\"\r\n") == std::string_view::npos)
+    {
+        _buffer.append(value);
+        return;
+    }
+
+    _buffer.push_back('"');
+    for (auto c : value)
+    {
+        if (c == '"')
+        {
+            _buffer.push_back('"');
+        }
+        _buffer.push_back(c);
+    }
+    _buffer.push_back('"');
+}
+
+void CsvResultExport::AddNull()
+{
+    if (!_firstField)
+    {
+        _buffer.push_back(',');
+    }
+    _firstField = false;
+}
+
+void CsvResultExport::AddInteger(
+    int64_t value)
+{
+    AddField(std::to_string(value));
+}
+
+void CsvResultExport::AddReal(
+    double value)
+{
+    AddField(FormatResultReal(value));
+}
+
+void CsvResultExport::AddText(
+    std::string_view value)
+{
+    AddField(value);
+}
+
+void CsvResultExport::EndRow()
+{
+    _buffer.append("\r\n");
+    _firstField = true;
+    _rowCount++;
+
+    if (_buffer.size() >= CsvWriteSize)
+    {
+        _file.write(_buffer.data(), std::streamsize(_buffer.size()));
+        _buffer.clear();
+    }
+}
+
+void CsvResultExport::Fail(
+    const std::string &error)
+{
+    if (_error.empty())
+    {
+        _error = error;
+    }
+}
+
+bool CsvResultExport::Close(
+    std::string &error)
+{
+    _file.write(_buffer.data(), std::streamsize(_buffer.size()));
+    _buffer.clear();
+    _file.close();
+
+    if (_error.empty() && !_file)
+    {
+        _error = "the file could not be written";
+    }
+
+    if (!_error.empty())
+    {
+        std::error_code removeError;
+        std::filesystem::remove(std::filesystem::u8path(_path), removeError);
+
+        error = _error;
+        return false;
+    }
+
+    return true;
+}
+
+uint64_t CsvResultExport::RowCount() const
+{
+    return _rowCount;
+}
+
+std::unique_ptr<ResultExport> CreateResultExport(
+    const std::string &path)
+{
+    if (iequals(std::filesystem::u8path(path).extension().u8string(), ".csv"))
+    {
+        return std::make_unique<CsvResultExport>();
+    }
+
+    return std::make_unique<ResultFileWriter>();
+}
+
+std::string ResultExportPath(
+    const std::string &path,
+    size_t index)
+{
+    if (index == 0)
+    {
+        return path;
+    }
+
+    auto numbered = std::filesystem::u8path(path);
+    numbered.replace_filename(numbered.stem().u8string() + "-" + std::to_string(index + 1) + numbered.extension().u8string());
+
+    return numbered.u8string();
+}
+
+std::unique_ptr<ResultExport> StartResultExport(
+    const std::string &path,
+    size_t index,
+    const std::vector<std::string> &columnNames,
+    std::string &output)
+{
+    auto exportPath = ResultExportPath(path, index);
+    auto resultExport = CreateResultExport(exportPath);
+
+    std::string error;
+    if (!resultExport->Open(exportPath, columnNames, error))
+    {
+        output.append("Error: could not export to '" + exportPath + "', " + error + "\n\n");
+        return nullptr;
+    }
+
+    return resultExport;
+}
+
+bool FinishResultExport(
+    ResultExport &resultExport,
+    std::string &output)
+{
+    std::string error;
+    if (!resultExport.Close(error))
+    {
+        output.append("Error: could not export to '" + resultExport.Path() + "', " + error + "\n\n");
+        return false;
+    }
+
+    auto rowCount = resultExport.RowCount();
+    output.append("Exported " + std::to_string(rowCount) + (rowCount == 1 ? " row" : " rows") + " to '" + resultExport.Path() + "'\n\n");
+
+    return true;
+}
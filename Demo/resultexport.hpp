@@ -0,0 +1,138 @@
+#ifndef RESULTEXPORT_HPP
+#define RESULTEXPORT_HPP
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Writes the rows of a result set to a file while they are read. Values are
+// added one after the other, from the first column to the last.
+class ResultExport
+{
+public:
+    virtual ~ResultExport() = default;
+
+public:
+    // Creates the file, false with error set when it can not be written
+    virtual bool Open(
+        const std::string &path,
+        const std::vector<std::string> &columnNames,
+        std::string &error) = 0;
+
+    virtual void AddNull() = 0;
+
+    virtual void AddInteger(
+        int64_t value) = 0;
+
+    virtual void AddReal(
+        double value) = 0;
+
+    virtual void AddText(
+        std::string_view value) = 0;
+
+    virtual void EndRow() = 0;
+
+    // Stops the export of rows that could not all be read, Close returns the error
+    virtual void Fail(
+        const std::string &error) = 0;
+
+    // Writes what is left, false with error set when the file could not be
+    // written. A file that was not written completely is removed.
+    virtual bool Close(
+        std::string &error) = 0;
+
+    virtual uint64_t RowCount() const = 0;
+
+    // For values that come as text, a number is added as a number when it
+    // reads back the same, as text otherwise
+    void AddValue(
+        std::string_view value,
+        bool isNumber,
+        bool isNull);
+
+    const std::string &Path() const;
+
+protected:
+    std::string _path;
+};
+
+// Comma separated values as in RFC 4180, with the column names on the first
+// line. NULL is written as an empty field.
+class CsvResultExport : public ResultExport
+{
+public:
+    CsvResultExport();
+
+    virtual ~CsvResultExport();
+
+public:
+    bool Open(
+        const std::string &path,
+        const std::vector<std::string> &columnNames,
+        std::string &error);
+
+    void AddNull();
+
+    void AddInteger(
+        int64_t value);
+
+    void AddReal(
+        double value);
+
+    void AddText(
+        std::string_view value);
+
+    void EndRow();
+
+    void Fail(
+        const std::string &error);
+
+    bool Close(
+        std::string &error);
+
+    uint64_t RowCount() const;
+
+private:
+    std::ofstream _file;
+    std::string _buffer;
+    std::string _error;
+    bool _firstField = true;
+    uint64_t _rowCount = 0;
+
+    void AddField(
+        std::string_view value);
+};
+
+// A .csv path is exported as CSV, any other as a results file
+std::unique_ptr<ResultExport> CreateResultExport(
+    const std::string &path);
+
+// The first result set of a run goes to path, the ones after it to numbered
+// files next to it: rows.csv, rows-2.csv, rows-3.csv
+std::string ResultExportPath(
+    const std::string &path,
+    size_t index);
+
+// Opens the export of the index-th result set of a run, on failure writes
+// why to output and returns nullptr
+std::unique_ptr<ResultExport> StartResultExport(
+    const std::string &path,
+    size_t index,
+    const std::vector<std::string> &columnNames,
+    std::string &output);
+
+// Closes the export and writes where its rows went, or why they did not.
+// Returns false when the export failed.
+bool FinishResultExport(
+    ResultExport &resultExport,
+    std::string &output);
+
+// A real as sqlite writes it, 2.0 or 1.0e+16, but with as many digits as
+// it takes to read back as the same value
+std::string FormatResultReal(
+    double value);
+
+#endif // RESULTEXPORT_HPP
@@ -0,0 +1,823 @@
+#include "resultfile.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <string_view>
+#include <unordered_map>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN 1
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const char ResultFileMagic[8] = {'S', 'G', 'L', 'R', 'E', 'S', '1', '\0'};
+
+void AppendResultFileInt(
+    std::string &output,
+    uint64_t value,
+    size_t bytes)
+{
+    for (size_t i = 0; i < bytes; i++)
+    {
+        output.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+}
+
+uint64_t ResultFileInt(
+    const unsigned char *data,
+    size_t bytes)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; i++)
+    {
+        value |= uint64_t(data[i]) << (8 * i);
+    }
+
+    return value;
+}
+
+uint64_t ResultFileRealBits(
+    double value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    return bits;
+}
+
+double ResultFileReal(
+    uint64_t bits)
+{
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+
+    return value;
+}
+
+ResultFileWriter::ResultFileWriter() = default;
+
+ResultFileWriter::~ResultFileWriter() = default;
+
+bool ResultFileWriter::Open(
+    const std::string &path,
+    const std::vector<std::string> &columnNames,
+    std::string &error)
+{
+    _path = path;
+    _columnNames = columnNames;
+    _columns.resize(columnNames.size());
+
+    _file.open(std::filesystem::u8path(path), std::ios::binary | std::ios::trunc);
+    if (!_file)
+    {
+        error = "the file can not be created";
+        return false;
+    }
+
+    Write(std::string(ResultFileMagic, sizeof(ResultFileMagic)));
+
+    return true;
+}
+
+ResultFileWriter::ColumnValues &ResultFileWriter::NextColumn(
+    ValueType type)
+{
+    auto &values = _columns[_column++];
+
+    values.Types.push_back(type);
+    values.Numbers.push_back(0);
+    values.TextEnds.push_back(static_cast<uint32_t>(values.Text.size()));
+
+    return values;
+}
+
+void ResultFileWriter::AddNull()
+{
+    NextColumn(ValueType::Null);
+}
+
+void ResultFileWriter::AddInteger(
+    int64_t value)
+{
+    NextColumn(ValueType::Integer).Numbers.back() = value;
+}
+
+void ResultFileWriter::AddReal(
+    double value)
+{
+    NextColumn(ValueType::Real).Numbers.back() = static_cast<int64_t>(ResultFileRealBits(value));
+}
+
+void ResultFileWriter::AddText(
+    std::string_view value)
+{
+    auto &values = NextColumn(ValueType::Text);
+
+    values.Text.append(value);
+    values.TextEnds.back() = static_cast<uint32_t>(values.Text.size());
+    _rowGroupBytes += value.size();
+}
+
+void ResultFileWriter::EndRow()
+{
+    // A row with too few values is filled up with NULLs
+    while (_column < _columns.size())
+    {
+        AddNull();
+    }
+    _column = 0;
+
+    _rowCount++;
+    _rowGroupRows++;
+
+    if (_rowGroupRows == ResultFileRowGroupRows || _rowGroupBytes >= ResultFileRowGroupBytes)
+    {
+        WriteRowGroup();
+    }
+}
+
+void ResultFileWriter::Fail(
+    const std::string &error)
+{
+    if (_error.empty())
+    {
+        _error = error;
+    }
+}
+
+void ResultFileWriter::Write(
+    const std::string &data)
+{
+    _file.write(data.data(), std::streamsize(data.size()));
+    _offset += data.size();
+}
+
+void ResultFileWriter::EncodeChunk(
+    const ColumnValues &values)
+{
+    auto rowCount = values.Types.size();
+
+    bool hasInteger = false;
+    bool hasReal = false;
+    bool hasText = false;
+    for (auto type : values.Types)
+    {
+        hasInteger = hasInteger || type == ValueType::Integer;
+        hasReal = hasReal || type == ValueType::Real;
+        hasText = hasText || type == ValueType::Text;
+    }
+
+    auto encoding = ResultFileEncoding::Integer;
+    if (hasText || (hasInteger && hasReal))
+    {
+        encoding = ResultFileEncoding::Text;
+    }
+    else if (hasReal)
+    {
+        encoding = ResultFileEncoding::Real;
+    }
+
+    _chunk.clear();
+    _chunk.push_back(static_cast<char>(encoding));
+
+    std::string nulls((rowCount + 7) / 8, '\0');
+    for (size_t row = 0; row < rowCount; row++)
+    {
+        if (values.Types[row] == ValueType::Null)
+        {
+            nulls[row / 8] = static_cast<char>(nulls[row / 8] | (1 << (row % 8)));
+        }
+    }
+    _chunk.append(nulls);
+
+    // Numbers holds the bits of a double as they are stored
+    if (encoding != ResultFileEncoding::Text)
+    {
+        for (size_t row = 0; row < rowCount; row++)
+        {
+            AppendResultFileInt(_chunk, static_cast<uint64_t>(values.Numbers[row]), 8);
+        }
+        return;
+    }
+
+    // Numbers among text are stored as the text they are shown as
+    std::string convertedText;
+    std::vector<uint32_t> convertedEnds;
+    auto text = &values.Text;
+    auto textEnds = &values.TextEnds;
+
+    if (hasInteger || hasReal)
+    {
+        size_t start = 0;
+        for (size_t row = 0; row < rowCount; row++)
+        {
+            switch (values.Types[row])
+            {
+                case ValueType::Integer:
+                    convertedText.append(std::to_string(values.Numbers[row]));
+                    break;
+                case ValueType::Real:
+                    convertedText.append(FormatResultReal(ResultFileReal(static_cast<uint64_t>(values.Numbers[row]))));
+                    break;
+                case ValueType::Text:
+                    convertedText.append(values.Text, start, values.TextEnds[row] - start);
+                    break;
+                default:
+                    break;
+            }
+            start = values.TextEnds[row];
+            convertedEnds.push_back(static_cast<uint32_t>(convertedText.size()));
+        }
+
+        text = &convertedText;
+        textEnds = &convertedEnds;
+    }
+
+    auto rowText = [&](size_t row) {
+        auto start = row == 0 ? 0 : (*textEnds)[row - 1];
+        return std::string_view(*text).substr(start, (*textEnds)[row] - start);
+    };
+
+    // Repeated values, like the names of a few categories, are stored once
+    // with an index into them per row
+    std::unordered_map<std::string_view, uint32_t> entryIndexes;
+    std::vector<std::string_view> entries;
+    std::vector<uint32_t> indexes(rowCount, 0);
+    size_t entryBytes = 0;
+
+    for (size_t row = 0; row < rowCount; row++)
+    {
+        if (values.Types[row] == ValueType::Null)
+        {
+            continue;
+        }
+
+        auto value = rowText(row);
+        auto found = entryIndexes.emplace(value, static_cast<uint32_t>(entries.size()));
+        if (found.second)
+        {
+            entries.push_back(value);
+            entryBytes += value.size();
+        }
+        indexes[row] = found.first->second;
+    }
+
+    size_t indexWidth = entries.size() <= 0x100 ? 1 : entries.size() <= 0x10000 ? 2 : 4;
+    auto textSize = 4 * rowCount + text->size();
+    auto dictionarySize = 4 + 4 * entries.size() + entryBytes + 1 + indexWidth * rowCount;
+
+    if (textSize <= dictionarySize)
+    {
+        _chunk[0] = static_cast<char>(ResultFileEncoding::Text);
+        for (size_t row = 0; row < rowCount; row++)
+        {
+            AppendResultFileInt(_chunk, (*textEnds)[row], 4);
+        }
+        _chunk.append(*text);
+        return;
+    }
+
+    _chunk[0] = static_cast<char>(ResultFileEncoding::Dictionary);
+    AppendResultFileInt(_chunk, entries.size(), 4);
+    uint64_t end = 0;
+    for (auto &entry : entries)
+    {
+        end += entry.size();
+        AppendResultFileInt(_chunk, end, 4);
+    }
+    for (auto &entry : entries)
+    {
+        _chunk.append(entry);
+    }
+    _chunk.push_back(static_cast<char>(indexWidth));
+    for (auto index : indexes)
+    {
+        AppendResultFileInt(_chunk, index, indexWidth);
+    }
+}
+
+void ResultFileWriter::WriteRowGroup()
+{
+    if (_rowGroupRows == 0)
+    {
+        return;
+    }
+
+    RowGroupIndex rowGroup;
+    rowGroup.FirstRow = _rowCount - _rowGroupRows;
+    rowGroup.RowCount = _rowGroupRows;
+
+    for (auto &values : _columns)
+    {
+        EncodeChunk(values);
+
+        rowGroup.ChunkOffsets.push_back(_offset);
+        rowGroup.ChunkSizes.push_back(_chunk.size());
+        Write(_chunk);
+
+        values.Types.clear();
+        values.Numbers.clear();
+        values.Text.clear();
+        values.TextEnds.clear();
+    }
+
+    _rowGroups.push_back(std::move(rowGroup));
+    _rowGroupRows = 0;
+    _rowGroupBytes = 0;
+}
+
+bool ResultFileWriter::Close(
+    std::string &error)
+{
+    if (_error.empty())
+    {
+        WriteRowGroup();
+
+        std::string footer;
+        AppendResultFileInt(footer, _columnNames.size(), 4);
+        for (auto &name : _columnNames)
+        {
+            AppendResultFileInt(footer, name.size(), 4);
+            footer.append(name);
+        }
+        AppendResultFileInt(footer, _rowCount, 8);
+        AppendResultFileInt(footer, _rowGroups.size(), 4);
+        for (auto &rowGroup : _rowGroups)
+        {
+            AppendResultFileInt(footer, rowGroup.FirstRow, 8);
+            AppendResultFileInt(footer, rowGroup.RowCount, 4);
+            for (size_t col = 0; col < _columnNames.size(); col++)
+            {
+                AppendResultFileInt(footer, rowGroup.ChunkOffsets[col], 8);
+                AppendResultFileInt(footer, rowGroup.ChunkSizes[col], 8);
+            }
+        }
+        AppendResultFileInt(footer, _offset, 8);
+        footer.append(ResultFileMagic, sizeof(ResultFileMagic));
+
+        Write(footer);
+    }
+
+    _file.close();
+
+    if (_error.empty() && !_file)
+    {
+        _error = "the file could not be written";
+    }
+
+    if (!_error.empty())
+    {
+        std::error_code removeError;
+        std::filesystem::remove(std::filesystem::u8path(_path), removeError);
+
+        error = _error;
+        return false;
+    }
+
+    return true;
+}
+
+uint64_t ResultFileWriter::RowCount() const
+{
+    return _rowCount;
+}
+
+ResultFileReader::ResultFileReader() = default;
+
+ResultFileReader::~ResultFileReader()
+{
+    Close();
+}
+
+#ifdef _WIN32
+bool ResultFileReader::Map(
+    const std::string &path,
+    std::string &error)
+{
+    auto file = CreateFileW(std::filesystem::u8path(path).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        error = "the file can not be opened";
+        return false;
+    }
+    _file = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart < LONGLONG(2 * sizeof(ResultFileMagic) + 8))
+    {
+        error = "not a results file";
+        return false;
+    }
+    _size = size_t(size.QuadPart);
+
+    _mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (_mapping == nullptr)
+    {
+        error = "the file can not be mapped";
+        return false;
+    }
+
+    _data = static_cast<const unsigned char *>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (_data == nullptr)
+    {
+        error = "the file can not be mapped";
+        return false;
+    }
+
+    return true;
+}
+
+void ResultFileReader::Close()
+{
+    if (_data != nullptr)
+    {
+        UnmapViewOfFile(_data);
+    }
+    if (_mapping != nullptr)
+    {
+        CloseHandle(_mapping);
+    }
+    if (_file != nullptr)
+    {
+        CloseHandle(_file);
+    }
+
+    _data = nullptr;
+    _mapping = nullptr;
+    _file = nullptr;
+    _size = 0;
+    _rowGroups.clear();
+}
+#else
+bool ResultFileReader::Map(
+    const std::string &path,
+    std::string &error)
+{
+    auto file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0)
+    {
+        error = "the file can not be opened";
+        return false;
+    }
+
+    struct stat status;
+    if (::fstat(file, &status) != 0 || size_t(status.st_size) < 2 * sizeof(ResultFileMagic) + 8)
+    {
+        ::close(file);
+        error = "not a results file";
+        return false;
+    }
+    _size = size_t(status.st_size);
+
+    // The mapping keeps the file open
+    auto data = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, file, 0);
+    ::close(file);
+
+    if (data == MAP_FAILED)
+    {
+        _size = 0;
+        error = "the file can not be mapped";
+        return false;
+    }
+    _data = static_cast<const unsigned char *>(data);
+
+    return true;
+}
+
+void ResultFileReader::Close()
+{
+    if (_data != nullptr)
+    {
+        ::munmap(const_cast<unsigned char *>(_data), _size);
+    }
+
+    _data = nullptr;
+    _size = 0;
+    _rowGroups.clear();
+}
+#endif
+
+bool ResultFileReader::Open(
+    const std::string &path,
+    std::string &error)
+{
+    Close();
+
+    if (!Map(path, error))
+    {
+        Close();
+        return false;
+    }
+
+    if (std::memcmp(_data, ResultFileMagic, sizeof(ResultFileMagic)) != 0 || std::memcmp(_data + _size - sizeof(ResultFileMagic), ResultFileMagic, sizeof(ResultFileMagic)) != 0)
+    {
+        Close();
+        error = "not a results file";
+        return false;
+    }
+
+    if (!ReadFooter())
+    {
+        Close();
+        error = "the results file is damaged";
+        return false;
+    }
+
+    return true;
+}
+
+bool ResultFileReader::ReadChunk(
+    const unsigned char *data,
+    uint64_t size,
+    uint32_t rowCount,
+    Chunk &chunk)
+{
+    uint64_t nullsSize = (uint64_t(rowCount) + 7) / 8;
+    if (size < 1 + nullsSize)
+    {
+        return false;
+    }
+
+    chunk.Encoding = static_cast<ResultFileEncoding>(data[0]);
+    chunk.Nulls = data + 1;
+    chunk.Values = chunk.Nulls + nullsSize;
+
+    uint64_t used = 1 + nullsSize;
+
+    switch (chunk.Encoding)
+    {
+        case ResultFileEncoding::Integer:
+        case ResultFileEncoding::Real:
+            return size - used >= 8 * uint64_t(rowCount);
+        case ResultFileEncoding::Text:
+        {
+            if (size - used < 4 * uint64_t(rowCount))
+            {
+                return false;
+            }
+            chunk.TextEnds = chunk.Values;
+            chunk.Text = chunk.TextEnds + 4 * uint64_t(rowCount);
+            used += 4 * uint64_t(rowCount);
+
+            // Each value is checked to lie within the text when it is read
+            chunk.TextSize = rowCount == 0 ? 0 : ResultFileInt(chunk.TextEnds + 4 * (rowCount - 1), 4);
+            return size - used >= chunk.TextSize;
+        }
+        case ResultFileEncoding::Dictionary:
+        {
+            if (size - used < 4)
+            {
+                return false;
+            }
+            chunk.EntryCount = ResultFileInt(chunk.Values, 4);
+            used += 4;
+            if (size - used < 4 * chunk.EntryCount)
+            {
+                return false;
+            }
+            chunk.TextEnds = chunk.Values + 4;
+            chunk.Text = chunk.TextEnds + 4 * chunk.EntryCount;
+            used += 4 * chunk.EntryCount;
+
+            chunk.TextSize = chunk.EntryCount == 0 ? 0 : ResultFileInt(chunk.TextEnds + 4 * (chunk.EntryCount - 1), 4);
+            if (size - used < chunk.TextSize + 1)
+            {
+                return false;
+            }
+            used += chunk.TextSize;
+
+            // Indexes are checked against the entry count when they are read
+            chunk.IndexWidth = data[used];
+            used++;
+            chunk.Values = data + used;
+
+            if (chunk.IndexWidth != 1 && chunk.IndexWidth != 2 && chunk.IndexWidth != 4)
+            {
+                return false;
+            }
+            return size - used >= chunk.IndexWidth * uint64_t(rowCount);
+        }
+        default:
+            return false;
+    }
+}
+
+bool ResultFileReader::ReadFooter()
+{
+    auto footerEnd = _size - sizeof(ResultFileMagic) - 8;
+    auto footerOffset = ResultFileInt(_data + footerEnd, 8);
+    if (footerOffset < sizeof(ResultFileMagic) || footerOffset > footerEnd)
+    {
+        return false;
+    }
+
+    auto position = _data + footerOffset;
+    auto end = _data + footerEnd;
+
+    auto read = [&](size_t bytes, uint64_t &value) {
+        if (size_t(end - position) < bytes)
+        {
+            return false;
+        }
+        value = ResultFileInt(position, bytes);
+        position += bytes;
+        return true;
+    };
+
+    uint64_t columnCount;
+    if (!read(4, columnCount))
+    {
+        return false;
+    }
+
+    _columnNames.clear();
+    for (uint64_t col = 0; col < columnCount; col++)
+    {
+        uint64_t length;
+        if (!read(4, length) || uint64_t(end - position) < length)
+        {
+            return false;
+        }
+        _columnNames.emplace_back(reinterpret_cast<const char *>(position), size_t(length));
+        position += length;
+    }
+
+    uint64_t rowGroupCount;
+    if (!read(8, _rowCount) || !read(4, rowGroupCount))
+    {
+        return false;
+    }
+
+    uint64_t nextRow = 0;
+    for (uint64_t i = 0; i < rowGroupCount; i++)
+    {
+        RowGroup rowGroup;
+        uint64_t rowCount;
+        if (!read(8, rowGroup.FirstRow) || !read(4, rowCount) || rowGroup.FirstRow != nextRow)
+        {
+            return false;
+        }
+        rowGroup.RowCount = static_cast<uint32_t>(rowCount);
+        nextRow += rowCount;
+
+        rowGroup.Chunks.resize(columnCount);
+        for (auto &chunk : rowGroup.Chunks)
+        {
+            uint64_t offset, size;
+            if (!read(8, offset) || !read(8, size) || offset < sizeof(ResultFileMagic) || offset > footerOffset || size > footerOffset - offset)
+            {
+                return false;
+            }
+
+            if (!ReadChunk(_data + offset, size, rowGroup.RowCount, chunk))
+            {
+                return false;
+            }
+        }
+
+        _rowGroups.push_back(std::move(rowGroup));
+    }
+
+    return nextRow == _rowCount;
+}
+
+const std::vector<std::string> &ResultFileReader::ColumnNames() const
+{
+    return _columnNames;
+}
+
+uint64_t ResultFileReader::RowCount() const
+{
+    return _rowCount;
+}
+
+size_t ResultFileReader::RowGroupCount() const
+{
+    return _rowGroups.size();
+}
+
+bool ResultFileReader::Value(
+    uint64_t row,
+    size_t column,
+    std::string_view &value,
+    std::string &buffer) const
+{
+    value = std::string_view();
+
+    if (row >= _rowCount || column >= _columnNames.size())
+    {
+        return false;
+    }
+
+    // The row group that starts at or before row, they are in order
+    auto rowGroup = std::upper_bound(_rowGroups.begin(), _rowGroups.end(), row, [](uint64_t r, const RowGroup &group) {
+                        return r < group.FirstRow;
+                    }) -
+                    1;
+
+    auto &chunk = rowGroup->Chunks[column];
+    auto index = size_t(row - rowGroup->FirstRow);
+
+    if (chunk.Nulls[index / 8] & (1 << (index % 8)))
+    {
+        return false;
+    }
+
+    switch (chunk.Encoding)
+    {
+        case ResultFileEncoding::Integer:
+            buffer = std::to_string(static_cast<int64_t>(ResultFileInt(chunk.Values + 8 * index, 8)));
+            value = buffer;
+            break;
+        case ResultFileEncoding::Real:
+            buffer = FormatResultReal(ResultFileReal(ResultFileInt(chunk.Values + 8 * index, 8)));
+            value = buffer;
+            break;
+        case ResultFileEncoding::Text:
+        case ResultFileEncoding::Dictionary:
+        {
+            size_t entry = index;
+            if (chunk.Encoding == ResultFileEncoding::Dictionary)
+            {
+                entry = size_t(ResultFileInt(chunk.Values + chunk.IndexWidth * index, chunk.IndexWidth));
+                if (entry >= chunk.EntryCount)
+                {
+                    break;
+                }
+            }
+
+            auto start = entry == 0 ? 0 : ResultFileInt(chunk.TextEnds + 4 * (entry - 1), 4);
+            auto stop = ResultFileInt(chunk.TextEnds + 4 * entry, 4);
+            if (start <= stop && stop <= chunk.TextSize)
+            {
+                value = std::string_view(reinterpret_cast<const char *>(chunk.Text + start), size_t(stop - start));
+            }
+            break;
+        }
+    }
+
+    return true;
+}
+
+ResultFileGrid::ResultFileGrid(
+    std::unique_ptr<ResultFileReader> reader,
+    const std::vector<TableColumn> &columns,
+    size_t rowsWritten)
+    : _reader(std::move(reader)),
+      _formatter(columns),
+      _rowsWritten(rowsWritten)
+{}
+
+ResultFileGrid::~ResultFileGrid() = default;
+
+size_t ResultFileGrid::RowsWritten() const
+{
+    return _rowsWritten;
+}
+
+long long ResultFileGrid::RowCount() const
+{
+    return static_cast<long long>(_reader->RowCount());
+}
+
+size_t ResultFileGrid::ReadRows(
+    size_t firstRow,
+    size_t count,
+    std::string &lines,
+    const CancellationToken &cancellationToken)
+{
+    auto columnCount = std::min(_formatter.Columns().size(), _reader->ColumnNames().size());
+    auto lastRow = std::min<uint64_t>(_reader->RowCount(), uint64_t(firstRow) + count);
+
+    lines.clear();
+    lines.reserve(count * _formatter.RowSize());
+
+    std::string_view value;
+    std::string buffer;
+    size_t rows = 0;
+
+    for (auto row = uint64_t(firstRow); row < lastRow; row++)
+    {
+        if (rows % 1024 == 0 && cancellationToken.IsCancellationRequested())
+        {
+            break;
+        }
+
+        for (size_t col = 0; col < columnCount; col++)
+        {
+            _reader->Value(row, col, value, buffer);
+            _formatter.WriteCell(col, value, lines);
+        }
+        _formatter.EndRow(lines);
+        rows++;
+    }
+
+    return rows;
+}
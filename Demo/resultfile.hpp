@@ -0,0 +1,241 @@
+#ifndef RESULTFILE_HPP
+#define RESULTFILE_HPP
+
+#include "resultexport.hpp"
+#include "resultgrid.hpp"
+#include "tableformatter.hpp"
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A results file stores a result set by column, in row groups of up to
+// ResultFileRowGroupRows rows. Each column of a row group is one chunk, of
+// 64-bit integers, doubles, or text that is dictionary encoded when that is
+// smaller. An index of the row groups and their chunks is at the end of the
+// file, so a row is found without reading the ones before it.
+//
+//   "SGLRES1\0"
+//   chunks, for every row group the chunk of each column
+//   footer: column count, column names, row count, row group count, for
+//           every row group its first row, row count and chunk offsets and sizes
+//   footer offset, "SGLRES1\0"
+//
+// Numbers are little endian. A chunk starts with its encoding, then a bitmap
+// with a bit set for every NULL, then its values:
+//
+//   Integer     int64 per row
+//   Real        double per row
+//   Text        uint32 end offset per row, the text
+//   Dictionary  uint32 entry count, uint32 end offset per entry, the text of
+//               the entries, the index width in bytes (1, 2 or 4), an index per row
+//
+// A column whose values in a row group are not all of one type is stored as text.
+enum class ResultFileEncoding : uint8_t
+{
+    Integer = 1,
+    Real = 2,
+    Text = 3,
+    Dictionary = 4,
+};
+
+const size_t ResultFileRowGroupRows = 64 * 1024;
+
+// A row group is also written when its text grows past this size
+const size_t ResultFileRowGroupBytes = 16 * 1024 * 1024;
+
+// Writes a results file, keeping one row group in memory
+class ResultFileWriter : public ResultExport
+{
+public:
+    ResultFileWriter();
+
+    virtual ~ResultFileWriter();
+
+public:
+    bool Open(
+        const std::string &path,
+        const std::vector<std::string> &columnNames,
+        std::string &error);
+
+    void AddNull();
+
+    void AddInteger(
+        int64_t value);
+
+    void AddReal(
+        double value);
+
+    void AddText(
+        std::string_view value);
+
+    void EndRow();
+
+    void Fail(
+        const std::string &error);
+
+    bool Close(
+        std::string &error);
+
+    uint64_t RowCount() const;
+
+private:
+    enum class ValueType : uint8_t
+    {
+        Null,
+        Integer,
+        Real,
+        Text,
+    };
+
+    // The values of a column in the row group that is being filled
+    struct ColumnValues
+    {
+        std::vector<ValueType> Types;
+        // The integer, or the bits of the double
+        std::vector<int64_t> Numbers;
+        std::string Text;
+        // Where the text of each row ends, rows without text end where the one before did
+        std::vector<uint32_t> TextEnds;
+    };
+
+    struct RowGroupIndex
+    {
+        uint64_t FirstRow = 0;
+        uint32_t RowCount = 0;
+        std::vector<uint64_t> ChunkOffsets;
+        std::vector<uint64_t> ChunkSizes;
+    };
+
+    std::ofstream _file;
+    std::string _error;
+    std::vector<std::string> _columnNames;
+    std::vector<ColumnValues> _columns;
+    size_t _column = 0;
+    uint64_t _rowCount = 0;
+    uint32_t _rowGroupRows = 0;
+    size_t _rowGroupBytes = 0;
+    uint64_t _offset = 0;
+    std::vector<RowGroupIndex> _rowGroups;
+    std::string _chunk;
+
+    ColumnValues &NextColumn(
+        ValueType type);
+
+    void WriteRowGroup();
+
+    // Encodes the values of a column into _chunk
+    void EncodeChunk(
+        const ColumnValues &values);
+
+    void Write(
+        const std::string &data);
+};
+
+// Reads a results file through a memory map, so only the pages of the rows
+// that are read are loaded, and read again from disk when memory runs low.
+class ResultFileReader
+{
+public:
+    ResultFileReader();
+
+    virtual ~ResultFileReader();
+
+public:
+    bool Open(
+        const std::string &path,
+        std::string &error);
+
+    void Close();
+
+    const std::vector<std::string> &ColumnNames() const;
+
+    uint64_t RowCount() const;
+
+    size_t RowGroupCount() const;
+
+    // Points value at the text of a column in a row, numbers are formatted
+    // into buffer. Returns false for NULL.
+    bool Value(
+        uint64_t row,
+        size_t column,
+        std::string_view &value,
+        std::string &buffer) const;
+
+private:
+    struct Chunk
+    {
+        ResultFileEncoding Encoding = ResultFileEncoding::Integer;
+        const unsigned char *Nulls = nullptr;
+        const unsigned char *Values = nullptr;
+        // The text of Text chunks and dictionary entries, with where each ends
+        const unsigned char *Text = nullptr;
+        const unsigned char *TextEnds = nullptr;
+        uint64_t TextSize = 0;
+        uint64_t EntryCount = 0;
+        uint8_t IndexWidth = 0;
+    };
+
+    struct RowGroup
+    {
+        uint64_t FirstRow = 0;
+        uint32_t RowCount = 0;
+        std::vector<Chunk> Chunks;
+    };
+
+    const unsigned char *_data = nullptr;
+    size_t _size = 0;
+#ifdef _WIN32
+    void *_file = nullptr;
+    void *_mapping = nullptr;
+#endif
+    std::vector<std::string> _columnNames;
+    uint64_t _rowCount = 0;
+    std::vector<RowGroup> _rowGroups;
+
+    bool Map(
+        const std::string &path,
+        std::string &error);
+
+    bool ReadFooter();
+
+    // Checks that a chunk of rowCount rows fits in size bytes and points chunk into it
+    bool ReadChunk(
+        const unsigned char *data,
+        uint64_t size,
+        uint32_t rowCount,
+        Chunk &chunk);
+};
+
+// Pages through the rows of a results file, reading them from disk instead
+// of running the query again
+class ResultFileGrid : public ResultGrid
+{
+public:
+    ResultFileGrid(
+        std::unique_ptr<ResultFileReader> reader,
+        const std::vector<TableColumn> &columns,
+        size_t rowsWritten);
+
+    virtual ~ResultFileGrid();
+
+public:
+    size_t RowsWritten() const;
+
+    size_t ReadRows(
+        size_t firstRow,
+        size_t count,
+        std::string &lines,
+        const CancellationToken &cancellationToken);
+
+    long long RowCount() const;
+
+private:
+    std::unique_ptr<ResultFileReader> _reader;
+    TableFormatter _formatter;
+    size_t _rowsWritten;
+};
+
+#endif // RESULTFILE_HPP
@@ -0,0 +1,30 @@
+#ifndef RESULTGRID_HPP
+#define RESULTGRID_HPP
+
+#include "executorservice.hpp"
+#include <string>
+
+// A result set that is too large to show at once. The run writes its first
+// rows, the rest are formatted a page at a time when they are scrolled to.
+class ResultGrid
+{
+public:
+    virtual ~ResultGrid() = default;
+
+public:
+    // The number of rows the run wrote as the last lines of its output
+    virtual size_t RowsWritten() const = 0;
+
+    // Formats up to count rows from firstRow on, one line per row, and
+    // returns the number of rows that were formatted
+    virtual size_t ReadRows(
+        size_t firstRow,
+        size_t count,
+        std::string &lines,
+        const CancellationToken &cancellationToken) = 0;
+
+    // The number of rows in the result set, -1 while they are being counted
+    virtual long long RowCount() const = 0;
+};
+
+#endif // RESULTGRID_HPP
@@ -0,0 +1,432 @@
+#include "sqliteconnectionpool.hpp"
+
+#include "executorservice.hpp"
+#include "stringhelpers.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <iterator>
+#include <sqlite3.h>
+
+SqliteConnection::SqliteConnection(
+    sqlite3 *db,
+    size_t maxCachedStatements)
+    : _db(db),
+      _maxCachedStatements(maxCachedStatements)
+{}
+
+SqliteConnection::~SqliteConnection()
+{
+    SetCancellationToken(nullptr);
+
+    for (auto &statement : _statements)
+    {
+        sqlite3_finalize(statement.Statement);
+    }
+
+    sqlite3_close(_db);
+}
+
+sqlite3 *SqliteConnection::Handle() const
+{
+    return _db;
+}
+
+std::string_view SqliteStatementText(
+    std::string_view sql)
+{
+    std::string prefix;
+    size_t from = 0;
+
+    while (true)
+    {
+        auto semicolon = sql.find(';', from);
+        if (semicolon == std::string_view::npos)
+        {
+            return sql;
+        }
+
+        // A semicolon in a string, comment or trigger body does not end the statement
+        prefix.append(sql.substr(from, semicolon + 1 - from));
+        if (sqlite3_complete(prefix.c_str()))
+        {
+            return sql.substr(0, semicolon + 1);
+        }
+
+        from = semicolon + 1;
+    }
+}
+
+int SqliteConnection::Prepare(
+    std::string_view sql,
+    sqlite3_stmt **stmt,
+    size_t &consumed)
+{
+    auto found = _statementsByText.find(SqliteStatementText(sql));
+    if (found != _statementsByText.end())
+    {
+        _statements.splice(_statements.begin(), _statements, found->second);
+
+        *stmt = found->second->Statement;
+        consumed = found->second->Text.size();
+
+        return SQLITE_OK;
+    }
+
+    const char *tail = nullptr;
+    auto result = sqlite3_prepare_v3(_db, sql.data(), int(sql.size()), SQLITE_PREPARE_PERSISTENT, stmt, &tail);
+
+    consumed = tail != nullptr ? size_t(tail - sql.data()) : sql.size();
+
+    // Whitespace and comments do not make a statement
+    if (result != SQLITE_OK || *stmt == nullptr)
+    {
+        return result;
+    }
+
+    _statements.push_front({std::string(sql.substr(0, consumed)), *stmt});
+    _statementsByText[_statements.front().Text] = _statements.begin();
+
+    while (_statements.size() > _maxCachedStatements)
+    {
+        _statementsByText.erase(_statements.back().Text);
+        sqlite3_finalize(_statements.back().Statement);
+        _statements.pop_back();
+    }
+
+    return SQLITE_OK;
+}
+
+void SqliteConnection::ResetStatement(
+    sqlite3_stmt *stmt)
+{
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+}
+
+// The number of virtual machine steps between progress calls
+const int SqliteProgressSteps = 1000;
+
+int SqliteConnection::OnProgress(
+    void *context)
+{
+    auto connection = static_cast<SqliteConnection *>(context);
+
+    if (connection->_cancellationToken->IsCancellationRequested())
+    {
+        return 1;
+    }
+
+    connection->_vmSteps += SqliteProgressSteps;
+
+    // The clock is only read once every so many calls
+    if (connection->_vmSteps % (SqliteProgressSteps * 64) != 0)
+    {
+        return 0;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+
+    if (connection->_deadline != std::chrono::steady_clock::time_point() && now > connection->_deadline)
+    {
+        connection->_timedOut = true;
+
+        return 1;
+    }
+
+    if (now - connection->_lastReport >= std::chrono::milliseconds(250))
+    {
+        connection->_lastReport = now;
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - connection->_started).count();
+
+        connection->_cancellationToken->ReportProgress(
+            FormatLatency(static_cast<uint32_t>(std::min<long long>(elapsed, UINT32_MAX))) + ", " +
+            std::to_string(connection->_rowsRead) + " rows read, " +
+            std::to_string(sqlite3_total_changes64(connection->_db) - connection->_changesAtStart) + " rows changed, " +
+            std::to_string(connection->_vmSteps) + " VM steps");
+    }
+
+    return 0;
+}
+
+void SqliteConnection::SetCancellationToken(
+    const CancellationToken *cancellationToken,
+    std::chrono::milliseconds timeout)
+{
+    if (_cancellationToken != nullptr)
+    {
+        _cancellationToken->RemoveCancelCallback(_cancelCallbackId);
+    }
+
+    _cancellationToken = cancellationToken;
+
+    if (cancellationToken == nullptr)
+    {
+        sqlite3_progress_handler(_db, 0, nullptr, nullptr);
+        return;
+    }
+
+    _started = std::chrono::steady_clock::now();
+    _lastReport = _started;
+    _deadline = timeout.count() > 0 ? _started + timeout : std::chrono::steady_clock::time_point();
+    _timedOut = false;
+    _changesAtStart = sqlite3_total_changes64(_db);
+    _vmSteps = 0;
+    _rowsRead = 0;
+
+    sqlite3_progress_handler(_db, SqliteProgressSteps, OnProgress, this);
+
+    // Cancelling interrupts right away, not at the next progress call
+    auto db = _db;
+    _cancelCallbackId = cancellationToken->AddCancelCallback([db]() {
+        sqlite3_interrupt(db);
+    });
+}
+
+bool SqliteConnection::TimedOut() const
+{
+    return _timedOut;
+}
+
+void SqliteConnection::AddRowsRead(
+    size_t rows)
+{
+    _rowsRead += rows;
+}
+
+void SqliteConnection::EndTransaction()
+{
+    if (sqlite3_get_autocommit(_db) == 0)
+    {
+        sqlite3_exec(_db, "ROLLBACK", nullptr, nullptr, nullptr);
+    }
+}
+
+bool IsSqliteMemoryDatabase(
+    const std::string &connectionString)
+{
+    return connectionString.empty() ||
+           connectionString == ":memory:" ||
+           connectionString.rfind("file::memory:", 0) == 0 ||
+           connectionString.find("mode=memory") != std::string::npos;
+}
+
+bool SqliteWildcardMatch(
+    std::string_view pattern,
+    std::string_view name)
+{
+    size_t p = 0, n = 0;
+    size_t starAt = std::string_view::npos, starMatched = 0;
+
+    while (n < name.size())
+    {
+        if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n]))
+        {
+            p++;
+            n++;
+        }
+        else if (p < pattern.size() && pattern[p] == '*')
+        {
+            starAt = p++;
+            starMatched = n;
+        }
+        else if (starAt != std::string_view::npos)
+        {
+            // The last * takes one more character
+            p = starAt + 1;
+            n = ++starMatched;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    while (p < pattern.size() && pattern[p] == '*')
+    {
+        p++;
+    }
+
+    return p == pattern.size();
+}
+
+std::vector<std::string> ExpandSqliteConnectionStrings(
+    const std::string &connectionStrings)
+{
+    std::vector<std::string> result;
+
+    size_t start = 0;
+    while (start <= connectionStrings.size())
+    {
+        auto end = connectionStrings.find(',', start);
+        if (end == std::string::npos)
+        {
+            end = connectionStrings.size();
+        }
+
+        auto item = connectionStrings.substr(start, end - start);
+        start = end + 1;
+
+        auto first = item.find_first_not_of(" \t");
+        if (first == std::string::npos)
+        {
+            continue;
+        }
+        item = item.substr(first, item.find_last_not_of(" \t") - first + 1);
+
+        // The ? of a file: uri starts its parameters
+        auto path = std::filesystem::path(item);
+        auto fileName = path.filename().string();
+        if (item.rfind("file:", 0) == 0 || fileName.find_first_of("*?") == std::string::npos)
+        {
+            result.push_back(item);
+            continue;
+        }
+
+        auto directory = path.parent_path();
+        std::error_code error;
+        std::vector<std::string> matches;
+        for (auto &entry : std::filesystem::directory_iterator(directory.empty() ? "." : directory, error))
+        {
+            if (entry.is_regular_file(error) && SqliteWildcardMatch(fileName, entry.path().filename().string()))
+            {
+                matches.push_back((directory / entry.path().filename()).string());
+            }
+        }
+
+        std::sort(matches.begin(), matches.end());
+        result.insert(result.end(), matches.begin(), matches.end());
+    }
+
+    return result;
+}
+
+SqliteConnectionPool::SqliteConnectionPool() = default;
+
+SqliteConnectionPool::~SqliteConnectionPool() = default;
+
+std::unique_ptr<SqliteConnection> SqliteConnectionPool::Acquire(
+    const std::string &connectionString,
+    const std::string &session,
+    std::string &error)
+{
+    auto key = ConnectionKey(connectionString, session);
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        // A session has one connection, a run that starts while the previous
+        // run still has it waits for it, it would not see the same database otherwise
+        if (!session.empty())
+        {
+            _sessionReleased.wait(lock, [&]() { return _sessionsInUse.find(key) == _sessionsInUse.end(); });
+            _sessionsInUse[key] = false;
+        }
+
+        auto found = _idleConnections.find(key);
+        if (found != _idleConnections.end() && !found->second.empty())
+        {
+            auto connection = std::move(found->second.back());
+            found->second.pop_back();
+
+            return connection;
+        }
+    }
+
+    sqlite3 *db = nullptr;
+    auto openResult = sqlite3_open_v2(connectionString.c_str(), &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_URI, nullptr);
+    if (openResult != SQLITE_OK)
+    {
+        error = sqlite3_errstr(openResult);
+
+        // The handle is allocated even when opening fails
+        sqlite3_close(db);
+
+        if (!session.empty())
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _sessionsInUse.erase(key);
+            _sessionReleased.notify_all();
+        }
+
+        return nullptr;
+    }
+
+    return std::make_unique<SqliteConnection>(db, MaxCachedStatements);
+}
+
+void SqliteConnectionPool::Release(
+    const std::string &connectionString,
+    const std::string &session,
+    std::unique_ptr<SqliteConnection> connection)
+{
+    auto key = ConnectionKey(connectionString, session);
+
+    // Without a session every run starts outside of a transaction, a session
+    // can keep one open from one run to the next
+    if (session.empty())
+    {
+        connection->EndTransaction();
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    bool keep = session.empty() ? !IsSqliteMemoryDatabase(connectionString) : !_sessionsInUse[key];
+
+    if (!session.empty())
+    {
+        _sessionsInUse.erase(key);
+        _sessionReleased.notify_all();
+    }
+
+    auto &idle = _idleConnections[key];
+    if (keep && idle.size() < MaxIdleConnections)
+    {
+        idle.push_back(std::move(connection));
+    }
+}
+
+void SqliteConnectionPool::EndSession(
+    const std::string &session)
+{
+    if (session.empty())
+    {
+        return;
+    }
+
+    std::vector<std::unique_ptr<SqliteConnection>> closing;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        for (auto it = _idleConnections.begin(); it != _idleConnections.end();)
+        {
+            if (it->first.second == session)
+            {
+                std::move(it->second.begin(), it->second.end(), std::back_inserter(closing));
+                it = _idleConnections.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        // A connection that is in use is closed when it is released
+        for (auto &inUse : _sessionsInUse)
+        {
+            if (inUse.first.second == session)
+            {
+                inUse.second = true;
+            }
+        }
+    }
+}
+
+void SqliteConnectionPool::Clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _idleConnections.clear();
+}
@@ -0,0 +1,152 @@
+#ifndef SQLITECONNECTIONPOOL_HPP
+#define SQLITECONNECTIONPOOL_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct sqlite3;
+struct sqlite3_stmt;
+class CancellationToken;
+
+// An open sqlite database with the statements that were prepared on it, so a
+// script that runs again does not have to parse its statements again.
+class SqliteConnection
+{
+public:
+    SqliteConnection(
+        sqlite3 *db,
+        size_t maxCachedStatements);
+
+    virtual ~SqliteConnection();
+
+public:
+    sqlite3 *Handle() const;
+
+    // Prepares the first statement in sql, or takes it from the cache when the
+    // same statement text was prepared before. consumed is set to the number of
+    // characters of sql the statement used, stmt is nullptr for sql that only
+    // holds whitespace or comments. The statement is reset after its last step
+    // by ResetStatement, it stays owned by the connection.
+    int Prepare(
+        std::string_view sql,
+        sqlite3_stmt **stmt,
+        size_t &consumed);
+
+    void ResetStatement(
+        sqlite3_stmt *stmt);
+
+    // Statements running while a token is set are interrupted once it is
+    // cancelled, or once the token was set for longer than timeout when that
+    // is not zero. The rows read and the VM steps run so far are reported to
+    // the token as progress. nullptr removes the token again.
+    void SetCancellationToken(
+        const CancellationToken *cancellationToken,
+        std::chrono::milliseconds timeout = std::chrono::milliseconds(0));
+
+    // The statements were interrupted because the timeout passed
+    bool TimedOut() const;
+
+    // Counted by the runner for the progress, sqlite does not count them
+    void AddRowsRead(
+        size_t rows);
+
+    // Rolls back a transaction that a script left open
+    void EndTransaction();
+
+private:
+    struct CachedStatement
+    {
+        std::string Text;
+        sqlite3_stmt *Statement;
+    };
+
+    sqlite3 *_db;
+    size_t _maxCachedStatements;
+
+    const CancellationToken *_cancellationToken = nullptr;
+    size_t _cancelCallbackId = 0;
+    std::chrono::steady_clock::time_point _started;
+    std::chrono::steady_clock::time_point _deadline;
+    std::chrono::steady_clock::time_point _lastReport;
+    bool _timedOut = false;
+    long long _changesAtStart = 0;
+    unsigned long long _vmSteps = 0;
+    unsigned long long _rowsRead = 0;
+
+    // Called by sqlite every so many virtual machine steps, a non-zero result
+    // interrupts the statement that is running with SQLITE_INTERRUPT
+    static int OnProgress(
+        void *connection);
+
+    // Most recently used first
+    std::list<CachedStatement> _statements;
+    std::unordered_map<std::string_view, std::list<CachedStatement>::iterator> _statementsByText;
+};
+
+// Keeps sqlite databases open per connection string between runs. In-memory
+// databases are only kept for a session, they would otherwise lose all of
+// their content when they are closed.
+class SqliteConnectionPool
+{
+public:
+    SqliteConnectionPool();
+
+    virtual ~SqliteConnectionPool();
+
+public:
+    size_t MaxIdleConnections = 2;
+    size_t MaxCachedStatements = 64;
+
+public:
+    // Returns an idle or newly opened connection, nullptr with error set when
+    // the database can not be opened. A non-empty session gets the same
+    // connection on every run until EndSession is called.
+    std::unique_ptr<SqliteConnection> Acquire(
+        const std::string &connectionString,
+        const std::string &session,
+        std::string &error);
+
+    void Release(
+        const std::string &connectionString,
+        const std::string &session,
+        std::unique_ptr<SqliteConnection> connection);
+
+    // Closes the connections kept for the session
+    void EndSession(
+        const std::string &session);
+
+    void Clear();
+
+private:
+    typedef std::pair<std::string, std::string> ConnectionKey;
+
+    std::mutex _mutex;
+    std::condition_variable _sessionReleased;
+    std::map<ConnectionKey, std::vector<std::unique_ptr<SqliteConnection>>> _idleConnections;
+
+    // Sessions whose connection is in use, true when the session ended meanwhile
+    std::map<ConnectionKey, bool> _sessionsInUse;
+};
+
+// The text of the first complete statement in sql, all of it when the last
+// statement is not terminated
+std::string_view SqliteStatementText(
+    std::string_view sql);
+
+bool IsSqliteMemoryDatabase(
+    const std::string &connectionString);
+
+// Splits a comma separated list of connection strings and expands the ones
+// with * or ? in their file name to the files that match, in sorted order
+std::vector<std::string> ExpandSqliteConnectionStrings(
+    const std::string &connectionStrings);
+
+#endif // SQLITECONNECTIONPOOL_HPP
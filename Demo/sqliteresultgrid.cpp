@@ -0,0 +1,344 @@
+#include "sqliteresultgrid.hpp"
+
+#include <sqlite3.h>
+
+std::string_view SqliteColumnText(
+    sqlite3_stmt *ppStmt,
+    int col)
+{
+    auto text = reinterpret_cast<const char *>(sqlite3_column_text(ppStmt, col));
+    if (text == nullptr)
+    {
+        return std::string_view();
+    }
+
+    return std::string_view(text, size_t(sqlite3_column_bytes(ppStmt, col)));
+}
+
+void SqliteRowCells(
+    sqlite3_stmt *ppStmt,
+    const TableFormatter &formatter,
+    std::string &output)
+{
+    auto columnCount = formatter.Columns().size();
+
+    for (size_t col = 0; col < columnCount; col++)
+    {
+        formatter.WriteCell(col, SqliteColumnText(ppStmt, int(col)), output);
+    }
+
+    formatter.EndRow(output);
+}
+
+SqliteResultGrid::SqliteResultGrid(
+    SqliteConnectionPool &connectionPool,
+    const std::string &connectionString,
+    const std::string &session,
+    std::unique_ptr<SqliteConnection> connection,
+    const std::string &query,
+    const std::vector<TableColumn> &columns,
+    size_t rowsWritten)
+    : _connectionPool(connectionPool),
+      _connectionString(connectionString),
+      _session(session),
+      _query(query),
+      _formatter(columns),
+      _rowsWritten(rowsWritten),
+      _connection(std::move(connection)),
+      _useCursor(session.empty())
+{}
+
+SqliteResultGrid::~SqliteResultGrid()
+{
+    if (_countJob != nullptr)
+    {
+        _countJob->Cancel();
+        _countJob->Wait();
+    }
+
+    std::lock_guard<std::mutex> lock(_cursorMutex);
+    CloseCursor();
+}
+
+size_t SqliteResultGrid::RowsWritten() const
+{
+    return _rowsWritten;
+}
+
+long long SqliteResultGrid::RowCount() const
+{
+    return _rowCount;
+}
+
+bool SqliteResultGrid::Query(
+    const std::string &sql,
+    const std::function<void(sqlite3_stmt *)> &bind,
+    const std::function<void(sqlite3_stmt *)> &row,
+    const CancellationToken &cancellationToken)
+{
+    std::unique_lock<std::mutex> lock(_connectionMutex, std::defer_lock);
+    std::unique_ptr<SqliteConnection> pooled;
+    SqliteConnection *connection = _connection.get();
+
+    if (connection != nullptr)
+    {
+        lock.lock();
+    }
+    else
+    {
+        std::string openError;
+        pooled = _connectionPool.Acquire(_connectionString, _session, openError);
+        if (pooled == nullptr)
+        {
+            return false;
+        }
+        connection = pooled.get();
+    }
+
+    connection->SetCancellationToken(&cancellationToken);
+
+    sqlite3_stmt *ppStmt = nullptr;
+    size_t consumed = 0;
+    bool done = false;
+
+    if (connection->Prepare(sql, &ppStmt, consumed) == SQLITE_OK && ppStmt != nullptr)
+    {
+        bind(ppStmt);
+
+        int stepResult;
+        while ((stepResult = sqlite3_step(ppStmt)) == SQLITE_ROW)
+        {
+            row(ppStmt);
+        }
+
+        done = stepResult == SQLITE_DONE;
+
+        connection->ResetStatement(ppStmt);
+    }
+
+    connection->SetCancellationToken(nullptr);
+
+    if (pooled != nullptr)
+    {
+        _connectionPool.Release(_connectionString, _session, std::move(pooled));
+    }
+
+    return done;
+}
+
+bool SqliteJournalModeIsWal(
+    SqliteConnection &connection)
+{
+    sqlite3_stmt *ppStmt = nullptr;
+    size_t consumed = 0;
+    bool wal = false;
+
+    if (connection.Prepare("PRAGMA journal_mode", &ppStmt, consumed) == SQLITE_OK && ppStmt != nullptr)
+    {
+        if (sqlite3_step(ppStmt) == SQLITE_ROW)
+        {
+            wal = sqlite3_stricmp(reinterpret_cast<const char *>(sqlite3_column_text(ppStmt, 0)), "wal") == 0;
+        }
+
+        connection.ResetStatement(ppStmt);
+    }
+
+    return wal;
+}
+
+bool SqliteResultGrid::OpenCursor()
+{
+    if (_connection == nullptr)
+    {
+        std::string openError;
+        _cursorConnection = _connectionPool.Acquire(_connectionString, _session, openError);
+        if (_cursorConnection == nullptr)
+        {
+            return false;
+        }
+
+        // With a rollback journal the read lock of the cursor would keep
+        // every other connection from writing to the database
+        if (!SqliteJournalModeIsWal(*_cursorConnection))
+        {
+            _useCursor = false;
+            CloseCursor();
+
+            return false;
+        }
+    }
+
+    bool prepared;
+    {
+        std::unique_lock<std::mutex> lock(_connectionMutex, std::defer_lock);
+        auto connection = _cursorConnection.get();
+        if (connection == nullptr)
+        {
+            lock.lock();
+            connection = _connection.get();
+        }
+
+        size_t consumed = 0;
+        prepared = connection->Prepare("SELECT * FROM (\n" + _query + "\n)", &_cursor, consumed) == SQLITE_OK && _cursor != nullptr;
+    }
+
+    if (!prepared)
+    {
+        _cursor = nullptr;
+        CloseCursor();
+
+        return false;
+    }
+
+    _cursorRow = 0;
+
+    return true;
+}
+
+void SqliteResultGrid::CloseCursor()
+{
+    if (_cursor != nullptr)
+    {
+        if (_cursorConnection != nullptr)
+        {
+            _cursorConnection->ResetStatement(_cursor);
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lock(_connectionMutex);
+            _connection->ResetStatement(_cursor);
+        }
+
+        _cursor = nullptr;
+    }
+
+    if (_cursorConnection != nullptr)
+    {
+        _connectionPool.Release(_connectionString, _session, std::move(_cursorConnection));
+    }
+}
+
+size_t SqliteResultGrid::ReadRows(
+    size_t firstRow,
+    size_t count,
+    std::string &lines,
+    const CancellationToken &cancellationToken)
+{
+    std::lock_guard<std::mutex> cursorLock(_cursorMutex);
+
+    // Rows before the cursor are only read by starting over
+    if (_cursor != nullptr && firstRow < _cursorRow)
+    {
+        CloseCursor();
+    }
+
+    if (_useCursor && _cursor == nullptr)
+    {
+        OpenCursor();
+    }
+
+    if (_cursor == nullptr)
+    {
+        return ReadRowsWithOffset(firstRow, count, lines, cancellationToken);
+    }
+
+    lines.clear();
+    lines.reserve(count * _formatter.RowSize());
+    size_t rows = 0;
+    int stepResult = SQLITE_ROW;
+
+    {
+        std::unique_lock<std::mutex> lock(_connectionMutex, std::defer_lock);
+        auto connection = _cursorConnection.get();
+        if (connection == nullptr)
+        {
+            lock.lock();
+            connection = _connection.get();
+        }
+
+        connection->SetCancellationToken(&cancellationToken);
+
+        // The rows up to firstRow are stepped over without being formatted
+        while (_cursorRow < firstRow + count && (stepResult = sqlite3_step(_cursor)) == SQLITE_ROW)
+        {
+            if (_cursorRow >= firstRow)
+            {
+                SqliteRowCells(_cursor, _formatter, lines);
+                rows++;
+            }
+            _cursorRow++;
+        }
+
+        connection->SetCancellationToken(nullptr);
+    }
+
+    // A cursor that got to the end counted the rows, one that failed or was
+    // interrupted starts over on the next page
+    if (stepResult == SQLITE_DONE)
+    {
+        _rowCount = static_cast<long long>(_cursorRow);
+
+        if (_countJob != nullptr)
+        {
+            _countJob->Cancel();
+        }
+    }
+
+    if (stepResult != SQLITE_ROW)
+    {
+        CloseCursor();
+    }
+
+    return rows;
+}
+
+size_t SqliteResultGrid::ReadRowsWithOffset(
+    size_t firstRow,
+    size_t count,
+    std::string &lines,
+    const CancellationToken &cancellationToken)
+{
+    // The query is wrapped on lines of its own, it may end in a line comment
+    auto sql = "SELECT * FROM (\n" + _query + "\n) LIMIT ?1 OFFSET ?2";
+
+    lines.clear();
+    lines.reserve(count * _formatter.RowSize());
+    size_t rows = 0;
+
+    Query(
+        sql,
+        [&](sqlite3_stmt *ppStmt) {
+            sqlite3_bind_int64(ppStmt, 1, sqlite3_int64(count));
+            sqlite3_bind_int64(ppStmt, 2, sqlite3_int64(firstRow));
+        },
+        [&](sqlite3_stmt *ppStmt) {
+            SqliteRowCells(ppStmt, _formatter, lines);
+            rows++;
+        },
+        cancellationToken);
+
+    return rows;
+}
+
+void SqliteResultGrid::CountRows(
+    ExecutorService &executor)
+{
+    _countJob = executor.Submit(
+        [this](const CancellationToken &cancellationToken) {
+            long long rowCount = -1;
+
+            auto counted = Query(
+                "SELECT count(*) FROM (\n" + _query + "\n)",
+                [](sqlite3_stmt *) {},
+                [&](sqlite3_stmt *ppStmt) {
+                    rowCount = sqlite3_column_int64(ppStmt, 0);
+                },
+                cancellationToken);
+
+            if (counted)
+            {
+                _rowCount = rowCount;
+            }
+        },
+        JobPriority::Low);
+}
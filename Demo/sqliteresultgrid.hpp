@@ -0,0 +1,109 @@
+#ifndef SQLITERESULTGRID_HPP
+#define SQLITERESULTGRID_HPP
+
+#include "resultgrid.hpp"
+#include "sqliteconnectionpool.hpp"
+#include "tableformatter.hpp"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <string>
+#include <vector>
+
+// Pages through the rows of a query. Where a read transaction that stays open
+// does not keep anyone else from writing, on the connection the grid owns or
+// on a database in WAL mode, the statement is kept stepping from one page to
+// the next so reading on does not run the query again. A page before the one
+// read last runs the query again from its start. Otherwise, on a session
+// connection or a database with a rollback journal, every page is read with
+// LIMIT and OFFSET and nothing is held between pages.
+class SqliteResultGrid : public ResultGrid
+{
+public:
+    // A connection that is passed is used for every page instead of one from
+    // the pool, that is how an in-memory database outside of a session lives on
+    SqliteResultGrid(
+        SqliteConnectionPool &connectionPool,
+        const std::string &connectionString,
+        const std::string &session,
+        std::unique_ptr<SqliteConnection> connection,
+        const std::string &query,
+        const std::vector<TableColumn> &columns,
+        size_t rowsWritten);
+
+    // Stops counting and waits for it, and closes the cursor
+    virtual ~SqliteResultGrid();
+
+public:
+    size_t RowsWritten() const;
+
+    size_t ReadRows(
+        size_t firstRow,
+        size_t count,
+        std::string &lines,
+        const CancellationToken &cancellationToken);
+
+    long long RowCount() const;
+
+    // Counts the rows on a worker of executor, by running the query once
+    // more, unless the cursor gets to the last row first
+    void CountRows(
+        ExecutorService &executor);
+
+private:
+    SqliteConnectionPool &_connectionPool;
+    std::string _connectionString;
+    std::string _session;
+    std::string _query;
+    TableFormatter _formatter;
+    size_t _rowsWritten;
+    std::atomic<long long> _rowCount{-1};
+    std::shared_ptr<JobHandle> _countJob;
+
+    // The connection owned by the grid is used by one page or count at a time
+    std::mutex _connectionMutex;
+    std::unique_ptr<SqliteConnection> _connection;
+
+    // The statement that is kept between pages, on _connection or on
+    // _cursorConnection taken from the pool for it. _cursorRow is the row
+    // its next step returns.
+    std::mutex _cursorMutex;
+    bool _useCursor;
+    std::unique_ptr<SqliteConnection> _cursorConnection;
+    sqlite3_stmt *_cursor = nullptr;
+    size_t _cursorRow = 0;
+
+    // Prepares the cursor at the first row, false when there is none and
+    // _useCursor is cleared when there should not be one
+    bool OpenCursor();
+
+    void CloseCursor();
+
+    size_t ReadRowsWithOffset(
+        size_t firstRow,
+        size_t count,
+        std::string &lines,
+        const CancellationToken &cancellationToken);
+
+    // Runs the statement in sql on a connection, calling row for every row
+    bool Query(
+        const std::string &sql,
+        const std::function<void(sqlite3_stmt *)> &bind,
+        const std::function<void(sqlite3_stmt *)> &row,
+        const CancellationToken &cancellationToken);
+};
+
+// The text of a column of the current row, empty for NULL
+std::string_view SqliteColumnText(
+    sqlite3_stmt *ppStmt,
+    int col);
+
+// Writes the current row of ppStmt as one line of the result table
+void SqliteRowCells(
+    sqlite3_stmt *ppStmt,
+    const TableFormatter &formatter,
+    std::string &output);
+
+#endif // SQLITERESULTGRID_HPP
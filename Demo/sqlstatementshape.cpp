@@ -0,0 +1,298 @@
+#include "sqlstatementshape.hpp"
+
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+
+bool IsSqlIdentifierChar(
+    char c)
+{
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '$' || static_cast<unsigned char>(c) >= 0x80;
+}
+
+bool SqlKeywordEquals(
+    std::string_view word,
+    const char *keyword)
+{
+    size_t i = 0;
+    for (; i < word.size() && keyword[i] != '\0'; i++)
+    {
+        if (std::toupper(static_cast<unsigned char>(word[i])) != keyword[i])
+        {
+            return false;
+        }
+    }
+
+    return i == word.size() && keyword[i] == '\0';
+}
+
+// The end of the quoted text that starts at begin, which holds the quote
+size_t SqlQuotedEnd(
+    std::string_view sql,
+    size_t begin)
+{
+    auto close = sql[begin] == '[' ? ']' : sql[begin];
+
+    for (auto i = begin + 1; i < sql.size(); i++)
+    {
+        if (sql[i] == close)
+        {
+            // A doubled quote is part of the text
+            if (close != ']' && i + 1 < sql.size() && sql[i + 1] == close)
+            {
+                i++;
+                continue;
+            }
+
+            return i + 1;
+        }
+    }
+
+    return sql.size();
+}
+
+// The end of the comment at begin, begin itself when there is none
+size_t SqlCommentEnd(
+    std::string_view sql,
+    size_t begin)
+{
+    if (sql.substr(begin, 2) == "--")
+    {
+        auto end = sql.find('\n', begin);
+        return end == std::string_view::npos ? sql.size() : end;
+    }
+
+    if (sql.substr(begin, 2) == "/*")
+    {
+        auto end = sql.find("*/", begin + 2);
+        return end == std::string_view::npos ? sql.size() : end + 2;
+    }
+
+    return begin;
+}
+
+bool ParameterizeInsert(
+    std::string_view sql,
+    std::string &shape,
+    std::vector<SqlLiteral> &values)
+{
+    shape.clear();
+    values.clear();
+
+    bool firstWord = true;
+    bool inValues = false;
+    size_t i = 0;
+
+    while (i < sql.size())
+    {
+        auto c = sql[i];
+
+        auto commentEnd = SqlCommentEnd(sql, i);
+        if (commentEnd != i || std::isspace(static_cast<unsigned char>(c)))
+        {
+            auto end = commentEnd != i ? commentEnd : i + 1;
+
+            // Leading whitespace and comments are not part of the shape
+            if (!firstWord || !values.empty() || !shape.empty())
+            {
+                shape.append(sql.substr(i, end - i));
+            }
+            i = end;
+            continue;
+        }
+
+        if (c == '\'')
+        {
+            auto end = SqlQuotedEnd(sql, i);
+            bool blob = !shape.empty() && (shape.back() == 'x' || shape.back() == 'X') && (shape.size() == 1 || !IsSqlIdentifierChar(shape[shape.size() - 2]));
+
+            if (!inValues || blob || end > sql.size() || sql[end - 1] != '\'' || end - i < 2)
+            {
+                shape.append(sql.substr(i, end - i));
+                i = end;
+                continue;
+            }
+
+            SqlLiteral literal;
+            literal.Type = SqlLiteralType::Text;
+            for (auto j = i + 1; j + 1 < end; j++)
+            {
+                literal.Text.push_back(sql[j]);
+                if (sql[j] == '\'')
+                {
+                    j++;
+                }
+            }
+            values.push_back(std::move(literal));
+            shape.push_back('?');
+            i = end;
+            continue;
+        }
+
+        if (c == '"' || c == '`' || c == '[')
+        {
+            auto end = SqlQuotedEnd(sql, i);
+            shape.append(sql.substr(i, end - i));
+            i = end;
+            continue;
+        }
+
+        // Statements with parameters of their own are left as they are
+        if (c == '?' || ((c == ':' || c == '@' || c == '$') && i + 1 < sql.size() && IsSqlIdentifierChar(sql[i + 1]) && (shape.empty() || !IsSqlIdentifierChar(shape.back()))))
+        {
+            return false;
+        }
+
+        bool startsNumber = std::isdigit(static_cast<unsigned char>(c)) || (c == '.' && i + 1 < sql.size() && std::isdigit(static_cast<unsigned char>(sql[i + 1])));
+        if (startsNumber && (shape.empty() || !IsSqlIdentifierChar(shape.back())))
+        {
+            auto end = i;
+            bool real = false;
+            while (end < sql.size() && std::isdigit(static_cast<unsigned char>(sql[end])))
+            {
+                end++;
+            }
+            if (end < sql.size() && sql[end] == '.')
+            {
+                real = true;
+                end++;
+                while (end < sql.size() && std::isdigit(static_cast<unsigned char>(sql[end])))
+                {
+                    end++;
+                }
+            }
+            if (end < sql.size() && (sql[end] == 'e' || sql[end] == 'E'))
+            {
+                auto exponent = end + 1;
+                if (exponent < sql.size() && (sql[exponent] == '+' || sql[exponent] == '-'))
+                {
+                    exponent++;
+                }
+                if (exponent < sql.size() && std::isdigit(static_cast<unsigned char>(sql[exponent])))
+                {
+                    real = true;
+                    end = exponent;
+                    while (end < sql.size() && std::isdigit(static_cast<unsigned char>(sql[end])))
+                    {
+                        end++;
+                    }
+                }
+            }
+
+            auto text = std::string(sql.substr(i, end - i));
+
+            // Hexadecimal numbers and numbers followed by letters stay as they are
+            bool plain = inValues && (end >= sql.size() || !IsSqlIdentifierChar(sql[end]));
+
+            SqlLiteral literal;
+            errno = 0;
+            if (real)
+            {
+                literal.Type = SqlLiteralType::Real;
+                literal.Real = std::strtod(text.c_str(), nullptr);
+            }
+            else
+            {
+                literal.Type = SqlLiteralType::Integer;
+                literal.Integer = std::strtoll(text.c_str(), nullptr, 10);
+            }
+
+            // An integer too large for 64 bits is read as a real by sqlite
+            if (!plain || errno == ERANGE)
+            {
+                while (end < sql.size() && IsSqlIdentifierChar(sql[end]))
+                {
+                    end++;
+                }
+                shape.append(sql.substr(i, end - i));
+                i = end;
+                continue;
+            }
+
+            values.push_back(std::move(literal));
+            shape.push_back('?');
+            i = end;
+            continue;
+        }
+
+        if (IsSqlIdentifierChar(c))
+        {
+            auto end = i;
+            while (end < sql.size() && IsSqlIdentifierChar(sql[end]))
+            {
+                end++;
+            }
+
+            auto word = sql.substr(i, end - i);
+
+            if (firstWord && !SqlKeywordEquals(word, "INSERT") && !SqlKeywordEquals(word, "REPLACE"))
+            {
+                return false;
+            }
+            firstWord = false;
+
+            // Literals in a SELECT can be column numbers, as in ORDER BY 1
+            if (SqlKeywordEquals(word, "SELECT"))
+            {
+                return false;
+            }
+
+            if (SqlKeywordEquals(word, "VALUES"))
+            {
+                inValues = true;
+            }
+
+            shape.append(word);
+            i = end;
+            continue;
+        }
+
+        if (firstWord)
+        {
+            return false;
+        }
+
+        shape.push_back(c);
+        i++;
+    }
+
+    return !values.empty();
+}
+
+std::vector<std::string> SqlLeadingWords(
+    std::string_view sql,
+    size_t count)
+{
+    std::vector<std::string> words;
+    size_t i = 0;
+
+    while (i < sql.size() && words.size() < count)
+    {
+        auto commentEnd = SqlCommentEnd(sql, i);
+        if (commentEnd != i)
+        {
+            i = commentEnd;
+            continue;
+        }
+
+        if (!IsSqlIdentifierChar(sql[i]))
+        {
+            if (!std::isspace(static_cast<unsigned char>(sql[i])))
+            {
+                break;
+            }
+            i++;
+            continue;
+        }
+
+        std::string word;
+        while (i < sql.size() && IsSqlIdentifierChar(sql[i]))
+        {
+            word.push_back(static_cast<char>(std::toupper(static_cast<unsigned char>(sql[i]))));
+            i++;
+        }
+        words.push_back(word);
+    }
+
+    return words;
+}
@@ -0,0 +1,37 @@
+#ifndef SQLSTATEMENTSHAPE_HPP
+#define SQLSTATEMENTSHAPE_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class SqlLiteralType
+{
+    Integer,
+    Real,
+    Text,
+};
+
+struct SqlLiteral
+{
+    SqlLiteralType Type = SqlLiteralType::Text;
+    long long Integer = 0;
+    double Real = 0;
+    std::string Text;
+};
+
+// Replaces the number and string literals in the VALUES of an INSERT with
+// parameters, so INSERTs that only differ in their values share a prepared
+// statement. Returns false for any other statement, for an INSERT with a
+// SELECT or parameters of its own and for one without literals.
+bool ParameterizeInsert(
+    std::string_view sql,
+    std::string &shape,
+    std::vector<SqlLiteral> &values);
+
+// The first words of a statement in upper case, skipping whitespace and comments
+std::vector<std::string> SqlLeadingWords(
+    std::string_view sql,
+    size_t count);
+
+#endif // SQLSTATEMENTSHAPE_HPP
@@ -1,6 +1,8 @@
 #include "stringhelpers.hpp"
 
+#include <iomanip>
 #include <regex>
+#include <sstream>
 
 bool ichar_equals(char a, char b)
 {
@@ -169,3 +171,24 @@ std::string escaped(
 
     return output;
 }
+
+std::string FormatLatency(
+    uint32_t microseconds)
+{
+    std::stringstream ss;
+
+    if (microseconds < 1000)
+    {
+        ss << microseconds << " us";
+    }
+    else if (microseconds < 1000000)
+    {
+        ss << std::fixed << std::setprecision(2) << (microseconds / 1000.0) << " ms";
+    }
+    else
+    {
+        ss << std::fixed << std::setprecision(2) << (microseconds / 1000000.0) << " s";
+    }
+
+    return ss.str();
+}
@@ -1,6 +1,8 @@
 #ifndef STRINGHELPERS_HPP
 #define STRINGHELPERS_HPP
 
+#include <cstdint>
+#include <cstdlib>
 #include <map>
 #include <string>
 #include <vector>
@@ -41,4 +43,25 @@ std::vector<std::string> split_string(
 std::string escaped(
     const std::string &input);
 
+// Formats a duration as us, ms or s, whichever reads best
+std::string FormatLatency(
+    uint32_t microseconds);
+
+template <class T>
+T HeaderNumber(
+    const std::map<std::string, std::string> &headers,
+    const char *key,
+    T fallBackValue)
+{
+    auto header = headers.find(key);
+    if (header == headers.end())
+    {
+        return fallBackValue;
+    }
+
+    auto value = (T)std::atoll(header->second.c_str());
+
+    return value;
+}
+
 #endif // STRINGHELPERS_HPP
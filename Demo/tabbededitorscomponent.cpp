@@ -92,6 +92,7 @@ void TabbedEditorsComponent::loadFile(
 
     editorLayer->openFile = std::filesystem::path(fileName);
     editorLayer->title = editorLayer->openFile.filename().generic_string();
+    editorLayer->setLexerForFile(editorLayer->openFile);
     editorLayer->loadContent(buffer.str());
 
     tabs.push_back(std::move(editorLayer));
@@ -147,6 +148,8 @@ void TabbedEditorsComponent::closeTab(
         return;
     }
 
+    _fileRunnerService->EndSession(tabs[index]->title);
+
     if (index == 0)
     {
         tabs.erase(tabs.begin());
@@ -216,6 +219,19 @@ void TabbedEditorsComponent::finishTabSwitch()
     }
 }
 
+// A tab that is running something shows how far it got after its title
+std::string TabText(
+    EditorComponent &tab)
+{
+    auto progress = tab.runProgress();
+    if (progress.empty())
+    {
+        return tab.title;
+    }
+
+    return tab.title + " (" + progress + ")";
+}
+
 void TabbedEditorsComponent::RenderTab(
     const struct InputState &inputState,
     const std::string &text,
@@ -333,7 +349,7 @@ void TabbedEditorsComponent::render(
 
             bool isActiveTab = tabs[_activeTab] == tab;
 
-            RenderTab(inputState, tab->title, x, y, isActiveTab);
+            RenderTab(inputState, TabText(*tab), x, y, isActiveTab);
 
             if (isActiveTab)
             {
@@ -706,7 +722,7 @@ bool TabbedEditorsComponent::handleMouseButtonInput(
         for (size_t i = 0; i < tabs.size(); i++)
         {
             const auto &tab = tabs[i];
-            auto border = GetBorderRectangle(tab->title, x, y);
+            auto border = GetBorderRectangle(TabText(*tab), x, y);
 
             if (border.Contains(mouse))
             {
@@ -0,0 +1,245 @@
+#include "tableformatter.hpp"
+
+#include <algorithm>
+
+size_t Utf8Length(
+    std::string_view text)
+{
+    size_t length = 0;
+
+    for (auto c : text)
+    {
+        // Continuation bytes do not start a character
+        if ((static_cast<unsigned char>(c) & 0xc0) != 0x80)
+        {
+            length++;
+        }
+    }
+
+    return length;
+}
+
+// The number of bytes the first characters of text take
+size_t Utf8Prefix(
+    std::string_view text,
+    size_t characters)
+{
+    size_t i = 0;
+
+    for (; i < text.size(); i++)
+    {
+        if ((static_cast<unsigned char>(text[i]) & 0xc0) != 0x80)
+        {
+            if (characters == 0)
+            {
+                break;
+            }
+            characters--;
+        }
+    }
+
+    return i;
+}
+
+TableFormatter::TableFormatter(
+    const std::vector<TableColumn> &columns)
+    : _columns(columns)
+{}
+
+TableFormatter::~TableFormatter() = default;
+
+const std::vector<TableColumn> &TableFormatter::Columns() const
+{
+    return _columns;
+}
+
+size_t TableFormatter::RowSize() const
+{
+    size_t size = 3;
+
+    for (auto &column : _columns)
+    {
+        size += column.Width + 3;
+    }
+
+    return size;
+}
+
+void TableFormatter::WriteHeader(
+    std::string &output) const
+{
+    for (size_t col = 0; col < _columns.size(); col++)
+    {
+        // Names are not aligned with their values
+        output.append(col == 0 ? "| " : " | ");
+
+        auto length = Utf8Length(_columns[col].Name);
+        output.append(_columns[col].Name);
+        output.append(_columns[col].Width - std::min(length, _columns[col].Width), ' ');
+    }
+
+    output.append(" |\n");
+
+    for (size_t col = 0; col < _columns.size(); col++)
+    {
+        output.append(col == 0 ? "+-" : "-+-");
+        output.append(_columns[col].Width, '-');
+    }
+
+    output.append("-+\n");
+}
+
+void TableFormatter::WriteCell(
+    size_t column,
+    std::string_view value,
+    std::string &output) const
+{
+    auto &format = _columns[column];
+
+    if (column == 0)
+    {
+        output.append("| ", 2);
+    }
+    else
+    {
+        output.append(" | ", 3);
+    }
+
+    // Characters are counted and line breaks looked for in one pass
+    size_t length = 0;
+    bool hasControl = false;
+    for (auto c : value)
+    {
+        auto byte = static_cast<unsigned char>(c);
+        length += (byte & 0xc0) != 0x80;
+        hasControl |= byte < 0x20;
+    }
+
+    // A number that is cut off reads as another number, one that is wider
+    // than its column pushes the rest of its row to the right instead
+    bool cut = length > format.Width && !format.AlignRight;
+
+    if (cut)
+    {
+        auto kept = format.Width > 2 ? format.Width - 2 : 0;
+        value = value.substr(0, Utf8Prefix(value, kept));
+        length = kept + 2;
+    }
+
+    auto padding = format.Width - std::min(length, format.Width);
+
+    if (format.AlignRight && padding > 0)
+    {
+        output.append(padding, ' ');
+    }
+
+    auto start = output.size();
+    output.append(value.data(), value.size());
+
+    // A row has to stay on one line
+    if (hasControl)
+    {
+        std::replace_if(
+            output.begin() + start,
+            output.end(),
+            [](char c) { return c == '\n' || c == '\r' || c == '\t'; },
+            ' ');
+    }
+
+    if (cut)
+    {
+        output.append("..", std::min<size_t>(2, format.Width));
+    }
+
+    if (!format.AlignRight && padding > 0)
+    {
+        output.append(padding, ' ');
+    }
+}
+
+void TableFormatter::EndRow(
+    std::string &output) const
+{
+    output.append(" |\n");
+}
+
+TableSampler::TableSampler(
+    const std::vector<std::string> &names,
+    size_t maxWidth)
+    : _maxWidth(maxWidth),
+      _hasNumbers(names.size()),
+      _hasText(names.size())
+{
+    for (auto &name : names)
+    {
+        TableColumn column;
+        column.Name = name;
+        column.Width = Utf8Length(name);
+        _columns.push_back(column);
+    }
+}
+
+TableSampler::~TableSampler() = default;
+
+void TableSampler::AddCell(
+    std::string_view value,
+    bool isNumber,
+    bool isNull)
+{
+    auto col = _valueEnds.size() % _columns.size();
+
+    _values.append(value);
+    _valueEnds.push_back(_values.size());
+
+    _columns[col].Width = std::max(_columns[col].Width, std::min(Utf8Length(value), _maxWidth));
+
+    if (!isNull)
+    {
+        if (isNumber)
+        {
+            _hasNumbers[col] = true;
+        }
+        else
+        {
+            _hasText[col] = true;
+        }
+    }
+}
+
+size_t TableSampler::RowCount() const
+{
+    return _columns.empty() ? 0 : _valueEnds.size() / _columns.size();
+}
+
+std::vector<TableColumn> TableSampler::Columns() const
+{
+    auto columns = _columns;
+
+    for (size_t col = 0; col < columns.size(); col++)
+    {
+        columns[col].AlignRight = _hasNumbers[col] && !_hasText[col];
+    }
+
+    return columns;
+}
+
+void TableSampler::WriteRows(
+    const TableFormatter &formatter,
+    std::string &output) const
+{
+    output.reserve(output.size() + RowCount() * formatter.RowSize() + _values.size());
+
+    size_t start = 0;
+    for (size_t i = 0; i < _valueEnds.size(); i++)
+    {
+        auto col = i % _columns.size();
+
+        formatter.WriteCell(col, std::string_view(_values).substr(start, _valueEnds[i] - start), output);
+        start = _valueEnds[i];
+
+        if (col + 1 == _columns.size())
+        {
+            formatter.EndRow(output);
+        }
+    }
+}
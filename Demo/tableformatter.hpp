@@ -0,0 +1,91 @@
+#ifndef TABLEFORMATTER_HPP
+#define TABLEFORMATTER_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct TableColumn
+{
+    std::string Name;
+    // In characters, not bytes
+    size_t Width = 0;
+    bool AlignRight = false;
+};
+
+// Writes the rows of a result table straight into an output string, text
+// wider than its column is cut off with "..".
+class TableFormatter
+{
+public:
+    TableFormatter(
+        const std::vector<TableColumn> &columns);
+
+    virtual ~TableFormatter();
+
+public:
+    const std::vector<TableColumn> &Columns() const;
+
+    // The number of bytes a row takes when its values are ASCII
+    size_t RowSize() const;
+
+    // The column names and the line under them
+    void WriteHeader(
+        std::string &output) const;
+
+    // Values are written one after the other, from the first column to the last
+    void WriteCell(
+        size_t column,
+        std::string_view value,
+        std::string &output) const;
+
+    void EndRow(
+        std::string &output) const;
+
+private:
+    std::vector<TableColumn> _columns;
+};
+
+// Picks column widths from a sample of the rows, no wider than maxWidth unless
+// the column name is. Columns that only hold numbers are aligned right.
+class TableSampler
+{
+public:
+    TableSampler(
+        const std::vector<std::string> &names,
+        size_t maxWidth);
+
+    virtual ~TableSampler();
+
+public:
+    // Values are added one after the other, from the first column to the last
+    void AddCell(
+        std::string_view value,
+        bool isNumber,
+        bool isNull);
+
+    size_t RowCount() const;
+
+    std::vector<TableColumn> Columns() const;
+
+    // Writes the sampled rows as formatted by formatter
+    void WriteRows(
+        const TableFormatter &formatter,
+        std::string &output) const;
+
+private:
+    std::vector<TableColumn> _columns;
+    size_t _maxWidth;
+    std::vector<bool> _hasNumbers;
+    std::vector<bool> _hasText;
+
+    // The sampled values, one after the other
+    std::string _values;
+    std::vector<size_t> _valueEnds;
+};
+
+// The number of characters in UTF-8 encoded text
+size_t Utf8Length(
+    std::string_view text);
+
+#endif // TABLEFORMATTER_HPP
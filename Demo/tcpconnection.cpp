@@ -0,0 +1,236 @@
+#include "tcpconnection.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <mutex>
+
+#pragma comment(lib, "ws2_32.lib")
+
+const SOCKET InvalidSocket = INVALID_SOCKET;
+
+void CloseTcpSocket(
+    SOCKET socket)
+{
+    ::closesocket(socket);
+}
+
+int PollTcpSocket(
+    SOCKET socket)
+{
+    WSAPOLLFD descriptor = {};
+    descriptor.fd = socket;
+    descriptor.events = POLLRDNORM;
+
+    return WSAPoll(&descriptor, 1, 0);
+}
+
+const int TcpSendFlags = 0;
+const int TcpShutdownBoth = SD_BOTH;
+#else
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+const int InvalidSocket = -1;
+
+void CloseTcpSocket(
+    int socket)
+{
+    ::close(socket);
+}
+
+int PollTcpSocket(
+    int socket)
+{
+    pollfd descriptor = {};
+    descriptor.fd = socket;
+    descriptor.events = POLLIN;
+
+    return poll(&descriptor, 1, 0);
+}
+
+const int TcpSendFlags = MSG_NOSIGNAL;
+const int TcpShutdownBoth = SHUT_RDWR;
+#endif
+
+TcpConnection::TcpConnection()
+    : _socket(InvalidSocket),
+      _buffer(65536)
+{}
+
+TcpConnection::~TcpConnection()
+{
+    Close();
+}
+
+bool TcpConnection::Open(
+    const std::string &host,
+    int port,
+    std::string &error)
+{
+#ifdef _WIN32
+    static std::once_flag started;
+    std::call_once(started, []() {
+        WSADATA data;
+        WSAStartup(MAKEWORD(2, 2), &data);
+    });
+#endif
+
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo *addresses = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0)
+    {
+        error = "could not resolve " + host;
+        return false;
+    }
+
+    for (auto address = addresses; address != nullptr; address = address->ai_next)
+    {
+        _socket = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (_socket == InvalidSocket)
+        {
+            continue;
+        }
+
+        if (::connect(_socket, address->ai_addr, static_cast<int>(address->ai_addrlen)) == 0)
+        {
+            break;
+        }
+
+        CloseTcpSocket(_socket);
+        _socket = InvalidSocket;
+    }
+
+    freeaddrinfo(addresses);
+
+    if (_socket == InvalidSocket)
+    {
+        error = "could not connect to " + host + ":" + std::to_string(port);
+        return false;
+    }
+
+    // Commands are written in one piece so there is nothing to gain from Nagle
+    int noDelay = 1;
+    setsockopt(_socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&noDelay), sizeof(noDelay));
+
+    _bufferStart = _bufferEnd = 0;
+
+    return true;
+}
+
+void TcpConnection::Close()
+{
+    if (_socket != InvalidSocket)
+    {
+        CloseTcpSocket(_socket);
+        _socket = InvalidSocket;
+    }
+}
+
+bool TcpConnection::IsOpen() const
+{
+    return _socket != InvalidSocket;
+}
+
+bool TcpConnection::IsStale()
+{
+    if (_socket == InvalidSocket)
+    {
+        return true;
+    }
+
+    // An idle connection has nothing to read, anything there is either the
+    // server closing the connection or data that does not belong to a command
+    return _bufferStart != _bufferEnd || PollTcpSocket(_socket) != 0;
+}
+
+bool TcpConnection::Write(
+    const char *data,
+    size_t size)
+{
+    while (size > 0)
+    {
+        auto written = ::send(_socket, data, static_cast<int>(std::min<size_t>(size, 1 << 30)), TcpSendFlags);
+#ifndef _WIN32
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+#endif
+        if (written <= 0)
+        {
+            return false;
+        }
+
+        data += written;
+        size -= written;
+    }
+
+    return true;
+}
+
+bool TcpConnection::ReadExactly(
+    char *buffer,
+    size_t size)
+{
+    while (size > 0)
+    {
+        if (_bufferStart == _bufferEnd)
+        {
+            // Large reads go straight into the buffer of the caller
+            auto target = size >= _buffer.size() ? buffer : _buffer.data();
+            auto capacity = size >= _buffer.size() ? size : _buffer.size();
+
+            auto received = ::recv(_socket, target, static_cast<int>(std::min<size_t>(capacity, 1 << 30)), 0);
+#ifndef _WIN32
+            if (received < 0 && errno == EINTR)
+            {
+                continue;
+            }
+#endif
+            if (received <= 0)
+            {
+                return false;
+            }
+
+            if (target == buffer)
+            {
+                buffer += received;
+                size -= received;
+                continue;
+            }
+
+            _bufferStart = 0;
+            _bufferEnd = static_cast<size_t>(received);
+        }
+
+        auto available = std::min(size, _bufferEnd - _bufferStart);
+        std::memcpy(buffer, _buffer.data() + _bufferStart, available);
+
+        _bufferStart += available;
+        buffer += available;
+        size -= available;
+    }
+
+    return true;
+}
+
+void TcpConnection::Shutdown()
+{
+    if (_socket != InvalidSocket)
+    {
+        ::shutdown(_socket, TcpShutdownBoth);
+    }
+}
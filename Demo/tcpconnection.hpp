@@ -0,0 +1,54 @@
+#ifndef TCPCONNECTION_HPP
+#define TCPCONNECTION_HPP
+
+#include <string>
+#include <vector>
+
+// A plain TCP connection for the database protocols, reads are buffered so
+// a protocol can read its packets a few bytes at a time.
+class TcpConnection
+{
+public:
+    TcpConnection();
+
+    virtual ~TcpConnection();
+
+public:
+    bool Open(
+        const std::string &host,
+        int port,
+        std::string &error);
+
+    void Close();
+
+    bool IsOpen() const;
+
+    // True when the server closed the connection or sent data while it was idle
+    bool IsStale();
+
+    bool Write(
+        const char *data,
+        size_t size);
+
+    // Reads exactly size bytes, false when the connection closed before that
+    bool ReadExactly(
+        char *buffer,
+        size_t size);
+
+    // Makes a read that is waiting, on another thread, return
+    void Shutdown();
+
+private:
+#ifdef _WIN32
+    typedef unsigned long long Socket;
+#else
+    typedef int Socket;
+#endif
+
+    Socket _socket;
+    std::vector<char> _buffer;
+    size_t _bufferStart = 0;
+    size_t _bufferEnd = 0;
+};
+
+#endif // TCPCONNECTION_HPP
@@ -0,0 +1,200 @@
+#include "httpstandin.hpp"
+
+#include "stringhelpers.hpp"
+#include <cstdlib>
+
+// How often the threads of the stand-in look whether it is stopping
+const int HttpStandInPollMilliseconds = 50;
+
+const std::string HttpStandIn::Body = "{\"ok\":true}";
+
+HttpStandIn::HttpStandIn()
+    : _listener(InvalidStandInSocket)
+{
+    _listener = ListenOnLoopback(_port);
+    if (_listener == InvalidStandInSocket)
+    {
+        Fail("could not listen on a loopback port");
+        return;
+    }
+
+    _thread = std::thread([this]() { Serve(); });
+}
+
+HttpStandIn::~HttpStandIn()
+{
+    _stopping = true;
+    if (_thread.joinable())
+    {
+        _thread.join();
+    }
+
+    // Serve has ended, nothing adds connections anymore
+    for (auto &connection : _connections)
+    {
+        connection.join();
+    }
+
+    if (_listener != InvalidStandInSocket)
+    {
+        CloseStandInSocket(_listener);
+    }
+}
+
+int HttpStandIn::Port() const
+{
+    return _port;
+}
+
+int HttpStandIn::ConnectionCount()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return _connectionCount;
+}
+
+int HttpStandIn::RequestCount()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return _requestCount;
+}
+
+size_t HttpStandIn::ContentBytes()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return _contentBytes;
+}
+
+std::vector<std::string> HttpStandIn::Failures()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return _failures;
+}
+
+void HttpStandIn::Fail(
+    const std::string &failure)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _failures.push_back(failure);
+}
+
+void HttpStandIn::Serve()
+{
+    while (WaitReadable(_listener))
+    {
+        auto socket = AcceptOnStandInSocket(_listener);
+        if (socket == InvalidStandInSocket)
+        {
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _connectionCount++;
+        _connections.emplace_back([this, socket]() {
+            ServeConnection(socket);
+            CloseStandInSocket(socket);
+        });
+    }
+}
+
+void HttpStandIn::ServeConnection(
+    Socket socket)
+{
+    std::string received;
+    char buffer[4096];
+
+    while (true)
+    {
+        // A request is its head up to the blank line and the content after it
+        auto headEnd = received.find("\r\n\r\n");
+        size_t contentLength = 0;
+        if (headEnd != std::string::npos)
+        {
+            for (auto &line : split_string(received.substr(0, headEnd), "\r\n"))
+            {
+                auto colon = line.find(':');
+                if (colon != std::string::npos && iequals(trim_copy(line.substr(0, colon)), "Content-Length"))
+                {
+                    contentLength = std::strtoul(line.c_str() + colon + 1, nullptr, 10);
+                }
+            }
+        }
+
+        if (headEnd == std::string::npos || received.size() < headEnd + 4 + contentLength)
+        {
+            if (!WaitReadable(socket))
+            {
+                return;
+            }
+
+            auto count = ReceiveFromStandInSocket(socket, buffer, sizeof(buffer));
+            if (count <= 0)
+            {
+                if (!received.empty())
+                {
+                    Fail("the connection was closed in the middle of a request");
+                }
+                return;
+            }
+
+            received.append(buffer, count);
+            continue;
+        }
+
+        auto requestLine = received.substr(0, received.find("\r\n"));
+        received.erase(0, headEnd + 4 + contentLength);
+
+        auto parts = split_string(requestLine, " ");
+        if (parts.size() != 3 || parts[2] != "HTTP/1.1")
+        {
+            Fail("the request line '" + requestLine + "'");
+            return;
+        }
+
+        int status = 200;
+        if (parts[1].compare(0, 8, "/status/") == 0)
+        {
+            status = std::atoi(parts[1].c_str() + 8);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _requestCount++;
+            _contentBytes += contentLength;
+        }
+
+        auto response = "HTTP/1.1 " + std::to_string(status) + " Stand-In\r\n"
+                        "Content-Type: application/json\r\n"
+                        "Content-Length: " + std::to_string(Body.size()) + "\r\n"
+                        "\r\n" + Body;
+
+        if (!SendToStandInSocket(socket, response))
+        {
+            Fail("could not send the response to " + requestLine);
+            return;
+        }
+    }
+}
+
+bool HttpStandIn::WaitReadable(
+    Socket socket)
+{
+    while (!_stopping)
+    {
+        auto ready = PollStandInSocket(socket, HttpStandInPollMilliseconds);
+        if (ready > 0)
+        {
+            return true;
+        }
+        if (ready < 0)
+        {
+            return false;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,63 @@
+#ifndef HTTPSTANDIN_HPP
+#define HTTPSTANDIN_HPP
+
+#include "standinsocket.hpp"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Stands in for a web server on a loopback port. Every connection is kept
+// alive and served on a thread of its own. GET /status/<code> answers with
+// that status, any other request with 200, both with Body.
+class HttpStandIn
+{
+public:
+    HttpStandIn();
+
+    virtual ~HttpStandIn();
+
+public:
+    static const std::string Body;
+
+    int Port() const;
+
+    int ConnectionCount();
+
+    int RequestCount();
+
+    // The bytes of request content received, over all requests
+    size_t ContentBytes();
+
+    std::vector<std::string> Failures();
+
+private:
+    typedef StandInSocket Socket;
+
+    Socket _listener;
+    int _port = 0;
+    std::atomic<bool> _stopping{false};
+    std::thread _thread;
+
+    std::mutex _mutex;
+    std::vector<std::thread> _connections;
+    int _connectionCount = 0;
+    int _requestCount = 0;
+    size_t _contentBytes = 0;
+    std::vector<std::string> _failures;
+
+    void Serve();
+
+    void ServeConnection(
+        Socket socket);
+
+    void Fail(
+        const std::string &failure);
+
+    // Waits for data while checking whether the stand-in is stopping
+    bool WaitReadable(
+        Socket socket);
+};
+
+#endif // HTTPSTANDIN_HPP
@@ -0,0 +1,236 @@
+#include "filerunnerservice.hpp"
+#include "httpstandin.hpp"
+#include "stringhelpers.hpp"
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+int FailureCount = 0;
+
+void Check(
+    bool condition,
+    const std::string &what)
+{
+    if (!condition)
+    {
+        std::cerr << "FAILED: " << what << std::endl;
+        FailureCount++;
+    }
+}
+
+void CheckStandIn(
+    HttpStandIn &standIn,
+    const std::string &what)
+{
+    for (auto &failure : standIn.Failures())
+    {
+        Check(false, what + ": " + failure);
+    }
+}
+
+typedef std::vector<std::vector<std::string>> Table;
+
+// The rows of the table in the output whose header starts with firstHeader,
+// the header included, with the spaces around the cells removed
+Table ReadTable(
+    const std::string &output,
+    const std::string &firstHeader)
+{
+    Table table;
+
+    std::istringstream lines(output);
+    std::string line;
+    while (std::getline(lines, line))
+    {
+        if (line.compare(0, 2, "| ") != 0)
+        {
+            if (!table.empty() && line.compare(0, 2, "+-") != 0)
+            {
+                break;
+            }
+            continue;
+        }
+
+        auto cells = split_string(line.substr(1, line.size() - 2), "|");
+        for (auto &cell : cells)
+        {
+            cell = trim_copy(cell);
+        }
+
+        if (table.empty() && (cells.empty() || cells.front() != firstHeader))
+        {
+            continue;
+        }
+
+        table.push_back(cells);
+    }
+
+    return table;
+}
+
+// The cell of the first row below the header of the table, by its column
+std::string Cell(
+    const Table &table,
+    const std::string &column)
+{
+    if (table.size() < 2)
+    {
+        return std::string();
+    }
+
+    for (size_t col = 0; col < table[0].size() && col < table[1].size(); col++)
+    {
+        if (table[0][col] == column)
+        {
+            return table[1][col];
+        }
+    }
+
+    return std::string();
+}
+
+// The second cell of the row that starts with label
+std::string Row(
+    const Table &table,
+    const std::string &label)
+{
+    for (auto &row : table)
+    {
+        if (row.size() > 1 && row[0] == label)
+        {
+            return row[1];
+        }
+    }
+
+    return std::string();
+}
+
+std::string LoadTestFile(
+    int port,
+    const std::string &request,
+    const std::string &headers)
+{
+    return request.substr(0, request.find(' ') + 1) + "http://127.0.0.1:" + std::to_string(port) + request.substr(request.find(' ') + 1) + "\n" + headers;
+}
+
+// Every request is counted once, by the load test and by the server, and
+// the clients keep their connections open between their requests. The
+// bytes stay below a kilobyte so they are shown as they are.
+void TestRequests()
+{
+    HttpStandIn standIn;
+    FileRunnerService fileRunner;
+
+    auto output = fileRunner.Execute("load.http", LoadTestFile(standIn.Port(), "POST /echo", "-- Concurrency: 4\n-- Requests: 80\n-- Content-Type: text/plain\n\nhello\n"));
+
+    CheckStandIn(standIn, "requests");
+
+    auto summary = ReadTable(output, "Requests");
+    Check(Cell(summary, "Requests") == "80", "requests: 80 requests in\n" + output);
+    Check(Cell(summary, "Completed") == "80", "requests: 80 completed in\n" + output);
+    Check(Cell(summary, "Failed") == "0", "requests: none failed in\n" + output);
+    auto received = std::to_string(80 * HttpStandIn::Body.size()) + " B (";
+    Check(Cell(summary, "Received").compare(0, received.size(), received) == 0, "requests: the bodies were received in\n" + output);
+    Check(Cell(summary, "Sent") == std::to_string(standIn.ContentBytes()) + " B", "requests: the contents were sent in\n" + output);
+
+    Check(Row(ReadTable(output, "Status"), "200") == "80", "requests: 80 responses with status 200 in\n" + output);
+    Check(ReadTable(output, "Latency").size() == 2, "requests: the latencies in\n" + output);
+    Check(ReadTable(output, "Latency up to").size() > 1, "requests: the histogram in\n" + output);
+
+    Check(standIn.RequestCount() == 80, "requests: the server got 80, not " + std::to_string(standIn.RequestCount()));
+    Check(standIn.ContentBytes() > 0 && standIn.ContentBytes() % 80 == 0, "requests: the server got the content of each");
+    Check(standIn.ConnectionCount() <= 4, "requests: the clients used their connections again, " + std::to_string(standIn.ConnectionCount()) + " were opened");
+}
+
+// Without Requests the clients keep sending until the time is up
+void TestDuration()
+{
+    HttpStandIn standIn;
+    FileRunnerService fileRunner;
+
+    auto started = std::chrono::steady_clock::now();
+    auto output = fileRunner.Execute("load.http", LoadTestFile(standIn.Port(), "GET /", "-- Concurrency: 2\n-- Duration: 300ms\n"));
+    auto elapsed = std::chrono::steady_clock::now() - started;
+
+    CheckStandIn(standIn, "duration");
+
+    auto summary = ReadTable(output, "Requests");
+    auto completed = std::atoi(Cell(summary, "Completed").c_str());
+    Check(completed > 0 && completed == standIn.RequestCount(), "duration: the completed requests are the ones the server got in\n" + output);
+    Check(Cell(summary, "Failed") == "0", "duration: none failed in\n" + output);
+    Check(elapsed >= std::chrono::milliseconds(300) && elapsed < std::chrono::seconds(5), "duration: it ran for the duration");
+}
+
+// Responses that are errors are counted by their status, they are not failures
+void TestStatusCodes()
+{
+    HttpStandIn standIn;
+    FileRunnerService fileRunner;
+
+    auto output = fileRunner.Execute("load.http", LoadTestFile(standIn.Port(), "GET /status/503", "-- Requests: 10\n"));
+
+    CheckStandIn(standIn, "status codes");
+    Check(Cell(ReadTable(output, "Requests"), "Failed") == "0", "status codes: none failed in\n" + output);
+    Check(Row(ReadTable(output, "Status"), "503") == "10", "status codes: 10 responses with status 503 in\n" + output);
+}
+
+// Requests to a port nobody listens on get no response
+void TestNoResponse()
+{
+    int port = 0;
+    auto socket = ListenOnLoopback(port);
+    CloseStandInSocket(socket);
+
+    FileRunnerService fileRunner;
+
+    auto output = fileRunner.Execute("load.http", LoadTestFile(port, "GET /", "-- Requests: 5\n"));
+
+    auto summary = ReadTable(output, "Requests");
+    Check(Cell(summary, "Completed") == "0", "no response: none completed in\n" + output);
+    Check(Cell(summary, "Failed") == "5", "no response: all failed in\n" + output);
+    Check(Row(ReadTable(output, "Status"), "No response") == "5", "no response: counted as such in\n" + output);
+}
+
+// Cancelling ends the test early with what was measured until then
+void TestCancellation()
+{
+    HttpStandIn standIn;
+    FileRunnerService fileRunner;
+
+    std::mutex outputMutex;
+    std::string output;
+    auto job = fileRunner.ExecuteAsync("load.http", LoadTestFile(standIn.Port(), "GET /", "-- Concurrency: 2\n-- Duration: 30s\n"), [&](std::string_view text) {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        output.append(text);
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    job->Cancel();
+    Check(job->WaitFor(std::chrono::seconds(5)), "cancellation: the run ended");
+
+    CheckStandIn(standIn, "cancellation");
+
+    std::lock_guard<std::mutex> lock(outputMutex);
+    Check(output.find("Cancelled, results so far") != std::string::npos, "cancellation: the output says so in\n" + output);
+    Check(std::atoi(Cell(ReadTable(output, "Requests"), "Completed").c_str()) > 0, "cancellation: the requests until then in\n" + output);
+}
+
+int main()
+{
+    TestRequests();
+    TestDuration();
+    TestStatusCodes();
+    TestNoResponse();
+    TestCancellation();
+
+    if (FailureCount > 0)
+    {
+        std::cerr << FailureCount << " failed" << std::endl;
+        return 1;
+    }
+
+    std::cout << "passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,149 @@
+#include "filerunnerservice.hpp"
+#include "tdsstandin.hpp"
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+// The responses are written the way SQL Server 2019 sends them: an
+// unencrypted prelogin, a login to master, and a batch that returns one int
+// column named n
+const char *PreloginResponse = "00 001a 0006 01 0020 0001 02 0021 0001 03 0022 0000 04 0022 0001 ff 10000fa30000 02 00 00";
+
+const char *LoginResponse =
+    "e3 1b00 01 066d0061007300740065007200 066d0061007300740065007200"
+    "ab 6000 45160000 02 00 2500 4300680061006e00670065006400200064006100740061006200610073006500200063006f006e0074006500780074002000"
+    "74006f00200027006d006100730074006500720027002e00 04530051004c003100 00 01000000"
+    "ad 3200 01 74000004 14 4d006900630072006f0073006f00660074002000530051004c002000530065007200760065007200 10000fa3"
+    "e3 1300 04 043400300039003600 043400300039003600"
+    "fd 0000 0000 0000000000000000";
+
+const char *DoneAttentionResponse = "fd 2000 0000 0000000000000000";
+
+int FailureCount = 0;
+
+void Check(
+    bool condition,
+    const std::string &what)
+{
+    if (!condition)
+    {
+        std::cerr << "FAILED: " << what << std::endl;
+        FailureCount++;
+    }
+}
+
+void CheckStandIn(
+    TdsStandIn &standIn,
+    size_t scriptSize,
+    const std::string &what)
+{
+    Check(standIn.WaitForPosition(scriptSize, std::chrono::seconds(5)), what + ": the client went through the script");
+    for (auto &failure : standIn.Failures())
+    {
+        Check(false, what + ": " + failure);
+    }
+}
+
+std::string MssqlScript(
+    const TdsStandIn &standIn,
+    const std::string &sql)
+{
+    return "-- mssql Server=127.0.0.1," + std::to_string(standIn.Port()) + ";User Id=sa;Password=secret\n\n" + sql;
+}
+
+// A SELECT of a number as n, with its one row and the DONE that counts it
+TdsExchange SelectExchange(
+    int value)
+{
+    char row[9];
+    snprintf(row, sizeof(row), "%02x%02x%02x%02x", value & 0xFF, (value >> 8) & 0xFF, (value >> 16) & 0xFF, (value >> 24) & 0xFF);
+
+    TdsExchange exchange;
+    exchange.RequestType = TdsSqlBatch;
+    exchange.Sql = "SELECT " + std::to_string(value) + " AS n";
+    exchange.Response = std::string("81 0100 00000000 0900 26 04 01 6e00 d1 04") + row + "fd 1000 c100 0100000000000000";
+
+    return exchange;
+}
+
+std::vector<TdsExchange> LoginExchanges()
+{
+    return {
+        {TdsPrelogin, "", PreloginResponse},
+        {TdsLogin7, "", LoginResponse},
+    };
+}
+
+// Batches end at lines with only GO on them, "GO 2" runs the one before it
+// twice, and all of them go over the connection that logged in
+void TestGoBatches()
+{
+    auto script = LoginExchanges();
+    script.push_back(SelectExchange(1));
+    script.push_back(SelectExchange(2));
+    script.push_back(SelectExchange(2));
+    script.push_back(SelectExchange(3));
+
+    TdsStandIn standIn(script);
+    FileRunnerService fileRunner;
+
+    auto output = fileRunner.Execute("go.sql", MssqlScript(standIn, "SELECT 1 AS n\nGO\nSELECT 2 AS n\n  GO 2\ngo -- the last one\nSELECT 3 AS n\n"));
+
+    CheckStandIn(standIn, script.size(), "GO batches");
+    Check(output.find("Error") == std::string::npos, "GO batches: no errors in\n" + output);
+    Check(standIn.ConnectionCount() == 1, "GO batches: one connection");
+}
+
+// Cancelling sends an attention, and the connection goes back to the pool
+// once the server acknowledged it
+void TestCancellation()
+{
+    auto script = LoginExchanges();
+    script.push_back({TdsSqlBatch, "WAITFOR DELAY '00:01:00'", ""});
+    script.push_back({TdsAttention, "", DoneAttentionResponse});
+    script.push_back(SelectExchange(5));
+
+    TdsStandIn standIn(script);
+    FileRunnerService fileRunner;
+
+    std::mutex outputMutex;
+    std::string output;
+    auto job = fileRunner.ExecuteAsync("cancel.sql", MssqlScript(standIn, "WAITFOR DELAY '00:01:00'\nGO\nSELECT 5 AS n\n"), [&](std::string_view text) {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        output.append(text);
+    });
+
+    Check(standIn.WaitForPosition(3, std::chrono::seconds(5)), "cancellation: the batch was sent");
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    job->Cancel();
+    Check(job->WaitFor(std::chrono::seconds(5)), "cancellation: the run ended");
+    Check(standIn.WaitForPosition(4, std::chrono::seconds(5)), "cancellation: the attention was sent");
+
+    {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        Check(output.find("Cancelled") != std::string::npos, "cancellation: the output says so in\n" + output);
+        Check(output.find("Error") == std::string::npos, "cancellation: no errors in\n" + output);
+    }
+
+    output = fileRunner.Execute("cancel.sql", MssqlScript(standIn, "SELECT 5 AS n\n"));
+
+    CheckStandIn(standIn, script.size(), "cancellation");
+    Check(output.find("Error") == std::string::npos, "cancellation: no errors after it in\n" + output);
+    Check(standIn.ConnectionCount() == 1, "cancellation: the connection was used again");
+}
+
+int main()
+{
+    TestGoBatches();
+    TestCancellation();
+
+    if (FailureCount > 0)
+    {
+        std::cerr << FailureCount << " failed" << std::endl;
+        return 1;
+    }
+
+    std::cout << "passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,460 @@
+#include "mysqlstandin.hpp"
+
+#include "stringhelpers.hpp"
+#include <algorithm>
+
+// The nonce of every greeting, with the scramble the password gives for it:
+// SHA1(password) XOR SHA1(nonce + SHA1(SHA1(password))), worked out apart
+// from the client so the stand-in does not check the client against itself
+const char *const MysqlStandInNonce = "0123456789abcdefghij";
+const char *const MysqlStandInScramble = "f5cac3f3b3df2133feb57db682c71e6ed433a988";
+
+// Protocol 4.1, secure connection, transactions, multi statements and results, plugin auth
+const uint32_t MysqlStandInCapabilities = 0x000ba200;
+
+// How often the threads of the stand-in look whether it is stopping
+const int MysqlStandInPollMilliseconds = 50;
+
+void AppendMysqlStandInInt(
+    std::string &output,
+    uint64_t value,
+    size_t bytes)
+{
+    for (size_t i = 0; i < bytes; i++)
+    {
+        output.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+}
+
+void AppendMysqlStandInString(
+    std::string &output,
+    const std::string &value)
+{
+    // The scripts only hold short values, a one byte length is enough
+    output.push_back(static_cast<char>(value.size()));
+    output.append(value);
+}
+
+std::string MysqlStandInHex(
+    const std::string &bytes)
+{
+    const char *digits = "0123456789abcdef";
+
+    std::string hex;
+    for (auto c : bytes)
+    {
+        hex.push_back(digits[static_cast<uint8_t>(c) >> 4]);
+        hex.push_back(digits[static_cast<uint8_t>(c) & 0x0f]);
+    }
+
+    return hex;
+}
+
+std::string MysqlStandInOk(
+    uint64_t affectedRows,
+    uint16_t status)
+{
+    std::string packet(1, '\x00');
+    AppendMysqlStandInInt(packet, affectedRows, 1);
+    AppendMysqlStandInInt(packet, 0, 1);
+    AppendMysqlStandInInt(packet, status, 2);
+    AppendMysqlStandInInt(packet, 0, 2);
+
+    return packet;
+}
+
+std::string MysqlStandInEof(
+    uint16_t status)
+{
+    std::string packet(1, '\xfe');
+    AppendMysqlStandInInt(packet, 0, 2);
+    AppendMysqlStandInInt(packet, status, 2);
+
+    return packet;
+}
+
+std::string MysqlStandInError(
+    uint16_t code,
+    const std::string &state,
+    const std::string &message)
+{
+    std::string packet(1, '\xff');
+    AppendMysqlStandInInt(packet, code, 2);
+
+    return packet + "#" + state + message;
+}
+
+std::string MysqlStandInColumn(
+    const std::string &name,
+    uint8_t type)
+{
+    std::string packet;
+    AppendMysqlStandInString(packet, "def");
+    AppendMysqlStandInString(packet, "");
+    AppendMysqlStandInString(packet, "");
+    AppendMysqlStandInString(packet, "");
+    AppendMysqlStandInString(packet, name);
+    AppendMysqlStandInString(packet, name);
+    packet.push_back(0x0c);
+    AppendMysqlStandInInt(packet, 45, 2);
+    AppendMysqlStandInInt(packet, 255, 4);
+    AppendMysqlStandInInt(packet, type, 1);
+    AppendMysqlStandInInt(packet, 0, 2);
+    AppendMysqlStandInInt(packet, 0, 1);
+    AppendMysqlStandInInt(packet, 0, 2);
+
+    return packet;
+}
+
+std::string MysqlStandInTextRow(
+    const std::vector<const char *> &values)
+{
+    std::string packet;
+    for (auto value : values)
+    {
+        if (value == nullptr)
+        {
+            packet.push_back('\xfb');
+        }
+        else
+        {
+            AppendMysqlStandInString(packet, value);
+        }
+    }
+
+    return packet;
+}
+
+MysqlStandIn::MysqlStandIn(
+    const std::vector<MysqlExchange> &script)
+    : _script(script),
+      _listener(InvalidStandInSocket)
+{
+    _listener = ListenOnLoopback(_port);
+    if (_listener == InvalidStandInSocket)
+    {
+        Fail("could not listen on a loopback port");
+        return;
+    }
+
+    _thread = std::thread([this]() { Serve(); });
+}
+
+MysqlStandIn::~MysqlStandIn()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _changed.notify_all();
+
+    if (_thread.joinable())
+    {
+        _thread.join();
+    }
+
+    // Serve has ended, nothing adds connections anymore
+    for (auto &connection : _connections)
+    {
+        connection.join();
+    }
+
+    if (_listener != InvalidStandInSocket)
+    {
+        CloseStandInSocket(_listener);
+    }
+}
+
+int MysqlStandIn::Port() const
+{
+    return _port;
+}
+
+size_t MysqlStandIn::Position()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return _position;
+}
+
+bool MysqlStandIn::WaitForPosition(
+    size_t count,
+    std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    return _changed.wait_for(lock, timeout, [this, count]() { return _position >= count; });
+}
+
+void MysqlStandIn::Resume()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _resumed = true;
+    }
+    _changed.notify_all();
+}
+
+int MysqlStandIn::ConnectionCount()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return _connectionCount;
+}
+
+std::vector<std::string> MysqlStandIn::Failures()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return _failures;
+}
+
+void MysqlStandIn::Fail(
+    const std::string &failure)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _failures.push_back(failure);
+}
+
+void MysqlStandIn::Serve()
+{
+    while (WaitReadable(_listener))
+    {
+        auto socket = AcceptOnStandInSocket(_listener);
+        if (socket == InvalidStandInSocket)
+        {
+            continue;
+        }
+
+        // Thread ids are counted from 1, like a server that just started
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto threadId = static_cast<uint32_t>(++_connectionCount);
+        _connections.emplace_back([this, socket, threadId]() {
+            if (LogIn(socket, threadId))
+            {
+                ServeConnection(socket, threadId);
+            }
+            CloseStandInSocket(socket);
+        });
+    }
+}
+
+bool MysqlStandIn::LogIn(
+    Socket socket,
+    uint32_t threadId)
+{
+    std::string greeting(1, '\x0a');
+    greeting.append("8.0.36-stand-in");
+    greeting.push_back('\0');
+    AppendMysqlStandInInt(greeting, threadId, 4);
+    greeting.append(MysqlStandInNonce, 8);
+    greeting.push_back('\0');
+    AppendMysqlStandInInt(greeting, MysqlStandInCapabilities & 0xffff, 2);
+    AppendMysqlStandInInt(greeting, 45, 1);
+    AppendMysqlStandInInt(greeting, 0x0002, 2);
+    AppendMysqlStandInInt(greeting, MysqlStandInCapabilities >> 16, 2);
+    AppendMysqlStandInInt(greeting, 21, 1);
+    greeting.append(10, '\0');
+    greeting.append(MysqlStandInNonce + 8);
+    greeting.push_back('\0');
+    greeting.append("mysql_native_password");
+    greeting.push_back('\0');
+
+    uint8_t sequence = 0;
+    std::string response;
+    if (!WritePacket(socket, sequence, greeting) || !ReadPacket(socket, sequence, response))
+    {
+        Fail("the client did not answer the greeting");
+        return false;
+    }
+
+    // Capabilities, maximum packet size, character set and 23 reserved bytes,
+    // then the user and the length encoded scramble
+    size_t pos = 32;
+    auto userEnd = response.find('\0', pos);
+    if (userEnd == std::string::npos || userEnd + 1 >= response.size())
+    {
+        Fail("a handshake response of " + std::to_string(response.size()) + " bytes");
+        return false;
+    }
+
+    auto user = response.substr(pos, userEnd - pos);
+    auto scrambleLength = static_cast<uint8_t>(response[userEnd + 1]);
+    auto scramble = MysqlStandInHex(response.substr(userEnd + 2, scrambleLength));
+
+    if (user != MysqlStandInUser || scramble != MysqlStandInScramble)
+    {
+        // Kept before the error goes out, the client can be done with it first
+        Fail("the login of '" + user + "' with the scramble " + scramble);
+        WritePacket(socket, sequence, MysqlStandInError(1045, "28000", "Access denied for user '" + user + "'"));
+        return false;
+    }
+
+    return WritePacket(socket, sequence, MysqlStandInOk());
+}
+
+void MysqlStandIn::ServeConnection(
+    Socket socket,
+    uint32_t threadId)
+{
+    uint8_t sequence = 0;
+    std::string payload;
+    while (ReadPacket(socket, sequence, payload))
+    {
+        auto command = static_cast<uint8_t>(payload[0]);
+
+        // Closing the connection is not part of a script
+        if (command == 0x01)
+        {
+            return;
+        }
+
+        size_t position;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            position = _position;
+        }
+
+        if (position >= _script.size())
+        {
+            Fail("command " + std::to_string(command) + " after the end of the script");
+            return;
+        }
+
+        auto &exchange = _script[position];
+        if (command != exchange.Command)
+        {
+            Fail("expected command " + std::to_string(exchange.Command) + " at " + std::to_string(position) + ", got " + std::to_string(command));
+            return;
+        }
+
+        auto sql = trim_copy(payload.substr(1));
+        if ((command == MysqlQueryCommand || command == MysqlPrepareCommand) && sql != exchange.Sql)
+        {
+            Fail("expected '" + exchange.Sql + "' at " + std::to_string(position) + ", got '" + sql + "'");
+            return;
+        }
+
+        // Counted before the response goes out, the client can be done with
+        // it before the stand-in is done sending it
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _position++;
+
+            if (command == MysqlQueryCommand && sql.compare(0, 11, "KILL QUERY ") == 0)
+            {
+                _killed.insert(static_cast<uint32_t>(std::stoul(sql.substr(11))));
+            }
+        }
+        _changed.notify_all();
+
+        for (size_t i = 0; i < exchange.Packets.size() || i == exchange.HoldAt; i++)
+        {
+            if (i == exchange.HoldAt && WaitForResume(threadId))
+            {
+                WritePacket(socket, sequence, MysqlStandInError(1317, "70100", "Query execution was interrupted"));
+                break;
+            }
+
+            if (i < exchange.Packets.size() && !WritePacket(socket, sequence, exchange.Packets[i]))
+            {
+                Fail("could not send the response at " + std::to_string(position));
+                return;
+            }
+        }
+    }
+}
+
+bool MysqlStandIn::WaitForResume(
+    uint32_t threadId)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    _changed.wait(lock, [this, threadId]() { return _resumed || _killed.count(threadId) > 0 || _stopping; });
+    _resumed = false;
+
+    return _killed.count(threadId) > 0;
+}
+
+bool MysqlStandIn::WaitReadable(
+    Socket socket)
+{
+    while (!_stopping)
+    {
+        auto ready = PollStandInSocket(socket, MysqlStandInPollMilliseconds);
+        if (ready > 0)
+        {
+            return true;
+        }
+        if (ready < 0)
+        {
+            return false;
+        }
+    }
+
+    return false;
+}
+
+bool MysqlStandIn::ReadExactly(
+    Socket socket,
+    char *buffer,
+    size_t size)
+{
+    while (size > 0)
+    {
+        if (!WaitReadable(socket))
+        {
+            return false;
+        }
+
+        auto received = ReceiveFromStandInSocket(socket, buffer, size);
+        if (received <= 0)
+        {
+            return false;
+        }
+
+        buffer += received;
+        size -= received;
+    }
+
+    return true;
+}
+
+bool MysqlStandIn::ReadPacket(
+    Socket socket,
+    uint8_t &sequence,
+    std::string &payload)
+{
+    // The scripts have no packets of 16 MB, so every payload is one packet
+    char header[4];
+    if (!ReadExactly(socket, header, sizeof(header)))
+    {
+        return false;
+    }
+
+    size_t length = static_cast<uint8_t>(header[0]) | (static_cast<uint8_t>(header[1]) << 8) | (static_cast<uint8_t>(header[2]) << 16);
+    if (length == 0)
+    {
+        Fail("an empty packet");
+        return false;
+    }
+
+    sequence = static_cast<uint8_t>(header[3] + 1);
+    payload.resize(length);
+
+    return ReadExactly(socket, &payload[0], length);
+}
+
+bool MysqlStandIn::WritePacket(
+    Socket socket,
+    uint8_t &sequence,
+    const std::string &payload)
+{
+    std::string packet;
+    AppendMysqlStandInInt(packet, payload.size(), 3);
+    packet.push_back(static_cast<char>(sequence++));
+    packet.append(payload);
+
+    return SendToStandInSocket(socket, packet);
+}
@@ -0,0 +1,146 @@
+#ifndef MYSQLSTANDIN_HPP
+#define MYSQLSTANDIN_HPP
+
+#include "standinsocket.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+const uint8_t MysqlQueryCommand = 0x03;
+const uint8_t MysqlPrepareCommand = 0x16;
+const uint8_t MysqlExecuteCommand = 0x17;
+const uint8_t MysqlCloseCommand = 0x19;
+
+// The user the stand-in lets in, with mysql_native_password
+const char *const MysqlStandInUser = "root";
+const char *const MysqlStandInPassword = "secret";
+
+// A command the client is expected to send and the packets the server answers it with
+struct MysqlExchange
+{
+    uint8_t Command = 0;
+    // For a query or a prepare the SQL it carries
+    std::string Sql;
+    // The payloads of the response packets, the stand-in numbers them. None
+    // are sent for commands the server does not answer, like closing a statement.
+    std::vector<std::string> Packets;
+    // The response stops after this many packets until Resume is called. A
+    // KILL QUERY for the connection ends it with an error instead.
+    size_t HoldAt = SIZE_MAX;
+};
+
+// Stands in for MySQL on a loopback port. Every connection is served on a
+// thread of its own, logged in and then given the exchanges of the script
+// in the order the commands arrive. What the client sends that the script
+// does not expect is kept as a failure, and ends the connection it came on.
+class MysqlStandIn
+{
+public:
+    MysqlStandIn(
+        const std::vector<MysqlExchange> &script);
+
+    virtual ~MysqlStandIn();
+
+public:
+    int Port() const;
+
+    // How many exchanges of the script the client went through
+    size_t Position();
+
+    // Waits until the client went through the first count exchanges,
+    // false when it did not within timeout
+    bool WaitForPosition(
+        size_t count,
+        std::chrono::milliseconds timeout);
+
+    // Sends the rest of a response that was held
+    void Resume();
+
+    int ConnectionCount();
+
+    std::vector<std::string> Failures();
+
+private:
+    typedef StandInSocket Socket;
+
+    std::vector<MysqlExchange> _script;
+    Socket _listener;
+    int _port = 0;
+    std::atomic<bool> _stopping{false};
+    std::thread _thread;
+
+    std::mutex _mutex;
+    std::condition_variable _changed;
+    std::vector<std::thread> _connections;
+    size_t _position = 0;
+    int _connectionCount = 0;
+    bool _resumed = false;
+    // The thread ids of connections whose query was killed
+    std::set<uint32_t> _killed;
+    std::vector<std::string> _failures;
+
+    void Serve();
+
+    void ServeConnection(
+        Socket socket,
+        uint32_t threadId);
+
+    bool LogIn(
+        Socket socket,
+        uint32_t threadId);
+
+    // Waits until the held response can go on, true when it was killed instead
+    bool WaitForResume(
+        uint32_t threadId);
+
+    void Fail(
+        const std::string &failure);
+
+    // Waits for data while checking whether the stand-in is stopping
+    bool WaitReadable(
+        Socket socket);
+
+    bool ReadExactly(
+        Socket socket,
+        char *buffer,
+        size_t size);
+
+    bool ReadPacket(
+        Socket socket,
+        uint8_t &sequence,
+        std::string &payload);
+
+    bool WritePacket(
+        Socket socket,
+        uint8_t &sequence,
+        const std::string &payload);
+};
+
+// Payloads of the packets a server sends, for the scripts
+std::string MysqlStandInOk(
+    uint64_t affectedRows = 0,
+    uint16_t status = 0x0002);
+
+std::string MysqlStandInEof(
+    uint16_t status = 0x0002);
+
+std::string MysqlStandInError(
+    uint16_t code,
+    const std::string &state,
+    const std::string &message);
+
+std::string MysqlStandInColumn(
+    const std::string &name,
+    uint8_t type);
+
+// A row of the text protocol, a value of nullptr is NULL
+std::string MysqlStandInTextRow(
+    const std::vector<const char *> &values);
+
+#endif // MYSQLSTANDIN_HPP
@@ -0,0 +1,226 @@
+#include "filerunnerservice.hpp"
+#include "mysqlstandin.hpp"
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+// Column types as the server sends them
+const uint8_t MysqlLongType = 3;
+const uint8_t MysqlLongLongType = 8;
+const uint8_t MysqlNullType = 6;
+const uint8_t MysqlVarStringType = 253;
+
+int FailureCount = 0;
+
+void Check(
+    bool condition,
+    const std::string &what)
+{
+    if (!condition)
+    {
+        std::cerr << "FAILED: " << what << std::endl;
+        FailureCount++;
+    }
+}
+
+void CheckStandIn(
+    MysqlStandIn &standIn,
+    size_t scriptSize,
+    const std::string &what)
+{
+    Check(standIn.WaitForPosition(scriptSize, std::chrono::seconds(5)), what + ": the client went through the script");
+    for (auto &failure : standIn.Failures())
+    {
+        Check(false, what + ": " + failure);
+    }
+}
+
+std::string MysqlScript(
+    const MysqlStandIn &standIn,
+    const std::string &sql,
+    const std::string &headers = "",
+    const std::string &password = MysqlStandInPassword)
+{
+    return "-- mysql Server=127.0.0.1;Port=" + std::to_string(standIn.Port()) + ";Uid=" + MysqlStandInUser + ";Pwd=" + password + "\n" + headers + "\n" + sql;
+}
+
+// Rows of the text protocol, NULLs included, and a second run with an
+// update and an error that reuses the connection of the first one
+void TestTextResults()
+{
+    std::vector<MysqlExchange> script = {
+        {MysqlQueryCommand,
+         "SELECT 1 AS n, 'a' AS s, NULL AS z",
+         {"\x03",
+          MysqlStandInColumn("n", MysqlLongLongType),
+          MysqlStandInColumn("s", MysqlVarStringType),
+          MysqlStandInColumn("z", MysqlNullType),
+          MysqlStandInEof(),
+          MysqlStandInTextRow({"1", "apple", nullptr}),
+          MysqlStandInTextRow({"2", "banana", "x"}),
+          MysqlStandInEof()}},
+        {MysqlQueryCommand,
+         "UPDATE fruit SET n = n + 1; SELECT * FROM nope",
+         {MysqlStandInOk(2, 0x000a),
+          MysqlStandInError(1146, "42S02", "Table 'shop.nope' doesn't exist")}},
+    };
+
+    MysqlStandIn standIn(script);
+    FileRunnerService fileRunner;
+
+    auto output = fileRunner.Execute("text.sql", MysqlScript(standIn, "SELECT 1 AS n, 'a' AS s, NULL AS z\n"));
+
+    Check(output.find("apple") != std::string::npos && output.find("banana") != std::string::npos, "text results: the rows in\n" + output);
+    Check(output.find("| apple  |   |") != std::string::npos, "text results: the NULL as an empty cell in\n" + output);
+    Check(output.find("Error") == std::string::npos, "text results: no errors in\n" + output);
+
+    output = fileRunner.Execute("text.sql", MysqlScript(standIn, "UPDATE fruit SET n = n + 1; SELECT * FROM nope\n"));
+
+    CheckStandIn(standIn, script.size(), "text results");
+    Check(output.find("(2 rows affected)") != std::string::npos, "text results: the update in\n" + output);
+    Check(output.find("Error: ERROR 1146 (42S02): Table 'shop.nope' doesn't exist") != std::string::npos, "text results: the error in\n" + output);
+    Check(standIn.ConnectionCount() == 1, "text results: the connection was used again");
+}
+
+// Rows after the sample are written while the rest of them are still on
+// their way, the stand-in holds them back until the first ones are shown
+void TestStreaming()
+{
+    const int rowCount = 5000;
+    const int heldAfter = 4000;
+
+    MysqlExchange exchange;
+    exchange.Command = MysqlQueryCommand;
+    exchange.Sql = "SELECT n, label FROM numbers";
+    exchange.Packets = {"\x02", MysqlStandInColumn("n", MysqlLongType), MysqlStandInColumn("label", MysqlVarStringType), MysqlStandInEof()};
+    for (int n = 1; n <= rowCount; n++)
+    {
+        auto value = std::to_string(n);
+        auto label = "row " + value + " of the numbers that stream in";
+        exchange.Packets.push_back(MysqlStandInTextRow({value.c_str(), label.c_str()}));
+    }
+    exchange.Packets.push_back(MysqlStandInEof());
+    exchange.HoldAt = 4 + heldAfter;
+
+    MysqlStandIn standIn({exchange});
+    FileRunnerService fileRunner;
+
+    std::mutex outputMutex;
+    std::string output;
+    auto job = fileRunner.ExecuteAsync("stream.sql", MysqlScript(standIn, "SELECT n, label FROM numbers\n"), [&](std::string_view text) {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        output.append(text);
+    });
+
+    bool shown = false;
+    for (int i = 0; i < 100 && !shown; i++)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        std::lock_guard<std::mutex> lock(outputMutex);
+        shown = output.find("row 2000 ") != std::string::npos;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        Check(shown, "streaming: rows were shown before all of them arrived");
+        Check(output.find("row " + std::to_string(heldAfter + 1) + " ") == std::string::npos, "streaming: no rows that were held back");
+    }
+
+    standIn.Resume();
+    Check(job->WaitFor(std::chrono::seconds(5)), "streaming: the run ended");
+
+    CheckStandIn(standIn, 1, "streaming");
+
+    std::lock_guard<std::mutex> lock(outputMutex);
+    Check(output.find("row " + std::to_string(rowCount) + " ") != std::string::npos, "streaming: the last row");
+    Check(output.find("Error") == std::string::npos, "streaming: no errors");
+}
+
+// With Prepared the statement is prepared, executed and closed, and its
+// rows come in the binary protocol
+void TestPrepared()
+{
+    std::string prepareOk("\x00\x01\x00\x00\x00\x01\x00\x00\x00\x00\x00\x00", 12);
+    std::string binaryRow("\x00\x00\x2a\x00\x00\x00\x00\x00\x00\x00", 10);
+
+    std::vector<MysqlExchange> script = {
+        {MysqlPrepareCommand, "SELECT 42 AS answer", {prepareOk, MysqlStandInColumn("answer", MysqlLongLongType), MysqlStandInEof()}},
+        {MysqlExecuteCommand, "", {"\x01", MysqlStandInColumn("answer", MysqlLongLongType), MysqlStandInEof(), binaryRow, MysqlStandInEof()}},
+        {MysqlCloseCommand, "", {}},
+    };
+
+    MysqlStandIn standIn(script);
+    FileRunnerService fileRunner;
+
+    auto output = fileRunner.Execute("prepared.sql", MysqlScript(standIn, "SELECT 42 AS answer;\n", "-- Prepared: true\n"));
+
+    CheckStandIn(standIn, script.size(), "prepared");
+    Check(output.find("answer") != std::string::npos && output.find("42") != std::string::npos, "prepared: the row in\n" + output);
+    Check(output.find("Error") == std::string::npos, "prepared: no errors in\n" + output);
+}
+
+// Cancelling kills the query from a connection of its own, the connection
+// that ran it is not used again
+void TestCancellation()
+{
+    MysqlExchange sleep;
+    sleep.Command = MysqlQueryCommand;
+    sleep.Sql = "SELECT SLEEP(60)";
+    sleep.HoldAt = 0;
+
+    std::vector<MysqlExchange> script = {
+        sleep,
+        {MysqlQueryCommand, "KILL QUERY 1", {MysqlStandInOk()}},
+    };
+
+    MysqlStandIn standIn(script);
+    FileRunnerService fileRunner;
+
+    std::mutex outputMutex;
+    std::string output;
+    auto job = fileRunner.ExecuteAsync("cancel.sql", MysqlScript(standIn, "SELECT SLEEP(60)\n"), [&](std::string_view text) {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        output.append(text);
+    });
+
+    Check(standIn.WaitForPosition(1, std::chrono::seconds(5)), "cancellation: the query was sent");
+    job->Cancel();
+    Check(job->WaitFor(std::chrono::seconds(5)), "cancellation: the run ended");
+
+    CheckStandIn(standIn, script.size(), "cancellation");
+    Check(standIn.ConnectionCount() == 2, "cancellation: the query was killed from a second connection");
+
+    std::lock_guard<std::mutex> lock(outputMutex);
+    Check(output.find("Cancelled") != std::string::npos, "cancellation: the output says so in\n" + output);
+}
+
+// A wrong password is refused at the login
+void TestWrongPassword()
+{
+    MysqlStandIn standIn({});
+    FileRunnerService fileRunner;
+
+    auto output = fileRunner.Execute("login.sql", MysqlScript(standIn, "SELECT 1\n", "", "wrong"));
+
+    Check(output.find("Error: ERROR 1045 (28000): Access denied") != std::string::npos, "wrong password: refused in\n" + output);
+    Check(standIn.Failures().size() == 1, "wrong password: the stand-in saw the login fail, " + std::to_string(standIn.Failures().size()) + " failures");
+}
+
+int main()
+{
+    TestTextResults();
+    TestStreaming();
+    TestPrepared();
+    TestCancellation();
+    TestWrongPassword();
+
+    if (FailureCount > 0)
+    {
+        std::cerr << FailureCount << " failed" << std::endl;
+        return 1;
+    }
+
+    std::cout << "passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,140 @@
+#include "standinsocket.hpp"
+
+#include <mutex>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#pragma comment(lib, "ws2_32.lib")
+
+const StandInSocket InvalidStandInSocket = INVALID_SOCKET;
+
+void CloseStandInSocket(
+    StandInSocket socket)
+{
+    ::closesocket(socket);
+}
+
+int PollStandInSocket(
+    StandInSocket socket,
+    int timeout)
+{
+    WSAPOLLFD descriptor = {};
+    descriptor.fd = socket;
+    descriptor.events = POLLRDNORM;
+
+    return WSAPoll(&descriptor, 1, timeout);
+}
+
+const int StandInSendFlags = 0;
+#else
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+const StandInSocket InvalidStandInSocket = -1;
+
+void CloseStandInSocket(
+    StandInSocket socket)
+{
+    ::close(socket);
+}
+
+int PollStandInSocket(
+    StandInSocket socket,
+    int timeout)
+{
+    pollfd descriptor = {};
+    descriptor.fd = socket;
+    descriptor.events = POLLIN;
+
+    return poll(&descriptor, 1, timeout);
+}
+
+const int StandInSendFlags = MSG_NOSIGNAL;
+#endif
+
+StandInSocket ListenOnLoopback(
+    int &port)
+{
+#ifdef _WIN32
+    static std::once_flag started;
+    std::call_once(started, []() {
+        WSADATA data;
+        WSAStartup(MAKEWORD(2, 2), &data);
+    });
+#endif
+
+    auto listener = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listener == InvalidStandInSocket)
+    {
+        return InvalidStandInSocket;
+    }
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+
+    socklen_t length = sizeof(address);
+    if (::bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0
+        || ::listen(listener, 64) != 0
+        || ::getsockname(listener, reinterpret_cast<sockaddr *>(&address), &length) != 0)
+    {
+        CloseStandInSocket(listener);
+        return InvalidStandInSocket;
+    }
+
+    port = ntohs(address.sin_port);
+
+    return listener;
+}
+
+StandInSocket AcceptOnStandInSocket(
+    StandInSocket listener)
+{
+    return ::accept(listener, nullptr, nullptr);
+}
+
+int ReceiveFromStandInSocket(
+    StandInSocket socket,
+    char *buffer,
+    size_t size)
+{
+    while (true)
+    {
+        auto received = ::recv(socket, buffer, static_cast<int>(size), 0);
+#ifndef _WIN32
+        if (received < 0 && errno == EINTR)
+        {
+            continue;
+        }
+#endif
+        return static_cast<int>(received);
+    }
+}
+
+bool SendToStandInSocket(
+    StandInSocket socket,
+    const std::string &data)
+{
+    const char *next = data.data();
+    size_t left = data.size();
+    while (left > 0)
+    {
+        auto written = ::send(socket, next, static_cast<int>(left), StandInSendFlags);
+        if (written <= 0)
+        {
+            return false;
+        }
+
+        next += written;
+        left -= written;
+    }
+
+    return true;
+}
@@ -0,0 +1,44 @@
+#ifndef STANDINSOCKET_HPP
+#define STANDINSOCKET_HPP
+
+#include <cstdint>
+#include <string>
+
+// The sockets of the server stand-ins, which listen on loopback ports
+#ifdef _WIN32
+typedef uintptr_t StandInSocket;
+#else
+typedef int StandInSocket;
+#endif
+
+extern const StandInSocket InvalidStandInSocket;
+
+// Listens on a free loopback port, InvalidStandInSocket when it can not
+StandInSocket ListenOnLoopback(
+    int &port);
+
+// Takes the next connection, InvalidStandInSocket when there is none
+StandInSocket AcceptOnStandInSocket(
+    StandInSocket listener);
+
+void CloseStandInSocket(
+    StandInSocket socket);
+
+// Waits at most timeout milliseconds for data, 1 when there is some, 0 when
+// there is none and a negative value on error
+int PollStandInSocket(
+    StandInSocket socket,
+    int timeout);
+
+// Returns the number of bytes received, 0 when the peer closed the connection
+// and a negative value on error
+int ReceiveFromStandInSocket(
+    StandInSocket socket,
+    char *buffer,
+    size_t size);
+
+bool SendToStandInSocket(
+    StandInSocket socket,
+    const std::string &data);
+
+#endif // STANDINSOCKET_HPP
@@ -0,0 +1,312 @@
+#include "tdsstandin.hpp"
+
+#include "stringhelpers.hpp"
+#include <algorithm>
+#include <cctype>
+
+const uint8_t TdsReply = 0x04;
+const uint8_t TdsEndOfMessage = 0x01;
+const size_t TdsPacketSize = 4096;
+
+// How often the threads of the stand-in look whether it is stopping
+const int StandInPollMilliseconds = 50;
+
+std::string TdsStandInBytes(
+    const std::string &hex)
+{
+    std::string digits;
+    for (auto c : hex)
+    {
+        if (!std::isspace(static_cast<unsigned char>(c)))
+        {
+            digits.push_back(c);
+        }
+    }
+
+    std::string bytes;
+    for (size_t i = 0; i + 1 < digits.size(); i += 2)
+    {
+        bytes.push_back(static_cast<char>(std::stoi(digits.substr(i, 2), nullptr, 16)));
+    }
+
+    return bytes;
+}
+
+// The text of a SQL batch follows the headers that start it, as UTF-16.
+// Scripts only hold ASCII, anything else is kept as a question mark.
+std::string TdsStandInBatchText(
+    const std::string &payload)
+{
+    if (payload.size() < 4)
+    {
+        return std::string();
+    }
+
+    uint32_t headersLength = 0;
+    for (int i = 3; i >= 0; i--)
+    {
+        headersLength = (headersLength << 8) | static_cast<uint8_t>(payload[i]);
+    }
+
+    std::string text;
+    for (size_t i = headersLength; i + 1 < payload.size(); i += 2)
+    {
+        auto low = static_cast<uint8_t>(payload[i]);
+        auto high = static_cast<uint8_t>(payload[i + 1]);
+        text.push_back(high == 0 && low < 0x80 ? static_cast<char>(low) : '?');
+    }
+
+    return trim_copy(text);
+}
+
+TdsStandIn::TdsStandIn(
+    const std::vector<TdsExchange> &script)
+    : _script(script),
+      _listener(InvalidStandInSocket)
+{
+    _listener = ListenOnLoopback(_port);
+    if (_listener == InvalidStandInSocket)
+    {
+        Fail("could not listen on a loopback port");
+        return;
+    }
+
+    _thread = std::thread([this]() { Serve(); });
+}
+
+TdsStandIn::~TdsStandIn()
+{
+    _stopping = true;
+    if (_thread.joinable())
+    {
+        _thread.join();
+    }
+
+    if (_listener != InvalidStandInSocket)
+    {
+        CloseStandInSocket(_listener);
+    }
+}
+
+int TdsStandIn::Port() const
+{
+    return _port;
+}
+
+size_t TdsStandIn::Position()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return _position;
+}
+
+bool TdsStandIn::WaitForPosition(
+    size_t count,
+    std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    return _positionChanged.wait_for(lock, timeout, [this, count]() { return _position >= count; });
+}
+
+int TdsStandIn::ConnectionCount()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return _connectionCount;
+}
+
+std::vector<std::string> TdsStandIn::Failures()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return _failures;
+}
+
+void TdsStandIn::Fail(
+    const std::string &failure)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _failures.push_back(failure);
+}
+
+void TdsStandIn::Serve()
+{
+    // The client takes one connection at a time, so they are served one
+    // after the other
+    while (WaitReadable(_listener))
+    {
+        auto socket = AcceptOnStandInSocket(_listener);
+        if (socket == InvalidStandInSocket)
+        {
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _connectionCount++;
+        }
+
+        ServeConnection(socket);
+        CloseStandInSocket(socket);
+    }
+}
+
+void TdsStandIn::ServeConnection(
+    Socket socket)
+{
+    uint8_t type = 0;
+    std::string payload;
+    while (ReadMessage(socket, type, payload))
+    {
+        size_t position = Position();
+        if (position >= _script.size())
+        {
+            Fail("message of type " + std::to_string(type) + " after the end of the script");
+            return;
+        }
+
+        auto &exchange = _script[position];
+        if (type != exchange.RequestType)
+        {
+            Fail("expected a message of type " + std::to_string(exchange.RequestType) + " at " + std::to_string(position) + ", got " + std::to_string(type));
+            return;
+        }
+
+        if (type == TdsSqlBatch)
+        {
+            auto sql = TdsStandInBatchText(payload);
+            if (sql != exchange.Sql)
+            {
+                Fail("expected the batch '" + exchange.Sql + "' at " + std::to_string(position) + ", got '" + sql + "'");
+                return;
+            }
+        }
+
+        // Counted before the response goes out, the client can be done with
+        // it before the stand-in is done sending it
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _position++;
+        }
+        _positionChanged.notify_all();
+
+        if (!exchange.Response.empty() && !WriteMessage(socket, TdsStandInBytes(exchange.Response)))
+        {
+            Fail("could not send the response at " + std::to_string(position));
+            return;
+        }
+    }
+}
+
+bool TdsStandIn::WaitReadable(
+    Socket socket)
+{
+    while (!_stopping)
+    {
+        auto ready = PollStandInSocket(socket, StandInPollMilliseconds);
+        if (ready > 0)
+        {
+            return true;
+        }
+        if (ready < 0)
+        {
+            return false;
+        }
+    }
+
+    return false;
+}
+
+bool TdsStandIn::ReadExactly(
+    Socket socket,
+    char *buffer,
+    size_t size)
+{
+    while (size > 0)
+    {
+        if (!WaitReadable(socket))
+        {
+            return false;
+        }
+
+        auto received = ReceiveFromStandInSocket(socket, buffer, size);
+        if (received <= 0)
+        {
+            return false;
+        }
+
+        buffer += received;
+        size -= received;
+    }
+
+    return true;
+}
+
+bool TdsStandIn::ReadMessage(
+    Socket socket,
+    uint8_t &type,
+    std::string &payload)
+{
+    payload.clear();
+
+    while (true)
+    {
+        char header[8];
+        if (!ReadExactly(socket, header, sizeof(header)))
+        {
+            return false;
+        }
+
+        type = static_cast<uint8_t>(header[0]);
+        size_t length = (static_cast<uint8_t>(header[2]) << 8) | static_cast<uint8_t>(header[3]);
+        if (length < sizeof(header))
+        {
+            Fail("packet of " + std::to_string(length) + " bytes");
+            return false;
+        }
+
+        auto start = payload.size();
+        payload.resize(start + length - sizeof(header));
+        if (!ReadExactly(socket, &payload[start], length - sizeof(header)))
+        {
+            return false;
+        }
+
+        if (header[1] & TdsEndOfMessage)
+        {
+            return true;
+        }
+    }
+}
+
+bool TdsStandIn::WriteMessage(
+    Socket socket,
+    const std::string &payload)
+{
+    const size_t dataSize = TdsPacketSize - 8;
+
+    uint8_t packetId = 1;
+    for (size_t offset = 0; offset == 0 || offset < payload.size(); offset += dataSize)
+    {
+        auto size = std::min(dataSize, payload.size() - offset);
+        auto last = offset + size >= payload.size();
+        auto length = size + 8;
+
+        std::string packet;
+        packet.push_back(static_cast<char>(TdsReply));
+        packet.push_back(static_cast<char>(last ? TdsEndOfMessage : 0));
+        packet.push_back(static_cast<char>(length >> 8));
+        packet.push_back(static_cast<char>(length & 0xFF));
+        packet.append({0, 0, static_cast<char>(packetId++), 0});
+        packet.append(payload, offset, size);
+
+        if (!SendToStandInSocket(socket, packet))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
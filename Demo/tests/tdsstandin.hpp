@@ -0,0 +1,102 @@
+#ifndef TDSSTANDIN_HPP
+#define TDSSTANDIN_HPP
+
+#include "standinsocket.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+const uint8_t TdsSqlBatch = 0x01;
+const uint8_t TdsAttention = 0x06;
+const uint8_t TdsLogin7 = 0x10;
+const uint8_t TdsPrelogin = 0x12;
+
+// A message the client is expected to send and the response the server
+// sent to it when the exchange was recorded
+struct TdsExchange
+{
+    uint8_t RequestType = 0;
+    // For a SQL batch the text it carries, without the whitespace around it
+    std::string Sql;
+    // The payload of the response as hex, spaces are ignored. An empty one
+    // sends nothing, like a server that is still running the batch.
+    std::string Response;
+};
+
+// Stands in for SQL Server on a loopback port by replaying a script of TDS
+// exchanges in order, over one connection or more. What the client sends
+// that the script does not expect is kept as a failure, and ends the
+// connection it came on.
+class TdsStandIn
+{
+public:
+    TdsStandIn(
+        const std::vector<TdsExchange> &script);
+
+    virtual ~TdsStandIn();
+
+public:
+    int Port() const;
+
+    // How many exchanges of the script the client went through
+    size_t Position();
+
+    // Waits until the client went through the first count exchanges,
+    // false when it did not within timeout
+    bool WaitForPosition(
+        size_t count,
+        std::chrono::milliseconds timeout);
+
+    int ConnectionCount();
+
+    std::vector<std::string> Failures();
+
+private:
+    typedef StandInSocket Socket;
+
+    std::vector<TdsExchange> _script;
+    Socket _listener;
+    int _port = 0;
+    std::atomic<bool> _stopping{false};
+    std::thread _thread;
+
+    std::mutex _mutex;
+    std::condition_variable _positionChanged;
+    size_t _position = 0;
+    int _connectionCount = 0;
+    std::vector<std::string> _failures;
+
+    void Serve();
+
+    void ServeConnection(
+        Socket socket);
+
+    void Fail(
+        const std::string &failure);
+
+    // Waits for data while checking whether the stand-in is stopping
+    bool WaitReadable(
+        Socket socket);
+
+    bool ReadExactly(
+        Socket socket,
+        char *buffer,
+        size_t size);
+
+    // Reads the packets of one message, false when the client closed the connection
+    bool ReadMessage(
+        Socket socket,
+        uint8_t &type,
+        std::string &payload);
+
+    bool WriteMessage(
+        Socket socket,
+        const std::string &payload);
+};
+
+#endif // TDSSTANDIN_HPP
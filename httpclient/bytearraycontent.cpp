@@ -5,6 +5,11 @@ ByteArrayContent::ByteArrayContent(
     : ByteArrayContent(bytes, 0, bytes.size())
 {}
 
+ByteArrayContent::ByteArrayContent(
+    std::vector<std::byte> &&bytes)
+    : _stream(std::move(bytes))
+{}
+
 ByteArrayContent::ByteArrayContent(
     const std::vector<std::byte> &bytes,
     size_t offset,
@@ -16,7 +21,7 @@ ByteArrayContent::ByteArrayContent(
 
 ByteArrayContent::~ByteArrayContent() = default;
 
-const std::vector<std::byte> &ByteArrayContent::Stream()
+std::string_view ByteArrayContent::Buffer()
 {
-    return _stream;
+    return std::string_view(reinterpret_cast<const char *>(_stream.data()), _stream.size());
 }
@@ -11,6 +11,9 @@ public:
     ByteArrayContent(
         const std::vector<std::byte> &bytes);
 
+    ByteArrayContent(
+        std::vector<std::byte> &&bytes);
+
     ByteArrayContent(
         const std::vector<std::byte> &bytes,
         size_t offset,
@@ -19,7 +22,7 @@ public:
     virtual ~ByteArrayContent();
 
 protected:
-    const std::vector<std::byte> &Stream();
+    std::string_view Buffer();
 
 protected:
     std::vector<std::byte> _stream;
@@ -1,6 +1,6 @@
-#define ca_crt_rsa_size 70369 
+#define ca_crt_rsa_size sizeof(ca_crt_rsa)
 
-char ca_crt_rsa[70369] = {
+const char ca_crt_rsa[] = {
     "-----BEGIN CERTIFICATE-----\r\n"
     "MIICWjCCAcMCAgGlMA0GCSqGSIb3DQEBBAUAMHUxCzAJBgNVBAYTAlVTMRgwFgYD\r\n"
     "VQQKEw9HVEUgQ29ycG9yYXRpb24xJzAlBgNVBAsTHkdURSBDeWJlclRydXN0IFNv\r\n"
@@ -1142,4 +1142,4 @@ char ca_crt_rsa[70369] = {
     "XjG4Kvte9nHfRCaexOYNkbQudZWAUWpLMKawYqGT8ZvYzsRjdT9ZR7E=\r\n"
     "-----END CERTIFICATE-----\r\n"
     " "
-};
\ No newline at end of file
+};
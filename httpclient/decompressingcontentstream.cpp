@@ -0,0 +1,188 @@
+#include "decompressingcontentstream.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <zlib.h>
+
+DecompressingContentStream::DecompressingContentStream(
+    const std::shared_ptr<HttpContentStream> &stream,
+    ContentEncoding encoding)
+    : _stream(stream),
+      _encoding(encoding),
+      _zstream(std::make_unique<z_stream_s>()),
+      _input(65536)
+{}
+
+DecompressingContentStream::~DecompressingContentStream()
+{
+    if (_initialized)
+    {
+        inflateEnd(_zstream.get());
+    }
+}
+
+bool DecompressingContentStream::Initialize()
+{
+    // gzip has its own header. "deflate" should be zlib wrapped, but some
+    // servers send a raw deflate stream, which has no valid zlib header.
+    int windowBits = 15 + 16;
+
+    if (_encoding == ContentEncoding::Deflate)
+    {
+        auto first = static_cast<unsigned char>(_input[0]);
+        auto second = _zstream->avail_in > 1 ? static_cast<unsigned char>(_input[1]) : 0;
+
+        bool zlibHeader = _zstream->avail_in > 1 && (first & 0x0f) == Z_DEFLATED && (first * 256 + second) % 31 == 0;
+
+        windowBits = zlibHeader ? 15 : -15;
+    }
+
+    _initialized = inflateInit2(_zstream.get(), windowBits) == Z_OK;
+
+    return _initialized;
+}
+
+int DecompressingContentStream::Read(
+    char *buffer,
+    size_t size)
+{
+    if (_failed)
+    {
+        return -1;
+    }
+
+    if (_ended || size == 0)
+    {
+        return 0;
+    }
+
+    auto zstream = _zstream.get();
+
+    zstream->next_out = reinterpret_cast<Bytef *>(buffer);
+    zstream->avail_out = static_cast<uInt>(std::min<size_t>(size, UINT_MAX));
+
+    // Input is read until some output is produced, a small piece of input
+    // can be all header and produce nothing
+    while (zstream->avail_out == std::min<size_t>(size, UINT_MAX))
+    {
+        if (zstream->avail_in == 0 && !_inputEnded)
+        {
+            auto read = _stream->Read(_input.data(), _input.size());
+            if (read < 0)
+            {
+                _failed = true;
+                return -1;
+            }
+
+            if (read == 0)
+            {
+                _inputEnded = true;
+            }
+            else
+            {
+                zstream->next_in = reinterpret_cast<Bytef *>(_input.data());
+                zstream->avail_in = static_cast<uInt>(read);
+            }
+        }
+
+        if (!_initialized)
+        {
+            // Encoded content that is empty decodes to nothing
+            if (_inputEnded)
+            {
+                _ended = true;
+                return 0;
+            }
+
+            // The zlib header is two bytes and both are needed to tell it from raw deflate
+            if (_encoding == ContentEncoding::Deflate && zstream->avail_in == 1 && !_inputEnded)
+            {
+                auto read = _stream->Read(_input.data() + 1, _input.size() - 1);
+                if (read < 0)
+                {
+                    _failed = true;
+                    return -1;
+                }
+
+                _inputEnded = read == 0;
+                zstream->avail_in += read;
+            }
+
+            if (!Initialize())
+            {
+                _failed = true;
+                return -1;
+            }
+        }
+
+        auto result = inflate(zstream, Z_NO_FLUSH);
+
+        if (result == Z_STREAM_END)
+        {
+            // gzip content can hold more than one member
+            if (_encoding == ContentEncoding::GZip && (zstream->avail_in > 0 || !_inputEnded))
+            {
+                if (zstream->avail_in == 0)
+                {
+                    auto read = _stream->Read(_input.data(), _input.size());
+                    if (read <= 0)
+                    {
+                        _inputEnded = read == 0;
+                        _failed = read < 0;
+                        break;
+                    }
+
+                    zstream->next_in = reinterpret_cast<Bytef *>(_input.data());
+                    zstream->avail_in = static_cast<uInt>(read);
+                }
+
+                inflateReset(zstream);
+                continue;
+            }
+
+            Drain();
+            break;
+        }
+
+        if (result != Z_OK && result != Z_BUF_ERROR)
+        {
+            _failed = true;
+            return -1;
+        }
+
+        // The encoded content ended before the decoded content did
+        if (_inputEnded && zstream->avail_in == 0 && zstream->avail_out == std::min<size_t>(size, UINT_MAX))
+        {
+            _failed = true;
+            return -1;
+        }
+    }
+
+    auto produced = std::min<size_t>(size, UINT_MAX) - zstream->avail_out;
+
+    if (produced == 0)
+    {
+        _ended = !_failed;
+        return _failed ? -1 : 0;
+    }
+
+    // A failure after some output is reported by the next Read
+    return static_cast<int>(produced);
+}
+
+void DecompressingContentStream::Drain()
+{
+    _zstream->avail_in = 0;
+
+    while (!_inputEnded)
+    {
+        auto read = _stream->Read(_input.data(), _input.size());
+        if (read <= 0)
+        {
+            _inputEnded = true;
+            _failed = read < 0;
+        }
+    }
+
+    _ended = true;
+}
@@ -0,0 +1,48 @@
+#ifndef DECOMPRESSINGCONTENTSTREAM_HPP
+#define DECOMPRESSINGCONTENTSTREAM_HPP
+
+#include "httpcontent.hpp"
+#include <memory>
+#include <vector>
+
+struct z_stream_s;
+
+enum class ContentEncoding
+{
+    GZip,
+    Deflate,
+};
+
+// Decodes gzip or deflate encoded content while it is read from another
+// stream, one piece at a time as the encoded content arrives.
+class DecompressingContentStream : public HttpContentStream
+{
+public:
+    DecompressingContentStream(
+        const std::shared_ptr<HttpContentStream> &stream,
+        ContentEncoding encoding);
+
+    virtual ~DecompressingContentStream();
+
+public:
+    int Read(
+        char *buffer,
+        size_t size);
+
+private:
+    std::shared_ptr<HttpContentStream> _stream;
+    ContentEncoding _encoding;
+    std::unique_ptr<z_stream_s> _zstream;
+    std::vector<char> _input;
+    bool _initialized = false;
+    bool _inputEnded = false;
+    bool _ended = false;
+    bool _failed = false;
+
+    bool Initialize();
+
+    // Reads the rest of the encoded stream, so its connection can be reused
+    void Drain();
+};
+
+#endif // DECOMPRESSINGCONTENTSTREAM_HPP
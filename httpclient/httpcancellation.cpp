@@ -0,0 +1,103 @@
+#include "httpcancellation.hpp"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN 1
+#include <windows.h>
+#include <wininet.h>
+#else
+#include "httpconnectionpool.hpp"
+#endif
+
+HttpCancellation::HttpCancellation() = default;
+
+HttpCancellation::~HttpCancellation() = default;
+
+void HttpCancellation::Cancel()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _cancellationRequested = true;
+
+#ifdef _WIN32
+    for (auto request : _requests)
+    {
+        InternetCloseHandle(static_cast<HINTERNET>(request));
+    }
+
+    _requests.clear();
+#else
+    for (auto connection : _connections)
+    {
+        connection->Shutdown();
+    }
+#endif
+}
+
+bool HttpCancellation::IsCancellationRequested()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return _cancellationRequested;
+}
+
+#ifdef _WIN32
+
+bool HttpCancellation::Attach(
+    void *request)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_cancellationRequested)
+    {
+        return false;
+    }
+
+    _requests.push_back(request);
+
+    return true;
+}
+
+bool HttpCancellation::Detach(
+    void *request)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto found = std::find(_requests.begin(), _requests.end(), request);
+    if (found == _requests.end())
+    {
+        return false;
+    }
+
+    _requests.erase(found);
+
+    return true;
+}
+
+#else
+
+bool HttpCancellation::Attach(
+    HttpConnection *connection)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_cancellationRequested)
+    {
+        return false;
+    }
+
+    _connections.push_back(connection);
+
+    return true;
+}
+
+void HttpCancellation::Detach(
+    HttpConnection *connection)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _connections.erase(std::remove(_connections.begin(), _connections.end(), connection), _connections.end());
+}
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef HTTPCANCELLATION_HPP
+#define HTTPCANCELLATION_HPP
+
+#include <mutex>
+#include <vector>
+
+class HttpConnection;
+
+// Lets the requests it is sent with be ended from another thread, Cancel
+// shuts down the connections they are waiting on
+class HttpCancellation
+{
+public:
+    HttpCancellation();
+
+    virtual ~HttpCancellation();
+
+public:
+    void Cancel();
+
+    bool IsCancellationRequested();
+
+#ifdef _WIN32
+    // A WinINet request handle is attached while a request uses it, false
+    // when the requests are cancelled already. Cancel closes the handles that
+    // are attached, which ends the calls waiting on them.
+    bool Attach(
+        void *request);
+
+    // False when Cancel closed the handle already
+    bool Detach(
+        void *request);
+#else
+    // A connection is attached while a request uses it, false when the
+    // requests are cancelled already
+    bool Attach(
+        HttpConnection *connection);
+
+    void Detach(
+        HttpConnection *connection);
+#endif
+
+private:
+    std::mutex _mutex;
+    bool _cancellationRequested = false;
+#ifdef _WIN32
+    std::vector<void *> _requests;
+#else
+    std::vector<HttpConnection *> _connections;
+#endif
+};
+
+#endif // HTTPCANCELLATION_HPP
@@ -1,10 +1,16 @@
 #include "httpclient.hpp"
 
-HttpClient::HttpClient() = default;
+#include "httpcancellation.hpp"
+
+HttpClient::HttpClient()
+    : _messageHandler(std::make_shared<HttpMessageHandler>()),
+      _cancellation(std::make_shared<HttpCancellation>())
+{}
 
 HttpClient::HttpClient(
     const std::shared_ptr<HttpMessageHandler> &messageHandler)
-    : _messageHandler(messageHandler)
+    : _messageHandler(messageHandler),
+      _cancellation(std::make_shared<HttpCancellation>())
 {}
 
 HttpClient::~HttpClient() = default;
@@ -14,7 +20,7 @@ std::shared_ptr<HttpResponseMessage> HttpClient::Delete(
 {
     auto requestMessage = std::make_shared<HttpRequestMessage>(HttpMethod::Delete, uri);
 
-    return _messageHandler->Send(requestMessage);
+    return Send(requestMessage);
 }
 
 std::shared_ptr<HttpResponseMessage> HttpClient::Get(
@@ -22,7 +28,16 @@ std::shared_ptr<HttpResponseMessage> HttpClient::Get(
 {
     auto requestMessage = std::make_shared<HttpRequestMessage>(HttpMethod::Get, uri);
 
-    return _messageHandler->Send(requestMessage);
+    return Send(requestMessage);
+}
+
+std::shared_ptr<HttpResponseMessage> HttpClient::Get(
+    const std::string &uri,
+    HttpCompletionOption completionOption)
+{
+    auto requestMessage = std::make_shared<HttpRequestMessage>(HttpMethod::Get, uri);
+
+    return Send(requestMessage, completionOption);
 }
 
 std::shared_ptr<HttpResponseMessage> HttpClient::Patch(
@@ -33,7 +48,7 @@ std::shared_ptr<HttpResponseMessage> HttpClient::Patch(
 
     requestMessage->Content = content;
 
-    return _messageHandler->Send(requestMessage);
+    return Send(requestMessage);
 }
 
 std::shared_ptr<HttpResponseMessage> HttpClient::Post(
@@ -44,7 +59,7 @@ std::shared_ptr<HttpResponseMessage> HttpClient::Post(
 
     requestMessage->Content = content;
 
-    return _messageHandler->Send(requestMessage);
+    return Send(requestMessage);
 }
 
 std::shared_ptr<HttpResponseMessage> HttpClient::Put(
@@ -55,5 +70,38 @@ std::shared_ptr<HttpResponseMessage> HttpClient::Put(
 
     requestMessage->Content = content;
 
-    return _messageHandler->Send(requestMessage);
+    return Send(requestMessage);
+}
+
+std::shared_ptr<HttpResponseMessage> HttpClient::Send(
+    const std::shared_ptr<HttpRequestMessage> &request,
+    HttpCompletionOption completionOption)
+{
+    std::shared_ptr<HttpCancellation> cancellation;
+    {
+        std::lock_guard<std::mutex> lock(_cancellationMutex);
+        cancellation = _cancellation;
+    }
+
+    return _messageHandler->Send(request, completionOption, cancellation);
+}
+
+std::shared_ptr<HttpResponseMessage> HttpClient::Send(
+    const std::shared_ptr<HttpRequestMessage> &request,
+    HttpCompletionOption completionOption,
+    const std::shared_ptr<HttpCancellation> &cancellation)
+{
+    return _messageHandler->Send(request, completionOption, cancellation);
+}
+
+void HttpClient::CancelPendingRequests()
+{
+    std::shared_ptr<HttpCancellation> cancellation;
+    {
+        std::lock_guard<std::mutex> lock(_cancellationMutex);
+        cancellation = _cancellation;
+        _cancellation = std::make_shared<HttpCancellation>();
+    }
+
+    cancellation->Cancel();
 }
@@ -6,6 +6,7 @@
 #include "httpresponsemessage.hpp"
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 
 class HttpClient
@@ -29,6 +30,10 @@ public:
     std::shared_ptr<HttpResponseMessage> Get(
         const std::string &uri);
 
+    std::shared_ptr<HttpResponseMessage> Get(
+        const std::string &uri,
+        HttpCompletionOption completionOption);
+
     std::shared_ptr<HttpResponseMessage> Patch(
         const std::string &uri,
         const std::shared_ptr<HttpContent> &content);
@@ -41,8 +46,25 @@ public:
         const std::string &uri,
         const std::shared_ptr<HttpContent> &content);
 
+    std::shared_ptr<HttpResponseMessage> Send(
+        const std::shared_ptr<HttpRequestMessage> &request,
+        HttpCompletionOption completionOption = HttpCompletionOption::ResponseContentRead);
+
+    // Sends a request that ends when cancellation is cancelled, also when that
+    // happens before it is sent. CancelPendingRequests does not end it.
+    std::shared_ptr<HttpResponseMessage> Send(
+        const std::shared_ptr<HttpRequestMessage> &request,
+        HttpCompletionOption completionOption,
+        const std::shared_ptr<HttpCancellation> &cancellation);
+
+    // Ends the requests sent until now, from any thread, including the
+    // reading of their content. Requests sent after it are not affected.
+    void CancelPendingRequests();
+
 private:
     std::shared_ptr<HttpMessageHandler> _messageHandler;
+    std::mutex _cancellationMutex;
+    std::shared_ptr<HttpCancellation> _cancellation;
 };
 
 #endif // HTTPCLIENT_HPP
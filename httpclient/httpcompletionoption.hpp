@@ -0,0 +1,10 @@
+#ifndef HTTPCOMPLETIONOPTION_HPP
+#define HTTPCOMPLETIONOPTION_HPP
+
+enum class HttpCompletionOption
+{
+    ResponseContentRead, // Send returns after the whole response, including its content, has been read.
+    ResponseHeadersRead, // Send returns as soon as the response headers are read, the content is read from the connection while it is consumed.
+};
+
+#endif // HTTPCOMPLETIONOPTION_HPP
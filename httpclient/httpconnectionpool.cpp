@@ -0,0 +1,423 @@
+#include "httpconnectionpool.hpp"
+
+#include "httptlscontext.hpp"
+#include <algorithm>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/ssl.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static const HttpConnection::Socket InvalidHttpSocket = -1;
+
+static void CloseHttpSocket(
+    HttpConnection::Socket socket)
+{
+    ::close(socket);
+}
+
+static int PollHttpSocket(
+    HttpConnection::Socket socket)
+{
+    pollfd descriptor = {};
+    descriptor.fd = socket;
+    descriptor.events = POLLIN;
+
+    return poll(&descriptor, 1, 0);
+}
+
+static bool HttpSocketInterrupted()
+{
+    return errno == EINTR;
+}
+
+static const int HttpSendFlags = MSG_NOSIGNAL;
+
+static const int HttpShutdownBoth = SHUT_RDWR;
+
+static bool ConnectHttpSocket(
+    HttpConnection::Socket socket,
+    const sockaddr *address,
+    size_t addressLength,
+    std::chrono::milliseconds timeout)
+{
+    // The socket connects in the background while the timeout runs
+    auto flags = fcntl(socket, F_GETFL, 0);
+    fcntl(socket, F_SETFL, flags | O_NONBLOCK);
+
+    auto result = ::connect(socket, address, static_cast<socklen_t>(addressLength));
+    if (result != 0 && errno == EINPROGRESS)
+    {
+        pollfd descriptor = {};
+        descriptor.fd = socket;
+        descriptor.events = POLLOUT;
+
+        int ready;
+        while ((ready = poll(&descriptor, 1, static_cast<int>(timeout.count()))) < 0 && errno == EINTR)
+        {
+        }
+
+        int error = 0;
+        socklen_t errorLength = sizeof(error);
+        if (ready == 1 && getsockopt(socket, SOL_SOCKET, SO_ERROR, &error, &errorLength) == 0 && error == 0)
+        {
+            result = 0;
+        }
+    }
+
+    fcntl(socket, F_SETFL, flags);
+
+    return result == 0;
+}
+
+static void SetHttpSocketTimeout(
+    HttpConnection::Socket socket,
+    std::chrono::milliseconds timeout)
+{
+    timeval time = {};
+    time.tv_sec = static_cast<time_t>(timeout.count() / 1000);
+    time.tv_usec = static_cast<suseconds_t>((timeout.count() % 1000) * 1000);
+    setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &time, sizeof(time));
+    setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, &time, sizeof(time));
+}
+
+struct HttpConnection::TlsSession
+{
+    mbedtls_ssl_context ssl;
+
+    TlsSession()
+    {
+        mbedtls_ssl_init(&ssl);
+    }
+
+    ~TlsSession()
+    {
+        mbedtls_ssl_free(&ssl);
+    }
+};
+
+static int TlsSend(
+    void *context,
+    const unsigned char *buffer,
+    size_t length)
+{
+    auto socket = *static_cast<HttpConnection::Socket *>(context);
+
+    auto sent = ::send(socket, reinterpret_cast<const char *>(buffer), static_cast<int>(std::min<size_t>(length, 1 << 30)), HttpSendFlags);
+
+    if (sent < 0)
+    {
+        return HttpSocketInterrupted() ? MBEDTLS_ERR_SSL_WANT_WRITE : MBEDTLS_ERR_NET_SEND_FAILED;
+    }
+
+    return static_cast<int>(sent);
+}
+
+static int TlsReceive(
+    void *context,
+    unsigned char *buffer,
+    size_t length)
+{
+    auto socket = *static_cast<HttpConnection::Socket *>(context);
+
+    auto received = ::recv(socket, reinterpret_cast<char *>(buffer), static_cast<int>(std::min<size_t>(length, 1 << 30)), 0);
+
+    if (received < 0)
+    {
+        return HttpSocketInterrupted() ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_RECV_FAILED;
+    }
+
+    return static_cast<int>(received);
+}
+
+HttpConnection::HttpConnection(
+    const std::string &scheme,
+    const std::string &host,
+    int port)
+    : _scheme(scheme), _host(host), _port(port), _socket(InvalidHttpSocket)
+{}
+
+HttpConnection::~HttpConnection()
+{
+    Close();
+}
+
+bool HttpConnection::Open(
+    std::chrono::milliseconds connectTimeout,
+    std::chrono::milliseconds ioTimeout)
+{
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo *addresses = nullptr;
+    if (getaddrinfo(_host.c_str(), std::to_string(_port).c_str(), &hints, &addresses) != 0)
+    {
+        return false;
+    }
+
+    for (auto address = addresses; address != nullptr; address = address->ai_next)
+    {
+        _socket = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (_socket == InvalidHttpSocket)
+        {
+            continue;
+        }
+
+        if (ConnectHttpSocket(_socket, address->ai_addr, address->ai_addrlen, connectTimeout))
+        {
+            break;
+        }
+
+        CloseHttpSocket(_socket);
+        _socket = InvalidHttpSocket;
+    }
+
+    freeaddrinfo(addresses);
+
+    if (_socket == InvalidHttpSocket)
+    {
+        return false;
+    }
+
+    // Requests are written in one piece so there is nothing to gain from Nagle
+    int noDelay = 1;
+    setsockopt(_socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&noDelay), sizeof(noDelay));
+
+    // A server that stops answering fails the request instead of holding it forever
+    SetHttpSocketTimeout(_socket, ioTimeout);
+
+    if (_scheme == "https" && !StartTls())
+    {
+        Close();
+        return false;
+    }
+
+    LastUsed = std::chrono::steady_clock::now();
+
+    return true;
+}
+
+bool HttpConnection::StartTls()
+{
+    _tls = std::make_unique<TlsSession>();
+
+    return HttpTlsContext::Shared().Handshake(&_tls->ssl, _host, _port, &_socket, TlsSend, TlsReceive);
+}
+
+void HttpConnection::Close()
+{
+    if (_tls != nullptr && _socket != InvalidHttpSocket)
+    {
+        mbedtls_ssl_close_notify(&_tls->ssl);
+    }
+
+    _tls.reset();
+
+    std::lock_guard<std::mutex> lock(_socketMutex);
+
+    if (_socket != InvalidHttpSocket)
+    {
+        CloseHttpSocket(_socket);
+        _socket = InvalidHttpSocket;
+    }
+}
+
+void HttpConnection::Shutdown()
+{
+    std::lock_guard<std::mutex> lock(_socketMutex);
+
+    if (_socket != InvalidHttpSocket)
+    {
+        ::shutdown(_socket, HttpShutdownBoth);
+    }
+}
+
+bool HttpConnection::IsOpen() const
+{
+    return _socket != InvalidHttpSocket;
+}
+
+bool HttpConnection::IsStale()
+{
+    if (_socket == InvalidHttpSocket)
+    {
+        return true;
+    }
+
+    if (_tls != nullptr && mbedtls_ssl_get_bytes_avail(&_tls->ssl) > 0)
+    {
+        return true;
+    }
+
+    // An idle connection has nothing to read, anything there is either the
+    // server closing the connection or data that does not belong to a request
+    return PollHttpSocket(_socket) != 0;
+}
+
+bool HttpConnection::Write(
+    const char *data,
+    size_t size)
+{
+    while (size > 0)
+    {
+        int written;
+        if (_tls != nullptr)
+        {
+            written = mbedtls_ssl_write(&_tls->ssl, reinterpret_cast<const unsigned char *>(data), size);
+            if (written == MBEDTLS_ERR_SSL_WANT_READ || written == MBEDTLS_ERR_SSL_WANT_WRITE)
+            {
+                continue;
+            }
+        }
+        else
+        {
+            written = static_cast<int>(::send(_socket, data, static_cast<int>(std::min<size_t>(size, 1 << 30)), HttpSendFlags));
+            if (written < 0 && HttpSocketInterrupted())
+            {
+                continue;
+            }
+        }
+
+        if (written <= 0)
+        {
+            return false;
+        }
+
+        data += written;
+        size -= written;
+    }
+
+    return true;
+}
+
+int HttpConnection::Read(
+    char *buffer,
+    size_t size)
+{
+    while (true)
+    {
+        if (_tls != nullptr)
+        {
+            auto result = mbedtls_ssl_read(&_tls->ssl, reinterpret_cast<unsigned char *>(buffer), size);
+            if (result == MBEDTLS_ERR_SSL_WANT_READ || result == MBEDTLS_ERR_SSL_WANT_WRITE)
+            {
+                continue;
+            }
+
+            if (result == MBEDTLS_ERR_SSL_RECEIVED_NEW_SESSION_TICKET)
+            {
+                HttpTlsContext::Shared().SaveSession(&_tls->ssl, _host, _port);
+                continue;
+            }
+
+            if (result == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY)
+            {
+                return 0;
+            }
+
+            return result;
+        }
+
+        auto received = ::recv(_socket, buffer, static_cast<int>(std::min<size_t>(size, 1 << 30)), 0);
+        if (received < 0 && HttpSocketInterrupted())
+        {
+            continue;
+        }
+
+        return static_cast<int>(received);
+    }
+}
+
+const std::string &HttpConnection::Scheme() const
+{
+    return _scheme;
+}
+
+const std::string &HttpConnection::Host() const
+{
+    return _host;
+}
+
+int HttpConnection::Port() const
+{
+    return _port;
+}
+
+HttpConnectionPool::HttpConnectionPool() = default;
+
+HttpConnectionPool::~HttpConnectionPool() = default;
+
+std::unique_ptr<HttpConnection> HttpConnectionPool::Acquire(
+    const std::string &scheme,
+    const std::string &host,
+    int port,
+    std::chrono::milliseconds idleTimeout,
+    std::chrono::milliseconds connectTimeout,
+    std::chrono::milliseconds ioTimeout)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        auto found = _idleConnections.find(ServerKey(scheme, host, port));
+        if (found != _idleConnections.end())
+        {
+            auto &connections = found->second;
+            auto now = std::chrono::steady_clock::now();
+
+            // Most recently used connections are at the back and least likely to have timed out
+            while (!connections.empty())
+            {
+                auto connection = std::move(connections.back());
+                connections.pop_back();
+
+                if (now - connection->LastUsed <= idleTimeout && !connection->IsStale())
+                {
+                    return connection;
+                }
+            }
+        }
+    }
+
+    auto connection = std::make_unique<HttpConnection>(scheme, host, port);
+
+    if (!connection->Open(connectTimeout, ioTimeout))
+    {
+        return nullptr;
+    }
+
+    return connection;
+}
+
+void HttpConnectionPool::Release(
+    std::unique_ptr<HttpConnection> connection,
+    size_t maxIdleConnectionsPerServer)
+{
+    if (connection == nullptr || !connection->IsOpen())
+    {
+        return;
+    }
+
+    connection->LastUsed = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto &connections = _idleConnections[ServerKey(connection->Scheme(), connection->Host(), connection->Port())];
+
+    if (connections.size() < maxIdleConnectionsPerServer)
+    {
+        connections.push_back(std::move(connection));
+    }
+}
+
+void HttpConnectionPool::Clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _idleConnections.clear();
+}
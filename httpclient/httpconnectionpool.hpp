@@ -0,0 +1,112 @@
+#ifndef HTTPCONNECTIONPOOL_HPP
+#define HTTPCONNECTIONPOOL_HPP
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// A TCP connection to one server, optionally secured with TLS, that can be
+// used for more than one HTTP/1.1 request.
+class HttpConnection
+{
+public:
+    HttpConnection(
+        const std::string &scheme,
+        const std::string &host,
+        int port);
+
+    virtual ~HttpConnection();
+
+public:
+    typedef int Socket;
+
+    std::chrono::steady_clock::time_point LastUsed;
+    int RequestCount = 0;
+
+public:
+    // Gives up on connecting after connectTimeout, and on a read or write
+    // that waits longer than ioTimeout once connected
+    bool Open(
+        std::chrono::milliseconds connectTimeout,
+        std::chrono::milliseconds ioTimeout);
+
+    void Close();
+
+    // Called from another thread to end the request that is waiting on the
+    // connection, its reads and writes fail from then on
+    void Shutdown();
+
+    bool IsOpen() const;
+
+    // True when the server closed the connection or sent data while it was idle
+    bool IsStale();
+
+    bool Write(
+        const char *data,
+        size_t size);
+
+    // Returns the number of bytes read, 0 when the server closed the connection
+    // and a negative value on error
+    int Read(
+        char *buffer,
+        size_t size);
+
+    const std::string &Scheme() const;
+
+    const std::string &Host() const;
+
+    int Port() const;
+
+private:
+    struct TlsSession;
+
+    std::string _scheme;
+    std::string _host;
+    int _port = 0;
+    // Held while the socket is closed, so Shutdown never sees a closed one
+    std::mutex _socketMutex;
+    Socket _socket;
+    std::unique_ptr<TlsSession> _tls;
+
+    bool StartTls();
+};
+
+// Keeps idle connections per (scheme, host, port) so that requests to the
+// same server do not pay for a TCP and TLS handshake each time.
+class HttpConnectionPool
+{
+public:
+    HttpConnectionPool();
+
+    virtual ~HttpConnectionPool();
+
+public:
+    // Returns an idle connection that has not been idle for longer than
+    // idleTimeout or a newly opened one, nullptr when the server can not be reached
+    std::unique_ptr<HttpConnection> Acquire(
+        const std::string &scheme,
+        const std::string &host,
+        int port,
+        std::chrono::milliseconds idleTimeout,
+        std::chrono::milliseconds connectTimeout,
+        std::chrono::milliseconds ioTimeout);
+
+    // Returns a connection to the pool after its response has been read completely
+    void Release(
+        std::unique_ptr<HttpConnection> connection,
+        size_t maxIdleConnectionsPerServer);
+
+    void Clear();
+
+private:
+    typedef std::tuple<std::string, std::string, int> ServerKey;
+
+    std::mutex _mutex;
+    std::map<ServerKey, std::vector<std::unique_ptr<HttpConnection>>> _idleConnections;
+};
+
+#endif // HTTPCONNECTIONPOOL_HPP
@@ -1,22 +1,125 @@
 #include "httpcontent.hpp"
 
+#include <algorithm>
+#include <climits>
+
+// Streams a buffer owned by the content that created it.
+class BufferContentStream : public HttpContentStream
+{
+public:
+    BufferContentStream(
+        std::string_view buffer)
+        : _buffer(buffer)
+    {}
+
+    int Read(
+        char *buffer,
+        size_t size)
+    {
+        auto count = _buffer.copy(buffer, std::min(size, static_cast<size_t>(INT_MAX)));
+        _buffer.remove_prefix(count);
+
+        return static_cast<int>(count);
+    }
+
+private:
+    std::string_view _buffer;
+};
+
+HttpContentStream::~HttpContentStream() = default;
+
 HttpContent::HttpContent() {}
 
 HttpContent::~HttpContent() {}
 
 std::vector<std::byte> HttpContent::ReadAsByteArray()
 {
-    return Stream();
+    auto s = ReadAsStringView();
+
+    auto bytes = reinterpret_cast<const std::byte *>(s.data());
+
+    return std::vector<std::byte>(bytes, bytes + s.size());
 }
 
 std::string HttpContent::ReadAsString()
 {
-    auto &s = Stream();
+    return std::string(ReadAsStringView());
+}
 
-    if (s.empty())
+std::string_view HttpContent::ReadAsStringView()
+{
+    if (!LoadIntoBuffer())
     {
-        return "";
+        return std::string_view();
     }
 
-    return std::string(reinterpret_cast<const char *>(&s[0]), s.size());
+    return Buffer();
+}
+
+std::shared_ptr<HttpContentStream> HttpContent::ReadAsStream()
+{
+    auto stream = CreateContentStream();
+
+    if (stream != nullptr)
+    {
+        return stream;
+    }
+
+    return std::make_shared<BufferContentStream>(ReadAsStringView());
+}
+
+bool HttpContent::CopyTo(
+    const std::function<bool(std::string_view)> &write)
+{
+    auto stream = CreateContentStream();
+
+    if (stream == nullptr)
+    {
+        if (!LoadIntoBuffer())
+        {
+            return false;
+        }
+
+        auto buffer = Buffer();
+
+        return buffer.empty() || write(buffer);
+    }
+
+    char block[65536];
+    while (true)
+    {
+        auto read = stream->Read(block, sizeof(block));
+        if (read == 0)
+        {
+            return true;
+        }
+
+        if (read < 0 || !write(std::string_view(block, read)))
+        {
+            return false;
+        }
+    }
+}
+
+bool HttpContent::LoadIntoBuffer()
+{
+    return true;
+}
+
+bool HttpContent::TryComputeLength(
+    size_t &length)
+{
+    if (!LoadIntoBuffer())
+    {
+        return false;
+    }
+
+    length = Buffer().size();
+
+    return true;
+}
+
+std::shared_ptr<HttpContentStream> HttpContent::CreateContentStream()
+{
+    return nullptr;
 }
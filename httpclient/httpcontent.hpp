@@ -1,10 +1,27 @@
 #ifndef HTTPCONTENT_HPP
 #define HTTPCONTENT_HPP
 
+#include <functional>
 #include <map>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
+// Reads content piece by piece, without holding all of it in memory.
+class HttpContentStream
+{
+public:
+    virtual ~HttpContentStream();
+
+public:
+    // Returns the number of bytes read, 0 at the end of the content and a
+    // negative value on error
+    virtual int Read(
+        char *buffer,
+        size_t size) = 0;
+};
+
 class HttpContent
 {
 public:
@@ -20,8 +37,32 @@ public:
 
     std::string ReadAsString();
 
+    // The content without copying it, valid for as long as the content is
+    std::string_view ReadAsStringView();
+
+    // A stream over the content, content that is not buffered yet can only be
+    // streamed once
+    std::shared_ptr<HttpContentStream> ReadAsStream();
+
+    // Calls write with the content piece by piece as it becomes available,
+    // stops and returns false when write returns false or reading fails
+    bool CopyTo(
+        const std::function<bool(std::string_view)> &write);
+
+    // Reads streamed content to its end so it can be read more than once
+    virtual bool LoadIntoBuffer();
+
+    // Sets length to the size of the content when it is known up front
+    virtual bool TryComputeLength(
+        size_t &length);
+
 protected:
-    virtual const std::vector<std::byte> &Stream() = 0;
+    // The content held in memory, only called after LoadIntoBuffer succeeded
+    virtual std::string_view Buffer() = 0;
+
+    // A stream for content that is not held in memory, nullptr when the
+    // content is read from Buffer
+    virtual std::shared_ptr<HttpContentStream> CreateContentStream();
 };
 
 #endif // HTTPCONTENT_HPP
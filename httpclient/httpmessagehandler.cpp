@@ -1,14 +1,62 @@
 #include "httpmessagehandler.hpp"
 
 #include "bytearraycontent.hpp"
-#define WIN32_LEAN_AND_MEAN 1
+#include "decompressingcontentstream.hpp"
+#include "httpcancellation.hpp"
+#include "httpresponsecache.hpp"
+#include "streamcontent.hpp"
 #include <algorithm>
+#include <cctype>
+#include <climits>
 #include <sstream>
 #include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN 1
 #include <windows.h>
 #include <wininet.h>
+#define strcasecmp _stricmp
+#else
+#include "httpconnectionpool.hpp"
+#include <strings.h>
+#endif
 
+#ifdef _WIN32
 HttpMessageHandler::HttpMessageHandler() = default;
+#else
+HttpMessageHandler::HttpMessageHandler()
+    : _connectionPool(std::make_shared<HttpConnectionPool>())
+{}
+#endif
+
+HttpMessageHandler::~HttpMessageHandler() = default;
+
+std::shared_ptr<HttpResponseMessage> HttpMessageHandler::Send(
+    const std::shared_ptr<HttpRequestMessage> &request,
+    HttpCompletionOption completionOption,
+    const std::shared_ptr<HttpCancellation> &cancellation)
+{
+    if (ResponseCache != nullptr)
+    {
+        return ResponseCache->Send(
+            request,
+            completionOption,
+            [this, cancellation](const std::shared_ptr<HttpRequestMessage> &requestToSend, HttpCompletionOption option) {
+                return SendToServer(requestToSend, option, cancellation);
+            });
+    }
+
+    return SendToServer(request, completionOption, cancellation);
+}
+
+std::string GetScheme(
+    const std::string &url)
+{
+    size_t found = url.find_first_of(":");
+
+    return url.substr(0, found);
+}
 
 std::string GetHost(
     const std::string &url)
@@ -35,6 +83,10 @@ std::string GetPath(
     std::string url_new = url.substr(found + 3); // url_new is the url excluding the http part
 
     size_t found2 = url_new.find_first_of("/");
+    if (found2 == std::string::npos)
+    {
+        return "/";
+    }
 
     std::string path = url_new.substr(found2);
 
@@ -68,10 +120,10 @@ int GetPort(
 
     if (protocol == "https")
     {
-        return INTERNET_DEFAULT_HTTPS_PORT;
+        return 443;
     }
 
-    return INTERNET_DEFAULT_HTTP_PORT;
+    return 80;
 }
 
 std::string GetHeaders(
@@ -79,14 +131,54 @@ std::string GetHeaders(
 {
     std::stringstream ss;
 
-    for (auto &header : request->Headers())
+    for (auto &header : request->Headers)
     {
         ss << header.first << ": " << header.second << "\n";
     }
 
+    if (request->Content != nullptr)
+    {
+        for (auto &header : request->Content->Headers)
+        {
+            ss << header.first << ": " << header.second << "\n";
+        }
+    }
+
     return ss.str();
 }
 
+bool HasRequestHeader(
+    const std::shared_ptr<HttpRequestMessage> &request,
+    const char *name)
+{
+    auto sameName = [name](const std::string &headerName) {
+        return std::equal(headerName.begin(), headerName.end(), name, name + strlen(name), [](char a, char b) {
+            return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+        });
+    };
+
+    for (auto &header : request->Headers)
+    {
+        if (sameName(header.first))
+        {
+            return true;
+        }
+    }
+
+    if (request->Content != nullptr)
+    {
+        for (auto &header : request->Content->Headers)
+        {
+            if (sameName(header.first))
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
 const char *GetMethod(
     const std::shared_ptr<HttpRequestMessage> &request)
 {
@@ -105,21 +197,180 @@ const char *GetMethod(
         return "PUT";
     }
 
+    if (request->Method == HttpMethod::Delete)
+    {
+        return "DELETE";
+    }
+
+    if (request->Method == HttpMethod::Head)
+    {
+        return "HEAD";
+    }
+
+    if (request->Method == HttpMethod::Options)
+    {
+        return "OPTIONS";
+    }
+
     return "GET";
 }
 
-std::shared_ptr<HttpResponseMessage> HttpMessageHandler::Send(
-    const std::shared_ptr<HttpRequestMessage> &request)
+const std::string *FindHeader(
+    const std::map<std::string, std::string> &headers,
+    const char *name)
+{
+    for (auto &header : headers)
+    {
+        if (strcasecmp(header.first.c_str(), name) == 0)
+        {
+            return &header.second;
+        }
+    }
+
+    return nullptr;
+}
+
+bool HeaderContains(
+    const std::map<std::string, std::string> &headers,
+    const char *name,
+    const char *token)
 {
-    static HINTERNET hsession;
-    hsession = InternetOpenA("wininet-test", INTERNET_OPEN_TYPE_PRECONFIG, NULL, NULL, 0);
+    auto value = FindHeader(headers, name);
+    if (value == nullptr)
+    {
+        return false;
+    }
+
+    auto lowerValue = *value;
+    std::transform(lowerValue.begin(), lowerValue.end(), lowerValue.begin(), ::tolower);
+
+    return lowerValue.find(token) != std::string::npos;
+}
+
+// Finds the encoding of content that can be decoded while it is read. The
+// Content-Encoding and Content-Length headers are removed, since they
+// describe the encoded content.
+bool TakeContentEncoding(
+    std::map<std::string, std::string> &headers,
+    ContentEncoding &encoding)
+{
+    auto contentEncoding = FindHeader(headers, "Content-Encoding");
+    if (contentEncoding == nullptr)
+    {
+        return false;
+    }
+
+    if (strcasecmp(contentEncoding->c_str(), "gzip") == 0 || strcasecmp(contentEncoding->c_str(), "x-gzip") == 0)
+    {
+        encoding = ContentEncoding::GZip;
+    }
+    else if (strcasecmp(contentEncoding->c_str(), "deflate") == 0)
+    {
+        encoding = ContentEncoding::Deflate;
+    }
+    else
+    {
+        return false;
+    }
+
+    for (auto header = headers.begin(); header != headers.end();)
+    {
+        if (strcasecmp(header->first.c_str(), "Content-Encoding") == 0 ||
+            strcasecmp(header->first.c_str(), "Content-Length") == 0)
+        {
+            header = headers.erase(header);
+        }
+        else
+        {
+            ++header;
+        }
+    }
+
+    return true;
+}
+
+#ifdef _WIN32
+
+// Reads the status code and the headers WinINet received into response
+void ReadResponseHead(
+    HINTERNET hrequest,
+    const std::shared_ptr<HttpResponseMessage> &response)
+{
+    DWORD statusCode = 0;
+    DWORD size = sizeof(statusCode);
+    if (HttpQueryInfoA(hrequest, HTTP_QUERY_STATUS_CODE | HTTP_QUERY_FLAG_NUMBER, &statusCode, &size, NULL))
+    {
+        response->StatusCode = static_cast<HttpStatusCode>(statusCode);
+    }
+
+    // The first call only tells the size of the headers
+    size = 0;
+    HttpQueryInfoA(hrequest, HTTP_QUERY_RAW_HEADERS_CRLF, NULL, &size, NULL);
+
+    std::string headers(size, '\0');
+    if (size == 0 || !HttpQueryInfoA(hrequest, HTTP_QUERY_RAW_HEADERS_CRLF, &headers[0], &size, NULL))
+    {
+        return;
+    }
+    headers.resize(size);
+
+    std::istringstream lines(headers);
+    std::string headerLine;
+
+    // The status line comes first
+    std::getline(lines, headerLine);
+
+    while (std::getline(lines, headerLine))
+    {
+        if (!headerLine.empty() && headerLine.back() == '\r')
+        {
+            headerLine.pop_back();
+        }
+
+        auto colon = headerLine.find(':');
+        if (colon == std::string::npos)
+        {
+            continue;
+        }
+
+        auto name = headerLine.substr(0, colon);
+        auto valueStart = headerLine.find_first_not_of(" \t", colon + 1);
+        auto value = valueStart == std::string::npos ? std::string() : headerLine.substr(valueStart);
+
+        auto &existing = response->Headers[name];
+        existing = existing.empty() ? value : existing + ", " + value;
+    }
+}
+
+// WinINet keeps its own connections and does its own TLS, so there is no
+// connection pool on Windows. The content is always read before this returns.
+std::shared_ptr<HttpResponseMessage> HttpMessageHandler::SendToServer(
+    const std::shared_ptr<HttpRequestMessage> &request,
+    HttpCompletionOption completionOption,
+    const std::shared_ptr<HttpCancellation> &cancellation)
+{
+    (void)completionOption;
+
+    auto response = std::make_shared<HttpResponseMessage>();
+
+    HINTERNET hsession = InternetOpenA("wininet-test", INTERNET_OPEN_TYPE_PRECONFIG, NULL, NULL, 0);
+    if (hsession == NULL)
+    {
+        return response;
+    }
+
+    DWORD connectTimeout = static_cast<DWORD>(ConnectTimeout.count());
+    DWORD readWriteTimeout = static_cast<DWORD>(ReadWriteTimeout.count());
+    InternetSetOptionA(hsession, INTERNET_OPTION_CONNECT_TIMEOUT, &connectTimeout, sizeof(connectTimeout));
+    InternetSetOptionA(hsession, INTERNET_OPTION_SEND_TIMEOUT, &readWriteTimeout, sizeof(readWriteTimeout));
+    InternetSetOptionA(hsession, INTERNET_OPTION_RECEIVE_TIMEOUT, &readWriteTimeout, sizeof(readWriteTimeout));
 
     auto server = GetHost(request->RequestUri);
 
-    HINTERNET hconnect = InternetConnect(
+    HINTERNET hconnect = InternetConnectA(
         hsession,
         server.c_str(),
-        GetPort(request->RequestUri),
+        static_cast<INTERNET_PORT>(GetPort(request->RequestUri)),
         NULL,
         NULL,
         INTERNET_SERVICE_HTTP,
@@ -128,57 +379,689 @@ std::shared_ptr<HttpResponseMessage> HttpMessageHandler::Send(
 
     auto objectName = GetPath(request->RequestUri);
 
-    const char *accept[] = {"text/xml", NULL};
-    HINTERNET hrequest = HttpOpenRequest(
+    // Responses are cached by HttpResponseCache when asked for, not by WinINet
+    DWORD flags = INTERNET_FLAG_RELOAD | INTERNET_FLAG_NO_CACHE_WRITE;
+    if (GetScheme(request->RequestUri) == "https")
+    {
+        flags |= INTERNET_FLAG_SECURE;
+    }
+
+    const char *accept[] = {"*/*", NULL};
+    HINTERNET hrequest = hconnect == NULL ? NULL : HttpOpenRequestA(
         hconnect,
         GetMethod(request),
         objectName.c_str(),
         NULL,
         NULL,
         accept,
-        0,
+        flags,
         0);
 
-    auto header = GetHeaders(request);
-    std::string content;
+    // A request that is not attached is not sent, the requests were cancelled already
+    bool attached = hrequest != NULL && (cancellation == nullptr || cancellation->Attach(hrequest));
+
+    if (attached)
+    {
+        auto header = GetHeaders(request);
+        std::string_view content;
+
+        // WinINet decodes the content itself while it is read
+        auto decompress = AutomaticDecompression && !HasRequestHeader(request, "Accept-Encoding");
+        if (decompress)
+        {
+            header += "Accept-Encoding: gzip, deflate\n";
+
+            BOOL decoding = TRUE;
+            InternetSetOptionA(hrequest, INTERNET_OPTION_HTTP_DECODING, &decoding, sizeof(decoding));
+        }
+
+        if (request->Content != nullptr && request->Content->LoadIntoBuffer())
+        {
+            content = request->Content->ReadAsStringView();
+        }
+
+        auto sendRequest = HttpSendRequestA(
+            hrequest,
+            header.c_str(),
+            static_cast<DWORD>(header.size()),
+            (LPVOID)content.data(),
+            static_cast<DWORD>(content.size()));
+
+        if (sendRequest)
+        {
+            ReadResponseHead(hrequest, response);
+
+            ContentEncoding encoding;
+            if (decompress)
+            {
+                // The headers describe the encoded content that WinINet decoded
+                TakeContentEncoding(response->Headers, encoding);
+            }
+
+            // Read straight into the end of the content so it is not copied again
+            const DWORD blocksize = 65536;
+            DWORD received = 0;
+            size_t used = 0;
+            std::vector<std::byte> data(blocksize);
+            BOOL read;
+            while ((read = InternetReadFile(hrequest, &data[used], static_cast<DWORD>(std::min<size_t>(data.size() - used, UINT_MAX)), &received)) && received)
+            {
+                used += received;
+                if (used == data.size())
+                {
+                    data.resize(used * 2);
+                }
+            }
+            data.resize(used);
+
+            // Content that ended early, for example because the request was
+            // cancelled, is left out
+            if (read)
+            {
+                response->Content = std::make_shared<ByteArrayContent>(std::move(data));
+            }
+        }
+    }
+
+    // Cancel closed the handle already when it is no longer attached
+    if (hrequest && (!attached || cancellation == nullptr || cancellation->Detach(hrequest))) InternetCloseHandle(hrequest);
+    if (hconnect) InternetCloseHandle(hconnect);
+    if (hsession) InternetCloseHandle(hsession);
+
+    return response;
+}
+#else
+
+std::string FormatRequest(
+    const std::shared_ptr<HttpRequestMessage> &request,
+    bool acceptEncoding,
+    bool &chunked)
+{
+    auto scheme = GetScheme(request->RequestUri);
+    auto port = GetPort(request->RequestUri);
+    auto defaultPort = scheme == "https" ? 443 : 80;
+
+    std::stringstream ss;
+
+    ss << GetMethod(request) << " " << GetPath(request->RequestUri) << " HTTP/1.1\r\n";
+    ss << "Host: " << GetHost(request->RequestUri);
+    if (port != defaultPort)
+    {
+        ss << ":" << port;
+    }
+    ss << "\r\n";
+
+    auto writeHeaders = [&](const std::map<std::string, std::string> &headers) {
+        for (auto &header : headers)
+        {
+            if (strcasecmp(header.first.c_str(), "Content-Length") != 0 &&
+                strcasecmp(header.first.c_str(), "Transfer-Encoding") != 0)
+            {
+                ss << header.first << ": " << header.second << "\r\n";
+            }
+        }
+    };
+
+    writeHeaders(request->Headers);
+
+    if (acceptEncoding)
+    {
+        ss << "Accept-Encoding: gzip, deflate\r\n";
+    }
 
     if (request->Content != nullptr)
     {
-        content = request->Content->ReadAsString();
+        writeHeaders(request->Content->Headers);
     }
 
-    auto sendRequest = HttpSendRequest(
-        hrequest,
-        header.c_str(),
-        header.size(),
-        (LPVOID)content.c_str(),
-        content.size());
+    chunked = false;
 
-    auto response = std::make_shared<HttpResponseMessage>();
-    if (sendRequest)
+    if (request->Content != nullptr)
+    {
+        size_t length;
+        if (request->Content->TryComputeLength(length))
+        {
+            ss << "Content-Length: " << length << "\r\n";
+        }
+        else
+        {
+            ss << "Transfer-Encoding: chunked\r\n";
+            chunked = true;
+        }
+    }
+
+    ss << "\r\n";
+
+    return ss.str();
+}
+
+// Writes the request head followed by its content as the content is read.
+// Small pieces are collected so a small request goes out in a single write.
+bool WriteRequest(
+    HttpConnection &connection,
+    const std::shared_ptr<HttpRequestMessage> &request,
+    const std::string &requestHead,
+    bool chunked)
+{
+    const size_t collectLimit = 16384;
+
+    std::string pending = requestHead;
+
+    auto send = [&](std::string_view data) {
+        if (pending.size() + data.size() <= collectLimit)
+        {
+            pending.append(data);
+            return true;
+        }
+
+        if (!pending.empty())
+        {
+            if (!connection.Write(pending.data(), pending.size()))
+            {
+                return false;
+            }
+            pending.clear();
+        }
+
+        if (data.size() <= collectLimit)
+        {
+            pending.append(data);
+            return true;
+        }
+
+        return connection.Write(data.data(), data.size());
+    };
+
+    if (request->Content != nullptr)
     {
-        DWORD blocksize = 4096;
-        DWORD received = 0;
-        std::string block(blocksize, 0);
-        std::string result;
-        while (InternetReadFile(hrequest, &block[0], blocksize, &received) && received)
+        auto written = request->Content->CopyTo([&](std::string_view piece) {
+            if (!chunked)
+            {
+                return send(piece);
+            }
+
+            // An empty chunk would end the content
+            if (piece.empty())
+            {
+                return true;
+            }
+
+            char chunkSize[24];
+            snprintf(chunkSize, sizeof(chunkSize), "%zx\r\n", piece.size());
+
+            return send(chunkSize) && send(piece) && send("\r\n");
+        });
+
+        if (!written || (chunked && !send("0\r\n\r\n")))
         {
-            block.resize(received);
-            result += block;
+            return false;
         }
-        std::vector<std::byte> data(result.size() + 1);
-        std::transform(
-            result.begin(),
-            result.end(),
-            data.begin(),
-            [](char c) { return std::byte(c); });
+    }
 
-        response->Content = std::make_shared<ByteArrayContent>(data);
+    return pending.empty() || connection.Write(pending.data(), pending.size());
+}
+
+// Reads one response from a connection, keeping bytes received past the part
+// that has been consumed so far in a buffer.
+class ResponseReader
+{
+public:
+    ResponseReader(
+        HttpConnection &connection)
+        : _connection(connection)
+    {}
+
+    size_t Received = 0;
+
+    bool ReadLine(
+        std::string &line)
+    {
+        size_t end;
+        while ((end = _buffer.find("\r\n", _position)) == std::string::npos)
+        {
+            if (!Fill())
+            {
+                return false;
+            }
+        }
+
+        line = _buffer.substr(_position, end - _position);
+        _position = end + 2;
+
+        return true;
     }
 
-    if (hrequest) InternetCloseHandle(hrequest);
-    if (hconnect) InternetCloseHandle(hconnect);
-    if (hsession) InternetCloseHandle(hsession);
+    // Returns bytes that are buffered already, when there are none the
+    // connection is read straight into buffer
+    int ReadSome(
+        char *buffer,
+        size_t size)
+    {
+        size = std::min(size, static_cast<size_t>(INT_MAX));
+
+        if (_position < _buffer.size())
+        {
+            auto count = _buffer.copy(buffer, size, _position);
+            _position += count;
+
+            return static_cast<int>(count);
+        }
+
+        auto read = _connection.Read(buffer, size);
+        if (read > 0)
+        {
+            Received += read;
+        }
+
+        return read;
+    }
+
+private:
+    HttpConnection &_connection;
+    std::string _buffer;
+    size_t _position = 0;
+
+    bool Fill()
+    {
+        if (_position > 0 && _position == _buffer.size())
+        {
+            _buffer.clear();
+            _position = 0;
+        }
+
+        char block[16384];
+        auto read = _connection.Read(block, sizeof(block));
+        if (read <= 0)
+        {
+            return false;
+        }
+
+        _buffer.append(block, read);
+        Received += read;
+
+        return true;
+    }
+};
+
+enum class BodyFraming
+{
+    None,
+    ContentLength,
+    Chunked,
+    UntilClosed,
+};
+
+// Reads a response body from its connection while the content is consumed,
+// the connection goes back to the pool once the body has been read completely.
+class ResponseContentStream : public HttpContentStream
+{
+public:
+    ResponseContentStream(
+        const std::shared_ptr<HttpConnectionPool> &connectionPool,
+        size_t maxIdleConnectionsPerServer,
+        std::unique_ptr<HttpConnection> connection,
+        const std::shared_ptr<HttpCancellation> &cancellation,
+        std::unique_ptr<ResponseReader> reader,
+        BodyFraming framing,
+        size_t contentLength,
+        bool keepAlive)
+        : _connectionPool(connectionPool),
+          _maxIdleConnectionsPerServer(maxIdleConnectionsPerServer),
+          _connection(std::move(connection)),
+          _cancellation(cancellation),
+          _reader(std::move(reader)),
+          _framing(framing),
+          _remaining(contentLength),
+          _keepAlive(keepAlive && framing != BodyFraming::UntilClosed)
+    {}
+
+    virtual ~ResponseContentStream()
+    {
+        // A connection with unread content left on it can not be reused
+        _reader.reset();
+
+        if (_cancellation != nullptr && _connection != nullptr)
+        {
+            _cancellation->Detach(_connection.get());
+        }
+    }
+
+    int Read(
+        char *buffer,
+        size_t size)
+    {
+        if (_reader == nullptr)
+        {
+            return _failed ? -1 : 0;
+        }
+
+        auto read = ReadBody(buffer, size);
+
+        if (read <= 0)
+        {
+            _failed = read < 0;
+            _reader.reset();
+
+            if (_cancellation != nullptr)
+            {
+                _cancellation->Detach(_connection.get());
+            }
+
+            if (!_failed && _keepAlive)
+            {
+                _connectionPool->Release(std::move(_connection), _maxIdleConnectionsPerServer);
+            }
+
+            _connection.reset();
+        }
+
+        return read;
+    }
+
+private:
+    std::shared_ptr<HttpConnectionPool> _connectionPool;
+    size_t _maxIdleConnectionsPerServer;
+    std::unique_ptr<HttpConnection> _connection;
+    // The connection is attached to it until the content has been read
+    std::shared_ptr<HttpCancellation> _cancellation;
+    std::unique_ptr<ResponseReader> _reader;
+    BodyFraming _framing;
+    size_t _remaining;
+    bool _keepAlive;
+    bool _chunkEndPending = false;
+    bool _failed = false;
+
+    int ReadBody(
+        char *buffer,
+        size_t size)
+    {
+        switch (_framing)
+        {
+            case BodyFraming::None:
+            {
+                return 0;
+            }
+            case BodyFraming::UntilClosed:
+            {
+                return _reader->ReadSome(buffer, size);
+            }
+            case BodyFraming::ContentLength:
+            {
+                return ReadRemaining(buffer, size);
+            }
+            case BodyFraming::Chunked:
+            {
+                if (_remaining == 0 && !StartChunk())
+                {
+                    return -1;
+                }
+
+                // The last chunk has size 0
+                if (_remaining == 0)
+                {
+                    return 0;
+                }
+
+                auto read = ReadRemaining(buffer, size);
+                _chunkEndPending = read > 0 && _remaining == 0;
+
+                return read;
+            }
+        }
+
+        return -1;
+    }
+
+    int ReadRemaining(
+        char *buffer,
+        size_t size)
+    {
+        if (_remaining == 0)
+        {
+            return 0;
+        }
+
+        auto read = _reader->ReadSome(buffer, std::min(size, _remaining));
+        if (read <= 0)
+        {
+            // The connection ended before the content did
+            return -1;
+        }
+
+        _remaining -= read;
+
+        return read;
+    }
+
+    bool StartChunk()
+    {
+        std::string line;
+
+        if (_chunkEndPending)
+        {
+            if (!_reader->ReadLine(line))
+            {
+                return false;
+            }
+            _chunkEndPending = false;
+        }
+
+        if (!_reader->ReadLine(line))
+        {
+            return false;
+        }
+
+        _remaining = strtoull(line.c_str(), nullptr, 16);
+
+        if (_remaining == 0)
+        {
+            // Skip trailers up to the empty line that ends the message
+            do
+            {
+                if (!_reader->ReadLine(line))
+                {
+                    return false;
+                }
+            } while (!line.empty());
+        }
+
+        return true;
+    }
+};
+
+enum class ExchangeResult
+{
+    HeadersRead,
+    Failed,
+    FailedBeforeResponse,
+};
+
+// Sends the request and reads the response up to and including its headers
+ExchangeResult Exchange(
+    HttpConnection &connection,
+    ResponseReader &reader,
+    const std::shared_ptr<HttpRequestMessage> &request,
+    const std::string &requestHead,
+    bool chunked,
+    const std::shared_ptr<HttpResponseMessage> &response,
+    BodyFraming &framing,
+    size_t &contentLength,
+    bool &keepAlive)
+{
+    if (!WriteRequest(connection, request, requestHead, chunked))
+    {
+        return ExchangeResult::FailedBeforeResponse;
+    }
+
+    int statusCode = 0;
+    bool http11 = false;
+    do
+    {
+        std::string statusLine;
+        if (!reader.ReadLine(statusLine))
+        {
+            return reader.Received == 0 ? ExchangeResult::FailedBeforeResponse : ExchangeResult::Failed;
+        }
+
+        auto firstSpace = statusLine.find(' ');
+        if (firstSpace == std::string::npos)
+        {
+            return ExchangeResult::Failed;
+        }
+
+        http11 = statusLine.compare(0, firstSpace, "HTTP/1.1") == 0;
+        statusCode = atoi(statusLine.c_str() + firstSpace + 1);
+
+        response->Headers.clear();
+        std::string headerLine;
+        while (true)
+        {
+            if (!reader.ReadLine(headerLine))
+            {
+                return ExchangeResult::Failed;
+            }
+
+            if (headerLine.empty())
+            {
+                break;
+            }
+
+            auto colon = headerLine.find(':');
+            if (colon == std::string::npos)
+            {
+                continue;
+            }
+
+            auto name = headerLine.substr(0, colon);
+            auto valueStart = headerLine.find_first_not_of(" \t", colon + 1);
+            auto value = valueStart == std::string::npos ? std::string() : headerLine.substr(valueStart);
+
+            auto &existing = response->Headers[name];
+            existing = existing.empty() ? value : existing + ", " + value;
+        }
+        // Interim 1xx responses are followed by the real one
+    } while (statusCode >= 100 && statusCode < 200);
+
+    response->StatusCode = static_cast<HttpStatusCode>(statusCode);
+
+    keepAlive = http11
+                    ? !HeaderContains(response->Headers, "Connection", "close")
+                    : HeaderContains(response->Headers, "Connection", "keep-alive");
+
+    auto length = FindHeader(response->Headers, "Content-Length");
+    contentLength = 0;
+
+    if (request->Method == HttpMethod::Head || statusCode == 204 || statusCode == 304)
+    {
+        framing = BodyFraming::None;
+    }
+    else if (HeaderContains(response->Headers, "Transfer-Encoding", "chunked"))
+    {
+        framing = BodyFraming::Chunked;
+    }
+    else if (length != nullptr)
+    {
+        framing = BodyFraming::ContentLength;
+        contentLength = strtoull(length->c_str(), nullptr, 10);
+    }
+    else
+    {
+        // The body ends when the server closes the connection
+        framing = BodyFraming::UntilClosed;
+    }
+
+    return ExchangeResult::HeadersRead;
+}
+
+std::shared_ptr<HttpResponseMessage> HttpMessageHandler::SendToServer(
+    const std::shared_ptr<HttpRequestMessage> &request,
+    HttpCompletionOption completionOption,
+    const std::shared_ptr<HttpCancellation> &cancellation)
+{
+    auto scheme = GetScheme(request->RequestUri);
+    auto host = GetHost(request->RequestUri);
+    auto port = GetPort(request->RequestUri);
+
+    auto decompress = AutomaticDecompression && !HasRequestHeader(request, "Accept-Encoding");
+
+    bool chunked;
+    auto requestHead = FormatRequest(request, decompress, chunked);
+
+    auto response = std::make_shared<HttpResponseMessage>();
+
+    // A pooled connection may have been closed by the server just as it was
+    // taken from the pool, in that case the request is sent once more on a new one
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        auto connection = _connectionPool->Acquire(scheme, host, port, PooledConnectionIdleTimeout, ConnectTimeout, ReadWriteTimeout);
+        if (connection == nullptr)
+        {
+            break;
+        }
+
+        // A connection that is not attached is not used, the requests were cancelled while it was opened
+        if (cancellation != nullptr && !cancellation->Attach(connection.get()))
+        {
+            break;
+        }
+
+        bool reused = connection->RequestCount > 0;
+        connection->RequestCount++;
+
+        auto reader = std::make_unique<ResponseReader>(*connection);
+        BodyFraming framing;
+        size_t contentLength;
+        bool keepAlive;
+
+        auto result = Exchange(*connection, *reader, request, requestHead, chunked, response, framing, contentLength, keepAlive);
+
+        if (result == ExchangeResult::HeadersRead)
+        {
+            auto stream = std::make_shared<ResponseContentStream>(
+                _connectionPool,
+                MaxIdleConnectionsPerServer,
+                std::move(connection),
+                cancellation,
+                std::move(reader),
+                framing,
+                contentLength,
+                keepAlive);
+
+            ContentEncoding encoding;
+            if (decompress && framing != BodyFraming::None && TakeContentEncoding(response->Headers, encoding))
+            {
+                response->Content = std::make_shared<StreamContent>(
+                    std::make_shared<DecompressingContentStream>(stream, encoding));
+            }
+            else if (framing == BodyFraming::ContentLength)
+            {
+                response->Content = std::make_shared<StreamContent>(stream, contentLength);
+            }
+            else
+            {
+                response->Content = std::make_shared<StreamContent>(stream);
+            }
+
+            if (completionOption == HttpCompletionOption::ResponseContentRead && !response->Content->LoadIntoBuffer())
+            {
+                response->Content = nullptr;
+            }
+
+            return response;
+        }
+
+        if (cancellation != nullptr)
+        {
+            cancellation->Detach(connection.get());
+        }
+
+        if (result != ExchangeResult::FailedBeforeResponse || !reused)
+        {
+            break;
+        }
+    }
 
     return response;
 }
+
+#endif
@@ -1,18 +1,60 @@
 #ifndef HTTPMESSAGEHANDLER_HPP
 #define HTTPMESSAGEHANDLER_HPP
 
+#include "httpcompletionoption.hpp"
 #include "httprequestmessage.hpp"
 #include "httpresponsemessage.hpp"
+#include <chrono>
+#include <memory>
+
+class HttpCancellation;
+class HttpConnectionPool;
+class HttpResponseCache;
 
 class HttpMessageHandler
 {
 public:
     HttpMessageHandler();
 
+    virtual ~HttpMessageHandler();
+
+public:
+    // How long an idle keep-alive connection is kept for reuse
+    std::chrono::milliseconds PooledConnectionIdleTimeout = std::chrono::seconds(60);
+
+    // How long opening a connection may take
+    std::chrono::milliseconds ConnectTimeout = std::chrono::seconds(30);
+
+    // How long a read or write on a connection may wait for the server
+    std::chrono::milliseconds ReadWriteTimeout = std::chrono::seconds(100);
+
+    // How many idle connections are kept for each scheme, host and port
+    size_t MaxIdleConnectionsPerServer = 8;
+
+    // Asks for gzip or deflate encoded responses and decodes them while they
+    // are read, unless the request sets Accept-Encoding itself
+    bool AutomaticDecompression = true;
+
+    // GET responses are answered from and stored in this cache when it is set
+    std::shared_ptr<HttpResponseCache> ResponseCache;
+
+public:
+    // With HttpCompletionOption::ResponseHeadersRead the response content
+    // streams from the connection, which is only reused once the content has
+    // been read to its end. Cancelling cancellation ends the request, also
+    // while its content is read.
     std::shared_ptr<HttpResponseMessage> Send(
-        const std::shared_ptr<HttpRequestMessage> &request);
+        const std::shared_ptr<HttpRequestMessage> &request,
+        HttpCompletionOption completionOption = HttpCompletionOption::ResponseContentRead,
+        const std::shared_ptr<HttpCancellation> &cancellation = nullptr);
 
 private:
+    std::shared_ptr<HttpConnectionPool> _connectionPool;
+
+    std::shared_ptr<HttpResponseMessage> SendToServer(
+        const std::shared_ptr<HttpRequestMessage> &request,
+        HttpCompletionOption completionOption,
+        const std::shared_ptr<HttpCancellation> &cancellation);
 };
 
 #endif // HTTPMESSAGEHANDLER_HPP
@@ -14,14 +14,3 @@ HttpRequestMessage::HttpRequestMessage(
 {}
 
 HttpRequestMessage::~HttpRequestMessage() = default;
-
-const std::map<std::string, std::string> &HttpRequestMessage::Headers() const
-{
-    if (Content == nullptr)
-    {
-        static std::map<std::string, std::string> empty;
-        return empty;
-    }
-
-    return Content->Headers;
-}
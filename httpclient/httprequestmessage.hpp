@@ -23,11 +23,10 @@ public:
 
 public:
     std::shared_ptr<HttpContent> Content;
+    // Sent along with the headers of Content
+    std::map<std::string, std::string> Headers;
     const HttpMethod Method = HttpMethod::Get;
     const std::string RequestUri;
-
-public:
-    const std::map<std::string, std::string> &Headers() const;
 };
 
 #endif // HTTPREQUESTMESSAGE_HPP
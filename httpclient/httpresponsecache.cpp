@@ -0,0 +1,909 @@
+#include "httpresponsecache.hpp"
+
+#include "streamcontent.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <list>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+struct CachedResponse
+{
+    std::string uri;
+    int statusCode = 200;
+    std::map<std::string, std::string> headers;
+    // The request headers named by Vary, the response only answers requests
+    // that send the same values
+    std::map<std::string, std::string> varyHeaders;
+    std::shared_ptr<const std::string> content;
+    // Seconds since the epoch at which the response was received or last revalidated
+    long long storedAt = 0;
+};
+
+// Content of a stored response, shared with the cache instead of copied
+class CachedContent : public HttpContent
+{
+public:
+    CachedContent(
+        const std::shared_ptr<const std::string> &content)
+        : _content(content)
+    {}
+
+protected:
+    std::string_view Buffer()
+    {
+        return *_content;
+    }
+
+private:
+    std::shared_ptr<const std::string> _content;
+};
+
+// Passes streamed content on while keeping a copy of it, which is stored once
+// the content has been read to its end
+class StoringContentStream : public HttpContentStream
+{
+public:
+    StoringContentStream(
+        const std::shared_ptr<HttpContentStream> &stream,
+        size_t maxContentBytes,
+        const std::function<void(std::string &&)> &store)
+        : _stream(stream), _maxContentBytes(maxContentBytes), _store(store)
+    {}
+
+    int Read(
+        char *buffer,
+        size_t size)
+    {
+        auto read = _stream->Read(buffer, size);
+
+        if (read > 0 && !_skipped)
+        {
+            if (_content.size() + read > _maxContentBytes)
+            {
+                _skipped = true;
+                _content = std::string();
+            }
+            else
+            {
+                _content.append(buffer, read);
+            }
+        }
+        else if (read == 0 && !_skipped)
+        {
+            _skipped = true;
+            _store(std::move(_content));
+        }
+
+        return read;
+    }
+
+private:
+    std::shared_ptr<HttpContentStream> _stream;
+    size_t _maxContentBytes;
+    std::function<void(std::string &&)> _store;
+    std::string _content;
+    bool _skipped = false;
+};
+
+bool SameHeaderName(
+    const std::string &a,
+    const char *b)
+{
+    return a.size() == strlen(b) &&
+           std::equal(a.begin(), a.end(), b, [](char x, char y) {
+               return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+           });
+}
+
+const std::string *FindCachingHeader(
+    const std::map<std::string, std::string> &headers,
+    const char *name)
+{
+    for (auto &header : headers)
+    {
+        if (SameHeaderName(header.first, name))
+        {
+            return &header.second;
+        }
+    }
+
+    return nullptr;
+}
+
+void SetCachingHeader(
+    std::map<std::string, std::string> &headers,
+    const std::string &name,
+    const std::string &value)
+{
+    for (auto &header : headers)
+    {
+        if (SameHeaderName(header.first, name.c_str()))
+        {
+            header.second = value;
+            return;
+        }
+    }
+
+    headers[name] = value;
+}
+
+std::string TrimmedLowerCase(
+    const std::string &value)
+{
+    auto first = value.find_first_not_of(" \t");
+    auto last = value.find_last_not_of(" \t");
+    if (first == std::string::npos)
+    {
+        return std::string();
+    }
+
+    auto result = value.substr(first, last - first + 1);
+    for (auto &c : result)
+    {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+
+    return result;
+}
+
+// Finds a directive like "no-cache" or "max-age=60" in a Cache-Control value,
+// setting argument to what follows its '='
+bool FindCacheDirective(
+    const std::string *cacheControl,
+    const char *directive,
+    std::string *argument = nullptr)
+{
+    if (cacheControl == nullptr)
+    {
+        return false;
+    }
+
+    std::stringstream ss(*cacheControl);
+    std::string part;
+    while (std::getline(ss, part, ','))
+    {
+        auto equals = part.find('=');
+        if (TrimmedLowerCase(part.substr(0, equals)) != directive)
+        {
+            continue;
+        }
+
+        if (argument != nullptr)
+        {
+            *argument = equals == std::string::npos ? std::string() : TrimmedLowerCase(part.substr(equals + 1));
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+long long NowInSeconds()
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Parses the preferred HTTP date format, like "Sun, 06 Nov 1994 08:49:37 GMT"
+bool ParseHttpDate(
+    const std::string *value,
+    long long &seconds)
+{
+    if (value == nullptr)
+    {
+        return false;
+    }
+
+    char monthName[4] = {};
+    int day, year, hour, minute, second;
+    if (sscanf(value->c_str(), "%*3s, %d %3s %d %d:%d:%d", &day, monthName, &year, &hour, &minute, &second) != 6)
+    {
+        return false;
+    }
+
+    const char *monthNames = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    auto found = strstr(monthNames, monthName);
+    if (strlen(monthName) != 3 || found == nullptr || (found - monthNames) % 3 != 0)
+    {
+        return false;
+    }
+
+    // Days since 1970-01-01 in the proleptic Gregorian calendar
+    int month = static_cast<int>(found - monthNames) / 3 + 1;
+    long long y = month <= 2 ? year - 1 : year;
+    long long era = (y >= 0 ? y : y - 399) / 400;
+    long long yearOfEra = y - era * 400;
+    long long dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    long long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    long long days = era * 146097 + dayOfEra - 719468;
+
+    seconds = days * 86400 + hour * 3600 + minute * 60 + second;
+
+    return true;
+}
+
+// How long the response may be used without revalidating it, in seconds
+long long FreshnessLifetime(
+    const CachedResponse &response)
+{
+    auto cacheControl = FindCachingHeader(response.headers, "Cache-Control");
+
+    if (FindCacheDirective(cacheControl, "no-cache"))
+    {
+        return 0;
+    }
+
+    std::string maxAge;
+    if (FindCacheDirective(cacheControl, "max-age", &maxAge))
+    {
+        return atoll(maxAge.c_str());
+    }
+
+    long long expires;
+    if (ParseHttpDate(FindCachingHeader(response.headers, "Expires"), expires))
+    {
+        long long date;
+        if (!ParseHttpDate(FindCachingHeader(response.headers, "Date"), date))
+        {
+            date = response.storedAt;
+        }
+
+        return expires - date;
+    }
+
+    // Without an explicit lifetime the response is revalidated every time
+    return 0;
+}
+
+long long CurrentAge(
+    const CachedResponse &response,
+    long long now)
+{
+    auto age = FindCachingHeader(response.headers, "Age");
+
+    return (age != nullptr ? atoll(age->c_str()) : 0) + std::max(0ll, now - response.storedAt);
+}
+
+bool VaryMatches(
+    const CachedResponse &response,
+    const HttpRequestMessage &request)
+{
+    for (auto &vary : response.varyHeaders)
+    {
+        auto value = FindCachingHeader(request.Headers, vary.first.c_str());
+        if ((value != nullptr ? *value : std::string()) != vary.second)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+std::shared_ptr<HttpResponseMessage> CachedResponseMessage(
+    const CachedResponse &cached)
+{
+    auto response = std::make_shared<HttpResponseMessage>();
+
+    response->StatusCode = static_cast<HttpStatusCode>(cached.statusCode);
+    response->Headers = cached.headers;
+    response->Content = std::make_shared<CachedContent>(cached.content);
+
+    return response;
+}
+
+// The file a response is stored in, named after a hash of its uri
+std::filesystem::path CacheFilePath(
+    const std::string &directory,
+    const std::string &uri)
+{
+    unsigned long long hash = 14695981039346656037ull;
+    for (auto c : uri)
+    {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.cache", hash);
+
+    return std::filesystem::path(directory) / name;
+}
+
+struct CachedFile
+{
+    std::filesystem::path path;
+    unsigned long long size = 0;
+};
+
+struct HttpResponseCache::State
+{
+    std::string directory;
+    size_t maxMemoryBytes;
+    unsigned long long maxDiskBytes;
+
+    std::mutex mutex;
+    // Most recently used first
+    std::list<std::shared_ptr<CachedResponse>> recentlyUsed;
+    std::map<std::string, std::list<std::shared_ptr<CachedResponse>>::iterator> responses;
+    size_t memoryBytes = 0;
+    HttpCacheStatistics statistics;
+
+    // The files in directory, most recently used first, found on first use
+    std::list<CachedFile> recentlyUsedFiles;
+    std::map<std::filesystem::path, std::list<CachedFile>::iterator> files;
+    unsigned long long diskBytes = 0;
+    bool filesFound = false;
+
+    std::atomic<unsigned> nextTemporaryFile{0};
+
+    static size_t MemorySize(
+        const CachedResponse &response)
+    {
+        size_t size = response.uri.size() + response.content->size();
+        for (auto &header : response.headers)
+        {
+            size += header.first.size() + header.second.size();
+        }
+
+        return size;
+    }
+
+    // Keeps response in memory, dropping the least recently used ones beyond maxMemoryBytes
+    void Remember(
+        const std::shared_ptr<CachedResponse> &response)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        Forget(response->uri);
+
+        recentlyUsed.push_front(response);
+        responses[response->uri] = recentlyUsed.begin();
+        memoryBytes += MemorySize(*response);
+
+        while (memoryBytes > maxMemoryBytes && recentlyUsed.size() > 1)
+        {
+            Forget(recentlyUsed.back()->uri);
+        }
+    }
+
+    // Called with mutex held
+    void Forget(
+        const std::string &uri)
+    {
+        auto found = responses.find(uri);
+        if (found == responses.end())
+        {
+            return;
+        }
+
+        memoryBytes -= MemorySize(**found->second);
+        recentlyUsed.erase(found->second);
+        responses.erase(found);
+    }
+
+    // Called with mutex held. The files of earlier sessions are ordered by
+    // their modification time, which is updated when a file is used.
+    void FindFiles()
+    {
+        if (filesFound || directory.empty())
+        {
+            return;
+        }
+        filesFound = true;
+
+        std::vector<std::pair<std::filesystem::file_time_type, CachedFile>> found;
+
+        std::error_code error;
+        for (auto &entry : std::filesystem::directory_iterator(directory, error))
+        {
+            if (entry.path().extension() != ".cache")
+            {
+                continue;
+            }
+
+            std::error_code sizeError, timeError;
+
+            CachedFile file;
+            file.path = entry.path();
+            file.size = entry.file_size(sizeError);
+            auto modified = entry.last_write_time(timeError);
+            if (!sizeError && !timeError)
+            {
+                found.emplace_back(modified, file);
+            }
+        }
+
+        std::sort(found.begin(), found.end(), [](const auto &a, const auto &b) {
+            return a.first > b.first;
+        });
+
+        for (auto &file : found)
+        {
+            recentlyUsedFiles.push_back(file.second);
+            files[file.second.path] = std::prev(recentlyUsedFiles.end());
+            diskBytes += file.second.size;
+        }
+    }
+
+    // Called with mutex held
+    void ForgetFile(
+        const std::filesystem::path &path)
+    {
+        auto found = files.find(path);
+        if (found == files.end())
+        {
+            return;
+        }
+
+        diskBytes -= found->second->size;
+        recentlyUsedFiles.erase(found->second);
+        files.erase(found);
+    }
+
+    // Counts a file that was written or read as the most recently used one and
+    // removes the least recently used files beyond maxDiskBytes
+    void UseFile(
+        const std::filesystem::path &path,
+        unsigned long long size)
+    {
+        std::vector<std::filesystem::path> evicted;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            FindFiles();
+            ForgetFile(path);
+
+            recentlyUsedFiles.push_front(CachedFile{path, size});
+            files[path] = recentlyUsedFiles.begin();
+            diskBytes += size;
+
+            while (diskBytes > maxDiskBytes && recentlyUsedFiles.size() > 1)
+            {
+                evicted.push_back(recentlyUsedFiles.back().path);
+                ForgetFile(recentlyUsedFiles.back().path);
+            }
+        }
+
+        std::error_code error;
+        for (auto &file : evicted)
+        {
+            std::filesystem::remove(file, error);
+        }
+    }
+
+    std::shared_ptr<CachedResponse> Find(
+        const std::string &uri)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            auto found = responses.find(uri);
+            if (found != responses.end())
+            {
+                recentlyUsed.splice(recentlyUsed.begin(), recentlyUsed, found->second);
+
+                // Answered from memory, its file is still in use
+                auto file = files.find(CacheFilePath(directory, uri));
+                if (file != files.end())
+                {
+                    recentlyUsedFiles.splice(recentlyUsedFiles.begin(), recentlyUsedFiles, file->second);
+                }
+
+                return *found->second;
+            }
+        }
+
+        auto response = Load(uri);
+        if (response != nullptr)
+        {
+            Remember(response);
+        }
+
+        return response;
+    }
+
+    void Store(
+        const std::shared_ptr<CachedResponse> &response)
+    {
+        Remember(response);
+        Save(*response);
+    }
+
+    void Remove(
+        const std::string &uri)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            Forget(uri);
+        }
+
+        if (!directory.empty())
+        {
+            auto path = CacheFilePath(directory, uri);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ForgetFile(path);
+            }
+
+            std::error_code error;
+            std::filesystem::remove(path, error);
+        }
+    }
+
+    // The file holds the uri, the status code and time stored, the response
+    // headers, the Vary request headers and the content
+    void Save(
+        const CachedResponse &response)
+    {
+        if (directory.empty())
+        {
+            return;
+        }
+
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+
+        // Written under another name first so a reader never sees half a file
+        auto path = CacheFilePath(directory, response.uri);
+        auto temporaryPath = path;
+        temporaryPath += "." + std::to_string(nextTemporaryFile++) + ".tmp";
+
+        {
+            std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+            if (!file)
+            {
+                return;
+            }
+
+            file << response.uri << "\n"
+                 << response.statusCode << " " << response.storedAt << "\n";
+            for (auto &header : response.headers)
+            {
+                file << header.first << ": " << header.second << "\n";
+            }
+            file << "\n";
+            for (auto &header : response.varyHeaders)
+            {
+                file << header.first << ": " << header.second << "\n";
+            }
+            file << "\n";
+            file.write(response.content->data(), response.content->size());
+
+            if (!file)
+            {
+                file.close();
+                std::filesystem::remove(temporaryPath, error);
+                return;
+            }
+        }
+
+        std::filesystem::rename(temporaryPath, path, error);
+        if (error)
+        {
+            std::filesystem::remove(temporaryPath, error);
+            return;
+        }
+
+        UseFile(path, std::filesystem::file_size(path, error));
+    }
+
+    std::shared_ptr<CachedResponse> Load(
+        const std::string &uri)
+    {
+        if (directory.empty())
+        {
+            return nullptr;
+        }
+
+        auto path = CacheFilePath(directory, uri);
+
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            return nullptr;
+        }
+
+        auto response = std::make_shared<CachedResponse>();
+
+        std::string line;
+        std::getline(file, response->uri);
+        if (response->uri != uri || !std::getline(file, line))
+        {
+            // Another uri with the same hash
+            return nullptr;
+        }
+
+        if (sscanf(line.c_str(), "%d %lld", &response->statusCode, &response->storedAt) != 2)
+        {
+            return nullptr;
+        }
+
+        for (auto headers : {&response->headers, &response->varyHeaders})
+        {
+            while (std::getline(file, line) && !line.empty())
+            {
+                auto colon = line.find(": ");
+                if (colon != std::string::npos)
+                {
+                    (*headers)[line.substr(0, colon)] = line.substr(colon + 2);
+                }
+            }
+        }
+
+        if (!file)
+        {
+            return nullptr;
+        }
+
+        std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        response->content = std::make_shared<const std::string>(std::move(content));
+
+        file.close();
+
+        // The modification time keeps the order of use for the next session
+        std::error_code error;
+        std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+        UseFile(path, std::filesystem::file_size(path, error));
+
+        return response;
+    }
+};
+
+HttpResponseCache::HttpResponseCache(
+    const std::string &directory,
+    size_t maxMemoryBytes,
+    unsigned long long maxDiskBytes)
+    : _state(std::make_shared<State>())
+{
+    _state->directory = directory;
+    _state->maxMemoryBytes = maxMemoryBytes;
+    _state->maxDiskBytes = maxDiskBytes;
+}
+
+HttpResponseCache::~HttpResponseCache() = default;
+
+std::shared_ptr<HttpResponseMessage> HttpResponseCache::Send(
+    const std::shared_ptr<HttpRequestMessage> &request,
+    HttpCompletionOption completionOption,
+    const std::function<std::shared_ptr<HttpResponseMessage>(const std::shared_ptr<HttpRequestMessage> &, HttpCompletionOption)> &send)
+{
+    auto requestCacheControl = FindCachingHeader(request->Headers, "Cache-Control");
+
+    // Requests that are conditional already are left to the code that made them.
+    // Responses to authorized requests are not written to disk.
+    if (request->Method != HttpMethod::Get ||
+        FindCacheDirective(requestCacheControl, "no-store") ||
+        FindCachingHeader(request->Headers, "Authorization") != nullptr ||
+        FindCachingHeader(request->Headers, "If-None-Match") != nullptr ||
+        FindCachingHeader(request->Headers, "If-Modified-Since") != nullptr ||
+        FindCachingHeader(request->Headers, "Range") != nullptr)
+    {
+        return send(request, completionOption);
+    }
+
+    auto now = NowInSeconds();
+
+    auto stored = _state->Find(request->RequestUri);
+    if (stored != nullptr && !VaryMatches(*stored, *request))
+    {
+        stored = nullptr;
+    }
+
+    auto requestToSend = request;
+
+    if (stored != nullptr)
+    {
+        auto pragma = FindCachingHeader(request->Headers, "Pragma");
+        bool revalidate = FindCacheDirective(requestCacheControl, "no-cache") ||
+                          (pragma != nullptr && TrimmedLowerCase(*pragma) == "no-cache");
+
+        auto age = CurrentAge(*stored, now);
+
+        std::string maxAge;
+        if (FindCacheDirective(requestCacheControl, "max-age", &maxAge) && age > atoll(maxAge.c_str()))
+        {
+            revalidate = true;
+        }
+
+        if (!revalidate && age < FreshnessLifetime(*stored))
+        {
+            std::lock_guard<std::mutex> lock(_state->mutex);
+            _state->statistics.Hits++;
+
+            return CachedResponseMessage(*stored);
+        }
+
+        auto etag = FindCachingHeader(stored->headers, "ETag");
+        auto lastModified = FindCachingHeader(stored->headers, "Last-Modified");
+
+        if (etag != nullptr || lastModified != nullptr)
+        {
+            requestToSend = std::make_shared<HttpRequestMessage>(request->Method, request->RequestUri);
+            requestToSend->Content = request->Content;
+            requestToSend->Headers = request->Headers;
+
+            if (etag != nullptr)
+            {
+                requestToSend->Headers["If-None-Match"] = *etag;
+            }
+
+            if (lastModified != nullptr)
+            {
+                requestToSend->Headers["If-Modified-Since"] = *lastModified;
+            }
+        }
+    }
+
+    auto response = send(requestToSend, completionOption);
+
+    if (response->Content == nullptr)
+    {
+        return response;
+    }
+
+    if (stored != nullptr && requestToSend != request && response->StatusCode == HttpStatusCode::NotModified)
+    {
+        // The stored content is still current, its headers are updated with
+        // the ones that came with the 304
+        auto refreshed = std::make_shared<CachedResponse>(*stored);
+        for (auto header = refreshed->headers.begin(); header != refreshed->headers.end(); ++header)
+        {
+            if (SameHeaderName(header->first, "Age"))
+            {
+                refreshed->headers.erase(header);
+                break;
+            }
+        }
+        for (auto &header : response->Headers)
+        {
+            auto name = TrimmedLowerCase(header.first);
+            if (name != "content-length" && name != "transfer-encoding" && name != "connection" && name != "keep-alive")
+            {
+                SetCachingHeader(refreshed->headers, header.first, header.second);
+            }
+        }
+        refreshed->storedAt = now;
+
+        _state->Store(refreshed);
+
+        {
+            std::lock_guard<std::mutex> lock(_state->mutex);
+            _state->statistics.Revalidated++;
+        }
+
+        return CachedResponseMessage(*refreshed);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_state->mutex);
+        _state->statistics.Misses++;
+    }
+
+    if (response->StatusCode != HttpStatusCode::OK)
+    {
+        return response;
+    }
+
+    auto cached = std::make_shared<CachedResponse>();
+    cached->uri = request->RequestUri;
+    cached->statusCode = static_cast<int>(response->StatusCode);
+    cached->headers = response->Headers;
+    cached->storedAt = now;
+
+    auto responseCacheControl = FindCachingHeader(response->Headers, "Cache-Control");
+    auto vary = FindCachingHeader(response->Headers, "Vary");
+
+    bool storable = !FindCacheDirective(responseCacheControl, "no-store") &&
+                    (vary == nullptr || vary->find('*') == std::string::npos) &&
+                    (FindCachingHeader(response->Headers, "ETag") != nullptr ||
+                     FindCachingHeader(response->Headers, "Last-Modified") != nullptr ||
+                     FreshnessLifetime(*cached) > 0);
+
+    size_t length;
+    if (!storable || (response->Content->TryComputeLength(length) && length > MaxContentBytes))
+    {
+        // What is stored is out of date now
+        if (stored != nullptr)
+        {
+            _state->Remove(request->RequestUri);
+        }
+
+        return response;
+    }
+
+    if (vary != nullptr)
+    {
+        std::stringstream ss(*vary);
+        std::string name;
+        while (std::getline(ss, name, ','))
+        {
+            name = TrimmedLowerCase(name);
+            auto value = FindCachingHeader(request->Headers, name.c_str());
+            cached->varyHeaders[name] = value != nullptr ? *value : std::string();
+        }
+    }
+
+    auto headers = response->Content->Headers;
+
+    if (completionOption == HttpCompletionOption::ResponseContentRead)
+    {
+        // The content is in memory already, the response shares it with the cache
+        cached->content = std::make_shared<const std::string>(response->Content->ReadAsStringView());
+        _state->Store(cached);
+
+        response->Content = std::make_shared<CachedContent>(cached->content);
+    }
+    else
+    {
+        // Streamed content is stored once the caller has read all of it
+        auto state = _state;
+        auto stream = std::make_shared<StoringContentStream>(
+            response->Content->ReadAsStream(),
+            MaxContentBytes,
+            [state, cached](std::string &&content) {
+                cached->content = std::make_shared<const std::string>(std::move(content));
+                state->Store(cached);
+            });
+
+        if (response->Content->TryComputeLength(length))
+        {
+            response->Content = std::make_shared<StreamContent>(stream, length);
+        }
+        else
+        {
+            response->Content = std::make_shared<StreamContent>(stream);
+        }
+    }
+
+    response->Content->Headers = headers;
+
+    return response;
+}
+
+void HttpResponseCache::Clear()
+{
+    {
+        std::lock_guard<std::mutex> lock(_state->mutex);
+
+        _state->recentlyUsed.clear();
+        _state->responses.clear();
+        _state->memoryBytes = 0;
+
+        _state->recentlyUsedFiles.clear();
+        _state->files.clear();
+        _state->diskBytes = 0;
+        _state->filesFound = false;
+    }
+
+    if (_state->directory.empty())
+    {
+        return;
+    }
+
+    std::error_code error;
+    for (auto &entry : std::filesystem::directory_iterator(_state->directory, error))
+    {
+        if (entry.path().extension() == ".cache")
+        {
+            std::filesystem::remove(entry.path(), error);
+        }
+    }
+}
+
+HttpCacheStatistics HttpResponseCache::Statistics()
+{
+    std::lock_guard<std::mutex> lock(_state->mutex);
+
+    return _state->statistics;
+}
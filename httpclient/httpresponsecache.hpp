@@ -0,0 +1,61 @@
+#ifndef HTTPRESPONSECACHE_HPP
+#define HTTPRESPONSECACHE_HPP
+
+#include "httpcompletionoption.hpp"
+#include "httprequestmessage.hpp"
+#include "httpresponsemessage.hpp"
+#include <functional>
+#include <memory>
+#include <string>
+
+struct HttpCacheStatistics
+{
+    int Hits = 0;
+    int Revalidated = 0;
+    int Misses = 0;
+};
+
+// Keeps GET responses in memory and, when given a directory, on disk. A stored
+// response is returned without contacting the server while Cache-Control or
+// Expires say it is fresh. Once it is stale it is revalidated with
+// If-None-Match and If-Modified-Since, and a 304 returns the stored content.
+//
+// A request with "Cache-Control: no-store" or an Authorization header
+// bypasses the cache, one with "Cache-Control: no-cache" is always revalidated.
+//
+// The files on disk are kept under maxDiskBytes by removing the least
+// recently used ones, also those stored in earlier sessions.
+class HttpResponseCache
+{
+public:
+    // An empty directory keeps the responses in memory only
+    HttpResponseCache(
+        const std::string &directory = std::string(),
+        size_t maxMemoryBytes = 64 * 1024 * 1024,
+        unsigned long long maxDiskBytes = 256 * 1024 * 1024);
+
+    virtual ~HttpResponseCache();
+
+public:
+    // The largest content that is stored
+    size_t MaxContentBytes = 32 * 1024 * 1024;
+
+public:
+    // Answers request from the cache or with send, storing what send returns
+    std::shared_ptr<HttpResponseMessage> Send(
+        const std::shared_ptr<HttpRequestMessage> &request,
+        HttpCompletionOption completionOption,
+        const std::function<std::shared_ptr<HttpResponseMessage>(const std::shared_ptr<HttpRequestMessage> &, HttpCompletionOption)> &send);
+
+    // Removes the stored responses from memory and disk
+    void Clear();
+
+    HttpCacheStatistics Statistics();
+
+private:
+    struct State;
+
+    std::shared_ptr<State> _state;
+};
+
+#endif // HTTPRESPONSECACHE_HPP
@@ -16,7 +16,8 @@ public:
 
 public:
     std::map<std::string, std::string> Headers;
-    HttpStatusCode StatusCode;
+    // 0 when no response was received
+    HttpStatusCode StatusCode = static_cast<HttpStatusCode>(0);
     std::shared_ptr<HttpContent> Content;
 
 public:
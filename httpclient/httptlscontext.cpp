@@ -0,0 +1,284 @@
+#include "httptlscontext.hpp"
+
+#include "ca_cert.h"
+#include <map>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/x509_crt.h>
+#include <mutex>
+#include <psa/crypto.h>
+#include <utility>
+
+struct SavedSession
+{
+    mbedtls_ssl_session session;
+
+    SavedSession()
+    {
+        mbedtls_ssl_session_init(&session);
+    }
+
+    ~SavedSession()
+    {
+        mbedtls_ssl_session_free(&session);
+    }
+};
+
+struct HttpTlsContext::State
+{
+    mbedtls_ssl_config config;
+    mbedtls_ctr_drbg_context drbg;
+    mbedtls_entropy_context entropy;
+    mbedtls_x509_crt caChain;
+    bool valid = false;
+
+    // mbedtls is built without MBEDTLS_THREADING_C, so the generator shared by
+    // all connections is only used while holding this mutex
+    std::mutex drbgMutex;
+
+    std::mutex sessionMutex;
+    std::map<std::pair<std::string, int>, std::unique_ptr<SavedSession>> sessions;
+
+    std::mutex statisticsMutex;
+    TlsHandshakeStatistics statistics;
+
+    State()
+    {
+        mbedtls_ssl_config_init(&config);
+        mbedtls_ctr_drbg_init(&drbg);
+        mbedtls_entropy_init(&entropy);
+        mbedtls_x509_crt_init(&caChain);
+    }
+
+    ~State()
+    {
+        sessions.clear();
+        mbedtls_ssl_config_free(&config);
+        mbedtls_ctr_drbg_free(&drbg);
+        mbedtls_entropy_free(&entropy);
+        mbedtls_x509_crt_free(&caChain);
+    }
+
+    static int LockedRandom(
+        void *context,
+        unsigned char *output,
+        size_t length)
+    {
+        auto state = static_cast<State *>(context);
+
+        std::lock_guard<std::mutex> lock(state->drbgMutex);
+
+        return mbedtls_ctr_drbg_random(&state->drbg, output, length);
+    }
+};
+
+// The certificate is only verified during a full handshake, a resumed
+// session reuses the peer certificate of the session it resumes
+static int NoteVerification(
+    void *context,
+    mbedtls_x509_crt *,
+    int,
+    uint32_t *)
+{
+    *static_cast<bool *>(context) = true;
+
+    return 0;
+}
+
+HttpTlsContext &HttpTlsContext::Shared()
+{
+    static HttpTlsContext context;
+
+    return context;
+}
+
+HttpTlsContext::HttpTlsContext()
+    : _state(std::make_unique<State>())
+{
+    psa_crypto_init();
+
+    const char personalisation[] = "httpclient";
+    if (mbedtls_ctr_drbg_seed(
+            &_state->drbg,
+            mbedtls_entropy_func,
+            &_state->entropy,
+            reinterpret_cast<const unsigned char *>(personalisation),
+            sizeof(personalisation) - 1) != 0)
+    {
+        return;
+    }
+
+    // The PEM bundle is parsed including its terminating zero
+    if (mbedtls_x509_crt_parse(
+            &_state->caChain,
+            reinterpret_cast<const unsigned char *>(ca_crt_rsa),
+            ca_crt_rsa_size) < 0)
+    {
+        return;
+    }
+
+    if (mbedtls_ssl_config_defaults(
+            &_state->config,
+            MBEDTLS_SSL_IS_CLIENT,
+            MBEDTLS_SSL_TRANSPORT_STREAM,
+            MBEDTLS_SSL_PRESET_DEFAULT) != 0)
+    {
+        return;
+    }
+
+    mbedtls_ssl_conf_authmode(&_state->config, MBEDTLS_SSL_VERIFY_REQUIRED);
+    mbedtls_ssl_conf_ca_chain(&_state->config, &_state->caChain, nullptr);
+    mbedtls_ssl_conf_rng(&_state->config, State::LockedRandom, _state.get());
+
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+    mbedtls_ssl_conf_session_tickets(&_state->config, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#if defined(MBEDTLS_SSL_PROTO_TLS1_3)
+    // TLS 1.3 servers send their tickets after the handshake, HttpConnection::Read
+    // hands them to SaveSession when they are signalled
+    mbedtls_ssl_conf_tls13_enable_signal_new_session_tickets(
+        &_state->config,
+        MBEDTLS_SSL_TLS1_3_SIGNAL_NEW_SESSION_TICKETS_ENABLED);
+#endif
+#endif
+
+    _state->valid = true;
+}
+
+HttpTlsContext::~HttpTlsContext() = default;
+
+bool HttpTlsContext::IsValid() const
+{
+    return _state->valid;
+}
+
+bool HttpTlsContext::AddCaCertificates(
+    const std::string &pem)
+{
+    // The configuration points at the chain, so it picks up what is added to it
+    return _state->valid && mbedtls_x509_crt_parse(
+                                &_state->caChain,
+                                reinterpret_cast<const unsigned char *>(pem.c_str()),
+                                pem.size() + 1) == 0;
+}
+
+bool HttpTlsContext::Handshake(
+    mbedtls_ssl_context *ssl,
+    const std::string &host,
+    int port,
+    void *bio,
+    int (*send)(void *, const unsigned char *, size_t),
+    int (*receive)(void *, unsigned char *, size_t))
+{
+    if (!_state->valid)
+    {
+        return false;
+    }
+
+    if (mbedtls_ssl_setup(ssl, &_state->config) != 0)
+    {
+        return false;
+    }
+
+    if (mbedtls_ssl_set_hostname(ssl, host.c_str()) != 0)
+    {
+        return false;
+    }
+
+    bool verified = false;
+    mbedtls_ssl_set_verify(ssl, NoteVerification, &verified);
+    mbedtls_ssl_set_bio(ssl, bio, send, receive, nullptr);
+
+    {
+        std::lock_guard<std::mutex> lock(_state->sessionMutex);
+
+        auto found = _state->sessions.find(std::make_pair(host, port));
+        if (found != _state->sessions.end() && mbedtls_ssl_set_session(ssl, &found->second->session) != 0)
+        {
+            _state->sessions.erase(found);
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    int result;
+    do
+    {
+        result = mbedtls_ssl_handshake(ssl);
+    } while (result == MBEDTLS_ERR_SSL_WANT_READ || result == MBEDTLS_ERR_SSL_WANT_WRITE);
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+    mbedtls_ssl_set_verify(ssl, nullptr, nullptr);
+
+    {
+        std::lock_guard<std::mutex> lock(_state->statisticsMutex);
+
+        if (result != 0)
+        {
+            _state->statistics.FailedHandshakes++;
+        }
+        else if (verified)
+        {
+            _state->statistics.FullHandshakes++;
+            _state->statistics.FullHandshakeTime += elapsed;
+        }
+        else
+        {
+            _state->statistics.ResumedHandshakes++;
+            _state->statistics.ResumedHandshakeTime += elapsed;
+        }
+    }
+
+    if (result != 0)
+    {
+        // A session the server no longer accepts is not offered again
+        std::lock_guard<std::mutex> lock(_state->sessionMutex);
+
+        _state->sessions.erase(std::make_pair(host, port));
+
+        return false;
+    }
+
+    SaveSession(ssl, host, port);
+
+    return true;
+}
+
+void HttpTlsContext::SaveSession(
+    mbedtls_ssl_context *ssl,
+    const std::string &host,
+    int port)
+{
+    auto saved = std::make_unique<SavedSession>();
+
+    if (mbedtls_ssl_get_session(ssl, &saved->session) != 0)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_state->sessionMutex);
+
+    _state->sessions[std::make_pair(host, port)] = std::move(saved);
+}
+
+void HttpTlsContext::ClearSessions()
+{
+    std::lock_guard<std::mutex> lock(_state->sessionMutex);
+
+    _state->sessions.clear();
+}
+
+TlsHandshakeStatistics HttpTlsContext::Statistics()
+{
+    std::lock_guard<std::mutex> lock(_state->statisticsMutex);
+
+    return _state->statistics;
+}
+
+void HttpTlsContext::ResetStatistics()
+{
+    std::lock_guard<std::mutex> lock(_state->statisticsMutex);
+
+    _state->statistics = TlsHandshakeStatistics();
+}
@@ -0,0 +1,68 @@
+#ifndef HTTPTLSCONTEXT_HPP
+#define HTTPTLSCONTEXT_HPP
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+struct mbedtls_ssl_context;
+
+struct TlsHandshakeStatistics
+{
+    int FullHandshakes = 0;
+    int ResumedHandshakes = 0;
+    int FailedHandshakes = 0;
+    std::chrono::microseconds FullHandshakeTime = std::chrono::microseconds(0);
+    std::chrono::microseconds ResumedHandshakeTime = std::chrono::microseconds(0);
+};
+
+// The TLS configuration shared by all https connections. The CA chain is
+// parsed and the random generator seeded once, and the last session for each
+// host and port is kept so new connections can resume it instead of
+// performing a full handshake.
+class HttpTlsContext
+{
+public:
+    static HttpTlsContext &Shared();
+
+    virtual ~HttpTlsContext();
+
+public:
+    bool IsValid() const;
+
+    // Trusts the certificates in pem as well as the bundled ones, like a
+    // private CA. Done before the first https connection, not during one.
+    bool AddCaCertificates(
+        const std::string &pem);
+
+    // Performs the handshake on ssl for host and port, resuming a cached
+    // session when there is one. send and receive are mbedtls bio callbacks.
+    bool Handshake(
+        mbedtls_ssl_context *ssl,
+        const std::string &host,
+        int port,
+        void *bio,
+        int (*send)(void *, const unsigned char *, size_t),
+        int (*receive)(void *, unsigned char *, size_t));
+
+    // Keeps the session of ssl, called again when a TLS 1.3 server sends a new ticket
+    void SaveSession(
+        mbedtls_ssl_context *ssl,
+        const std::string &host,
+        int port);
+
+    void ClearSessions();
+
+    TlsHandshakeStatistics Statistics();
+
+    void ResetStatistics();
+
+private:
+    HttpTlsContext();
+
+    struct State;
+
+    std::unique_ptr<State> _state;
+};
+
+#endif // HTTPTLSCONTEXT_HPP
@@ -2,17 +2,12 @@
 
 JsonContent::JsonContent(
     const nlohmann::json &data)
-{
-    auto str = data.dump();
-
-    _stream.resize(str.size());
-    std::transform(str.begin(), str.end(), _stream.begin(),
-                   [](char c) { return std::byte(c); });
-}
+    : _content(data.dump())
+{}
 
 JsonContent::~JsonContent() = default;
 
-const std::vector<std::byte> &JsonContent::Stream()
+std::string_view JsonContent::Buffer()
 {
-    return _stream;
+    return _content;
 }
@@ -13,10 +13,10 @@ public:
     virtual ~JsonContent();
 
 protected:
-    const std::vector<std::byte> &Stream();
+    std::string_view Buffer();
 
 private:
-    std::vector<std::byte> _stream;
+    std::string _content;
 };
 
 #endif // JSONCONTENT_HPP
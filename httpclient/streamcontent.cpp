@@ -0,0 +1,97 @@
+#include "streamcontent.hpp"
+
+#include <algorithm>
+
+StreamContent::StreamContent(
+    const std::shared_ptr<HttpContentStream> &stream)
+    : _stream(stream)
+{}
+
+StreamContent::StreamContent(
+    const std::shared_ptr<HttpContentStream> &stream,
+    size_t length)
+    : _stream(stream), _length(length), _lengthKnown(true)
+{}
+
+StreamContent::~StreamContent() = default;
+
+bool StreamContent::LoadIntoBuffer()
+{
+    if (_buffered)
+    {
+        return true;
+    }
+
+    if (_stream == nullptr)
+    {
+        // The stream was handed out before the content was buffered
+        return false;
+    }
+
+    // Read straight into the end of the buffer so the content is not copied
+    // through an intermediate block. With a known length one byte more is
+    // left so the end of the stream is seen without growing the buffer, a
+    // length that is too large to trust is grown into like an unknown one.
+    const size_t initialSizeMax = 256 * 1024 * 1024;
+    _buffer.resize(_lengthKnown ? std::min(_length, initialSizeMax) + 1 : 65536);
+
+    size_t used = 0;
+    while (true)
+    {
+        if (used == _buffer.size())
+        {
+            _buffer.resize(used * 2);
+        }
+
+        auto read = _stream->Read(&_buffer[used], _buffer.size() - used);
+        if (read < 0)
+        {
+            _buffer.clear();
+            _stream = nullptr;
+            return false;
+        }
+
+        if (read == 0)
+        {
+            break;
+        }
+
+        used += read;
+    }
+
+    _buffer.resize(used);
+    _stream = nullptr;
+    _buffered = true;
+
+    return true;
+}
+
+bool StreamContent::TryComputeLength(
+    size_t &length)
+{
+    if (_buffered)
+    {
+        length = _buffer.size();
+        return true;
+    }
+
+    length = _length;
+
+    return _lengthKnown;
+}
+
+std::string_view StreamContent::Buffer()
+{
+    return _buffer;
+}
+
+std::shared_ptr<HttpContentStream> StreamContent::CreateContentStream()
+{
+    if (_buffered)
+    {
+        return nullptr;
+    }
+
+    // Once handed out the content can neither be buffered nor streamed again
+    return std::move(_stream);
+}
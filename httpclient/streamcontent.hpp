@@ -0,0 +1,45 @@
+#ifndef STREAMCONTENT_HPP
+#define STREAMCONTENT_HPP
+
+#include "httpcontent.hpp"
+
+#include <memory>
+#include <string>
+
+// Content read from a stream, such as a response body that is still being
+// received. The stream is handed out once by ReadAsStream or CopyTo, or read
+// to its end by LoadIntoBuffer after which the content can be read any number
+// of times.
+class StreamContent : public HttpContent
+{
+public:
+    StreamContent(
+        const std::shared_ptr<HttpContentStream> &stream);
+
+    // length is the size of the content when it is known up front
+    StreamContent(
+        const std::shared_ptr<HttpContentStream> &stream,
+        size_t length);
+
+    virtual ~StreamContent();
+
+public:
+    bool LoadIntoBuffer();
+
+    bool TryComputeLength(
+        size_t &length);
+
+protected:
+    std::string_view Buffer();
+
+    std::shared_ptr<HttpContentStream> CreateContentStream();
+
+private:
+    std::shared_ptr<HttpContentStream> _stream;
+    std::string _buffer;
+    size_t _length = 0;
+    bool _lengthKnown = false;
+    bool _buffered = false;
+};
+
+#endif // STREAMCONTENT_HPP
@@ -5,7 +5,7 @@
 std::vector<std::byte> convert(
     const std::string &content)
 {
-    std::vector<std::byte> data(content.size() + 1);
+    std::vector<std::byte> data(content.size());
 
     std::transform(
         content.begin(),
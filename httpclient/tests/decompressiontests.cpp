@@ -0,0 +1,222 @@
+#include "decompressingcontentstream.hpp"
+#include "streamcontent.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+
+// The fixtures are response.json encoded with Python's gzip and zlib
+// modules: gzip with mtime 0, zlib wrapped deflate, raw deflate, and gzip
+// with each half of the content in its own member
+std::string FixtureDirectory;
+
+int FailureCount = 0;
+
+void Check(
+    bool condition,
+    const std::string &what)
+{
+    if (!condition)
+    {
+        std::cerr << "FAILED: " << what << std::endl;
+        FailureCount++;
+    }
+}
+
+std::string ReadFixture(
+    const std::string &name)
+{
+    std::ifstream file(FixtureDirectory + "/" + name, std::ios::binary);
+    Check(file.good(), "the fixture " + name + " can be read");
+
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// Hands out encoded content in pieces of at most pieceSize bytes, like a
+// connection that receives it a little at a time. failAtEnd makes the last
+// read fail, like a connection that is lost.
+class PieceStream : public HttpContentStream
+{
+public:
+    PieceStream(
+        const std::string &content,
+        size_t pieceSize,
+        bool failAtEnd = false)
+        : _content(content),
+          _pieceSize(pieceSize),
+          _failAtEnd(failAtEnd)
+    {}
+
+    int Read(
+        char *buffer,
+        size_t size)
+    {
+        if (_position == _content.size() && _failAtEnd)
+        {
+            return -1;
+        }
+
+        auto count = _content.copy(buffer, std::min(size, _pieceSize), _position);
+        _position += count;
+
+        return static_cast<int>(count);
+    }
+
+    bool ReadToEnd() const
+    {
+        return _position == _content.size();
+    }
+
+private:
+    std::string _content;
+    size_t _pieceSize;
+    bool _failAtEnd;
+    size_t _position = 0;
+};
+
+// Decodes encoded with reads of readSize bytes, false when a read failed
+bool Decode(
+    const std::shared_ptr<HttpContentStream> &encoded,
+    ContentEncoding encoding,
+    size_t readSize,
+    std::string &decoded)
+{
+    DecompressingContentStream stream(encoded, encoding);
+
+    decoded.clear();
+    std::string buffer(readSize, '\0');
+
+    int read;
+    while ((read = stream.Read(&buffer[0], buffer.size())) > 0)
+    {
+        decoded.append(buffer, 0, read);
+    }
+
+    return read == 0;
+}
+
+struct Fixture
+{
+    const char *Name;
+    ContentEncoding Encoding;
+};
+
+const Fixture Fixtures[] = {
+    {"response.json.gz", ContentEncoding::GZip},
+    {"response.json.2.gz", ContentEncoding::GZip},
+    {"response.json.zlib", ContentEncoding::Deflate},
+    {"response.json.deflate", ContentEncoding::Deflate},
+};
+
+void TestFixtures()
+{
+    auto expected = ReadFixture("response.json");
+
+    for (auto &fixture : Fixtures)
+    {
+        auto encoded = ReadFixture(fixture.Name);
+
+        for (size_t pieceSize : {1, 7, 4096, 1 << 20})
+        {
+            for (size_t readSize : {1, 100, 65536})
+            {
+                auto what = std::string(fixture.Name) + " in pieces of " + std::to_string(pieceSize) + " read " + std::to_string(readSize) + " at a time";
+
+                auto source = std::make_shared<PieceStream>(encoded, pieceSize);
+                std::string decoded;
+                Check(Decode(source, fixture.Encoding, readSize, decoded), what + ": no error");
+                Check(decoded == expected, what + ": decodes to the fixture");
+                Check(source->ReadToEnd(), what + ": the encoded content is read to its end");
+            }
+        }
+
+        // Through the content of a response, as the message handler uses it
+        auto content = std::make_shared<StreamContent>(
+            std::make_shared<DecompressingContentStream>(std::make_shared<PieceStream>(encoded, 1500), fixture.Encoding));
+        Check(content->LoadIntoBuffer(), std::string(fixture.Name) + ": loads into a buffer");
+        Check(content->ReadAsString() == expected, std::string(fixture.Name) + ": reads as the fixture");
+    }
+}
+
+// Content that ends early fails, wherever it is cut off, and so does
+// content whose connection is lost after all of it arrived
+void TestTruncated()
+{
+    for (auto &fixture : Fixtures)
+    {
+        auto encoded = ReadFixture(fixture.Name);
+
+        for (size_t cut = 1; cut < encoded.size(); cut += (cut < 16 || encoded.size() - cut < 16) ? 1 : 97)
+        {
+            std::string decoded;
+            auto source = std::make_shared<PieceStream>(encoded.substr(0, encoded.size() - cut), 4096);
+            Check(!Decode(source, fixture.Encoding, 65536, decoded), std::string(fixture.Name) + " without its last " + std::to_string(cut) + " bytes fails");
+        }
+
+        std::string decoded;
+        Check(!Decode(std::make_shared<PieceStream>(encoded, 4096, true), fixture.Encoding, 65536, decoded), std::string(fixture.Name) + " with a lost connection fails");
+    }
+
+    auto content = std::make_shared<StreamContent>(
+        std::make_shared<DecompressingContentStream>(std::make_shared<PieceStream>(ReadFixture("response.json.gz").substr(0, 3000), 4096), ContentEncoding::GZip));
+    Check(!content->LoadIntoBuffer(), "truncated content does not load into a buffer");
+}
+
+// Flipped bits in the compressed data or the trailer are caught by the
+// checks of the format. Raw deflate has no check, so only gzip and zlib
+// are corrupted.
+void TestCorrupt()
+{
+    for (auto &fixture : Fixtures)
+    {
+        if (std::string(fixture.Name) == "response.json.deflate")
+        {
+            continue;
+        }
+
+        auto encoded = ReadFixture(fixture.Name);
+
+        for (size_t position : {encoded.size() / 3, encoded.size() / 2, encoded.size() - 6, encoded.size() - 1})
+        {
+            auto corrupt = encoded;
+            corrupt[position] ^= 0x55;
+
+            std::string decoded;
+            Check(!Decode(std::make_shared<PieceStream>(corrupt, 4096), fixture.Encoding, 65536, decoded), std::string(fixture.Name) + " with byte " + std::to_string(position) + " changed fails");
+        }
+    }
+
+    std::string decoded;
+    Check(!Decode(std::make_shared<PieceStream>("this is not compressed at all", 4096), ContentEncoding::GZip, 65536, decoded), "plain text as gzip fails");
+    Check(!Decode(std::make_shared<PieceStream>(std::string(64, '\xff'), 4096), ContentEncoding::Deflate, 65536, decoded), "garbage as deflate fails");
+}
+
+// Encoded content that is empty decodes to nothing, as for a HEAD response
+void TestEmpty()
+{
+    std::string decoded;
+    Check(Decode(std::make_shared<PieceStream>("", 4096), ContentEncoding::GZip, 65536, decoded) && decoded.empty(), "empty gzip content decodes to nothing");
+    Check(Decode(std::make_shared<PieceStream>("", 4096), ContentEncoding::Deflate, 65536, decoded) && decoded.empty(), "empty deflate content decodes to nothing");
+}
+
+int main(
+    int argc,
+    char *argv[])
+{
+    FixtureDirectory = argc > 1 ? argv[1] : "fixtures";
+
+    TestFixtures();
+    TestTruncated();
+    TestCorrupt();
+    TestEmpty();
+
+    if (FailureCount > 0)
+    {
+        std::cerr << FailureCount << " failed" << std::endl;
+        return 1;
+    }
+
+    std::cout << "passed" << std::endl;
+    return 0;
+}
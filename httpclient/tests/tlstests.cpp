@@ -0,0 +1,300 @@
+#include "httpclient.hpp"
+#include "httptlscontext.hpp"
+#include <csignal>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/pk.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/ssl_cache.h>
+#include <mbedtls/ssl_ticket.h>
+#include <mbedtls/version.h>
+#include <mbedtls/x509_crt.h>
+#include <netinet/in.h>
+#include <psa/crypto.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// The fixtures are a CA and a certificate for localhost it signed, both
+// ECDSA P-256 and made with openssl to be valid until 2126
+std::string FixtureDirectory;
+
+int FailureCount = 0;
+
+void Check(
+    bool condition,
+    const std::string &what)
+{
+    if (!condition)
+    {
+        std::cerr << "FAILED: " << what << std::endl;
+        FailureCount++;
+    }
+}
+
+std::string ReadFixture(
+    const std::string &name)
+{
+    std::ifstream file(FixtureDirectory + "/" + name, std::ios::binary);
+    Check(file.good(), "the fixture " + name + " can be read");
+
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+int SendToSocket(
+    void *context,
+    const unsigned char *data,
+    size_t size)
+{
+    auto written = ::send(*static_cast<int *>(context), data, size, MSG_NOSIGNAL);
+
+    return written < 0 ? MBEDTLS_ERR_NET_SEND_FAILED : static_cast<int>(written);
+}
+
+int ReceiveFromSocket(
+    void *context,
+    unsigned char *data,
+    size_t size)
+{
+    auto received = ::recv(*static_cast<int *>(context), data, size, 0);
+
+    return received < 0 ? MBEDTLS_ERR_NET_RECV_FAILED : static_cast<int>(received);
+}
+
+// Answers every connection on listener with a short response and closes it,
+// so each request of the client needs a handshake of its own. Sessions are
+// resumed from a cache of session ids and from tickets, like most servers do.
+void ServeTls(
+    int listener)
+{
+    psa_crypto_init();
+
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context drbg;
+    mbedtls_x509_crt certificate;
+    mbedtls_pk_context key;
+    mbedtls_ssl_cache_context cache;
+    mbedtls_ssl_ticket_context tickets;
+    mbedtls_ssl_config config;
+    mbedtls_ssl_context ssl;
+
+    mbedtls_entropy_init(&entropy);
+    mbedtls_ctr_drbg_init(&drbg);
+    mbedtls_x509_crt_init(&certificate);
+    mbedtls_pk_init(&key);
+    mbedtls_ssl_cache_init(&cache);
+    mbedtls_ssl_ticket_init(&tickets);
+    mbedtls_ssl_config_init(&config);
+    mbedtls_ssl_init(&ssl);
+
+    auto certificatePem = ReadFixture("tls-server.pem");
+    auto keyPem = ReadFixture("tls-server-key.pem");
+
+    bool ready =
+        mbedtls_ctr_drbg_seed(&drbg, mbedtls_entropy_func, &entropy, nullptr, 0) == 0 &&
+        mbedtls_x509_crt_parse(&certificate, reinterpret_cast<const unsigned char *>(certificatePem.c_str()), certificatePem.size() + 1) == 0 &&
+#if MBEDTLS_VERSION_MAJOR >= 3
+        mbedtls_pk_parse_key(&key, reinterpret_cast<const unsigned char *>(keyPem.c_str()), keyPem.size() + 1, nullptr, 0, mbedtls_ctr_drbg_random, &drbg) == 0 &&
+#else
+        mbedtls_pk_parse_key(&key, reinterpret_cast<const unsigned char *>(keyPem.c_str()), keyPem.size() + 1, nullptr, 0) == 0 &&
+#endif
+        mbedtls_ssl_config_defaults(&config, MBEDTLS_SSL_IS_SERVER, MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT) == 0 &&
+        mbedtls_ssl_conf_own_cert(&config, &certificate, &key) == 0 &&
+        mbedtls_ssl_ticket_setup(&tickets, mbedtls_ctr_drbg_random, &drbg, MBEDTLS_CIPHER_AES_256_GCM, 86400) == 0;
+
+    if (ready)
+    {
+        mbedtls_ssl_conf_rng(&config, mbedtls_ctr_drbg_random, &drbg);
+        mbedtls_ssl_conf_session_cache(&config, &cache, mbedtls_ssl_cache_get, mbedtls_ssl_cache_set);
+        mbedtls_ssl_conf_session_tickets_cb(&config, mbedtls_ssl_ticket_write, mbedtls_ssl_ticket_parse, &tickets);
+
+        ready = mbedtls_ssl_setup(&ssl, &config) == 0;
+    }
+
+    if (!ready)
+    {
+        std::cerr << "FAILED: the server could not be set up" << std::endl;
+        return;
+    }
+
+    const std::string response = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\nConnection: close\r\n\r\nok";
+
+    while (true)
+    {
+        int socket = ::accept(listener, nullptr, nullptr);
+        if (socket < 0)
+        {
+            continue;
+        }
+
+        mbedtls_ssl_session_reset(&ssl);
+        mbedtls_ssl_set_bio(&ssl, &socket, SendToSocket, ReceiveFromSocket, nullptr);
+
+        int result;
+        do
+        {
+            result = mbedtls_ssl_handshake(&ssl);
+        } while (result == MBEDTLS_ERR_SSL_WANT_READ || result == MBEDTLS_ERR_SSL_WANT_WRITE);
+
+        // The request is read up to its blank line, it has no content
+        std::string request;
+        while (result == 0 && request.find("\r\n\r\n") == std::string::npos)
+        {
+            unsigned char buffer[1024];
+            auto received = mbedtls_ssl_read(&ssl, buffer, sizeof(buffer));
+            if (received == MBEDTLS_ERR_SSL_WANT_READ || received == MBEDTLS_ERR_SSL_WANT_WRITE)
+            {
+                continue;
+            }
+            if (received <= 0)
+            {
+                result = received;
+                break;
+            }
+            request.append(reinterpret_cast<char *>(buffer), received);
+        }
+
+        if (result == 0)
+        {
+            mbedtls_ssl_write(&ssl, reinterpret_cast<const unsigned char *>(response.data()), response.size());
+            mbedtls_ssl_close_notify(&ssl);
+        }
+
+        ::close(socket);
+    }
+}
+
+std::string Url(
+    int port)
+{
+    return "https://localhost:" + std::to_string(port) + "/";
+}
+
+bool Get(
+    int port)
+{
+    // A handler of its own for each request, the server closes every connection anyway
+    HttpClient client(std::make_shared<HttpMessageHandler>());
+
+    auto response = client.Get(Url(port));
+
+    return response->Content != nullptr && static_cast<int>(response->StatusCode) == 200 && response->Content->ReadAsString() == "ok";
+}
+
+double Milliseconds(
+    std::chrono::microseconds total,
+    int count)
+{
+    return count > 0 ? total.count() / 1000.0 / count : 0;
+}
+
+// The test CA is not in the bundle, so its certificates are refused until it is added
+void TestUntrusted(
+    int port)
+{
+    auto &context = HttpTlsContext::Shared();
+    context.ResetStatistics();
+
+    Check(!Get(port), "untrusted: the request fails");
+
+    auto statistics = context.Statistics();
+    Check(statistics.FailedHandshakes == 1, "untrusted: the handshake failed");
+    Check(statistics.FullHandshakes == 0 && statistics.ResumedHandshakes == 0, "untrusted: no handshake completed");
+}
+
+// Only the first connection does a full handshake, the ones after it resume
+// its session, until the sessions are cleared
+void TestResumption(
+    int port)
+{
+    const int requestCount = 50;
+
+    auto &context = HttpTlsContext::Shared();
+    Check(context.AddCaCertificates(ReadFixture("tls-ca.pem")), "resumption: the test CA is added");
+
+    context.ClearSessions();
+    context.ResetStatistics();
+
+    for (int i = 0; i < requestCount; i++)
+    {
+        Check(Get(port), "resumption: request " + std::to_string(i + 1) + " succeeds");
+    }
+
+    auto statistics = context.Statistics();
+    Check(statistics.FullHandshakes == 1, "resumption: one full handshake, not " + std::to_string(statistics.FullHandshakes));
+    Check(statistics.ResumedHandshakes == requestCount - 1, "resumption: the other handshakes resumed, " + std::to_string(statistics.ResumedHandshakes) + " did");
+    Check(statistics.FailedHandshakes == 0, "resumption: no handshake failed");
+
+    std::printf("Full handshakes: %d, %.3f ms on average. Resumed: %d, %.3f ms on average\n",
+                statistics.FullHandshakes,
+                Milliseconds(statistics.FullHandshakeTime, statistics.FullHandshakes),
+                statistics.ResumedHandshakes,
+                Milliseconds(statistics.ResumedHandshakeTime, statistics.ResumedHandshakes));
+
+    context.ClearSessions();
+    context.ResetStatistics();
+
+    Check(Get(port), "resumption: a request after clearing the sessions succeeds");
+
+    statistics = context.Statistics();
+    Check(statistics.FullHandshakes == 1, "resumption: it does a full handshake");
+
+    std::printf("Full handshake after clearing the sessions: %.3f ms\n", Milliseconds(statistics.FullHandshakeTime, statistics.FullHandshakes));
+}
+
+int main(
+    int argc,
+    char *argv[])
+{
+    FixtureDirectory = argc > 1 ? argv[1] : "fixtures";
+
+    int listener = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    socklen_t length = sizeof(address);
+    if (listener < 0 ||
+        ::bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+        ::listen(listener, 16) != 0 ||
+        ::getsockname(listener, reinterpret_cast<sockaddr *>(&address), &length) != 0)
+    {
+        std::cerr << "FAILED: could not listen on a loopback port" << std::endl;
+        return 1;
+    }
+
+    // The server runs in a process of its own. mbedtls is built without
+    // MBEDTLS_THREADING_C, and a server thread would share the PSA key store
+    // of the client.
+    auto server = fork();
+    if (server == 0)
+    {
+        ServeTls(listener);
+        _exit(1);
+    }
+
+    ::close(listener);
+
+    int port = ntohs(address.sin_port);
+
+    TestUntrusted(port);
+    TestResumption(port);
+
+    kill(server, SIGTERM);
+    waitpid(server, nullptr, 0);
+
+    if (FailureCount > 0)
+    {
+        std::cerr << FailureCount << " failed" << std::endl;
+        return 1;
+    }
+
+    std::cout << "passed" << std::endl;
+    return 0;
+}
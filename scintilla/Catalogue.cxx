@@ -13,6 +13,7 @@
 #include <assert.h>
 
 #include <vector>
+#include <unordered_map>
 
 #include "ILexer.h"
 #include "Scintilla.h"
@@ -28,25 +29,54 @@ using namespace Scintilla;
 static std::vector<LexerModule *> lexerCatalogue;
 static int nextLanguage = SCLEX_AUTOMATIC+1;
 
-const LexerModule *Catalogue::Find(int language) {
-	Scintilla_LinkLexers();
-	for (std::vector<LexerModule *>::iterator it=lexerCatalogue.begin();
-		it != lexerCatalogue.end(); ++it) {
-		if ((*it)->GetLanguage() == language) {
-			return *it;
+// Hashes and compares lexer names by their characters. Names are keyed by the
+// languageName of their module, which lives as long as the module does, so
+// lookups need no copy of the name searched for.
+struct LexerNameHash {
+	size_t operator()(const char *name) const {
+		// FNV-1a
+		size_t hash = static_cast<size_t>(2166136261u);
+		for (; *name; name++) {
+			hash ^= static_cast<unsigned char>(*name);
+			hash *= static_cast<size_t>(16777619u);
 		}
+		return hash;
+	}
+};
+
+struct LexerNameEqual {
+	bool operator()(const char *a, const char *b) const {
+		return strcmp(a, b) == 0;
+	}
+};
+
+// Indexes over lexerCatalogue, filled in as lexers are added so that lookups
+// do not scan the catalogue.
+static std::unordered_map<int, LexerModule *> lexersByLanguage;
+static std::unordered_map<const char *, LexerModule *, LexerNameHash, LexerNameEqual> lexersByName;
+
+// Adds the lexers of Scintilla to the catalogue the first time it is searched
+static inline void LinkLexersOnce() {
+	static const int linked = Scintilla_LinkLexers();
+	(void)linked;
+}
+
+const LexerModule *Catalogue::Find(int language) {
+	LinkLexersOnce();
+	std::unordered_map<int, LexerModule *>::const_iterator it = lexersByLanguage.find(language);
+	if (it != lexersByLanguage.end()) {
+		return it->second;
 	}
 	return 0;
 }
 
 const LexerModule *Catalogue::Find(const char *languageName) {
-	Scintilla_LinkLexers();
+	LinkLexersOnce();
 	if (languageName) {
-		for (std::vector<LexerModule *>::iterator it=lexerCatalogue.begin();
-			it != lexerCatalogue.end(); ++it) {
-			if ((*it)->languageName && (0 == strcmp((*it)->languageName, languageName))) {
-				return *it;
-			}
+		std::unordered_map<const char *, LexerModule *, LexerNameHash, LexerNameEqual>::const_iterator it =
+			lexersByName.find(languageName);
+		if (it != lexersByName.end()) {
+			return it->second;
 		}
 	}
 	return 0;
@@ -58,6 +88,11 @@ void Catalogue::AddLexerModule(LexerModule *plm) {
 		nextLanguage++;
 	}
 	lexerCatalogue.push_back(plm);
+	// The first module added for a language or name wins, as it did when searching in order
+	lexersByLanguage.insert(std::make_pair(plm->GetLanguage(), plm));
+	if (plm->languageName) {
+		lexersByName.insert(std::make_pair(plm->languageName, plm));
+	}
 }
 
 // Alternative historical name for Scintilla_LinkLexers
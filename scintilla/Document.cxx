@@ -116,6 +116,8 @@ Document::Document() {
 	perLineData[ldState] = new LineState();
 	perLineData[ldMargin] = new LineAnnotation();
 	perLineData[ldAnnotation] = new LineAnnotation();
+	perLineData[ldCharacters] = new LineCharacterCheckpoints();
+	lineCharacterIndex = SC_LINECHARACTERINDEX_NONE;
 
 	cb.SetPerLine(this);
 
@@ -637,6 +639,7 @@ int Document::SafeSegment(const char *text, int length, int lengthSegment) {
 void Document::ModifiedAt(int pos) {
 	if (endStyled > pos)
 		endStyled = pos;
+	InvalidateLineCharacters(pos);
 }
 
 void Document::CheckReadOnly() {
@@ -966,6 +969,9 @@ int Document::GetColumn(int pos) {
 	int column = 0;
 	int line = LineFromPosition(pos);
 	if ((line >= 0) && (line < LinesTotal())) {
+		const LineCharacters *lc = IndexedLine(line);
+		if (lc)
+			return CheckpointAt(lc, line, Platform::Minimum(pos, LineEnd(line))).column;
 		for (int i = LineStart(line); i < pos;) {
 			char ch = cb.CharAt(i);
 			if (ch == '\t') {
@@ -989,6 +995,12 @@ int Document::GetColumn(int pos) {
 int Document::CountCharacters(int startPos, int endPos) {
 	startPos = MovePositionOutsideChar(startPos, 1, false);
 	endPos = MovePositionOutsideChar(endPos, -1, false);
+	const int line = LineFromPosition(startPos);
+	if ((startPos < endPos) && (line == LineFromPosition(endPos))) {
+		const LineCharacters *lc = IndexedLine(line);
+		if (lc)
+			return CheckpointAt(lc, line, endPos).characters - CheckpointAt(lc, line, startPos).characters;
+	}
 	int count = 0;
 	int i = startPos;
 	while (i < endPos) {
@@ -1000,9 +1012,45 @@ int Document::CountCharacters(int startPos, int endPos) {
 	return count;
 }
 
+/**
+ * Count the UTF-16 code units between two positions. Characters outside the
+ * Basic Multilingual Plane take 4 bytes in UTF-8 and 2 code units in UTF-16.
+ */
+int Document::CountUTF16(int startPos, int endPos) {
+	startPos = MovePositionOutsideChar(startPos, 1, false);
+	endPos = MovePositionOutsideChar(endPos, -1, false);
+	const int line = LineFromPosition(startPos);
+	if ((startPos < endPos) && (line == LineFromPosition(endPos))) {
+		const LineCharacters *lc = IndexedLine(line);
+		if (lc)
+			return CheckpointAt(lc, line, endPos).codeUnits - CheckpointAt(lc, line, startPos).codeUnits;
+	}
+	int count = 0;
+	int i = startPos;
+	while (i < endPos) {
+		const int next = NextPosition(i, 1);
+		count += (next - i == 4) ? 2 : 1;
+		i = next;
+	}
+	return count;
+}
+
 int Document::FindColumn(int line, int column) {
 	int position = LineStart(line);
 	if ((line >= 0) && (line < LinesTotal())) {
+		const LineCharacters *lc = IndexedLine(line);
+		if (lc) {
+			const int lineEnd = LineEnd(line);
+			CharacterCheckpoint cp = lc->Before(&CharacterCheckpoint::column, column);
+			while ((cp.column < column) && (position + cp.position < lineEnd)) {
+				CharacterCheckpoint cpNext = cp;
+				AdvanceCharacter(cpNext, position);
+				if (cpNext.column > column)
+					break;
+				cp = cpNext;
+			}
+			return position + cp.position;
+		}
 		int columnCurrent = 0;
 		while ((columnCurrent < column) && (position < Length())) {
 			char ch = cb.CharAt(position);
@@ -1024,6 +1072,89 @@ int Document::FindColumn(int line, int column) {
 	return position;
 }
 
+int Document::LineCharacterIndex() const {
+	return lineCharacterIndex;
+}
+
+void Document::AllocateLineCharacterIndex(int lineCharacterIndex_) {
+	lineCharacterIndex |= lineCharacterIndex_ & (SC_LINECHARACTERINDEX_UTF32 | SC_LINECHARACTERINDEX_UTF16);
+}
+
+void Document::ReleaseLineCharacterIndex(int lineCharacterIndex_) {
+	lineCharacterIndex &= ~lineCharacterIndex_;
+	if (lineCharacterIndex == SC_LINECHARACTERINDEX_NONE)
+		static_cast<LineCharacterCheckpoints *>(perLineData[ldCharacters])->ClearAll();
+}
+
+/**
+ * Step cp over the character at lineStart + cp.position, which must be before the line end.
+ */
+void Document::AdvanceCharacter(CharacterCheckpoint &cp, int lineStart) const {
+	const int pos = lineStart + cp.position;
+	if (cb.CharAt(pos) == '\t') {
+		cp.column = NextTab(cp.column, tabInChars);
+		cp.position++;
+		cp.codeUnits++;
+	} else {
+		const int posNext = NextPosition(pos, 1);
+		cp.column++;
+		cp.codeUnits += (posNext - pos == 4) ? 2 : 1;
+		cp.position = posNext - lineStart;
+	}
+	cp.characters++;
+}
+
+/**
+ * Checkpoints for a line long enough to benefit from them, created when first needed.
+ * Short lines and documents without a line character index return 0 and are scanned directly.
+ */
+const LineCharacters *Document::IndexedLine(int line) {
+	if (lineCharacterIndex == SC_LINECHARACTERINDEX_NONE)
+		return 0;
+	LineCharacterCheckpoints *plc = static_cast<LineCharacterCheckpoints *>(perLineData[ldCharacters]);
+	const LineCharacters *lc = plc->Characters(line);
+	if (lc && (lc->tabInChars == tabInChars))
+		return lc;
+	const int lineStart = LineStart(line);
+	const int lengthLine = LineEnd(line) - lineStart;
+	if (lengthLine < 2 * LineCharacters::checkpointStep)
+		return 0;
+	LineCharacters *lcNew = new LineCharacters(tabInChars);
+	CharacterCheckpoint cp = {0, 0, 0, 0};
+	lcNew->checkpoints.push_back(cp);
+	int positionCheckpoint = LineCharacters::checkpointStep;
+	while (cp.position < lengthLine) {
+		AdvanceCharacter(cp, lineStart);
+		if (cp.position >= positionCheckpoint) {
+			lcNew->checkpoints.push_back(cp);
+			positionCheckpoint = cp.position + LineCharacters::checkpointStep;
+		}
+	}
+	plc->SetCharacters(line, lcNew);
+	return lcNew;
+}
+
+/**
+ * Counts from the start of line up to pos which must be a character boundary in the line.
+ */
+CharacterCheckpoint Document::CheckpointAt(const LineCharacters *lc, int line, int pos) {
+	const int lineStart = LineStart(line);
+	CharacterCheckpoint cp = lc->Before(&CharacterCheckpoint::position, pos - lineStart);
+	while (lineStart + cp.position < pos)
+		AdvanceCharacter(cp, lineStart);
+	return cp;
+}
+
+void Document::InvalidateLineCharacters(int pos) {
+	if (lineCharacterIndex != SC_LINECHARACTERINDEX_NONE) {
+		// A modification may join the line containing pos with the next
+		LineCharacterCheckpoints *plc = static_cast<LineCharacterCheckpoints *>(perLineData[ldCharacters]);
+		const int line = LineFromPosition(pos);
+		plc->Invalidate(line);
+		plc->Invalidate(line + 1);
+	}
+}
+
 void Document::Indent(bool forwards, int lineBottom, int lineTop) {
 	// Dedent - suck white space off the front of the line to dedent by equivalent of a tab
 	for (int line = lineBottom; line >= lineTop; line--) {
@@ -75,6 +75,8 @@ public:
 class DocWatcher;
 class DocModification;
 class Document;
+class LineCharacters;
+struct CharacterCheckpoint;
 
 /**
  * Interface class for regular expression searching
@@ -223,8 +225,9 @@ private:
 	int lenWatchers;
 
 	// ldSize is not real data - it is for dimensions and loops
-	enum lineData { ldMarkers, ldLevels, ldState, ldMargin, ldAnnotation, ldSize };
+	enum lineData { ldMarkers, ldLevels, ldState, ldMargin, ldAnnotation, ldCharacters, ldSize };
 	PerLine *perLineData[ldSize];
+	int lineCharacterIndex;
 
 	bool matchesValid;
 	RegexSearchBase *regex;
@@ -301,7 +304,11 @@ public:
 	int GetLineIndentPosition(int line) const;
 	int GetColumn(int position);
 	int CountCharacters(int startPos, int endPos);
+	int CountUTF16(int startPos, int endPos);
 	int FindColumn(int line, int column);
+	int LineCharacterIndex() const;
+	void AllocateLineCharacterIndex(int lineCharacterIndex_);
+	void ReleaseLineCharacterIndex(int lineCharacterIndex_);
 	void Indent(bool forwards, int lineBottom, int lineTop);
 	static char *TransformLineEnds(int *pLenOut, const char *s, size_t len, int eolModeWanted);
 	void ConvertLineEnds(int eolModeSet);
@@ -416,6 +423,10 @@ private:
 	bool IsWordEndAt(int pos);
 	bool IsWordAt(int start, int end);
 
+	const LineCharacters *IndexedLine(int line);
+	void AdvanceCharacter(CharacterCheckpoint &cp, int lineStart) const;
+	CharacterCheckpoint CheckpointAt(const LineCharacters *lc, int line, int pos);
+	void InvalidateLineCharacters(int pos);
 	void NotifyModifyAttempt();
 	void NotifySavePoint(bool atSavePoint);
 	void NotifyModified(DocModification mh);
@@ -14,6 +14,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <algorithm>
 #include <memory>
 
@@ -235,6 +236,7 @@ void Editor::Finalise() {
 void Editor::InvalidateStyleData() {
 	stylesValid = false;
 	llc.Invalidate(LineLayout::llInvalid);
+	lcc.Clear();
 	posCache.Clear();
 }
 
@@ -364,7 +366,8 @@ Point Editor::LocationFromPosition(SelectionPosition pos) {
 		pt.y = (lineVisible - topLine - 1) * vs.lineHeight;
 		pt.x = 0;
 		unsigned int posLineStart = pdoc->LineStart(line);
-		LayoutLine(line, drawSurface, vs, ll, wrapWidth);
+		LayoutLine(line, drawSurface, vs, ll, wrapWidth, pos.Position() - posLineStart);
+		posLineStart += ll->windowStart;
 		int posInLine = pos.Position() - posLineStart;
 		// In case of very long line put x at arbitrary large position
 		if (posInLine > ll->maxLineLength) {
@@ -384,7 +387,7 @@ Point Editor::LocationFromPosition(SelectionPosition pos) {
 				pt.y += vs.lineHeight;
 			}
 		}
-		pt.x += vs.fixedColumnWidth - xOffset;
+		pt.x += vs.fixedColumnWidth - xOffset + ll->xWindowStart;
 	}
 	pt.x += pos.VirtualSpace() * vs.styles[ll->EndLineStyle()].spaceWidth;
 	return pt;
@@ -427,7 +430,7 @@ SelectionPosition Editor::SPositionFromLocation(Point pt, bool canReturnInvalid,
 		if (pt.y < 0)
 			return SelectionPosition(INVALID_POSITION);
 	}
-	pt.x = pt.x - vs.fixedColumnWidth + xOffset;
+	const int xLine = static_cast<int>(pt.x) - vs.fixedColumnWidth + xOffset;
 	int visibleLine = pt.y / vs.lineHeight + topLine;
 	if (pt.y < 0) {	// Division rounds towards 0
 		visibleLine = (static_cast<int>(pt.y) - (vs.lineHeight - 1)) / vs.lineHeight + topLine;
@@ -444,7 +447,10 @@ SelectionPosition Editor::SPositionFromLocation(Point pt, bool canReturnInvalid,
 
 	AutoLineLayout ll(llc, RetrieveLineLayout(lineDoc));
 	if (drawSurface && ll) {
-		LayoutLine(lineDoc, drawSurface, vs, ll, wrapWidth);
+		LayoutLine(lineDoc, drawSurface, vs, ll, wrapWidth, 0, Platform::Maximum(xLine, 0));
+		// Relative to the laid out part of a long line
+		posLineStart += ll->windowStart;
+		pt.x = pt.x - vs.fixedColumnWidth + (xOffset - ll->xWindowStart);
 		int lineStartSet = cs.DisplayFromDoc(lineDoc);
 		int subLine = visibleLine - lineStartSet;
 		if (subLine < ll->lines) {
@@ -506,12 +512,13 @@ SelectionPosition Editor::SPositionFromLineX(int lineDoc, int x) {
 	int retVal = 0;
 	if (drawSurface && ll) {
 		unsigned int posLineStart = pdoc->LineStart(lineDoc);
-		LayoutLine(lineDoc, drawSurface, vs, ll, wrapWidth);
+		LayoutLine(lineDoc, drawSurface, vs, ll, wrapWidth, 0, Platform::Maximum(x, 0));
+		posLineStart += ll->windowStart;
 		int subLine = 0;
 		int lineStart = ll->LineStart(subLine);
 		int lineEnd = ll->LineLastVisible(subLine);
 		float subLineStart = ll->positions[lineStart];
-		float newX = x;
+		float newX = static_cast<float>(x - ll->xWindowStart);
 
 		if (ll->wrapIndent != 0) {
 			if (lineStart != 0)	// Wrapped
@@ -982,8 +989,9 @@ int Editor::DisplayFromPosition(int pos) {
 
 	AutoLineLayout ll(llc, RetrieveLineLayout(lineDoc));
 	if (drawSurface && ll) {
-		LayoutLine(lineDoc, drawSurface, vs, ll, wrapWidth);
 		unsigned int posLineStart = pdoc->LineStart(lineDoc);
+		LayoutLine(lineDoc, drawSurface, vs, ll, wrapWidth, pos - posLineStart);
+		posLineStart += ll->windowStart;
 		int posInLine = pos - posLineStart;
 		lineDisplay--; // To make up for first increment ahead.
 		for (int subLine = 0; subLine < ll->lines; subLine++) {
@@ -1482,8 +1490,11 @@ void Editor::LinesSplit(int pixelWidth) {
 			//AutoSurface surface(this);
 			AutoLineLayout ll(llc, RetrieveLineLayout(line));
 			if (drawSurface && ll) {
-				unsigned int posLineStart = pdoc->LineStart(line);
 				LayoutLine(line, drawSurface, vs, ll, pixelWidth);
+				// A windowed layout only holds part of a long line and its sublines are
+				// relative to the window. What follows the last split becomes a later
+				// line of this loop, so it is split in turn.
+				unsigned int posLineStart = pdoc->LineStart(line) + ll->windowStart;
 				for (int subLine = 1; subLine < ll->lines; subLine++) {
 					pdoc->InsertCString(
 						static_cast<int>(posLineStart + (subLine - 1) * strlen(eol) +
@@ -1878,8 +1889,13 @@ LineLayout *Editor::RetrieveLineLayout(int lineNumber) {
 	int posLineEnd = pdoc->LineStart(lineNumber + 1);
 	PLATFORM_ASSERT(posLineEnd >= posLineStart);
 	int lineCaret = pdoc->LineFromPosition(sel.MainCaret());
+	int maxChars = posLineEnd - posLineStart;
+	if ((wrapState == eWrapNone) && (maxChars > LineLayout::lengthWindowMax)) {
+		// Only a window of the line is laid out at once
+		maxChars = LineLayout::lengthWindowMax;
+	}
 	return llc.Retrieve(lineNumber, lineCaret,
-	        posLineEnd - posLineStart, pdoc->GetStyleClock(),
+	        maxChars, pdoc->GetStyleClock(),
 	        LinesOnScreen() + 1, pdoc->LinesTotal());
 }
 
@@ -1972,12 +1988,199 @@ bool BadUTF(const char *s, int len, int &trailBytes) {
 	}
 }
 
+/**
+ * Copy @a length characters and their styles from @a posStart into the start of the
+ * LineLayout arrays, separating styles from indicators for the first @a numCharsInLine.
+ */
+void Editor::FillLayout(ViewStyle &vstyle, LineLayout *ll, int posStart, int length, int numCharsInLine) {
+	const int styleMask = pdoc->stylingBitsMask;
+	ll->styleBitsSet = 0;
+	pdoc->GetCharRange(ll->chars, posStart, length);
+	pdoc->GetStyleRange(ll->styles, posStart, length);
+	for (int styleInLine = 0; styleInLine < numCharsInLine; styleInLine++) {
+		char styleByte = ll->styles[styleInLine];
+		ll->styleBitsSet |= styleByte;
+		ll->styles[styleInLine] = static_cast<char>(styleByte & styleMask);
+		ll->indicators[styleInLine] = static_cast<char>(styleByte & ~styleMask);
+	}
+	if (vstyle.someStylesForceCase) {
+		for (int charInLine = 0; charInLine<length; charInLine++) {
+			char chDoc = ll->chars[charInLine];
+			if (vstyle.styles[ll->styles[charInLine]].caseForce == Style::caseUpper)
+				ll->chars[charInLine] = static_cast<char>(toupper(chDoc));
+			else if (vstyle.styles[ll->styles[charInLine]].caseForce == Style::caseLower)
+				ll->chars[charInLine] = static_cast<char>(tolower(chDoc));
+		}
+	}
+}
+
+/**
+ * Determine the x position of each character from @a start to @a end in the LineLayout
+ * relative to the position of @a start which is @a xLine pixels from the start of the line.
+ * A segment always ends at @a end so the range can be measured independently.
+ * Returns true if the last segment is italic.
+ */
+bool Editor::MeasureLayout(Surface *surface, ViewStyle &vstyle, LineLayout *ll, int start, int end, int xLine) {
+	int startseg = start;	// Start of the current segment, in char. number
+	float startsegx = 0;	// Start of the current segment, in pixels
+	ll->positions[start] = 0;
+	float tabWidth = vstyle.spaceWidth * pdoc->tabInChars;
+	bool lastSegItalics = false;
+	Font &ctrlCharsFont = vstyle.styles[STYLE_CONTROLCHAR].font;
+
+	float ctrlCharWidth[32] = {0};
+	bool isControlNext = IsControlCharacter(ll->chars[start]);
+	int trailBytes = 0;
+	bool isBadUTFNext = BadUTF(ll->chars + start, end - start, trailBytes);
+	for (int charInLine = start; charInLine < end; charInLine++) {
+		bool isControl = isControlNext;
+		isControlNext = IsControlCharacter(ll->chars[charInLine + 1]);
+		bool isBadUTF = isBadUTFNext;
+		isBadUTFNext = BadUTF(ll->chars + charInLine + 1, end - charInLine - 1, trailBytes);
+		if ((ll->styles[charInLine] != ll->styles[charInLine + 1]) ||
+		        isControl || isControlNext || isBadUTF || isBadUTFNext || (charInLine + 1 == end)) {
+			ll->positions[startseg] = 0;
+			if (vstyle.styles[ll->styles[charInLine]].visible) {
+				if (isControl) {
+					if (ll->chars[charInLine] == '\t') {
+						// Tab stops are relative to the start of the line, not the range
+						const double xTab = xLine + startsegx;
+						ll->positions[charInLine + 1] = static_cast<float>(
+							((static_cast<int>((xTab + 2) / tabWidth) + 1) * tabWidth) - xTab);
+					} else if (controlCharSymbol < 32) {
+						if (ctrlCharWidth[ll->chars[charInLine]] == 0) {
+							const char *ctrlChar = ControlCharacterString(ll->chars[charInLine]);
+							// +3 For a blank on front and rounded edge each side:
+							ctrlCharWidth[ll->chars[charInLine]] =
+							    surface->WidthText(ctrlCharsFont, ctrlChar, istrlen(ctrlChar)) + 3;
+						}
+						ll->positions[charInLine + 1] = ctrlCharWidth[ll->chars[charInLine]];
+					} else {
+						char cc[2] = { static_cast<char>(controlCharSymbol), '\0' };
+						surface->MeasureWidths(ctrlCharsFont, cc, 1,
+						        ll->positions + startseg + 1);
+					}
+					lastSegItalics = false;
+				} else if (isBadUTF) {
+					char hexits[4];
+					sprintf(hexits, "x%2X", ll->chars[charInLine] & 0xff);
+					ll->positions[charInLine + 1] =
+					    surface->WidthText(ctrlCharsFont, hexits, istrlen(hexits)) + 3;
+				} else {	// Regular character
+					int lenSeg = charInLine - startseg + 1;
+					if ((lenSeg == 1) && (' ' == ll->chars[startseg])) {
+						lastSegItalics = false;
+						// Over half the segments are single characters and of these about half are space characters.
+						ll->positions[charInLine + 1] = vstyle.styles[ll->styles[charInLine]].spaceWidth;
+					} else {
+						lastSegItalics = vstyle.styles[ll->styles[charInLine]].italic;
+						posCache.MeasureWidths(surface, vstyle, ll->styles[charInLine], ll->chars + startseg,
+						        lenSeg, ll->positions + startseg + 1, pdoc);
+					}
+				}
+			} else {    // invisible
+				for (int posToZero = startseg; posToZero <= (charInLine + 1); posToZero++) {
+					ll->positions[posToZero] = 0;
+				}
+			}
+			for (int posToIncrease = startseg; posToIncrease <= (charInLine + 1); posToIncrease++) {
+				ll->positions[posToIncrease] += startsegx;
+			}
+			startsegx = ll->positions[charInLine + 1];
+			startseg = charInLine + 1;
+		}
+	}
+	return lastSegItalics;
+}
+
+/**
+ * Add checkpoints to a long line until one is beyond both @a posInLine and @a x or the
+ * end of the line is reached. The LineLayout arrays are used to measure each step.
+ */
+void Editor::ExtendCheckpoints(int line, Surface *surface, ViewStyle &vstyle, LineLayout *ll,
+	LineCheckpoints &lcp, int posInLine, int x) {
+	const int posLineStart = pdoc->LineStart(line);
+	const int lengthLine = pdoc->LineEnd(line) - posLineStart;
+	while (!lcp.complete && (lcp.Start(lcp.Count() - 1) <= posInLine) && (lcp.X(lcp.Count() - 1) <= x)) {
+		const int checkpoint = lcp.Count() - 1;
+		const int start = lcp.Start(checkpoint);
+		int end = pdoc->MovePositionOutsideChar(posLineStart + start + LineCheckpoints::checkpointStep, 1) -
+			posLineStart;
+		if (end >= lengthLine) {
+			end = lengthLine;
+			lcp.complete = true;
+		}
+		const int length = end - start;
+		PLATFORM_ASSERT(length < ll->maxLineLength);
+		FillLayout(vstyle, ll, posLineStart + start, length, length);
+		ll->chars[length] = 0;
+		ll->styles[length] = 0;
+		MeasureLayout(surface, vstyle, ll, 0, length, lcp.X(checkpoint));
+		lcp.Add(end, lcp.X(checkpoint) + static_cast<int>(ll->positions[length] + 0.5));
+		ll->validity = LineLayout::llInvalid;
+	}
+}
+
+/**
+ * Choose the part of a long line to lay out: starting at the checkpoint before @a xTarget,
+ * or before @a posInLineTarget when there is no x target, and wide enough to fill the text area.
+ */
+void Editor::ChooseLayoutWindow(int line, Surface *surface, ViewStyle &vstyle, LineLayout *ll,
+	int posInLineTarget, int xTarget) {
+	LineCheckpoints &lcp = lcc.Retrieve(line);
+	const int lengthLine = pdoc->LineStart(line + 1) - pdoc->LineStart(line);
+	const int widthText = static_cast<int>(GetTextRectangle().Width());
+
+	// Keep the current window while it is still valid, covers the target and fills the
+	// text area so that painting and hit testing share one layout
+	const bool windowValid = (ll->windowEnd > 0) && lcp.Contains(ll->windowStart) &&
+		(lcp.X(lcp.FindPosition(ll->windowStart)) == ll->xWindowStart) &&
+		((ll->windowEnd == lengthLine) ? lcp.complete : lcp.Contains(ll->windowEnd));
+	if (windowValid) {
+		const bool toEnd = ll->windowEnd == lengthLine;
+		const bool fillsView = toEnd || (ll->xWindowEnd >= xOffset + widthText);
+		if ((xTarget >= 0) && (ll->xWindowStart <= xTarget) &&
+			(toEnd || (xTarget < ll->xWindowEnd)) && fillsView)
+			return;
+		if ((xTarget < 0) && (ll->windowStart <= posInLineTarget) &&
+			(toEnd || (posInLineTarget < ll->windowEnd)) && fillsView)
+			return;
+	}
+
+	int first;
+	if (xTarget >= 0) {
+		ExtendCheckpoints(line, surface, vstyle, ll, lcp, lengthLine, xTarget);
+		first = lcp.FindX(xTarget);
+	} else {
+		ExtendCheckpoints(line, surface, vstyle, ll, lcp, posInLineTarget, LineLayout::wrapWidthInfinite);
+		first = lcp.FindPosition(posInLineTarget);
+	}
+	if (lcp.complete && (first == lcp.Count() - 1) && (first > 0)) {
+		// The last checkpoint is the end of the line so start the window one step earlier
+		first--;
+	}
+	// Leave space for the line end characters
+	const int lengthWindowMax = ll->maxLineLength - 2;
+	const int xEnd = Platform::Maximum(Platform::Maximum(lcp.X(first), xTarget), xOffset) + widthText;
+	ExtendCheckpoints(line, surface, vstyle, ll, lcp, lcp.Start(first) + lengthWindowMax, xEnd);
+	int last = first + 1;
+	while ((last + 1 < lcp.Count()) && (lcp.X(last) <= xEnd) &&
+		(lcp.Start(last + 1) - lcp.Start(first) <= lengthWindowMax)) {
+		last++;
+	}
+	const int windowEnd = (lcp.complete && (last == lcp.Count() - 1)) ? lengthLine : lcp.Start(last);
+	ll->SetWindow(lcp.Start(first), windowEnd, lcp.X(first), lcp.X(last));
+}
+
 /**
  * Fill in the LineLayout data for the given line.
  * Copy the given @a line and its styles from the document into local arrays.
  * Also determine the x position at which each character starts.
+ * An unwrapped line too long for the LineLayout is laid out as a window around
+ * @a xTarget or, when that is negative, @a posInLineTarget.
  */
-void Editor::LayoutLine(int line, Surface *surface, ViewStyle &vstyle, LineLayout *ll, int width) {
+void Editor::LayoutLine(int line, Surface *surface, ViewStyle &vstyle, LineLayout *ll, int width,
+	int posInLineTarget, int xTarget) {
 	if (!ll)
 		return;
 
@@ -1985,9 +2188,18 @@ void Editor::LayoutLine(int line, Surface *surface, ViewStyle &vstyle, LineLayou
 	PLATFORM_ASSERT(ll->chars != NULL);
 	int posLineStart = pdoc->LineStart(line);
 	int posLineEnd = pdoc->LineStart(line + 1);
-	// If the line is very long, limit the treatment to a length that should fit in the viewport
-	if (posLineEnd > (posLineStart + ll->maxLineLength)) {
-		posLineEnd = posLineStart + ll->maxLineLength;
+	ll->windowed = (posLineEnd > (posLineStart + ll->maxLineLength)) &&
+		(&vstyle == &vs) && (wrapState == eWrapNone);
+	if (ll->windowed) {
+		ChooseLayoutWindow(line, surface, vstyle, ll, posInLineTarget, xTarget);
+		posLineEnd = posLineStart + ll->windowEnd;
+		posLineStart += ll->windowStart;
+	} else {
+		ll->SetWindow(0, 0, 0, 0);
+		// If the line is very long, limit the treatment to a length that should fit in the viewport
+		if (posLineEnd > (posLineStart + ll->maxLineLength)) {
+			posLineEnd = posLineStart + ll->maxLineLength;
+		}
 	}
 	if (ll->validity == LineLayout::llCheckTextAndStyle) {
 		int lineLength = posLineEnd - posLineStart;
@@ -2041,39 +2253,23 @@ void Editor::LayoutLine(int line, Surface *surface, ViewStyle &vstyle, LineLayou
 			ll->edgeColumn = pdoc->FindColumn(line, theEdge);
 			if (ll->edgeColumn >= posLineStart) {
 				ll->edgeColumn -= posLineStart;
+			} else if (ll->windowed) {
+				ll->edgeColumn = 0;	// Window starts beyond the edge
 			}
 		} else {
 			ll->edgeColumn = -1;
 		}
 
-		char styleByte;
-		const int styleMask = pdoc->stylingBitsMask;
-		ll->styleBitsSet = 0;
 		// Fill base line layout
 		const int lineLength = posLineEnd - posLineStart;
-		pdoc->GetCharRange(ll->chars, posLineStart, lineLength);
-		pdoc->GetStyleRange(ll->styles, posLineStart, lineLength);
 		int numCharsBeforeEOL = lineLength;
-		while ((numCharsBeforeEOL > 0) && IsEOLChar(ll->chars[numCharsBeforeEOL-1])) {
+		while ((numCharsBeforeEOL > 0) && IsEOLChar(pdoc->CharAt(posLineStart + numCharsBeforeEOL - 1))) {
 			numCharsBeforeEOL--;
 		}
 		const int numCharsInLine = (vstyle.viewEOL) ? lineLength : numCharsBeforeEOL;
-		for (int styleInLine = 0; styleInLine < numCharsInLine; styleInLine++) {
-			styleByte = ll->styles[styleInLine];
-			ll->styleBitsSet |= styleByte;
-			ll->styles[styleInLine] = static_cast<char>(styleByte & styleMask);
-			ll->indicators[styleInLine] = static_cast<char>(styleByte & ~styleMask);
-		}
-		styleByte = static_cast<char>(((lineLength > 0) ? ll->styles[lineLength-1] : 0) & styleMask);
-		if (vstyle.someStylesForceCase) {
-			for (int charInLine = 0; charInLine<lineLength; charInLine++) {
-				char chDoc = ll->chars[charInLine];
-				if (vstyle.styles[ll->styles[charInLine]].caseForce == Style::caseUpper)
-					ll->chars[charInLine] = static_cast<char>(toupper(chDoc));
-				else if (vstyle.styles[ll->styles[charInLine]].caseForce == Style::caseLower)
-					ll->chars[charInLine] = static_cast<char>(tolower(chDoc));
-			}
-		}
+		FillLayout(vstyle, ll, posLineStart, lineLength, numCharsInLine);
+		const char styleByte = static_cast<char>(((lineLength > 0) ? ll->styles[lineLength-1] : 0) &
+			pdoc->stylingBitsMask);
 		ll->xHighlightGuide = 0;
 		// Extra element at the end of the line to hold end x position and act as
 		ll->chars[numCharsInLine] = 0;   // Also triggers processing in the loops as this is a control character
@@ -2082,76 +2278,38 @@ void Editor::LayoutLine(int line, Surface *surface, ViewStyle &vstyle, LineLayou
 
 		// Layout the line, determining the position of each character,
 		// with an extra element at the end for the end of the line.
-		int startseg = 0;	// Start of the current segment, in char. number
-		float startsegx = 0;	// Start of the current segment, in pixels
-		ll->positions[0] = 0;
-		float tabWidth = vstyle.spaceWidth * pdoc->tabInChars;
 		bool lastSegItalics = false;
-		Font &ctrlCharsFont = vstyle.styles[STYLE_CONTROLCHAR].font;
-
-		float ctrlCharWidth[32] = {0};
-		bool isControlNext = IsControlCharacter(ll->chars[0]);
-		int trailBytes = 0;
-		bool isBadUTFNext = BadUTF(ll->chars, numCharsInLine, trailBytes);
-		for (int charInLine = 0; charInLine < numCharsInLine; charInLine++) {
-			bool isControl = isControlNext;
-			isControlNext = IsControlCharacter(ll->chars[charInLine + 1]);
-			bool isBadUTF = isBadUTFNext;
-			isBadUTFNext = BadUTF(ll->chars + charInLine + 1, numCharsInLine - charInLine - 1, trailBytes);
-			if ((ll->styles[charInLine] != ll->styles[charInLine + 1]) ||
-			        isControl || isControlNext || isBadUTF || isBadUTFNext) {
-				ll->positions[startseg] = 0;
-				if (vstyle.styles[ll->styles[charInLine]].visible) {
-					if (isControl) {
-						if (ll->chars[charInLine] == '\t') {
-							ll->positions[charInLine + 1] = 
-								((static_cast<int>((startsegx + 2) / tabWidth) + 1) * tabWidth) - startsegx;
-						} else if (controlCharSymbol < 32) {
-							if (ctrlCharWidth[ll->chars[charInLine]] == 0) {
-								const char *ctrlChar = ControlCharacterString(ll->chars[charInLine]);
-								// +3 For a blank on front and rounded edge each side:
-								ctrlCharWidth[ll->chars[charInLine]] =
-								    surface->WidthText(ctrlCharsFont, ctrlChar, istrlen(ctrlChar)) + 3;
-							}
-							ll->positions[charInLine + 1] = ctrlCharWidth[ll->chars[charInLine]];
-						} else {
-							char cc[2] = { static_cast<char>(controlCharSymbol), '\0' };
-							surface->MeasureWidths(ctrlCharsFont, cc, 1,
-							        ll->positions + startseg + 1);
-						}
-						lastSegItalics = false;
-					} else if (isBadUTF) {
-						char hexits[4];
-						sprintf(hexits, "x%2X", ll->chars[charInLine] & 0xff);
-						ll->positions[charInLine + 1] =
-						    surface->WidthText(ctrlCharsFont, hexits, istrlen(hexits)) + 3;
-					} else {	// Regular character
-						int lenSeg = charInLine - startseg + 1;
-						if ((lenSeg == 1) && (' ' == ll->chars[startseg])) {
-							lastSegItalics = false;
-							// Over half the segments are single characters and of these about half are space characters.
-							ll->positions[charInLine + 1] = vstyle.styles[ll->styles[charInLine]].spaceWidth;
-						} else {
-							lastSegItalics = vstyle.styles[ll->styles[charInLine]].italic;
-							posCache.MeasureWidths(surface, vstyle, ll->styles[charInLine], ll->chars + startseg,
-							        lenSeg, ll->positions + startseg + 1, pdoc);
-						}
-					}
-				} else {    // invisible
-					for (int posToZero = startseg; posToZero <= (charInLine + 1); posToZero++) {
-						ll->positions[posToZero] = 0;
-					}
+		if (ll->windowed) {
+			// Measure from each checkpoint in the window so positions agree with the checkpoints
+			LineCheckpoints &lcp = lcc.Retrieve(line);
+			int checkpoint = lcp.FindPosition(ll->windowStart);
+			int start = 0;
+			while (start < numCharsInLine) {
+				const bool toCheckpoint = checkpoint + 1 < lcp.Count() &&
+					(lcp.Start(checkpoint + 1) - ll->windowStart <= numCharsInLine);
+				const int end = toCheckpoint ? lcp.Start(checkpoint + 1) - ll->windowStart : numCharsInLine;
+				const int xStep = lcp.X(checkpoint) - ll->xWindowStart;
+				lastSegItalics = MeasureLayout(surface, vstyle, ll, start, end, lcp.X(checkpoint));
+				for (int posToIncrease = start; posToIncrease < end; posToIncrease++) {
+					ll->positions[posToIncrease] += xStep;
 				}
-				for (int posToIncrease = startseg; posToIncrease <= (charInLine + 1); posToIncrease++) {
-					ll->positions[posToIncrease] += startsegx;
+				if (toCheckpoint) {
+					ll->positions[end] = static_cast<float>(lcp.X(checkpoint + 1) - ll->xWindowStart);
+				} else {
+					ll->positions[end] += xStep;
 				}
-				startsegx = ll->positions[charInLine + 1];
-				startseg = charInLine + 1;
+				start = end;
+				checkpoint++;
+			}
+			if (ll->windowEnd < pdoc->LineStart(line + 1) - pdoc->LineStart(line)) {
+				lastSegItalics = false;	// Not the end of the line
 			}
+		} else {
+			lastSegItalics = MeasureLayout(surface, vstyle, ll, 0, numCharsInLine, 0);
 		}
 		// Small hack to make lines that end with italics not cut off the edge of the last character
-		if ((startseg > 0) && lastSegItalics) {
-			ll->positions[startseg] += 2;
+		if ((numCharsInLine > 0) && lastSegItalics) {
+			ll->positions[numCharsInLine] += 2;
 		}
 		ll->numCharsInLine = numCharsInLine;
 		ll->numCharsBeforeEOL = numCharsBeforeEOL;
@@ -2360,11 +2518,13 @@ void Editor::DrawEOL(Surface *surface, ViewStyle &vsDraw, PRectangle rcLine, Lin
         bool overrideBackground, Colour background,
         bool drawWrapMarkEnd, Colour wrapColour) {
 
-	const int posLineStart = pdoc->LineStart(line);
+	const int posLineStart = pdoc->LineStart(line) + ll->windowStart;
 	const int styleMask = pdoc->stylingBitsMask;
 	PRectangle rcSegment = rcLine;
 
-	const bool lastSubLine = subLine == (ll->lines - 1);
+	// A window of a long line may end before the end of the line
+	const bool lastSubLine = (subLine == (ll->lines - 1)) &&
+		(posLineStart + ll->numCharsBeforeEOL == pdoc->LineEnd(line));
 	float virtualSpace = 0;
 	if (lastSubLine) {
 		const float spaceWidth = vsDraw.styles[ll->EndLineStyle()].spaceWidth;
@@ -2400,7 +2560,7 @@ void Editor::DrawEOL(Surface *surface, ViewStyle &vsDraw, PRectangle rcLine, Lin
 	int alpha = SC_ALPHA_NOALPHA;
 	if (!hideSelection) {
 		int posAfterLineEnd = pdoc->LineStart(line + 1);
-		eolInSelection = (subLine == (ll->lines - 1)) ? sel.InSelectionForEOL(posAfterLineEnd) : 0;
+		eolInSelection = lastSubLine ? sel.InSelectionForEOL(posAfterLineEnd) : 0;
 		alpha = (eolInSelection == 1) ? vsDraw.selAlpha : vsDraw.selAdditionalAlpha;
 	}
 
@@ -2505,7 +2665,7 @@ void Editor::DrawIndicator(int indicNum, int startPos, int endPos, Surface *surf
 void Editor::DrawIndicators(Surface *surface, ViewStyle &vsDraw, int line, int xStart,
         PRectangle rcLine, LineLayout *ll, int subLine, int lineEnd, bool under) {
 	// Draw decorators
-	const int posLineStart = pdoc->LineStart(line);
+	const int posLineStart = pdoc->LineStart(line) + ll->windowStart;
 	const int lineStart = ll->LineStart(subLine);
 	const int posLineEnd = posLineStart + lineEnd;
 
@@ -2684,11 +2844,11 @@ void Editor::DrawLine(Surface *surface, ViewStyle &vsDraw, int line, int lineVis
 	bool drawWhitespaceBackground = (vsDraw.viewWhitespace != wsInvisible) &&
 	        (!overrideBackground) && (vsDraw.whitespaceBackgroundSet);
 
-	bool inIndentation = subLine == 0;	// Do not handle indentation except on first subline.
+	bool inIndentation = (subLine == 0) && (ll->windowStart == 0);	// Do not handle indentation except on first subline.
 	const float indentWidth = pdoc->IndentSize() * vsDraw.spaceWidth;
 	const float epsilon = 0.0001f;	// A small nudge to avoid floating point precision issues
 
-	int posLineStart = pdoc->LineStart(line);
+	int posLineStart = pdoc->LineStart(line) + ll->windowStart;
 
 	int startseg = ll->LineStart(subLine);
 	double subLineStart = ll->positions[startseg];
@@ -2835,7 +2995,7 @@ void Editor::DrawLine(Surface *surface, ViewStyle &vsDraw, int line, int lineVis
 
 	if (vsDraw.edgeState == EDGE_LINE) {
 		int edgeX = theEdge * vsDraw.spaceWidth;
-		rcSegment.left = edgeX + xStart;
+		rcSegment.left = edgeX + xStart - ll->xWindowStart;
 		if ((ll->wrapIndent != 0) && (lineStart != 0))
 			rcSegment.left -= ll->wrapIndent;
 		rcSegment.right = rcSegment.left + 1;
@@ -2855,7 +3015,7 @@ void Editor::DrawLine(Surface *surface, ViewStyle &vsDraw, int line, int lineVis
 		marks >>= 1;
 	}
 
-	inIndentation = subLine == 0;	// Do not handle indentation except on first subline.
+	inIndentation = (subLine == 0) && (ll->windowStart == 0);	// Do not handle indentation except on first subline.
 	// Foreground drawing loop
 	BreakFinder bfFore(ll, lineStart, lineEnd, posLineStart, xStartVisible,
 		((!twoPhaseDraw && selBackDrawn) || vsDraw.selforeset), pdoc);
@@ -3011,7 +3171,7 @@ void Editor::DrawLine(Surface *surface, ViewStyle &vsDraw, int line, int lineVis
 		}
 	}
 	if ((vsDraw.viewIndentationGuides == ivLookForward || vsDraw.viewIndentationGuides == ivLookBoth)
-	        && (subLine == 0)) {
+	        && (subLine == 0) && (ll->windowStart == 0)) {
 		int indentSpace = pdoc->GetLineIndentation(line);
 		int xStartText = ll->positions[pdoc->GetLineIndentPosition(line) - posLineStart];
 
@@ -3071,7 +3231,7 @@ void Editor::DrawLine(Surface *surface, ViewStyle &vsDraw, int line, int lineVis
 	if (!hideSelection && ((vsDraw.selAlpha != SC_ALPHA_NOALPHA) || (vsDraw.selAdditionalAlpha != SC_ALPHA_NOALPHA))) {
 		// For each selection draw
 		int virtualSpaces = 0;
-		if (subLine == (ll->lines - 1)) {
+		if ((subLine == (ll->lines - 1)) && (posLineStart + lineEnd == pdoc->LineEnd(line))) {
 			virtualSpaces = sel.VirtualSpaceFor(pdoc->LineEnd(line));
 		}
 		SelectionPosition posStart(posLineStart + lineStart);
@@ -3236,7 +3396,7 @@ void Editor::DrawCarets(Surface *surface, ViewStyle &vsDraw, int lineDoc, int xS
 	bool drawDrag = posDrag.IsValid();
 	if (hideSelection && !drawDrag)
 		return;
-	const int posLineStart = pdoc->LineStart(lineDoc);
+	const int posLineStart = pdoc->LineStart(lineDoc) + ll->windowStart;
 	// For each selection draw
 	for (size_t r=0; (r<sel.Count()) || drawDrag; r++) {
 		const bool mainCaret = r == sel.Main();
@@ -3425,7 +3585,7 @@ void Editor::Paint(/*Surface *surfaceWindow, PRectangle rcArea*/) {
 			if (lineDoc != lineDocPrevious) {
 				ll.Set(0);
 				ll.Set(RetrieveLineLayout(lineDoc));
-				LayoutLine(lineDoc, surface, vs, ll, wrapWidth);
+				LayoutLine(lineDoc, surface, vs, ll, wrapWidth, 0, xOffset);
 				lineDocPrevious = lineDoc;
 			}
 			//durLayout += et.Duration(true);
@@ -3447,13 +3607,15 @@ void Editor::Paint(/*Surface *surfaceWindow, PRectangle rcArea*/) {
 					(vs.braceBadLightIndicatorSet && (bracesMatchStyle == STYLE_BRACEBAD))) {
 					bracesIgnoreStyle = true;
 				}
-				Range rangeLine(pdoc->LineStart(lineDoc), pdoc->LineStart(lineDoc + 1));
+				Range rangeLine(pdoc->LineStart(lineDoc) + ll->windowStart, pdoc->LineStart(lineDoc + 1));
+				// Text of a long line is drawn from the start of its window
+				const int xStartLine = (subLine < ll->lines) ? xStart + ll->xWindowStart : xStart;
 				// Highlight the current braces if any
 				ll->SetBracesHighlight(rangeLine, braces, static_cast<char>(bracesMatchStyle),
 				        highlightGuideColumn * vs.spaceWidth, bracesIgnoreStyle);
 
 				// Draw the line
-				DrawLine(surface, vs, lineDoc, visibleLine, xStart, rcLine, ll, subLine);
+				DrawLine(surface, vs, lineDoc, visibleLine, xStartLine, rcLine, ll, subLine);
 				//durPaint += et.Duration(true);
 
 				// Restore the previous styles for the brace highlights in case layout is in cache.
@@ -3482,10 +3644,10 @@ void Editor::Paint(/*Surface *surfaceWindow, PRectangle rcArea*/) {
 					}
 				}
 
-				DrawCarets(surface, vs, lineDoc, xStart, rcLine, ll, subLine);
+				DrawCarets(surface, vs, lineDoc, xStartLine, rcLine, ll, subLine);
 
 				lineWidthMaxSeen = Platform::Maximum(
-					    lineWidthMaxSeen, ll->positions[ll->numCharsInLine]);
+					    lineWidthMaxSeen, ll->xWindowStart + ll->positions[ll->numCharsInLine]);
 				//durCopy += et.Duration(true);
 			}
 
@@ -4435,6 +4597,12 @@ void Editor::NotifyModified(Document *, DocModification mh, void *) {
 		}
 		if (mh.modificationType & SC_MOD_CHANGESTYLE) {
 			llc.Invalidate(LineLayout::llCheckTextAndStyle);
+			const int lineOfPos = pdoc->LineFromPosition(mh.position);
+			const int lineLast = pdoc->LineFromPosition(mh.position + mh.length);
+			lcc.Invalidate(lineOfPos, mh.position - pdoc->LineStart(lineOfPos));
+			for (int line = lineOfPos + 1; line <= lineLast; line++) {
+				lcc.Invalidate(line, 0);
+			}
 		}
 	} else {
 		// Move selection and brace highlights
@@ -4465,6 +4633,15 @@ void Editor::NotifyModified(Document *, DocModification mh, void *) {
 				NotifyNeedShown(mh.position, mh.length);
 			}
 		}
+		if (mh.modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT)) {
+			// Long line checkpoints after the change are no longer valid
+			const int lineOfPos = pdoc->LineFromPosition(mh.position);
+			if (mh.linesAdded != 0) {
+				lcc.InvalidateFrom(lineOfPos);
+			} else {
+				lcc.Invalidate(lineOfPos, mh.position - pdoc->LineStart(lineOfPos));
+			}
+		}
 		if (mh.linesAdded != 0) {
 			// Update contraction state for inserted and removed lines
 			// lineOfPos should be calculated in context of state before modification, shouldn't it
@@ -4946,9 +5123,12 @@ int Editor::StartEndDisplayLine(int pos, bool start) {
 	int posRet = INVALID_POSITION;
 	if (drawSurface && ll) {
 		unsigned int posLineStart = pdoc->LineStart(line);
-		LayoutLine(line, drawSurface, vs, ll, wrapWidth);
+		LayoutLine(line, drawSurface, vs, ll, wrapWidth, pos - posLineStart);
 		int posInLine = pos - posLineStart;
-		if (posInLine <= ll->maxLineLength) {
+		if (ll->windowed) {
+			// Long lines are only laid out in windows when not wrapped
+			posRet = start ? posLineStart : pdoc->LineEnd(line);
+		} else if (posInLine <= ll->maxLineLength) {
 			for (int subLine = 0; subLine < ll->lines; subLine++) {
 				if ((posInLine >= ll->LineStart(subLine)) && (posInLine <= ll->LineStart(subLine + 1))) {
 					if (start) {
@@ -6562,6 +6742,7 @@ void Editor::SetDocPointer(Document *document) {
 	cs.InsertLines(0, pdoc->LinesTotal() - 1);
 	SetAnnotationHeights(0, pdoc->LinesTotal());
 	llc.Deallocate();
+	lcc.Clear();
 	NeedWrapping();
 
 	pdoc->AddWatcher(this, 0);
@@ -8968,6 +9149,20 @@ sptr_t Editor::Command(unsigned int iMessage, uptr_t wParam, sptr_t lParam) {
 	case SCI_COUNTCHARACTERS:
 		return pdoc->CountCharacters(wParam, lParam);
 
+	case SCI_COUNTCODEUNITS:
+		return pdoc->CountUTF16(wParam, lParam);
+
+	case SCI_GETLINECHARACTERINDEX:
+		return pdoc->LineCharacterIndex();
+
+	case SCI_ALLOCATELINECHARACTERINDEX:
+		pdoc->AllocateLineCharacterIndex(wParam);
+		break;
+
+	case SCI_RELEASELINECHARACTERINDEX:
+		pdoc->ReleaseLineCharacterIndex(wParam);
+		break;
+
 	}
 	//Platform::DebugPrintf("end wnd proc\n");
 	return 0l;
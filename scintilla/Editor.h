@@ -168,6 +168,7 @@ protected:	// ScintillaBase subclass needs access to much of Editor
 	Pixmap	pixmapIndentGuideHighlight;
 
 	LineLayoutCache llc;
+	LineCheckpointsCache lcc;
 	PositionCache posCache;
 
 	KeyMap kmap;
@@ -346,8 +347,14 @@ protected:	// ScintillaBase subclass needs access to much of Editor
 	int SubstituteMarkerIfEmpty(int markerCheck, int markerDefault);
 	void PaintSelMargin(Surface *surface, PRectangle &rc);
 	LineLayout *RetrieveLineLayout(int lineNumber);
+	bool MeasureLayout(Surface *surface, ViewStyle &vstyle, LineLayout *ll, int start, int end, int xLine);
+	void FillLayout(ViewStyle &vstyle, LineLayout *ll, int posStart, int length, int numCharsInLine);
+	void ExtendCheckpoints(int line, Surface *surface, ViewStyle &vstyle, LineLayout *ll,
+		LineCheckpoints &lcp, int posInLine, int x);
+	void ChooseLayoutWindow(int line, Surface *surface, ViewStyle &vstyle, LineLayout *ll,
+		int posInLineTarget, int xTarget);
 	void LayoutLine(int line, Surface *surface, ViewStyle &vstyle, LineLayout *ll,
-		int width=LineLayout::wrapWidthInfinite);
+		int width=LineLayout::wrapWidthInfinite, int posInLineTarget=0, int xTarget=-1);
 	Colour SelectionBackground(ViewStyle &vsDraw, bool main);
 	Colour TextBackground(ViewStyle &vsDraw, bool overrideBackground, Colour background, int inSelection, bool inHotspot, int styleMain, int i, LineLayout *ll);
 	void DrawIndentGuide(Surface *surface, int lineVisible, float lineHeight, int start, PRectangle rcSegment, bool highlight);
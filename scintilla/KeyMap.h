@@ -30,12 +30,14 @@ public:
 };
 
 /**
+ * Key bindings are hashed on key and modifiers together so that Find is a
+ * single lookup for every key press.
  */
 class KeyMap {
-	KeyToCommand *kmap;
-	int len;
-	int alloc;
+	typedef std::unordered_map<unsigned long long, unsigned int> MapKeyToCommand;
+	MapKeyToCommand kmap;
 	static const KeyToCommand MapDefault[];
+	static unsigned long long KeyModifiers(int key, int modifiers);
 
 public:
 	KeyMap();
@@ -7,6 +7,8 @@
 
 #include <string.h>
 
+#include <vector>
+
 #include "Platform.h"
 
 #include "Scintilla.h"
@@ -504,3 +506,69 @@ int LineAnnotation::Lines(int line) const {
 	else
 		return 0;
 }
+
+const CharacterCheckpoint &LineCharacters::Before(int CharacterCheckpoint::*field, int value) const {
+	// checkpoints[0] is always the start of the line and every field increases along the line
+	int lower = 0;
+	int upper = static_cast<int>(checkpoints.size()) - 1;
+	while (lower < upper) {
+		const int middle = (lower + upper + 1) / 2;
+		if (checkpoints[middle].*field <= value)
+			lower = middle;
+		else
+			upper = middle - 1;
+	}
+	return checkpoints[lower];
+}
+
+LineCharacterCheckpoints::~LineCharacterCheckpoints() {
+	ClearAll();
+}
+
+void LineCharacterCheckpoints::Init() {
+	ClearAll();
+}
+
+void LineCharacterCheckpoints::InsertLine(int line) {
+	if (lines.Length()) {
+		lines.EnsureLength(line);
+		lines.Insert(line, 0);
+	}
+}
+
+void LineCharacterCheckpoints::RemoveLine(int line) {
+	if (lines.Length() && (line < lines.Length())) {
+		delete lines[line];
+		lines.Delete(line);
+	}
+}
+
+const LineCharacters *LineCharacterCheckpoints::Characters(int line) const {
+	if (lines.Length() && (line >= 0) && (line < lines.Length()))
+		return lines[line];
+	else
+		return 0;
+}
+
+void LineCharacterCheckpoints::SetCharacters(int line, LineCharacters *characters) {
+	if (line >= 0) {
+		lines.EnsureLength(line + 1);
+		delete lines[line];
+		lines[line] = characters;
+	}
+}
+
+void LineCharacterCheckpoints::Invalidate(int line) {
+	if (lines.Length() && (line >= 0) && (line < lines.Length())) {
+		delete lines[line];
+		lines[line] = 0;
+	}
+}
+
+void LineCharacterCheckpoints::ClearAll() {
+	for (int line = 0; line < lines.Length(); line++) {
+		delete lines[line];
+		lines[line] = 0;
+	}
+	lines.DeleteAll();
+}
@@ -114,6 +114,50 @@ public:
 	int Lines(int line) const;
 };
 
+/**
+ * Counts of characters, UTF-16 code units and columns from the start of a line
+ * up to a position in the line.
+ */
+struct CharacterCheckpoint {
+	int position;	///< Offset from the start of the line, always at a character boundary
+	int characters;
+	int codeUnits;	///< UTF-16 code units
+	int column;	///< Column with tabs expanded
+};
+
+/**
+ * Checkpoints every checkpointStep bytes through one long line so that converting
+ * between positions and characters or columns only has to scan from the nearest
+ * checkpoint.
+ */
+class LineCharacters {
+public:
+	enum { checkpointStep = 256 };
+	int tabInChars;
+	std::vector<CharacterCheckpoint> checkpoints;
+
+	explicit LineCharacters(int tabInChars_) : tabInChars(tabInChars_) {
+	}
+	/// The last checkpoint whose field is not greater than value
+	const CharacterCheckpoint &Before(int CharacterCheckpoint::*field, int value) const;
+};
+
+class LineCharacterCheckpoints : public PerLine {
+	SplitVector<LineCharacters *> lines;
+public:
+	LineCharacterCheckpoints() {
+	}
+	virtual ~LineCharacterCheckpoints();
+	virtual void Init();
+	virtual void InsertLine(int line);
+	virtual void RemoveLine(int line);
+
+	const LineCharacters *Characters(int line) const;
+	void SetCharacters(int line, LineCharacters *characters);
+	void Invalidate(int line);
+	void ClearAll();
+};
+
 #ifdef SCI_NAMESPACE
 }
 #endif
@@ -13,6 +13,8 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <algorithm>
 
 #include "Platform.h"
 
@@ -68,7 +70,12 @@ LineLayout::LineLayout(int maxLineLength_) :
 	hsEnd(0),
 	widthLine(wrapWidthInfinite),
 	lines(1),
-	wrapIndent(0) {
+	wrapIndent(0),
+	windowed(false),
+	windowStart(0),
+	windowEnd(0),
+	xWindowStart(0),
+	xWindowEnd(0) {
 	bracePreviousStyles[0] = 0;
 	bracePreviousStyles[1] = 0;
 	Resize(maxLineLength_);
@@ -206,6 +213,87 @@ int LineLayout::EndLineStyle() const {
 	return styles[numCharsBeforeEOL > 0 ? numCharsBeforeEOL-1 : 0];
 }
 
+void LineLayout::SetWindow(int windowStart_, int windowEnd_, int xWindowStart_, int xWindowEnd_) {
+	if ((windowStart != windowStart_) || (windowEnd != windowEnd_) || (xWindowStart != xWindowStart_)) {
+		validity = llInvalid;
+	}
+	windowStart = windowStart_;
+	windowEnd = windowEnd_;
+	xWindowStart = xWindowStart_;
+	xWindowEnd = xWindowEnd_;
+}
+
+LineCheckpoints::LineCheckpoints() : complete(false) {
+	Clear();
+}
+
+void LineCheckpoints::Clear() {
+	starts.clear();
+	xs.clear();
+	complete = false;
+	Add(0, 0);
+}
+
+void LineCheckpoints::Add(int start, int x) {
+	starts.push_back(start);
+	xs.push_back(x);
+}
+
+int LineCheckpoints::Count() const {
+	return static_cast<int>(starts.size());
+}
+
+int LineCheckpoints::Start(int checkpoint) const {
+	return starts[checkpoint];
+}
+
+int LineCheckpoints::X(int checkpoint) const {
+	return xs[checkpoint];
+}
+
+int LineCheckpoints::FindPosition(int posInLine) const {
+	std::vector<int>::const_iterator it = std::upper_bound(starts.begin(), starts.end(), posInLine);
+	return Platform::Maximum(static_cast<int>(it - starts.begin()) - 1, 0);
+}
+
+int LineCheckpoints::FindX(int x) const {
+	std::vector<int>::const_iterator it = std::upper_bound(xs.begin(), xs.end(), x);
+	return Platform::Maximum(static_cast<int>(it - xs.begin()) - 1, 0);
+}
+
+bool LineCheckpoints::Contains(int posInLine) const {
+	return std::binary_search(starts.begin(), starts.end(), posInLine);
+}
+
+void LineCheckpoints::Truncate(int posInLine) {
+	// A checkpoint at posInLine may no longer be a character boundary
+	const int keep = Platform::Maximum(static_cast<int>(
+		std::lower_bound(starts.begin(), starts.end(), posInLine) - starts.begin()), 1);
+	if (keep < Count()) {
+		starts.resize(keep);
+		xs.resize(keep);
+		complete = false;
+	}
+}
+
+LineCheckpoints &LineCheckpointsCache::Retrieve(int line) {
+	return lines[line];
+}
+
+void LineCheckpointsCache::Invalidate(int line, int posInLine) {
+	std::map<int, LineCheckpoints>::iterator it = lines.find(line);
+	if (it != lines.end())
+		it->second.Truncate(posInLine);
+}
+
+void LineCheckpointsCache::InvalidateFrom(int line) {
+	lines.erase(lines.lower_bound(line), lines.end());
+}
+
+void LineCheckpointsCache::Clear() {
+	lines.clear();
+}
+
 LineLayoutCache::LineLayoutCache() :
 	level(0), length(0), size(0), cache(0),
 	allInvalidated(false), styleClock(-1), useCount(0) {
@@ -28,6 +28,8 @@ private:
 	bool inCache;
 public:
 	enum { wrapWidthInfinite = 0x7ffffff };
+	/// Unwrapped lines longer than this are laid out a window at a time
+	enum { lengthWindowMax = 0x10000 };
 	int maxLineLength;
 	int numCharsInLine;
 	int numCharsBeforeEOL;
@@ -53,6 +55,14 @@ public:
 	int lines;
 	float wrapIndent; // In pixels
 
+	// Long line support: a line longer than maxLineLength may be laid out as a window
+	// so that chars[0] is windowStart bytes and xWindowStart pixels from the line start
+	bool windowed;
+	int windowStart;
+	int windowEnd;
+	int xWindowStart;
+	int xWindowEnd;
+
 	LineLayout(int maxLineLength_);
 	virtual ~LineLayout();
 	void Resize(int maxLineLength_);
@@ -67,6 +77,45 @@ public:
 	void RestoreBracesHighlight(Range rangeLine, Position braces[], bool ignoreStyle);
 	int FindBefore(float x, int lower, int upper) const;
 	int EndLineStyle() const;
+	void SetWindow(int windowStart_, int windowEnd_, int xWindowStart_, int xWindowEnd_);
+};
+
+/**
+ * Character boundaries about checkpointStep bytes apart along a line too long to lay out
+ * at once, with their x positions from the start of the line. Measurement restarts at each
+ * checkpoint, so a window laid out from any checkpoint agrees with the rest of the line.
+ */
+class LineCheckpoints {
+	std::vector<int> starts;
+	std::vector<int> xs;
+public:
+	enum { checkpointStep = 1024 };
+	bool complete;	///< The last checkpoint is the end of the line
+
+	LineCheckpoints();
+	void Clear();
+	void Add(int start, int x);
+	int Count() const;
+	int Start(int checkpoint) const;
+	int X(int checkpoint) const;
+	/// Last checkpoint at or before posInLine
+	int FindPosition(int posInLine) const;
+	/// Last checkpoint at or before x
+	int FindX(int x) const;
+	/// Whether posInLine is a checkpoint
+	bool Contains(int posInLine) const;
+	/// Discard checkpoints that may be changed by modifying text or styles at posInLine
+	void Truncate(int posInLine);
+};
+
+class LineCheckpointsCache {
+	std::map<int, LineCheckpoints> lines;
+public:
+	LineCheckpoints &Retrieve(int line);
+	void Invalidate(int line, int posInLine);
+	/// Line numbers from line on no longer refer to the same text
+	void InvalidateFrom(int line);
+	void Clear();
 };
 
 /**
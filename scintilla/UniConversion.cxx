@@ -6,61 +6,256 @@
 // The License.txt file describes the conditions under which this software may be distributed.
 
 #include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define UNICONVERSION_SSE2 1
+#include <emmintrin.h>
+#endif
 
 #include "UniConversion.h"
 
 enum { SURROGATE_LEAD_FIRST = 0xD800 };
+enum { SURROGATE_LEAD_LAST = 0xDBFF };
 enum { SURROGATE_TRAIL_FIRST = 0xDC00 };
 enum { SURROGATE_TRAIL_LAST = 0xDFFF };
+enum { SUPPLEMENTAL_PLANE_FIRST = 0x10000 };
+enum { MAX_UNICODE = 0x10FFFF };
+
+// Width of the blocks checked at once by the ASCII fast paths
+enum { asciiBlock = 16 };
+
+// Are the asciiBlock bytes at us all ASCII?
+static inline bool IsASCIIBlock(const unsigned char *us) {
+#ifdef UNICONVERSION_SSE2
+	const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(us));
+	// The top bit of each byte is set only for non-ASCII bytes
+	return _mm_movemask_epi8(block) == 0;
+#else
+	unsigned long long words[2];
+	memcpy(words, us, sizeof(words));
+	return ((words[0] | words[1]) & 0x8080808080808080ULL) == 0;
+#endif
+}
+
+// Are the asciiBlock code units at uptr all ASCII and not NUL?
+static inline bool IsASCIIBlock(const wchar_t *uptr) {
+#ifdef UNICONVERSION_SSE2
+	// wchar_t is 2 bytes on Windows and 4 bytes elsewhere
+	const int units = 16 / sizeof(wchar_t);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i nonASCII = (sizeof(wchar_t) == 2) ?
+		_mm_set1_epi16(static_cast<short>(0xFF80)) : _mm_set1_epi32(static_cast<int>(0xFFFFFF80));
+	__m128i high = zero;
+	__m128i nul = zero;
+	for (unsigned int j = 0; j < asciiBlock; j += units) {
+		const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(uptr + j));
+		high = _mm_or_si128(high, _mm_and_si128(block, nonASCII));
+		nul = _mm_or_si128(nul, (sizeof(wchar_t) == 2) ?
+			_mm_cmpeq_epi16(block, zero) : _mm_cmpeq_epi32(block, zero));
+	}
+	return (_mm_movemask_epi8(_mm_cmpeq_epi8(high, zero)) == 0xFFFF) && (_mm_movemask_epi8(nul) == 0);
+#else
+	unsigned int unitMin = uptr[0];
+	unsigned int unitMax = uptr[0];
+	for (unsigned int j = 1; j < asciiBlock; j++) {
+		const unsigned int uch = uptr[j];
+		unitMin = (uch < unitMin) ? uch : unitMin;
+		unitMax = (uch > unitMax) ? uch : unitMax;
+	}
+	return (unitMin != 0) && (unitMax < 0x80);
+#endif
+}
+
+// Copy a block of ASCII bytes to wider code units.
+static inline void WidenASCIIBlock(const unsigned char *us, wchar_t *tbuf) {
+#ifdef UNICONVERSION_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(us));
+	const __m128i low = _mm_unpacklo_epi8(block, zero);
+	const __m128i high = _mm_unpackhi_epi8(block, zero);
+	if (sizeof(wchar_t) == 2) {
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(tbuf), low);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(tbuf + 8), high);
+	} else {
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(tbuf), _mm_unpacklo_epi16(low, zero));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(tbuf + 4), _mm_unpackhi_epi16(low, zero));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(tbuf + 8), _mm_unpacklo_epi16(high, zero));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(tbuf + 12), _mm_unpackhi_epi16(high, zero));
+	}
+#else
+	for (unsigned int j = 0; j < asciiBlock; j++)
+		tbuf[j] = static_cast<wchar_t>(us[j]);
+#endif
+}
+
+// Copy a block of ASCII code units, as checked by IsASCIIBlock, to bytes.
+static inline void NarrowASCIIBlock(const wchar_t *uptr, char *putf) {
+#ifdef UNICONVERSION_SSE2
+	const __m128i *blocks = reinterpret_cast<const __m128i *>(uptr);
+	__m128i narrowed;
+	if (sizeof(wchar_t) == 2) {
+		narrowed = _mm_packus_epi16(_mm_loadu_si128(blocks), _mm_loadu_si128(blocks + 1));
+	} else {
+		// Values are below 0x80 so signed saturation to 16 bits is exact
+		const __m128i low = _mm_packs_epi32(_mm_loadu_si128(blocks), _mm_loadu_si128(blocks + 1));
+		const __m128i high = _mm_packs_epi32(_mm_loadu_si128(blocks + 2), _mm_loadu_si128(blocks + 3));
+		narrowed = _mm_packus_epi16(low, high);
+	}
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(putf), narrowed);
+#else
+	for (unsigned int j = 0; j < asciiBlock; j++)
+		putf[j] = static_cast<char>(uptr[j]);
+#endif
+}
+
+/**
+ * Decode one character from a UTF-8 string, validating it fully.
+ * Invalid, overlong, truncated or surrogate sequences and values beyond U+10FFFF
+ * decode as the replacement character U+FFFD and consume a single byte so that
+ * decoding resynchronises at the next byte.
+ */
+static inline unsigned int DecodeUTF8(const unsigned char *us, unsigned int len, unsigned int &i) {
+	const unsigned char lead = us[i];
+	if (lead < 0x80) {
+		i++;
+		return lead;
+	}
+	const unsigned int remaining = len - i;
+	if (lead < 0xC2) {
+		// Trail byte or overlong 2 byte lead
+	} else if (lead < 0xE0) {
+		if ((remaining >= 2) && ((us[i+1] & 0xC0) == 0x80)) {
+			const unsigned int value = ((lead & 0x1F) << 6) | (us[i+1] & 0x3F);
+			i += 2;
+			return value;
+		}
+	} else if (lead < 0xF0) {
+		if ((remaining >= 3) && ((us[i+1] & 0xC0) == 0x80) && ((us[i+2] & 0xC0) == 0x80)) {
+			const unsigned int value = ((lead & 0x0F) << 12) | ((us[i+1] & 0x3F) << 6) | (us[i+2] & 0x3F);
+			if ((value >= 0x800) && ((value < SURROGATE_LEAD_FIRST) || (value > SURROGATE_TRAIL_LAST))) {
+				i += 3;
+				return value;
+			}
+		}
+	} else if (lead < 0xF5) {
+		if ((remaining >= 4) && ((us[i+1] & 0xC0) == 0x80) && ((us[i+2] & 0xC0) == 0x80) &&
+			((us[i+3] & 0xC0) == 0x80)) {
+			const unsigned int value = ((lead & 0x07) << 18) | ((us[i+1] & 0x3F) << 12) |
+				((us[i+2] & 0x3F) << 6) | (us[i+3] & 0x3F);
+			if ((value >= SUPPLEMENTAL_PLANE_FIRST) && (value <= MAX_UNICODE)) {
+				i += 4;
+				return value;
+			}
+		}
+	}
+	i++;
+	return UNICODE_REPLACEMENT_CHAR;
+}
+
+/**
+ * Decode one character from a UTF-16 string.
+ * Unpaired surrogates decode as the replacement character U+FFFD.
+ */
+static inline unsigned int DecodeUTF16(const wchar_t *uptr, unsigned int tlen, unsigned int &i) {
+	const unsigned int uch = uptr[i];
+	i++;
+	if ((uch >= SURROGATE_LEAD_FIRST) && (uch <= SURROGATE_LEAD_LAST)) {
+		if (i < tlen) {
+			const unsigned int uchTrail = uptr[i];
+			if ((uchTrail >= SURROGATE_TRAIL_FIRST) && (uchTrail <= SURROGATE_TRAIL_LAST)) {
+				i++;
+				return SUPPLEMENTAL_PLANE_FIRST + ((uch & 0x3ff) << 10) + (uchTrail & 0x3ff);
+			}
+		}
+		return UNICODE_REPLACEMENT_CHAR;
+	} else if ((uch >= SURROGATE_TRAIL_FIRST) && (uch <= SURROGATE_TRAIL_LAST)) {
+		return UNICODE_REPLACEMENT_CHAR;
+	}
+	return uch;
+}
+
+static inline unsigned int UTF8Width(unsigned int value) {
+	if (value < 0x80)
+		return 1;
+	else if (value < 0x800)
+		return 2;
+	else if (value < SUPPLEMENTAL_PLANE_FIRST)
+		return 3;
+	else
+		return 4;
+}
 
 unsigned int UTF8Length(const wchar_t *uptr, unsigned int tlen) {
 	unsigned int len = 0;
-	for (unsigned int i = 0; i < tlen && uptr[i];) {
-		unsigned int uch = uptr[i];
-		if (uch < 0x80) {
-			len++;
-		} else if (uch < 0x800) {
-			len += 2;
-		} else if ((uch >= SURROGATE_LEAD_FIRST) &&
-			(uch <= SURROGATE_TRAIL_LAST)) {
-			len += 4;
-			i++;
-		} else {
-			len += 3;
+	unsigned int i = 0;
+	while (i < tlen) {
+		if ((i + asciiBlock <= tlen) && IsASCIIBlock(uptr + i)) {
+			len += asciiBlock;
+			i += asciiBlock;
+			continue;
+		}
+		const unsigned int blockEnd = (i + asciiBlock < tlen) ? (i + asciiBlock) : tlen;
+		while (i < blockEnd) {
+			if (!uptr[i])
+				return len;
+			len += UTF8Width(DecodeUTF16(uptr, tlen, i));
 		}
-		i++;
 	}
 	return len;
 }
 
 void UTF8FromUTF16(const wchar_t *uptr, unsigned int tlen, char *putf, unsigned int len) {
 	unsigned int k = 0;
-	for (unsigned int i = 0; i < tlen && uptr[i];) {
-		unsigned int uch = uptr[i];
-		if (uch < 0x80) {
-			if (k>=len) break;
-			putf[k++] = static_cast<char>(uch);
-		} else if (uch < 0x800) {
-			if (k+2>=len) break;
-			putf[k++] = static_cast<char>(0xC0 | (uch >> 6));
-			putf[k++] = static_cast<char>(0x80 | (uch & 0x3f));
-		} else if ((uch >= SURROGATE_LEAD_FIRST) &&
-			(uch <= SURROGATE_TRAIL_LAST)) {
-			// Half a surrogate pair
-			i++;
-			if (k+4>=len) break;
-			unsigned int xch = 0x10000 + ((uch & 0x3ff) << 10) + (uptr[i] & 0x3ff);
-			putf[k++] = static_cast<char>(0xF0 | (xch >> 18));
-			putf[k++] = static_cast<char>(0x80 | ((xch >> 12) & 0x3f));
-			putf[k++] = static_cast<char>(0x80 | ((xch >> 6) & 0x3f));
-			putf[k++] = static_cast<char>(0x80 | (xch & 0x3f));
-		} else {
-			if (k+3>=len) break;
-			putf[k++] = static_cast<char>(0xE0 | (uch >> 12));
-			putf[k++] = static_cast<char>(0x80 | ((uch >> 6) & 0x3f));
-			putf[k++] = static_cast<char>(0x80 | (uch & 0x3f));
+	unsigned int i = 0;
+	while (i < tlen) {
+		if ((i + asciiBlock <= tlen) && (k + asciiBlock <= len) && IsASCIIBlock(uptr + i)) {
+			NarrowASCIIBlock(uptr + i, putf + k);
+			k += asciiBlock;
+			i += asciiBlock;
+			continue;
+		}
+		const unsigned int blockEnd = (i + asciiBlock < tlen) ? (i + asciiBlock) : tlen;
+		while (i < blockEnd) {
+			if (!uptr[i]) {
+				putf[k] = '\0';
+				return;
+			}
+			// A character that does not fit ends the output, nothing after it is written
+			const unsigned int value = DecodeUTF16(uptr, tlen, i);
+			const unsigned int width = UTF8Width(value);
+			if (width == 1) {
+				if (k>=len) {
+					putf[k] = '\0';
+					return;
+				}
+				putf[k++] = static_cast<char>(value);
+			} else if (width == 2) {
+				if (k+2>=len) {
+					putf[k] = '\0';
+					return;
+				}
+				putf[k++] = static_cast<char>(0xC0 | (value >> 6));
+				putf[k++] = static_cast<char>(0x80 | (value & 0x3f));
+			} else if (width == 3) {
+				if (k+3>=len) {
+					putf[k] = '\0';
+					return;
+				}
+				putf[k++] = static_cast<char>(0xE0 | (value >> 12));
+				putf[k++] = static_cast<char>(0x80 | ((value >> 6) & 0x3f));
+				putf[k++] = static_cast<char>(0x80 | (value & 0x3f));
+			} else {
+				if (k+4>=len) {
+					putf[k] = '\0';
+					return;
+				}
+				putf[k++] = static_cast<char>(0xF0 | (value >> 18));
+				putf[k++] = static_cast<char>(0x80 | ((value >> 12) & 0x3f));
+				putf[k++] = static_cast<char>(0x80 | ((value >> 6) & 0x3f));
+				putf[k++] = static_cast<char>(0x80 | (value & 0x3f));
+			}
 		}
-		i++;
 	}
 	putf[k] = '\0';
 }
@@ -78,58 +273,48 @@ unsigned int UTF8CharLength(unsigned char ch) {
 }
 
 unsigned int UTF16Length(const char *s, unsigned int len) {
+	const unsigned char *us = reinterpret_cast<const unsigned char *>(s);
 	unsigned int ulen = 0;
-	unsigned int charLen;
-	for (unsigned int i=0; i<len;) {
-		unsigned char ch = static_cast<unsigned char>(s[i]);
-		if (ch < 0x80) {
-			charLen = 1;
-		} else if (ch < 0x80 + 0x40 + 0x20) {
-			charLen = 2;
-		} else if (ch < 0x80 + 0x40 + 0x20 + 0x10) {
-			charLen = 3;
-		} else {
-			charLen = 4;
-			ulen++;
+	unsigned int i = 0;
+	while (i < len) {
+		if ((i + asciiBlock <= len) && IsASCIIBlock(us + i)) {
+			ulen += asciiBlock;
+			i += asciiBlock;
+			continue;
+		}
+		const unsigned int blockEnd = (i + asciiBlock < len) ? (i + asciiBlock) : len;
+		while (i < blockEnd) {
+			const unsigned int value = DecodeUTF8(us, len, i);
+			ulen += (value >= SUPPLEMENTAL_PLANE_FIRST) ? 2 : 1;
 		}
-		i += charLen;
-		ulen++;
 	}
 	return ulen;
 }
 
 unsigned int UTF16FromUTF8(const char *s, unsigned int len, wchar_t *tbuf, unsigned int tlen) {
-	unsigned int ui=0;
 	const unsigned char *us = reinterpret_cast<const unsigned char *>(s);
+	unsigned int ui=0;
 	unsigned int i=0;
 	while ((i<len) && (ui<tlen)) {
-		unsigned char ch = us[i++];
-		if (ch < 0x80) {
-			tbuf[ui] = ch;
-		} else if (ch < 0x80 + 0x40 + 0x20) {
-			tbuf[ui] = static_cast<wchar_t>((ch & 0x1F) << 6);
-			ch = us[i++];
-			tbuf[ui] = static_cast<wchar_t>(tbuf[ui] + (ch & 0x7F));
-		} else if (ch < 0x80 + 0x40 + 0x20 + 0x10) {
-			tbuf[ui] = static_cast<wchar_t>((ch & 0xF) << 12);
-			ch = us[i++];
-			tbuf[ui] = static_cast<wchar_t>(tbuf[ui] + ((ch & 0x7F) << 6));
-			ch = us[i++];
-			tbuf[ui] = static_cast<wchar_t>(tbuf[ui] + (ch & 0x7F));
-		} else {
-			// Outside the BMP so need two surrogates
-			int val = (ch & 0x7) << 18;
-			ch = us[i++];
-			val += (ch & 0x3F) << 12;
-			ch = us[i++];
-			val += (ch & 0x3F) << 6;
-			ch = us[i++];
-			val += (ch & 0x3F);
-			tbuf[ui] = static_cast<wchar_t>(((val - 0x10000) >> 10) + SURROGATE_LEAD_FIRST);
-			ui++;
-			tbuf[ui] = static_cast<wchar_t>((val & 0x3ff) + SURROGATE_TRAIL_FIRST);
+		if ((i + asciiBlock <= len) && (ui + asciiBlock <= tlen) && IsASCIIBlock(us + i)) {
+			WidenASCIIBlock(us + i, tbuf + ui);
+			ui += asciiBlock;
+			i += asciiBlock;
+			continue;
+		}
+		const unsigned int blockEnd = (i + asciiBlock < len) ? (i + asciiBlock) : len;
+		while ((i < blockEnd) && (ui < tlen)) {
+			const unsigned int value = DecodeUTF8(us, len, i);
+			if (value >= SUPPLEMENTAL_PLANE_FIRST) {
+				// Outside the BMP so need two surrogates
+				if (ui + 2 > tlen)
+					return ui;
+				tbuf[ui++] = static_cast<wchar_t>(((value - SUPPLEMENTAL_PLANE_FIRST) >> 10) + SURROGATE_LEAD_FIRST);
+				tbuf[ui++] = static_cast<wchar_t>((value & 0x3ff) + SURROGATE_TRAIL_FIRST);
+			} else {
+				tbuf[ui++] = static_cast<wchar_t>(value);
+			}
 		}
-		ui++;
 	}
 	return ui;
 }
@@ -5,6 +5,10 @@
 // Copyright 1998-2001 by Neil Hodgson <neilh@scintilla.org>
 // The License.txt file describes the conditions under which this software may be distributed.
 
+const unsigned int UNICODE_REPLACEMENT_CHAR = 0xFFFD;
+
+// Conversions validate their input: malformed UTF-8 and unpaired UTF-16 surrogates
+// are converted to UNICODE_REPLACEMENT_CHAR.
 unsigned int UTF8Length(const wchar_t *uptr, unsigned int tlen);
 void UTF8FromUTF16(const wchar_t *uptr, unsigned int tlen, char *putf, unsigned int len);
 unsigned int UTF8CharLength(unsigned char ch);
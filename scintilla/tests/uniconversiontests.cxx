@@ -0,0 +1,304 @@
+// Scintilla source code edit control
+/** @file uniconversiontests.cxx
+ ** Checks the UTF-8 and UTF-16 conversions against a scalar reference and
+ ** reports how fast both of them are.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "UniConversion.h"
+
+static int failureCount = 0;
+
+static void Check(bool condition, const char *what, size_t where) {
+	if (!condition) {
+		fprintf(stderr, "FAILED: %s at %u\n", what, static_cast<unsigned int>(where));
+		failureCount++;
+	}
+}
+
+// Decodes one character by the table of well-formed UTF-8 sequences in the
+// Unicode standard. Anything else decodes as U+FFFD and uses up one byte.
+static unsigned int ReferenceDecodeUTF8(const unsigned char *us, size_t len, size_t &i) {
+	const unsigned char lead = us[i];
+	size_t trail = 0;
+	unsigned char secondLow = 0x80;
+	unsigned char secondHigh = 0xBF;
+	if (lead < 0x80) {
+		i++;
+		return lead;
+	} else if (lead >= 0xC2 && lead <= 0xDF) {
+		trail = 1;
+	} else if (lead >= 0xE0 && lead <= 0xEF) {
+		trail = 2;
+		if (lead == 0xE0)
+			secondLow = 0xA0;
+		else if (lead == 0xED)
+			secondHigh = 0x9F;
+	} else if (lead >= 0xF0 && lead <= 0xF4) {
+		trail = 3;
+		if (lead == 0xF0)
+			secondLow = 0x90;
+		else if (lead == 0xF4)
+			secondHigh = 0x8F;
+	}
+	if (trail == 0 || i + trail >= len || us[i+1] < secondLow || us[i+1] > secondHigh) {
+		i++;
+		return UNICODE_REPLACEMENT_CHAR;
+	}
+	unsigned int value = lead & (0x7F >> (trail + 1));
+	for (size_t j = 1; j <= trail; j++) {
+		if ((us[i+j] & 0xC0) != 0x80) {
+			i++;
+			return UNICODE_REPLACEMENT_CHAR;
+		}
+		value = (value << 6) | (us[i+j] & 0x3F);
+	}
+	i += trail + 1;
+	return value;
+}
+
+static std::vector<wchar_t> ReferenceUTF16FromUTF8(const std::string &s) {
+	const unsigned char *us = reinterpret_cast<const unsigned char *>(s.data());
+	std::vector<wchar_t> utf16;
+	utf16.reserve(s.size());
+	size_t i = 0;
+	while (i < s.size()) {
+		const unsigned int value = ReferenceDecodeUTF8(us, s.size(), i);
+		if (value >= 0x10000) {
+			utf16.push_back(static_cast<wchar_t>(0xD800 + ((value - 0x10000) >> 10)));
+			utf16.push_back(static_cast<wchar_t>(0xDC00 + (value & 0x3FF)));
+		} else {
+			utf16.push_back(static_cast<wchar_t>(value));
+		}
+	}
+	return utf16;
+}
+
+static std::string ReferenceUTF8FromUTF16(const std::vector<wchar_t> &utf16) {
+	std::string s;
+	s.reserve(utf16.size() * 3);
+	for (size_t i = 0; i < utf16.size() && utf16[i]; i++) {
+		unsigned int value = utf16[i];
+		if (value >= 0xD800 && value <= 0xDBFF && i + 1 < utf16.size() &&
+			utf16[i+1] >= 0xDC00 && utf16[i+1] <= 0xDFFF) {
+			value = 0x10000 + ((value & 0x3FF) << 10) + (utf16[i+1] & 0x3FF);
+			i++;
+		} else if (value >= 0xD800 && value <= 0xDFFF) {
+			value = UNICODE_REPLACEMENT_CHAR;
+		}
+		if (value < 0x80) {
+			s.push_back(static_cast<char>(value));
+		} else if (value < 0x800) {
+			s.push_back(static_cast<char>(0xC0 | (value >> 6)));
+			s.push_back(static_cast<char>(0x80 | (value & 0x3F)));
+		} else if (value < 0x10000) {
+			s.push_back(static_cast<char>(0xE0 | (value >> 12)));
+			s.push_back(static_cast<char>(0x80 | ((value >> 6) & 0x3F)));
+			s.push_back(static_cast<char>(0x80 | (value & 0x3F)));
+		} else {
+			s.push_back(static_cast<char>(0xF0 | (value >> 18)));
+			s.push_back(static_cast<char>(0x80 | ((value >> 12) & 0x3F)));
+			s.push_back(static_cast<char>(0x80 | ((value >> 6) & 0x3F)));
+			s.push_back(static_cast<char>(0x80 | (value & 0x3F)));
+		}
+	}
+	return s;
+}
+
+static std::vector<wchar_t> ToUTF16(const std::string &s) {
+	const unsigned int len = static_cast<unsigned int>(s.size());
+	std::vector<wchar_t> utf16(UTF16Length(s.data(), len));
+	const unsigned int converted = UTF16FromUTF8(s.data(), len, utf16.data(), static_cast<unsigned int>(utf16.size()));
+	utf16.resize(converted);
+	return utf16;
+}
+
+static std::string ToUTF8(const std::vector<wchar_t> &utf16) {
+	const unsigned int tlen = static_cast<unsigned int>(utf16.size());
+	// The terminator goes after len bytes, and a multi-byte character is
+	// only written with a byte to spare
+	const unsigned int len = UTF8Length(utf16.data(), tlen) + 1;
+	std::string s(len + 1, '\0');
+	UTF8FromUTF16(utf16.data(), tlen, &s[0], len);
+	s.resize(strlen(s.c_str()));
+	return s;
+}
+
+static void CheckUTF8(const std::string &s, size_t where) {
+	const std::vector<wchar_t> expected = ReferenceUTF16FromUTF8(s);
+	Check(UTF16Length(s.data(), static_cast<unsigned int>(s.size())) == expected.size(), "UTF16Length", where);
+	Check(ToUTF16(s) == expected, "UTF16FromUTF8", where);
+}
+
+static void CheckUTF16(const std::vector<wchar_t> &utf16, size_t where) {
+	const std::string expected = ReferenceUTF8FromUTF16(utf16);
+	Check(UTF8Length(utf16.data(), static_cast<unsigned int>(utf16.size())) == expected.size(), "UTF8Length", where);
+	Check(ToUTF8(utf16) == expected, "UTF8FromUTF16", where);
+}
+
+// Malformed sequences, put at every offset around the end of a 16 byte block
+// so that they are met by the ASCII fast path as well as by the decoder
+static void TestMalformed() {
+	const char *sequences[] = {
+		"\x80", "\xBF", "\xC0\x80", "\xC1\xBF", "\xC2", "\xE0\x80\x80", "\xE0\x9F\xBF", "\xE2\x82",
+		"\xED\xA0\x80", "\xED\xBF\xBF", "\xF0\x8F\xBF\xBF", "\xF4\x90\x80\x80", "\xF5\x80\x80\x80",
+		"\xFF", "\xF0\x9F\x98", "\xE2\x82\xAC", "\xF0\x9F\x98\x80", "\xEF\xBF\xBD", "\xC3\xA9",
+	};
+	for (size_t j = 0; j < sizeof(sequences) / sizeof(sequences[0]); j++) {
+		for (size_t offset = 0; offset < 40; offset++) {
+			std::string s(offset, 'a');
+			s += sequences[j];
+			CheckUTF8(s, j * 100 + offset);
+			s += std::string(20, 'b');
+			CheckUTF8(s, j * 100 + offset);
+		}
+	}
+}
+
+static void TestUnpairedSurrogates() {
+	const wchar_t sequences[][2] = {
+		{0xD800, 'x'}, {0xDC00, 'x'}, {0xDBFF, 0xDBFF}, {0xDFFF, 0xD800}, {0xD83D, 0xDE00}, {0x20AC, 0xFFFD},
+	};
+	for (size_t j = 0; j < sizeof(sequences) / sizeof(sequences[0]); j++) {
+		for (size_t offset = 0; offset < 40; offset++) {
+			std::vector<wchar_t> utf16(offset, 'a');
+			utf16.insert(utf16.end(), sequences[j], sequences[j] + 2);
+			CheckUTF16(utf16, j * 100 + offset);
+			// A lead surrogate as the last unit has no trail to pair with
+			utf16.resize(offset + 1);
+			CheckUTF16(utf16, j * 100 + offset);
+		}
+	}
+}
+
+// Random bytes, mostly ASCII with runs of lead and trail bytes, so that both
+// valid and malformed sequences turn up
+static void TestRandom() {
+	srand(28);
+	for (size_t round = 0; round < 20000; round++) {
+		std::string s(rand() % 64, '\0');
+		for (size_t j = 0; j < s.size(); j++) {
+			const int kind = rand() % 4;
+			s[j] = static_cast<char>(kind < 2 ? 0x20 + rand() % 0x5F : (kind == 2 ? 0x80 + rand() % 0x40 : 0xC0 + rand() % 0x40));
+		}
+		CheckUTF8(s, round);
+
+		std::vector<wchar_t> utf16(rand() % 64);
+		for (size_t j = 0; j < utf16.size(); j++) {
+			const int kind = rand() % 4;
+			utf16[j] = static_cast<wchar_t>(kind < 2 ? 0x20 + rand() % 0x5F : (kind == 2 ? 0xD800 + rand() % 0x800 : 1 + rand() % 0xFFFF));
+		}
+		CheckUTF16(utf16, round);
+	}
+}
+
+// A buffer that is too short ends the output at the last character that fits
+static void TestShortBuffers() {
+	const std::vector<wchar_t> utf16 = ReferenceUTF16FromUTF8("abcdefghijklmnop\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80xyz");
+	const std::string whole = ReferenceUTF8FromUTF16(utf16);
+	for (size_t len = 1; len <= whole.size() + 1; len++) {
+		std::string s(len + 1, '\x7F');
+		UTF8FromUTF16(utf16.data(), static_cast<unsigned int>(utf16.size()), &s[0], static_cast<unsigned int>(len));
+		const size_t written = strlen(s.c_str());
+		Check(written <= len, "UTF8FromUTF16 terminates within the buffer", len);
+		Check(whole.compare(0, written, s.c_str()) == 0, "UTF8FromUTF16 writes a prefix", len);
+	}
+}
+
+// Text like the JSON the editor opens, with a non-ASCII character at every
+// nonASCIIEvery characters or none when it is 0
+static std::string SampleText(size_t size, size_t nonASCIIEvery) {
+	const char *fragment = "{\"id\": 12345, \"name\": \"example\", \"tags\": [\"alpha\", \"beta\"]},\n";
+	std::string s;
+	s.reserve(size + 64);
+	size_t count = 0;
+	while (s.size() < size) {
+		for (const char *p = fragment; *p; p++) {
+			s.push_back(*p);
+			if (nonASCIIEvery && (++count % nonASCIIEvery == 0))
+				s += "\xC3\xA9";
+		}
+	}
+	return s;
+}
+
+template <typename Function>
+static double MegabytesPerSecond(size_t bytes, Function function) {
+	const int repeats = 3;
+	double best = 0.0;
+	for (int r = 0; r < repeats; r++) {
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		function();
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		const double rate = bytes / (1024.0 * 1024.0) / (seconds > 0.0 ? seconds : 1e-9);
+		best = (rate > best) ? rate : best;
+	}
+	return best;
+}
+
+// Reports the throughput of the conversions next to the scalar reference.
+// The numbers depend on the machine so they are printed, not checked.
+static void Benchmark() {
+	const size_t size = 8 * 1024 * 1024;
+	const size_t mixes[] = {0, 64, 4};
+	for (size_t m = 0; m < sizeof(mixes) / sizeof(mixes[0]); m++) {
+		const std::string text = SampleText(size, mixes[m]);
+		const unsigned int len = static_cast<unsigned int>(text.size());
+		std::vector<wchar_t> utf16(UTF16Length(text.data(), len));
+		const unsigned int tlen = static_cast<unsigned int>(utf16.size());
+		std::string utf8(text.size() + 2, '\0');
+		size_t sink = 0;
+
+		const double length16 = MegabytesPerSecond(text.size(), [&]() {
+			sink += UTF16Length(text.data(), len);
+		});
+		const double to16 = MegabytesPerSecond(text.size(), [&]() {
+			sink += UTF16FromUTF8(text.data(), len, utf16.data(), tlen);
+		});
+		const double to8 = MegabytesPerSecond(text.size(), [&]() {
+			UTF8FromUTF16(utf16.data(), tlen, &utf8[0], len + 1);
+			sink += utf8[0];
+		});
+		const double length8 = MegabytesPerSecond(text.size(), [&]() {
+			sink += UTF8Length(utf16.data(), tlen);
+		});
+		const double reference16 = MegabytesPerSecond(text.size(), [&]() {
+			sink += ReferenceUTF16FromUTF8(text).size();
+		});
+		const double reference8 = MegabytesPerSecond(text.size(), [&]() {
+			sink += ReferenceUTF8FromUTF16(utf16).size();
+		});
+
+		Check(utf8.compare(0, text.size(), text) == 0, "round trip of the sample", mixes[m]);
+		if (mixes[m])
+			printf("one non-ASCII character in %u:", static_cast<unsigned int>(mixes[m]));
+		else
+			printf("ASCII only:");
+		printf(" UTF16Length %.0f MB/s, UTF16FromUTF8 %.0f MB/s (reference %.0f), "
+			"UTF8FromUTF16 %.0f MB/s (reference %.0f), UTF8Length %.0f MB/s [%u]\n",
+			length16, to16, reference16, to8, reference8, length8, static_cast<unsigned int>(sink & 1));
+	}
+}
+
+int main() {
+	TestMalformed();
+	TestUnpairedSurrogates();
+	TestRandom();
+	TestShortBuffers();
+	Benchmark();
+
+	if (failureCount > 0) {
+		fprintf(stderr, "%d failed\n", failureCount);
+		return 1;
+	}
+	printf("passed\n");
+	return 0;
+}